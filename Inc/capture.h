@@ -0,0 +1,150 @@
+/**
+ * @file capture.h
+ *
+ * @brief Compact binary format of raw pulse captures (shared between the
+ * firmware and the host tools).
+ *
+ * @details A capture starts with a CAPTURE_HEADER_SIZE-byte header:
+ *
+ * Offset | Size | Description
+ * -------|------|------------
+ * 0      | 4    | magic "DSPC"
+ * 4      | 1    | version (CAPTURE_VERSION)
+ * 5      | 1    | flags (see CAPTURE_FLAG_XXX declarations)
+ * 6      | 2    | timer tick in nanosec (little endian)
+ * 8      | 8    | start time in microsec since epoch, 0 if unknown (little endian)
+ *
+ * Each record is an unsigned LEB128 varint of (zigzag(value - previous
+ * value of the channel) << 2 | channel), i.e. durations are delta encoded
+ * per channel; durations longer than CAPTURE_DURATION_MAX ticks (idle
+ * gaps) are clamped to it. Event records hold (event << 2 |
+ * CAPTURE_CHANNEL_EVENT) followed by a varint argument. With
+ * CAPTURE_FLAG_TIMESTAMPS each record is followed by a varint of the
+ * timestamp delta in timer ticks.
+ *
+ * Over the UART (sniffer mode) the records are sent in blocks so that the
+ * host can synchronise on a running stream and detect lost blocks:
+ *
+ * Offset | Size | Description
+ * -------|------|------------
+ * 0      | 2    | sync CAPTURE_BLOCK_SYNC_0, CAPTURE_BLOCK_SYNC_1
+ * 2      | 1    | payload length N (up to CAPTURE_BLOCK_PAYLOAD_MAX)
+ * 3      | 1    | block sequence number (modulo 256)
+ * 4      | N    | records (the delta encoding restarts in each block)
+ * 4 + N  | 1    | CRC8 (polynomial 0x31) of bytes 2 to 3 + N
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* header */
+#define CAPTURE_MAGIC        "DSPC"
+#define CAPTURE_VERSION      1
+#define CAPTURE_HEADER_SIZE  16
+
+/* header flags */
+#define CAPTURE_FLAG_TIMESTAMPS  0x01
+
+/* 433 MHz idle timeout of the firmware in microsec: the decoders are flushed after this gap (CAPTURE_EVENT_IDLE) */
+#define CAPTURE_IDLE_TIMEOUT_US  150000  /* 150 ms */
+
+/* longest encoded duration in ticks (2^28 - 1, longer ones are clamped) */
+#define CAPTURE_DURATION_MAX  0x0FFFFFFFu
+
+/* maximal size of an encoded record in bytes (3 varints of 5 bytes) */
+#define CAPTURE_RECORD_MAX  15
+
+/* stream blocks */
+#define CAPTURE_BLOCK_SYNC_0        0xD5
+#define CAPTURE_BLOCK_SYNC_1        0x5C
+#define CAPTURE_BLOCK_HEADER_SIZE   4
+#define CAPTURE_BLOCK_PAYLOAD_MAX   120
+#define CAPTURE_BLOCK_SIZE_MAX      (CAPTURE_BLOCK_HEADER_SIZE + CAPTURE_BLOCK_PAYLOAD_MAX + 1)
+
+
+/**
+ * Record channels.
+ */
+typedef enum {
+  CAPTURE_CHANNEL_RADIO = 0, /*!< 433 MHz durations (timer channel 3) */
+  CAPTURE_CHANNEL_DHT22 = 1, /*!< DHT22 durations (timer channel 1) */
+  CAPTURE_CHANNEL_RESERVED = 2,
+  CAPTURE_CHANNEL_EVENT = 3, /*!< events (see CAPTURE_EVENT_e) */
+  CAPTURE_CHANNEL_NUMBER
+} CAPTURE_CHANNEL_e;
+
+/**
+ * Events.
+ */
+typedef enum {
+  CAPTURE_EVENT_IDLE = 0, /*!< 433 MHz idle timeout (decoders are flushed) */
+  CAPTURE_EVENT_DHT22_START = 1, /*!< DHT22 conversion start (previous one is analysed) */
+  CAPTURE_EVENT_DROPPED = 2 /*!< argument: number of dropped durations */
+} CAPTURE_EVENT_e;
+
+/**
+ * Capture header.
+ */
+typedef struct {
+  uint8_t version; /*!< format version */
+  uint8_t flags; /*!< see CAPTURE_FLAG_XXX declarations */
+  uint16_t tick_ns; /*!< timer tick in nanosec */
+  uint64_t start_us; /*!< start time in microsec since epoch (0 if unknown) */
+} CAPTURE_header_t;
+
+/**
+ * Decoded record.
+ */
+typedef struct {
+  int32_t channel; /*!< see CAPTURE_CHANNEL_e */
+  uint32_t value; /*!< duration in ticks or event (see CAPTURE_EVENT_e) */
+  uint32_t argument; /*!< event argument */
+  uint32_t timestamp; /*!< timestamp in ticks (with CAPTURE_FLAG_TIMESTAMPS) */
+} CAPTURE_record_t;
+
+/**
+ * Encoder/decoder state (previous values of the delta encoding).
+ */
+typedef struct {
+  uint8_t flags; /*!< see CAPTURE_FLAG_XXX declarations */
+  uint32_t previous[CAPTURE_CHANNEL_NUMBER]; /*!< previous value per channel */
+  uint32_t timestamp; /*!< previous timestamp */
+} CAPTURE_codec_t;
+
+
+int32_t CAPTURE_HeaderWrite(uint8_t * buffer, const CAPTURE_header_t * header);
+int32_t CAPTURE_HeaderRead(const uint8_t * buffer, int32_t len, CAPTURE_header_t * header);
+void CAPTURE_CodecInit(CAPTURE_codec_t * codec, uint8_t flags);
+int32_t CAPTURE_Encode(CAPTURE_codec_t * codec, uint8_t * buffer, const CAPTURE_record_t * record);
+int32_t CAPTURE_Decode(CAPTURE_codec_t * codec, const uint8_t * buffer, int32_t len, CAPTURE_record_t * record);
+uint8_t CAPTURE_Crc8(const uint8_t * buffer, int32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
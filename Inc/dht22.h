@@ -24,10 +24,20 @@
 #define DHT22_H_
 
 #include <stdint.h>
-#include "stm32f1xx_hal.h"
 
-void DHT22_Init(TIM_HandleTypeDef * htim_us, GPIO_TypeDef * gpio_port, int32_t gpio_pin);
-int32_t DHT22_AnalyseData(uint32_t * buffer, int32_t len, uint32_t * temper, uint32_t * rh);
+/* GPIO and timer of the platform (simulated on a host build, see DHT22_HOST) */
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void DHT22_Init(PLATFORM_timer_t * htim_us, PLATFORM_port_t * gpio_port, int32_t gpio_pin);
 void DHT22_StartSensor(void);
+int32_t DHT22_AnalyseData(const uint16_t * buffer, int32_t len, uint32_t * temper, uint32_t * rh);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* DHT22_H_ */
@@ -0,0 +1,131 @@
+/**
+ * @file flashlog.h
+ *
+ * @brief Persistent log of the readings that could not be delivered to the
+ * Linux server, in spare pages of the internal flash.
+ *
+ * @details The log is append-only: fixed-size records are programmed one
+ * after the other in a page, then in the next page of the area. A full area
+ * goes on with its oldest page (page rotation): each page is erased once per
+ * turn of the area, so that the erase cycles are spread evenly. The pages
+ * and the records are numbered by sequence numbers (record sequence = page
+ * sequence * FLASHLOG_RECORDS_PER_PAGE + slot).
+ *
+ * Page header (FLASHLOG_HEADER_SIZE bytes, little endian half-words):
+ *
+ * Offset | Size | Description
+ * -------|------|------------
+ * 0      | 2    | FLASHLOG_MAGIC, programmed last (the header is complete)
+ * 2      | 4    | page sequence number
+ * 6      | 2    | check: complement of the XOR of the sequence half-words
+ *
+ * Record (FLASHLOG_RECORD_SIZE bytes):
+ *
+ * Offset | Size | Description
+ * -------|------|------------
+ * 0      | 1    | channel (see SENSORS_CHANNEL_e), programmed last with:
+ * 1      | 1    | CRC8 (see CAPTURE_Crc8()) of the channel, value and time
+ * 2      | 4    | value (scaled as published)
+ * 6      | 4    | time: seconds since epoch if >= FLASHLOG_TIME_WALL, otherwise seconds since boot
+ *
+ * A power loss leaves at most one torn record (skipped) or one page without
+ * header (erased again): the recovery scan at the initialisation reads the
+ * page headers, then looks for the end of the last page by bisection. The
+ * magic of a page is cleared (0x0000 can be programmed over any half-word)
+ * before its erase, so that a partial erase is never taken for a valid page.
+ *
+ * The appends are staged in RAM (FLASHLOG_Append() is a copy) and
+ * programmed one by one by FLASHLOG_Commit() out of the time critical
+ * paths. Staged records are dropped by FLASHLOG_Delivered() when the Linux
+ * server acknowledges the live messages. Called from the main loop only.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* flash geometry (STM32F100xB: 1 KB pages programmed by half-words) */
+#define FLASHLOG_PAGE_SIZE    1024
+#define FLASHLOG_HEADER_SIZE  8
+#define FLASHLOG_RECORD_SIZE  10
+#define FLASHLOG_RECORDS_PER_PAGE  ((FLASHLOG_PAGE_SIZE - FLASHLOG_HEADER_SIZE) / FLASHLOG_RECORD_SIZE)
+
+/* page header marker */
+#define FLASHLOG_MAGIC  0x4C46  /* "FL" */
+
+/* records staged in RAM (power of 2), the oldest ones are lost beyond */
+#define FLASHLOG_STAGE_SIZE  32
+
+/* record times from this value are in seconds since epoch (2001-09-09) */
+#define FLASHLOG_TIME_WALL  1000000000u
+
+
+/**
+ * Flash backend (internal flash of the target, simulated flash on the host).
+ */
+typedef struct {
+  const uint8_t * base; /*!< memory-mapped log area (read directly) */
+  int32_t pages; /*!< pages of the area (at least 2) */
+  int32_t (*program)(uint32_t offset, uint16_t value); /*!< programs an erased half-word, 0 if ok */
+  int32_t (*erase)(uint32_t offset); /*!< erases the page at this offset, 0 if ok */
+} FLASHLOG_flash_t;
+
+/**
+ * Logged reading.
+ */
+typedef struct {
+  uint32_t channel; /*!< published channel (see SENSORS_CHANNEL_e), below 255 */
+  int32_t value; /*!< published value */
+  uint32_t time; /*!< see FLASHLOG_TIME_WALL */
+} FLASHLOG_record_t;
+
+/**
+ * Log state and counters.
+ */
+typedef struct {
+  uint32_t first; /*!< sequence of the oldest record in flash */
+  uint32_t next; /*!< sequence of the next programmed record */
+  uint32_t boot; /*!< sequence of the first record of this boot */
+  uint32_t staged; /*!< records waiting in RAM */
+  uint32_t lost; /*!< staged records lost (RAM full) */
+  uint32_t torn; /*!< torn records or pages found by the recovery scan */
+  uint32_t erases; /*!< page erases since the initialisation */
+  uint32_t errors; /*!< failed flash operations */
+} FLASHLOG_stats_t;
+
+
+int32_t FLASHLOG_Init(const FLASHLOG_flash_t * flash);
+void FLASHLOG_Append(uint32_t channel, int32_t value, uint32_t time);
+void FLASHLOG_Delivered(void);
+int32_t FLASHLOG_Commit(void);
+int32_t FLASHLOG_Read(uint32_t sequence, FLASHLOG_record_t * record);
+void FLASHLOG_StatsGet(FLASHLOG_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file glitch.h
+ *
+ * @brief Glitch suppression of the 433 MHz falling edges: an interval
+ * shorter than a runt threshold is merged into the next duration instead of
+ * being dropped (no hardware dependency, shared with the host tools).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef GLITCH_H
+#define GLITCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* default runt threshold in timer ticks (microsec) */
+#define GLITCH_MERGE_TICKS_DEFAULT  400
+
+/* default input filter of the timer (ICxF: fDTS/32, N=8, about 10 microsec at 24 MHz) */
+#define GLITCH_HW_FILTER_DEFAULT  0xF
+
+
+/**
+ * Handling of a runt interval.
+ */
+typedef enum {
+  GLITCH_MODE_MERGE = 0, /*!< the runt edge is ignored, the next duration keeps the last valid edge */
+  GLITCH_MODE_DROP = 1 /*!< the runt interval is dropped, the next duration starts at the runt edge */
+} GLITCH_MODE_e;
+
+/**
+ * Runtime configuration.
+ */
+typedef struct {
+  uint32_t hw_filter; /*!< timer input filter (ICxF, 0 to 15, applied by the caller) */
+  uint32_t merge_ticks; /*!< intervals below are runts (0 - off) */
+  int32_t mode; /*!< see GLITCH_MODE_e */
+} GLITCH_config_t;
+
+/**
+ * Filter state and counters.
+ */
+typedef struct {
+  uint32_t reference; /*!< timestamp of the last valid edge */
+  uint32_t edges; /*!< falling edges */
+  uint32_t merged; /*!< runt edges merged into the next duration */
+  uint32_t dropped; /*!< runt intervals dropped */
+} GLITCH_state_t;
+
+
+void GLITCH_Init(GLITCH_state_t * state, uint32_t timestamp);
+int32_t GLITCH_Edge(GLITCH_state_t * state, const GLITCH_config_t * config, uint32_t timestamp, uint32_t * duration);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,36 +27,124 @@
 #ifndef LACROSSE_H
 #define LACROSSE_H
 
-/* code shared with Arduino 433 MHz transmitter, not debugged yet */
-#ifdef STM32F100xB
-#define STM32_RX_ONLY_ENABLED
-#else 
-#define ARDUINO_RX_TX_ENABLED
-#endif
+#include <stdint.h>
 
-/* include arduino header */
-#ifdef ARDUINO_RX_TX_ENABLED
-#include "Arduino.h"
-#endif
+/* STM32 receiver, Arduino transmitter or host tools (see LACROSSE_HOST) */
+#include "platform.h"
 
 /* module version */
 #define LACROSSE_VERSION  "0.02"
 
+/* repeats of a frame sent by a transmitter in one burst */
+#define LACROSSE_REPEAT_NUMBER  12
+
+/* durations which can start a frame in microsec (start bit with calibration) */
+#define LACROSSE_START_LOW   1400
+#define LACROSSE_START_HIGH  1900
+
+/**
+ * Symbol classes of the receiver.
+ */
+typedef enum {
+  LACROSSE_SYMBOL_START = 0, /*!< 'start bit' */
+  LACROSSE_SYMBOL_FIRST, /*!< transition from 'start bit' to '1' */
+  LACROSSE_SYMBOL_SHORT, /*!< transition from '1' to '0' */
+  LACROSSE_SYMBOL_MEDIUM, /*!< transitions from '0' to '0' and from '1' to '1' */
+  LACROSSE_SYMBOL_LONG, /*!< transition from '0' to '1' */
+  LACROSSE_SYMBOL_NUMBER
+} LACROSSE_SYMBOL_e;
+
+/**
+ * Receiver window of a symbol class.
+ */
+typedef struct {
+  uint32_t low; /*!< lower duration limit in microsec (excluded) */
+  uint32_t high; /*!< upper duration limit in microsec (excluded) */
+  uint32_t centre; /*!< estimated cluster centre in microsec */
+  uint32_t count; /*!< number of histogram samples used for the estimation */
+} LACROSSE_window_t;
+
+/**
+ * Receiver statistics.
+ */
+typedef struct {
+  uint32_t frames; /*!< frames with a valid checksum */
+  uint32_t crc_errors; /*!< complete frames with an invalid checksum */
+} LACROSSE_stats_t;
+
+/**
+ * Link quality of the last complete 40-bit word (valid or not).
+ */
+typedef struct {
+  uint32_t sync; /*!< sync byte (sensor ID), not reliable with an invalid checksum */
+  uint32_t valid; /*!< 1 if the checksum is valid */
+  uint32_t jitter_mean; /*!< mean deviation of the durations from the nominal window centres in microsec */
+  uint32_t jitter_max; /*!< maximal deviation in microsec */
+} LACROSSE_word_t;
+
 /* STM32 C functions */ 
-#ifdef STM32_RX_ONLY_ENABLED
+#ifdef PLATFORM_STM32
 
 #ifdef __cplusplus
 extern "C"
 #endif
 uint32_t LACROSSE_input_handler_c(uint32_t duration_usec);
+#ifdef __cplusplus
+extern "C"
+#endif
+uint32_t LACROSSE_flush_c(void);
+#ifdef __cplusplus
+extern "C"
+#endif
+uint32_t LACROSSE_is_idle_c(void);
+#ifdef __cplusplus
+extern "C"
+#endif
+void LACROSSE_stats_get_c(LACROSSE_stats_t * stats);
+#ifdef __cplusplus
+extern "C"
+#endif
+void LACROSSE_calib_get_c(LACROSSE_window_t * windows);
+#ifdef __cplusplus
+extern "C"
+#endif
+void LACROSSE_calib_reset_c(void);
+#ifdef __cplusplus
+extern "C"
+#endif
+uint32_t LACROSSE_word_get_c(LACROSSE_word_t * word);
 
 #endif
 
-/* Arduino C++ functions */ 
-#ifdef ARDUINO_RX_TX_ENABLED 
+/* transmitter C++ functions (Arduino, host tools) */
+#ifdef PLATFORM_RADIO_TX
+
+/* maximal number of levels in a schedule (scaling + 4 start bits + 40 bits) */
+#define LACROSSE_SCHEDULE_SIZE  (2 + 2 * (4 + 40))
+
+/**
+ * Transmitter edge schedule: durations of alternate levels, high first.
+ */
+typedef struct {
+  uint16_t duration[LACROSSE_SCHEDULE_SIZE]; /*!< level durations in microsec */
+  int32_t size; /*!< number of durations */
+  int32_t repeat_start; /*!< first duration of a repeat (after scaling) */
+  int32_t index; /*!< next duration to play */
+  int32_t repeat; /*!< current repeat */
+} LACROSSE_schedule_t;
 
-void LACROSSE_init(void (*pin_switch)(int32_t), void (*sleep_us)(int32_t));
+void LACROSSE_init(void);
+void LACROSSE_schedule_build(LACROSSE_schedule_t * schedule, uint32_t sync, uint32_t data);
+int32_t LACROSSE_schedule_next(LACROSSE_schedule_t * schedule, int32_t * level, uint32_t * duration_usec);
+uint32_t LACROSSE_output_start(uint32_t sync, uint32_t data);
+uint32_t LACROSSE_output_edge(void);
 uint32_t LACROSSE_input_handler(uint32_t duration_usec);
+uint32_t LACROSSE_flush(void);
+uint32_t LACROSSE_is_idle(void);
+void LACROSSE_stats_get(LACROSSE_stats_t * stats);
+void LACROSSE_calib_get(LACROSSE_window_t * windows);
+void LACROSSE_calib_reset(void);
+uint32_t LACROSSE_word_get(LACROSSE_word_t * word);
 void LACROSSE_output_send(uint32_t sync, uint32_t data);
 uint32_t LACROSSE_decrypt_24bits(uint32_t data);
 uint32_t LACROSSE_encrypt_24bits(uint32_t data);
@@ -0,0 +1,76 @@
+/**
+ * @file latency.h
+ *
+ * @brief Latency histograms of the pipeline stages, from the edge capture to
+ * the last UART byte, with power of 2 buckets in microsec.
+ *
+ * @details Bucket 0 counts the latencies of 0 microsec, bucket k the ones
+ * from 2^(k-1) to 2^k - 1 microsec, the last bucket also counts the longer
+ * ones. Probes are recorded from the main loop only.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+/* number of buckets (the last one is 0.5 sec and more, the worst case is in max) */
+#define LATENCY_BUCKET_NUMBER  20
+
+/*      name              channel   stage */
+#define LATENCY_PROBES(X) \
+  X(RADIO_RING,           "radio",  "ring")   /* 433 MHz edge to main loop read */ \
+  X(RADIO_DECODE,         "radio",  "decode") /* last edge of a frame to its handler */ \
+  X(RADIO_UART,           "radio",  "uart")   /* MySensors messages of a frame */ \
+  X(RADIO_TOTAL,          "radio",  "total")  /* last edge of a frame to its last UART byte */ \
+  X(DHT22_DECODE,         "dht22",  "decode") /* last edge of a conversion to its analysis */ \
+  X(DHT22_UART,           "dht22",  "uart")   /* MySensors messages of a conversion */ \
+  X(DHT22_TOTAL,          "dht22",  "total")  /* last edge of a conversion to its last UART byte */ \
+  X(SERVER_ITERATION,     "server", "iter")   /* SERV_Routine() iteration running tasks */
+
+#define LATENCY_ENUM(name, channel, stage)  LATENCY_PROBE_##name,
+
+/**
+ * Probes (one per channel and stage).
+ */
+typedef enum {
+  LATENCY_PROBES(LATENCY_ENUM)
+  LATENCY_PROBE_NUMBER
+} LATENCY_PROBE_e;
+
+/**
+ * Histogram of a probe.
+ */
+typedef struct {
+  uint32_t count; /*!< number of recorded latencies */
+  uint32_t max; /*!< worst case in microsec */
+  uint16_t bucket[LATENCY_BUCKET_NUMBER]; /*!< saturated counts per bucket */
+} LATENCY_histogram_t;
+
+
+void LATENCY_Init(void);
+void LATENCY_Record(int32_t probe, uint32_t usec);
+void LATENCY_Get(int32_t probe, LATENCY_histogram_t * histogram);
+int32_t LATENCY_Format(int32_t probe, char * buffer, int32_t size);
+void LATENCY_Reset(void);
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file linkstats.h
+ *
+ * @brief Link quality of the 433 MHz sensors per sensor ID: received
+ * repeats per burst, checksum errors, pulse jitter and stability of the
+ * interval between bursts.
+ *
+ * @details A burst is the set of repeats of a frame sent at once by a
+ * sensor: frames of an ID closer than LINKSTATS_BURST_GAP_US belong to the
+ * same burst. The statistics are restarted after each report
+ * (LINKSTATS_Reset()), the burst state of the sensors is kept and the IDs
+ * silent during the period are forgotten. Called from the main loop only.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef LINKSTATS_H
+#define LINKSTATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* followed sensor IDs (the next ones are counted as unknown) */
+#define LINKSTATS_SENSOR_NUMBER  8
+
+/* gap between two frames of an ID to end a burst in microsec */
+#define LINKSTATS_BURST_GAP_US  2000000  /* 2 sec */
+
+
+/**
+ * Statistics of a sensor ID.
+ */
+typedef struct {
+  uint32_t jitter_sum; /*!< sum of the mean pulse jitters of the frames in microsec */
+  uint32_t interval_sum; /*!< sum of the intervals in millisec */
+  uint32_t interval_change_sum; /*!< sum of the changes in millisec */
+  uint32_t burst_start; /*!< start of the current burst in microsec */
+  uint32_t burst_last; /*!< last frame of the current burst in microsec */
+  uint32_t interval_last; /*!< last interval in millisec, 0 if none */
+  /* counts of a report period: a sensor sends a few hundred frames in 10 min */
+  uint16_t frames; /*!< frames with a valid checksum */
+  uint16_t crc_errors; /*!< frames of this ID with an invalid checksum */
+  uint16_t bursts; /*!< ended bursts */
+  uint16_t burst_frames; /*!< frames of the ended bursts */
+  uint16_t burst_count; /*!< frames of the current burst, 0 if none */
+  uint16_t intervals; /*!< intervals between burst starts */
+  uint16_t interval_changes; /*!< changes between consecutive intervals */
+  uint16_t jitter_max; /*!< maximal pulse jitter in microsec */
+  uint8_t id; /*!< sensor ID */
+  uint8_t used; /*!< 1 if the entry is used */
+} LINKSTATS_sensor_t;
+
+
+void LINKSTATS_Init(uint32_t repeats);
+void LINKSTATS_Frame(uint32_t id, uint32_t timestamp, uint32_t jitter_mean, uint32_t jitter_max);
+void LINKSTATS_CrcError(uint32_t id);
+int32_t LINKSTATS_Format(int32_t index, uint32_t now, char * buffer, int32_t size);
+void LINKSTATS_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
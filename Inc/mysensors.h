@@ -24,13 +24,73 @@
 #define MYSENSORS_H
 
 #include <stdint.h>
-#include "stm32f1xx_hal.h"
-
-void MYSENSORS_Init(UART_HandleTypeDef * huart);
-void MYSENSORS_LocalTemperSend(int32_t temper);
-void MYSENSORS_LocalHumiditySend(int32_t hum);
-void MYSENSORS_ExtTemperSend(int32_t temper);
-void MYSENSORS_ExtHumiditySend(int32_t hum);
-void MYSENSORS_DebugSend(int32_t debug);
+#include "platform.h"
+
+/*
+ * API UART codes (used by the sensor configuration table).
+ */
+#define MYSENSORS_CHILD_ID_TEMP   0
+#define MYSENSORS_CHILD_ID_HUM    1
+#define MYSENSORS_CHILD_ID_DEBUG  33
+#define MYSENSORS_CHILD_ID_PROFILE  35  /* function profile (profiling variant) */
+#define MYSENSORS_CHILD_ID_LINK  36  /* 433 MHz link quality per sensor ID */
+#define MYSENSORS_CHILD_ID_FLASHLOG  37  /* replay of the persistent reading log */
+#define MYSENSORS_CHILD_ID_LATENCY  40  /* first of the latency probes */
+#define MYSENSORS_CHILD_ID_INTERNAL  255  /* node itself (internal commands) */
+
+#define MYSENSORS_CMD_PRESENTATION   0
+#define MYSENSORS_CMD_SET            1
+#define MYSENSORS_CMD_REQ            2
+#define MYSENSORS_CMD_INTERNAL       3
+
+#define MYSENSORS_ACK_NONE  0
+
+#define MYSENSORS_TYPE_PRES_TEMP    6
+#define MYSENSORS_TYPE_PRES_HUM     7
+#define MYSENSORS_TYPE_PRES_CUSTOM  23
+#define MYSENSORS_TYPE_PRES_INFO    36
+
+#define MYSENSORS_TYPE_SET_TEMP    0
+#define MYSENSORS_TYPE_SET_HUM     1
+#define MYSENSORS_TYPE_SET_VAR1    24
+#define MYSENSORS_TYPE_SET_TEXT    47
+#define MYSENSORS_TYPE_SET_CUSTOM  48
+
+#define MYSENSORS_TYPE_INTERNAL_TIME  1  /* payload: seconds since epoch */
+
+/* maximal length of a text payload in bytes */
+#define MYSENSORS_TEXT_MAX  96
+
+/* maximal length of a received line in bytes (longer lines are dropped) */
+#define MYSENSORS_RX_LINE_MAX  64
+
+
+/**
+ * Payload formats.
+ */
+typedef enum {
+  MYSENSORS_FORMAT_X10 = 0, /*!< value multiplied by 10, sent with one decimal */
+  MYSENSORS_FORMAT_INT = 1, /*!< signed integer */
+  MYSENSORS_FORMAT_UINT = 2 /*!< unsigned integer */
+} MYSENSORS_FORMAT_e;
+
+/**
+ * Received message.
+ */
+typedef struct {
+  int32_t node; /*!< node ID */
+  int32_t child; /*!< child sensor ID */
+  int32_t command; /*!< command (MYSENSORS_CMD_XXX) */
+  int32_t ack; /*!< acknowledge */
+  int32_t type; /*!< value type */
+  char payload[MYSENSORS_RX_LINE_MAX]; /*!< payload (terminated) */
+} MYSENSORS_message_t;
+
+
+void MYSENSORS_Init(PLATFORM_uart_t * huart);
+void MYSENSORS_Send(const char * header, int32_t header_len, int32_t value, int32_t format);
+void MYSENSORS_SendText(int32_t node, int32_t child, int32_t type, const char * text);
+void MYSENSORS_ReceiveStart(void (*ready)(void));
+int32_t MYSENSORS_Receive(MYSENSORS_message_t * message);
 
 #endif
@@ -0,0 +1,39 @@
+/**
+ * @file nexus.h
+ *
+ * @brief Decoder of the Nexus-compatible 433 MHz temperature/humidity sensors
+ * (pulse distance coding, 36 bits, sold under many brands).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef NEXUS_H
+#define NEXUS_H
+
+#include <stdint.h>
+#include "ook.h"
+
+/* durations which can start a frame in microsec (sync gap + pulse) */
+#define NEXUS_SYNC_LOW   3800
+#define NEXUS_SYNC_HIGH  5200
+
+int32_t NEXUS_InputHandler(uint32_t duration, OOK_frame_t * frame);
+int32_t NEXUS_Flush(OOK_frame_t * frame);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file ook.h
+ *
+ * @brief Registry of 433 MHz OOK protocol decoders fed with the same pulses.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef OOK_H
+#define OOK_H
+
+#include <stdint.h>
+
+/* maximal number of registered decoders */
+#define OOK_DECODER_MAX  4
+
+/* decoder status flags */
+#define OOK_FLAG_BUSY   0x1  /* decoder is inside a frame */
+#define OOK_FLAG_FRAME  0x2  /* a frame has been decoded */
+
+
+/**
+ * Decoded temperature/humidity frame.
+ */
+typedef struct
+{
+  uint32_t id; /*!< sensor ID (protocol specific) */
+  int32_t channel; /*!< sensor channel (see sensors_config.h) */
+  int32_t temper; /*!< raw temperature (scaled by the configuration table) */
+  int32_t hum; /*!< raw relative humidity (scaled by the configuration table) */
+  uint32_t timestamp; /*!< time of the last edge of the frame in microsec (set by the registry) */
+} OOK_frame_t;
+
+/**
+ * Protocol decoder description.
+ */
+typedef struct
+{
+  const char * name; /*!< protocol name */
+  int32_t source; /*!< source of the frames (see SENSORS_SOURCE_e) */
+  uint32_t sync_low; /*!< an idle decoder only gets durations above (in microsec) */
+  uint32_t sync_high; /*!< an idle decoder only gets durations below (in microsec) */
+  int32_t (*input)(uint32_t duration, OOK_frame_t * frame); /*!< pulse handler (see OOK_FLAG_XXX) */
+  int32_t (*flush)(OOK_frame_t * frame); /*!< end of burst handler (see OOK_FLAG_XXX) */
+} OOK_decoder_t;
+
+
+void OOK_Init(void (*handler)(const OOK_decoder_t * decoder, const OOK_frame_t * frame));
+int32_t OOK_Register(const OOK_decoder_t * decoder);
+void OOK_InputHandler(uint32_t duration, uint32_t timestamp);
+void OOK_Flush(void);
+
+#endif
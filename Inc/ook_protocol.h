@@ -0,0 +1,222 @@
+/**
+ * @file ook_protocol.h
+ *
+ * @brief Compile-time description of 433 MHz OOK protocols (C++ only).
+ *
+ * @details A protocol is declared as constexpr data (preamble, symbol
+ * windows, number of bits, checksum) and @ref ook_decoder generates its
+ * decoder: the symbol table is unrolled at compile time, so there is no
+ * runtime interpretation of the description.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef OOK_PROTOCOL_H
+#define OOK_PROTOCOL_H
+
+#include <stdint.h>
+
+/* maximal number of symbols in a protocol */
+#define OOK_SYMBOL_MAX  8
+
+/* previous bit required by a symbol */
+#define OOK_PREV_0      0  /* after a '0' */
+#define OOK_PREV_1      1  /* after a '1' */
+#define OOK_PREV_START  2  /* first bit after the preamble */
+#define OOK_PREV_ANY    3  /* any bit or the preamble */
+
+/* handling of the pulse following the last bit */
+#define OOK_TRAILER_CONSUME  0  /* the pulse ends the frame and is dropped */
+#define OOK_TRAILER_RESTART  1  /* the pulse ends the frame and starts a new one */
+
+
+/**
+ * Duration window (both limits excluded).
+ */
+typedef struct {
+  uint32_t low; /*!< lower limit in microsec */
+  uint32_t high; /*!< upper limit in microsec */
+} ook_window_t;
+
+/**
+ * Symbol: a duration window decoded as a bit.
+ */
+typedef struct {
+  ook_window_t window; /*!< duration window */
+  int32_t prev; /*!< required previous bit (see OOK_PREV_XXX declarations) */
+  int32_t bit; /*!< decoded bit */
+} ook_symbol_t;
+
+/**
+ * Protocol description.
+ */
+typedef struct {
+  ook_window_t preamble; /*!< window of a preamble duration */
+  int32_t preamble_number; /*!< number of preamble durations */
+  ook_symbol_t symbol[OOK_SYMBOL_MAX]; /*!< symbols, the first matching one wins */
+  int32_t symbol_number; /*!< number of symbols */
+  int32_t bits; /*!< number of bits in a frame */
+  int32_t trailer; /*!< see OOK_TRAILER_XXX declarations */
+  int32_t (*check)(uint64_t word); /*!< frame verification (0 when no error) */
+} ook_protocol_t;
+
+
+/**
+ * Unrolled symbol matching: tries symbol I, then the next ones.
+ */
+template <const ook_protocol_t & P, int32_t I, bool End = (I >= P.symbol_number)>
+struct ook_symbol_match
+{
+  /**
+   * @param duration pulse duration in microsec.
+   * @param prev previous bit (see OOK_PREV_XXX declarations).
+   *
+   * @return decoded bit, -1 if no symbol matches.
+   */
+  static inline int32_t match(uint32_t duration, int32_t prev)
+  {
+    constexpr ook_symbol_t symbol = P.symbol[I];
+
+    return ((duration > symbol.window.low) && (duration < symbol.window.high) &&
+        ((symbol.prev == OOK_PREV_ANY) || (symbol.prev == prev))) ?
+        symbol.bit : ook_symbol_match<P, I + 1>::match(duration, prev);
+  }
+};
+
+/**
+ * End of the symbol table.
+ */
+template <const ook_protocol_t & P, int32_t I>
+struct ook_symbol_match<P, I, true>
+{
+  static inline int32_t match(uint32_t, int32_t)
+  {
+    return -1;
+  }
+};
+
+
+/**
+ * Decoder generated from a protocol description.
+ */
+template <const ook_protocol_t & P>
+class ook_decoder
+{
+public:
+  /**
+   * Handles a pulse duration.
+   *
+   * @param duration pulse duration in microsec.
+   * @param word output frame (bits right aligned) when 0 is returned.
+   *
+   * @return 0 when a frame is decoded, otherwise -1.
+   */
+  inline int32_t input(uint32_t duration, uint64_t * word)
+  {
+    int32_t retval = -1;
+
+    if (state < P.preamble_number)
+    {
+      state = ((duration > P.preamble.low) && (duration < P.preamble.high)) ? (state + 1) : 0;
+      prev = OOK_PREV_START;
+    }
+    else if (state < state_done)
+    {
+      const int32_t bit = ook_symbol_match<P, 0>::match(duration, prev);
+      if (bit >= 0)
+      {
+        reg = (prev == OOK_PREV_START) ? (uint64_t)bit : ((reg << 1) | (uint64_t)bit);
+        prev = bit;
+        state++;
+      }
+      else
+      {
+        state = 0;
+      }
+    }
+    else
+    {
+      retval = complete(word);
+      if (P.trailer == OOK_TRAILER_RESTART)
+      {
+        uint64_t unused;
+        (void)input(duration, &unused);
+      }
+    }
+
+    return retval;
+  }
+
+  /**
+   * Ends the current frame (no more pulses expected).
+   *
+   * @param word output frame (bits right aligned) when 0 is returned.
+   *
+   * @return 0 when a frame is decoded, otherwise -1.
+   */
+  inline int32_t flush(uint64_t * word)
+  {
+    int32_t retval = -1;
+
+    if (state == state_done)
+    {
+      retval = complete(word);
+    }
+    state = 0;
+
+    return retval;
+  }
+
+  /**
+   * @return 1 if the decoder waits for a preamble, otherwise 0.
+   */
+  inline int32_t is_idle(void) const
+  {
+    return (state == 0) ? 1 : 0;
+  }
+
+private:
+  static constexpr int32_t state_done = P.preamble_number + P.bits;
+
+  static_assert(P.bits <= 64, "frame does not fit in 64 bits");
+  static_assert(P.symbol_number <= OOK_SYMBOL_MAX, "too many symbols");
+
+  /**
+   * Verifies the received frame and resets the decoder.
+   */
+  inline int32_t complete(uint64_t * word)
+  {
+    int32_t retval = -1;
+
+    state = 0;
+    if (P.check(reg) == 0)
+    {
+      *word = reg;
+      retval = 0;
+    }
+
+    return retval;
+  }
+
+  int32_t state = 0; /* number of received preamble durations and bits */
+  int32_t prev = OOK_PREV_START; /* previous bit */
+  uint64_t reg = 0; /* received bits */
+};
+
+#endif
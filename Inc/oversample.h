@@ -0,0 +1,65 @@
+/**
+ * @file oversample.h
+ *
+ * @brief Falling edge extraction from an oversampled 433 MHz data pin: the
+ * pin is sampled at a fixed rate into a packed bit buffer (SPI receiver fed
+ * by DMA), the edges are found a word at a time with count leading zeros
+ * (no hardware dependency, shared with the host tools).
+ *
+ * @details The samples are 16-bit words received MSB first, the oldest
+ * sample is the MSB of the first word. Two words are scanned at once: the
+ * falling edges are the set bits of (previous samples & ~samples), each one
+ * is located with CLZ and stamped with the time of its first low sample.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef OVERSAMPLE_H
+#define OVERSAMPLE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extraction state.
+ */
+typedef struct {
+  uint32_t level; /*!< last sample */
+  uint32_t time; /*!< time of the next sample in microsec */
+  uint32_t remainder; /*!< fraction of the time in 1/tick_den microsec */
+  uint32_t tick_num; /*!< sample period numerator in microsec */
+  uint32_t tick_den; /*!< sample period denominator */
+  uint32_t edges; /*!< extracted falling edges */
+  void (*edge)(uint32_t timestamp); /*!< falling edge handler */
+} OVERSAMPLE_state_t;
+
+
+void OVERSAMPLE_Init(OVERSAMPLE_state_t * state, uint32_t time, uint32_t tick_num, uint32_t tick_den,
+    void (*edge)(uint32_t timestamp));
+void OVERSAMPLE_Extract(OVERSAMPLE_state_t * state, const uint16_t * samples, int32_t count);
+void OVERSAMPLE_Skip(OVERSAMPLE_state_t * state, int32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
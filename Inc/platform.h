@@ -0,0 +1,349 @@
+/**
+ * @file platform.h
+ *
+ * @brief Platform layer of the shared modules: GPIO, microsecond delay and
+ * UART operations resolved at compile time (no function pointers), so that
+ * they inline into the timing loops of the LaCrosse transmitter and of the
+ * DHT22 start sequence.
+ *
+ * @details Exactly one platform is selected:
+ *
+ * Platform          | Selected by                      | Radio
+ * ------------------|----------------------------------|---------------------
+ * PLATFORM_STM32    | STM32F100xB                      | receiver only
+ * PLATFORM_ARDUINO  | none of the others               | receiver, transmitter
+ * PLATFORM_HOST     | LACROSSE_HOST or DHT22_HOST      | receiver, transmitter
+ *
+ * C modules call the PLATFORM_XXX functions with the handles of the
+ * platform (HAL handles on STM32, ignored on Arduino, simulated state on the
+ * host). C++ code takes a policy as a template parameter (see
+ * platform_radio_tx): a host tool can instantiate the same loops with its
+ * own policy to record or time the output.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* platform selection (a host build for tools wins over the target) */
+#if defined(LACROSSE_HOST) || defined(DHT22_HOST)
+#define PLATFORM_HOST
+#elif defined(STM32F100xB)
+#define PLATFORM_STM32
+#else
+#define PLATFORM_ARDUINO
+#endif
+
+/* 433 MHz transmitter available (see platform_radio_tx) */
+#if defined(PLATFORM_ARDUINO) || defined(PLATFORM_HOST)
+#define PLATFORM_RADIO_TX
+#endif
+
+/* 433 MHz transmitter data pin (Arduino pin number, bit mask on the host) */
+#ifndef PLATFORM_RADIO_TX_PIN
+#ifdef PLATFORM_ARDUINO
+#define PLATFORM_RADIO_TX_PIN  10
+#else
+#define PLATFORM_RADIO_TX_PIN  0x1
+#endif
+#endif
+
+/* timeout of a blocking UART transmission in millisec */
+#define PLATFORM_UART_TIMEOUT_MS  10000
+
+
+/*********************************************************************************/
+
+#ifdef PLATFORM_STM32
+
+#include "stm32f1xx_hal.h"
+
+typedef GPIO_TypeDef PLATFORM_port_t; /*!< GPIO port */
+typedef TIM_HandleTypeDef PLATFORM_timer_t; /*!< timer counting microsec */
+typedef UART_HandleTypeDef PLATFORM_uart_t; /*!< UART */
+
+/**
+ * Sets the level of an output pin.
+ *
+ * @param port GPIO port.
+ * @param pin pin mask (GPIO_PIN_XXX).
+ * @param level 1 - high, 0 - low.
+ *
+ * @return void.
+ */
+static inline void PLATFORM_PinWrite(PLATFORM_port_t * port, uint32_t pin, int32_t level)
+{
+  HAL_GPIO_WritePin(port, pin, (level != 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+/**
+ * Configures a pin as push-pull output or as input without pull.
+ *
+ * @param port GPIO port.
+ * @param pin pin mask (GPIO_PIN_XXX).
+ * @param output 1 - output, 0 - input.
+ *
+ * @return void.
+ */
+static inline void PLATFORM_PinMode(PLATFORM_port_t * port, uint32_t pin, int32_t output)
+{
+  GPIO_InitTypeDef GPIO_InitStruct;
+  GPIO_InitStruct.Pin = pin;
+  GPIO_InitStruct.Mode = (output != 0) ? GPIO_MODE_OUTPUT_PP : GPIO_MODE_INPUT;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+
+/**
+ * Waits (very approximative): counts the changes of a 1 MHz timer counter.
+ *
+ * @param timer timer counting microsec.
+ * @param delay delay in microsec.
+ *
+ * @return void.
+ */
+static inline void PLATFORM_DelayUs(PLATFORM_timer_t * timer, int32_t delay)
+{
+  uint32_t old = 0xFFFFFFFF;
+
+  while (delay > 0)
+  {
+    if (timer->Instance->CNT != old)
+    {
+      delay--;
+      old = timer->Instance->CNT;
+    }
+  }
+}
+
+/**
+ * Sends bytes over a UART (blocking).
+ *
+ * @param uart UART.
+ * @param data bytes to send.
+ * @param len number of bytes.
+ *
+ * @return 0 when no error.
+ */
+static inline int32_t PLATFORM_UartWrite(PLATFORM_uart_t * uart, const uint8_t * data, int32_t len)
+{
+  return (HAL_UART_Transmit(uart, (uint8_t *)data, (uint16_t)len, PLATFORM_UART_TIMEOUT_MS) == HAL_OK) ? 0 : -1;
+}
+
+#endif
+
+
+/*********************************************************************************/
+
+#ifdef PLATFORM_ARDUINO
+
+#include "Arduino.h"
+
+/* the Arduino core addresses the pins by number: no port, no timer handle */
+typedef struct PLATFORM_port_s PLATFORM_port_t;
+typedef struct PLATFORM_timer_s PLATFORM_timer_t;
+#ifdef __cplusplus
+typedef Stream PLATFORM_uart_t;
+#endif
+
+/**
+ * Sets the level of an output pin.
+ */
+static inline void PLATFORM_PinWrite(PLATFORM_port_t * port, uint32_t pin, int32_t level)
+{
+  (void)port;
+  digitalWrite((uint8_t)pin, (level != 0) ? HIGH : LOW);
+}
+
+/**
+ * Configures a pin as output or as input.
+ */
+static inline void PLATFORM_PinMode(PLATFORM_port_t * port, uint32_t pin, int32_t output)
+{
+  (void)port;
+  pinMode((uint8_t)pin, (output != 0) ? OUTPUT : INPUT);
+}
+
+/**
+ * Waits (busy loop of the Arduino core).
+ */
+static inline void PLATFORM_DelayUs(PLATFORM_timer_t * timer, int32_t delay)
+{
+  (void)timer;
+  delayMicroseconds((unsigned int)delay);
+}
+
+#ifdef __cplusplus
+/**
+ * Sends bytes over a serial port (blocking).
+ */
+static inline int32_t PLATFORM_UartWrite(PLATFORM_uart_t * uart, const uint8_t * data, int32_t len)
+{
+  return (uart->write(data, (size_t)len) == (size_t)len) ? 0 : -1;
+}
+#endif
+
+#endif
+
+
+/*********************************************************************************/
+
+#ifdef PLATFORM_HOST
+
+/**
+ * Simulated GPIO port.
+ */
+typedef struct {
+  uint32_t output; /*!< pins configured as output (mask) */
+  uint32_t level; /*!< pin levels (mask) */
+  uint32_t writes; /*!< number of writes */
+} PLATFORM_port_t;
+
+/**
+ * Simulated timer: the delays advance a virtual clock.
+ */
+typedef struct {
+  uint64_t now_us; /*!< virtual time in microsec */
+} PLATFORM_timer_t;
+
+/**
+ * Simulated UART: the sent bytes are appended to a buffer.
+ */
+typedef struct {
+  uint8_t * buffer; /*!< output buffer */
+  int32_t size; /*!< size of the buffer in bytes */
+  int32_t len; /*!< number of bytes in the buffer */
+} PLATFORM_uart_t;
+
+/**
+ * Sets the level of a pin.
+ */
+static inline void PLATFORM_PinWrite(PLATFORM_port_t * port, uint32_t pin, int32_t level)
+{
+  port->level = (level != 0) ? (port->level | pin) : (port->level & ~pin);
+  port->writes++;
+}
+
+/**
+ * Configures a pin as output or as input.
+ */
+static inline void PLATFORM_PinMode(PLATFORM_port_t * port, uint32_t pin, int32_t output)
+{
+  port->output = (output != 0) ? (port->output | pin) : (port->output & ~pin);
+}
+
+/**
+ * Advances the virtual clock.
+ */
+static inline void PLATFORM_DelayUs(PLATFORM_timer_t * timer, int32_t delay)
+{
+  timer->now_us += (delay > 0) ? (uint32_t)delay : 0;
+}
+
+/**
+ * Appends bytes to the UART buffer.
+ *
+ * @return 0 when no error, -1 if the buffer is full (bytes are truncated).
+ */
+static inline int32_t PLATFORM_UartWrite(PLATFORM_uart_t * uart, const uint8_t * data, int32_t len)
+{
+  int32_t i;
+
+  for (i = 0; (i < len) && (uart->len < uart->size); i++)
+  {
+    uart->buffer[uart->len++] = data[i];
+  }
+
+  return (i == len) ? 0 : -1;
+}
+
+#endif
+
+
+/*********************************************************************************/
+
+#if defined(__cplusplus) && defined(PLATFORM_RADIO_TX)
+
+/**
+ * Policy of the 433 MHz transmitter: data pin and delay of the selected
+ * platform. The LaCrosse transmitter loops take it as a template parameter
+ * (any struct with the same static functions can be given instead).
+ */
+struct platform_radio_tx
+{
+  /**
+   * GPIO port of the data pin (simulated one on the host).
+   */
+  static inline PLATFORM_port_t * port(void)
+  {
+#ifdef PLATFORM_HOST
+    static PLATFORM_port_t port = { 0, 0, 0 };
+    return &port;
+#else
+    return NULL;
+#endif
+  }
+
+  /**
+   * Timer of the delays (virtual clock on the host).
+   */
+  static inline PLATFORM_timer_t * timer(void)
+  {
+#ifdef PLATFORM_HOST
+    static PLATFORM_timer_t timer = { 0 };
+    return &timer;
+#else
+    return NULL;
+#endif
+  }
+
+  /**
+   * Configures the data pin as output, low.
+   */
+  static inline void init(void)
+  {
+    PLATFORM_PinMode(port(), PLATFORM_RADIO_TX_PIN, 1);
+    PLATFORM_PinWrite(port(), PLATFORM_RADIO_TX_PIN, 0);
+  }
+
+  /**
+   * Sets the level of the data pin (1 - carrier on, 0 - off).
+   */
+  static inline void pin_write(int32_t level)
+  {
+    PLATFORM_PinWrite(port(), PLATFORM_RADIO_TX_PIN, level);
+  }
+
+  /**
+   * Waits for a level duration in microsec.
+   */
+  static inline void delay_us(int32_t delay)
+  {
+    PLATFORM_DelayUs(timer(), delay);
+  }
+};
+
+#endif
+
+#endif
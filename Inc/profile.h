@@ -0,0 +1,68 @@
+/**
+ * @file profile.h
+ *
+ * @brief Function-level profile of the profiling build variant: call counts
+ * and cycles per calling context, measured with the DWT cycle counter from
+ * the -finstrument-functions entry/exit hooks.
+ *
+ * @details The profiling variant is built with -DPROFILE_ENABLED, with
+ * -finstrument-functions on the profiled sources (server.c, dht22.c,
+ * mysensors.c, lacrosse.cpp) and with the linker wrappers of the library
+ * calls to separate:
+ *   -Wl,--wrap=sprintf -Wl,--wrap=HAL_UART_Transmit -Wl,--wrap=SCHED_Sleep
+ * (see docs/doc_data_server.md). Each node of the calling context tree
+ * counts the calls and the self cycles of a function called from its parent
+ * node: the cycles of the callees, of the interrupts and of the WFI sleep
+ * (SCHED_Sleep) are not in the self cycles of the caller.
+ *
+ * The profile is sent as MySensors lines by SERV (PROFILE_Format()), then
+ * restarted; Tools/profile_report.py turns them into a flat profile and
+ * folded stacks for flame graphs.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* nodes of the calling context tree (power of 2, node 0 is the root) */
+#define PROFILE_NODE_NUMBER  64
+
+/* nesting depth of the profiled calls (interrupts included) */
+#define PROFILE_DEPTH_MAX  16
+
+
+void PROFILE_Init(void);
+int32_t PROFILE_Format(int32_t node, char * buffer, int32_t size);
+
+void __cyg_profile_func_enter(void * function, void * site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void * function, void * site) __attribute__((no_instrument_function));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
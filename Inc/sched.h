@@ -0,0 +1,68 @@
+/**
+ * @file sched.h
+ *
+ * @brief Cooperative scheduler: periodic and one-shot tasks in a timer wheel
+ * driven by the systick, event tasks posted from interrupts, and WFI sleep
+ * when nothing is runnable.
+ *
+ * @details Tasks run to completion in the main loop (SCHED_Run() then
+ * SCHED_Sleep()), in the order of their registration for event tasks. Only
+ * SCHED_Tick() and SCHED_Post() may be called from an interrupt.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+/* number of wheel slots (power of 2), one slot per systick */
+#define SCHED_WHEEL_SIZE    32
+
+/* maximal number of event tasks (one bit each) */
+#define SCHED_EVENT_NUMBER  32
+
+
+/**
+ * Task (statically allocated by its owner, fields private to the scheduler).
+ */
+typedef struct SCHED_task_s {
+  const char * name; /*!< task name */
+  void (*handler)(void); /*!< called in the main loop */
+  uint32_t period; /*!< timer period in systicks, 0 for a one-shot timer */
+  uint32_t expiry; /*!< systick of the next timer expiry */
+  int32_t armed; /*!< timer is in the wheel */
+  int32_t event; /*!< event bit, -1 if not registered */
+  struct SCHED_task_s * next; /*!< next task in the same wheel slot */
+} SCHED_task_t;
+
+
+void SCHED_Init(void);
+int32_t SCHED_Register(SCHED_task_t * task, const char * name, void (*handler)(void));
+void SCHED_Post(SCHED_task_t * task);
+void SCHED_TimerStart(SCHED_task_t * task, uint32_t delay, uint32_t period);
+void SCHED_TimerStop(SCHED_task_t * task);
+void SCHED_Tick(void);
+uint32_t SCHED_TickGet(void);
+int32_t SCHED_Run(void);
+void SCHED_Sleep(void);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file sensors.h
+ *
+ * @brief Publication of the sensor readings to the Linux server as described
+ * by the configuration table (sensors_config.h).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdint.h>
+
+#include "mysensors.h"
+#include "sensors_config.h"
+
+
+/**
+ * Reading sources.
+ */
+typedef enum {
+  SENSORS_SOURCE_DHT22 = 0, /*!< local DHT22 */
+  SENSORS_SOURCE_LACROSSE = 1, /*!< LaCrosse 433 MHz sensor */
+  SENSORS_SOURCE_NEXUS = 2, /*!< Nexus 433 MHz sensors */
+  SENSORS_SOURCE_DEBUG = 3 /*!< debug codes */
+} SENSORS_SOURCE_e;
+
+/**
+ * Measured quantities.
+ */
+typedef enum {
+  SENSORS_QUANTITY_TEMPER = 0, /*!< temperature */
+  SENSORS_QUANTITY_HUM = 1, /*!< relative humidity */
+  SENSORS_QUANTITY_TIMESTAMP = 2, /*!< capture time in microsec */
+  SENSORS_QUANTITY_TEXT = 3 /*!< debug code */
+} SENSORS_QUANTITY_e;
+
+/**
+ * Publish policies.
+ */
+typedef enum {
+  SENSORS_PUBLISH_ALWAYS = 0, /*!< each reading is sent */
+  SENSORS_PUBLISH_ON_CHANGE = 1 /*!< a reading is sent only if it changed (for database size) */
+} SENSORS_PUBLISH_e;
+
+/* enabled channels (disabled ones are stripped) */
+#define SENSORS_IF_0(...)
+#define SENSORS_IF_1(...)  __VA_ARGS__
+#define SENSORS_ENUM(name, enabled, ...)  SENSORS_IF_##enabled(SENSORS_CHANNEL_##name,)
+
+/**
+ * Enabled channels.
+ */
+typedef enum {
+  SENSORS_CONFIG(SENSORS_ENUM)
+  SENSORS_CHANNEL_NUMBER
+} SENSORS_CHANNEL_e;
+
+
+void SENSORS_Init(void (*handler)(int32_t channel, int32_t quantity, int32_t value));
+int32_t SENSORS_Publish(int32_t source, int32_t sensor, int32_t quantity, int32_t raw);
+int32_t SENSORS_Resend(int32_t channel, int32_t value);
+void SENSORS_Reset(void);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file sensors_config.h
+ *
+ * @brief Compile-time configuration of the published sensor channels.
+ *
+ * @details One line per channel:
+ * - name: channel name (SENSORS_CHANNEL_<name>),
+ * - enabled: 0 strips the channel from the firmware (no flash, no RAM),
+ * - source and sensor: reading source (see SENSORS_SOURCE_e) and its
+ *   channel (e.g. Nexus channel switch),
+ * - quantity: see SENSORS_QUANTITY_e,
+ * - node, child, type: MySensors IDs (plain numbers, the message header is
+ *   built at compile time),
+ * - mul, offset: scaling of the raw reading (raw * mul + offset),
+ * - format: payload format (see MYSENSORS_FORMAT_e),
+ * - policy: see SENSORS_PUBLISH_e.
+ *
+ * Node IDs in use: 100 local DHT22, 103 LaCrosse, 104 to 107 Nexus
+ * channels 0 to 3. Type 0 is V_TEMP, 1 V_HUM, 24 V_VAR1 (capture time in
+ * microsec, see timebase.h).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SENSORS_CONFIG_H
+#define SENSORS_CONFIG_H
+
+/*      name             enabled source                   sensor quantity                    node child type mul offset format                 policy */
+#define SENSORS_CONFIG(X) \
+  X(LOCAL_TEMPER,        1, SENSORS_SOURCE_DHT22,    0, SENSORS_QUANTITY_TEMPER,    100, 0, 0,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ON_CHANGE) \
+  X(LOCAL_HUM,           1, SENSORS_SOURCE_DHT22,    0, SENSORS_QUANTITY_HUM,       100, 1, 1,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ON_CHANGE) \
+  X(LOCAL_TIME,          1, SENSORS_SOURCE_DHT22,    0, SENSORS_QUANTITY_TIMESTAMP, 100, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(LACROSSE_TEMPER,     1, SENSORS_SOURCE_LACROSSE, 0, SENSORS_QUANTITY_TEMPER,    103, 0, 0,  1, -500, MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(LACROSSE_HUM,        1, SENSORS_SOURCE_LACROSSE, 0, SENSORS_QUANTITY_HUM,       103, 1, 1,  10, 0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(LACROSSE_TIME,       1, SENSORS_SOURCE_LACROSSE, 0, SENSORS_QUANTITY_TIMESTAMP, 103, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS0_TEMPER,       1, SENSORS_SOURCE_NEXUS,    0, SENSORS_QUANTITY_TEMPER,    104, 0, 0,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS0_HUM,          1, SENSORS_SOURCE_NEXUS,    0, SENSORS_QUANTITY_HUM,       104, 1, 1,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS0_TIME,         1, SENSORS_SOURCE_NEXUS,    0, SENSORS_QUANTITY_TIMESTAMP, 104, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS1_TEMPER,       1, SENSORS_SOURCE_NEXUS,    1, SENSORS_QUANTITY_TEMPER,    105, 0, 0,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS1_HUM,          1, SENSORS_SOURCE_NEXUS,    1, SENSORS_QUANTITY_HUM,       105, 1, 1,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS1_TIME,         1, SENSORS_SOURCE_NEXUS,    1, SENSORS_QUANTITY_TIMESTAMP, 105, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS2_TEMPER,       1, SENSORS_SOURCE_NEXUS,    2, SENSORS_QUANTITY_TEMPER,    106, 0, 0,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS2_HUM,          1, SENSORS_SOURCE_NEXUS,    2, SENSORS_QUANTITY_HUM,       106, 1, 1,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS2_TIME,         1, SENSORS_SOURCE_NEXUS,    2, SENSORS_QUANTITY_TIMESTAMP, 106, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS3_TEMPER,       1, SENSORS_SOURCE_NEXUS,    3, SENSORS_QUANTITY_TEMPER,    107, 0, 0,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS3_HUM,          1, SENSORS_SOURCE_NEXUS,    3, SENSORS_QUANTITY_HUM,       107, 1, 1,  1,  0,   MYSENSORS_FORMAT_X10,  SENSORS_PUBLISH_ALWAYS) \
+  X(NEXUS3_TIME,         1, SENSORS_SOURCE_NEXUS,    3, SENSORS_QUANTITY_TIMESTAMP, 107, 0, 24, 1,  0,   MYSENSORS_FORMAT_UINT, SENSORS_PUBLISH_ALWAYS) \
+  X(DEBUG,               1, SENSORS_SOURCE_DEBUG,    0, SENSORS_QUANTITY_TEXT,      133, 33, 47, 1, 0,   MYSENSORS_FORMAT_INT,  SENSORS_PUBLISH_ALWAYS)
+
+#endif
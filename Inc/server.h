@@ -25,10 +25,16 @@
 
 
 #include "stm32f1xx_hal.h"
+#include "glitch.h"
 
 
 void SERV_Init(UART_HandleTypeDef * huart, TIM_HandleTypeDef * htim);
 void SERV_Routine(void);
 void SERV_TickIncrement(void);
+void SERV_GlitchConfigSet(const GLITCH_config_t * config);
+void SERV_GlitchStatsGet(GLITCH_state_t * state);
+#ifdef OVERSAMPLE_ENABLED
+void SERV_OversampleStart(SPI_HandleTypeDef * hspi);
+#endif
 
 #endif
@@ -0,0 +1,43 @@
+/**
+ * @file sniffer.h
+ *
+ * @brief Raw pulse sniffer: streams the captured durations to the Linux
+ * server as capture records (see capture.h) by UART DMA instead of the
+ * decoded frames.
+ *
+ * @details The sniffer variant is built with -DSNIFFER_ENABLED, with a DMA
+ * channel on the transmitter of the UART (see docs/doc_data_server.md).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SNIFFER_H
+#define SNIFFER_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+
+void SNIFFER_Init(UART_HandleTypeDef * huart);
+void SNIFFER_Input(int32_t channel, uint32_t duration);
+void SNIFFER_Event(uint32_t event, uint32_t argument);
+void SNIFFER_Dropped(uint32_t number);
+uint32_t SNIFFER_DroppedGet(void);
+
+#endif
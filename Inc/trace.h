@@ -0,0 +1,74 @@
+/**
+ * @file trace.h
+ *
+ * @brief Binary trace log: call sites record an event ID of trace_events.h
+ * and up to TRACE_ARG_MAX integer arguments in a RAM ring (no formatting),
+ * a background task sends the ring as MySensors lines with a hex payload.
+ *
+ * @details A record is TRACE_HEADER_WORDS + arguments 32-bit words:
+ *
+ * Word  | Description
+ * ------|------------
+ * 0     | event ID (bits 0-7), number of arguments (bits 8-9)
+ * 1     | TIMEBASE_NowUs() time in microsec
+ * 2..   | arguments
+ *
+ * Each line "133;34;1;0;48;<hex>" holds whole records, every word as 8 hex
+ * digits (most significant first), so a line lost on the serial link only
+ * loses its own records. Recording is safe from any context: the record is
+ * written with the interrupts masked, or counted as lost if the ring is
+ * full (reported by a TRACE_EVENT_LOST record). Build with -DTRACE_DISABLED
+ * to remove the call sites.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+#include "trace_events.h"
+
+/* ring size in 32-bit words (power of 2) */
+#define TRACE_RING_SIZE  64
+
+/* words of a record before its arguments */
+#define TRACE_HEADER_WORDS  2
+
+#define TRACE_HEADER(name)  ((uint32_t)TRACE_EVENT_##name | ((uint32_t)TRACE_ARGS_##name << 8))
+
+#ifndef TRACE_DISABLED
+#define TRACE0(name)           TRACE_Record(TRACE_HEADER(name), 0, 0, 0)
+#define TRACE1(name, a)        TRACE_Record(TRACE_HEADER(name), (uint32_t)(a), 0, 0)
+#define TRACE2(name, a, b)     TRACE_Record(TRACE_HEADER(name), (uint32_t)(a), (uint32_t)(b), 0)
+#define TRACE3(name, a, b, c)  TRACE_Record(TRACE_HEADER(name), (uint32_t)(a), (uint32_t)(b), (uint32_t)(c))
+#else
+#define TRACE0(name)           do {} while (0)
+#define TRACE1(name, a)        do {} while (0)
+#define TRACE2(name, a, b)     do {} while (0)
+#define TRACE3(name, a, b, c)  do {} while (0)
+#endif
+
+
+void TRACE_Init(void);
+void TRACE_Record(uint32_t header, uint32_t a, uint32_t b, uint32_t c);
+void TRACE_Start(uint32_t period);
+
+#endif
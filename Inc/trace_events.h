@@ -0,0 +1,74 @@
+/**
+ * @file trace_events.h
+ *
+ * @brief Trace events of the firmware (see trace.h) and their format
+ * strings. The firmware only records the event ID and its integer
+ * arguments; the host renderer (Tools/trace_render.cpp) is built with this
+ * table to print the text.
+ *
+ * @details Formats only use integer conversions (%d, %u, %x with flags and
+ * widths), one per argument. An event keeps its ID (its rank in the table)
+ * for the captured logs to stay readable: new events are added at the end.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+/* MySensors channel of the trace lines (hex payload) */
+#define TRACE_MYSENSORS_NODE   133
+#define TRACE_MYSENSORS_CHILD  34
+#define TRACE_MYSENSORS_TYPE   48
+
+/* arguments of an event at most */
+#define TRACE_ARG_MAX  3
+
+/*      name              args format */
+#define TRACE_EVENTS(X) \
+  X(LOST,                 1,   "%u events lost (ring full)") \
+  X(BOOT,                 1,   "boot, server version %d") \
+  X(RADIO_OVERRUN,        1,   "radio ring overrun, %u entries dropped") \
+  X(RADIO_FLUSH,          1,   "radio idle flush, %u us after the last edge") \
+  X(RADIO_GAP,            1,   "radio gap of %u us (burst start)") \
+  X(OOK_FRAME,            3,   "ook frame: source %d, temper %d, hum %d") \
+  X(DHT22_FAILED,         1,   "dht22 analysis failed on %u durations") \
+  X(DHT22_OK,             2,   "dht22 temper %u, rh %u") \
+  X(SAMPLE_OVERRUN,       1,   "oversampling overrun, %u half buffers lost")
+
+#define TRACE_ENUM(name, args, format)  TRACE_EVENT_##name,
+#define TRACE_ARGS(name, args, format)  TRACE_ARGS_##name = (args),
+
+/**
+ * Events (IDs sent in the trace lines).
+ */
+typedef enum {
+  TRACE_EVENTS(TRACE_ENUM)
+  TRACE_EVENT_NUMBER
+} TRACE_EVENT_e;
+
+/**
+ * Number of arguments of each event.
+ */
+typedef enum {
+  TRACE_EVENTS(TRACE_ARGS)
+  TRACE_ARGS_UNUSED = 0
+} TRACE_ARGS_e;
+
+#endif
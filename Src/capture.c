@@ -0,0 +1,298 @@
+/**
+ * @file capture.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+
+#include "capture.h"
+
+
+/**
+ * Writes an unsigned LEB128 varint.
+ *
+ * @param buffer output buffer (at least 5 bytes).
+ * @param value value to write.
+ *
+ * @return number of written bytes.
+ */
+static int32_t varint_write(uint8_t * buffer, uint32_t value)
+{
+  int32_t size = 0;
+
+  while (value >= 0x80)
+  {
+    buffer[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = (uint8_t)value;
+
+  return size;
+}
+
+/**
+ * Reads an unsigned LEB128 varint.
+ *
+ * @param buffer input buffer.
+ * @param len length of the buffer in bytes.
+ * @param value output value.
+ *
+ * @return number of read bytes, 0 if incomplete, -1 if invalid (more than 32 bits).
+ */
+static int32_t varint_read(const uint8_t * buffer, int32_t len, uint32_t * value)
+{
+  int32_t retval = 0;
+  uint32_t result = 0;
+  int32_t i;
+
+  for (i = 0; (i < len) && (retval == 0); i++)
+  {
+    if ((i == 4) && ((buffer[i] & 0xF0) != 0))
+    {
+      /* 5th byte: only the 4 high bits of the value, last byte */
+      retval = -1;
+    }
+    else
+    {
+      result |= (uint32_t)(buffer[i] & 0x7F) << (7 * i);
+      if ((buffer[i] & 0x80) == 0)
+      {
+        *value = result;
+        retval = i + 1;
+      }
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Writes a capture header.
+ *
+ * @param buffer output buffer of CAPTURE_HEADER_SIZE bytes.
+ * @param header header to write.
+ *
+ * @return number of written bytes.
+ */
+int32_t CAPTURE_HeaderWrite(uint8_t * buffer, const CAPTURE_header_t * header)
+{
+  int32_t i;
+
+  for (i = 0; i < 4; i++)
+  {
+    buffer[i] = (uint8_t)CAPTURE_MAGIC[i];
+  }
+  buffer[4] = header->version;
+  buffer[5] = header->flags;
+  buffer[6] = (uint8_t)(header->tick_ns >> 0);
+  buffer[7] = (uint8_t)(header->tick_ns >> 8);
+  for (i = 0; i < 8; i++)
+  {
+    buffer[8 + i] = (uint8_t)(header->start_us >> (8 * i));
+  }
+
+  return CAPTURE_HEADER_SIZE;
+}
+
+/**
+ * Reads a capture header.
+ *
+ * @param buffer input buffer.
+ * @param len length of the buffer in bytes.
+ * @param header output header.
+ *
+ * @return number of read bytes, -1 if not a capture, -2 if unknown version.
+ */
+int32_t CAPTURE_HeaderRead(const uint8_t * buffer, int32_t len, CAPTURE_header_t * header)
+{
+  int32_t retval = CAPTURE_HEADER_SIZE;
+  int32_t i;
+
+  if (len < CAPTURE_HEADER_SIZE)
+  {
+    retval = -1;
+  }
+  for (i = 0; (i < 4) && (retval > 0); i++)
+  {
+    if (buffer[i] != (uint8_t)CAPTURE_MAGIC[i])
+    {
+      retval = -1;
+    }
+  }
+  if ((retval > 0) && (buffer[4] != CAPTURE_VERSION))
+  {
+    retval = -2;
+  }
+
+  if (retval > 0)
+  {
+    header->version = buffer[4];
+    header->flags = buffer[5];
+    header->tick_ns = (uint16_t)(buffer[6] | (buffer[7] << 8));
+    header->start_us = 0;
+    for (i = 0; i < 8; i++)
+    {
+      header->start_us |= (uint64_t)buffer[8 + i] << (8 * i);
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Initializes an encoder/decoder state.
+ *
+ * @param codec state to initialize.
+ * @param flags header flags (see CAPTURE_FLAG_XXX declarations).
+ *
+ * @return void.
+ */
+void CAPTURE_CodecInit(CAPTURE_codec_t * codec, uint8_t flags)
+{
+  int32_t i;
+
+  codec->flags = flags;
+  for (i = 0; i < CAPTURE_CHANNEL_NUMBER; i++)
+  {
+    codec->previous[i] = 0;
+  }
+  codec->timestamp = 0;
+}
+
+/**
+ * Encodes a record.
+ *
+ * @param codec encoder state.
+ * @param buffer output buffer (at least CAPTURE_RECORD_MAX bytes).
+ * @param record record to encode (durations above CAPTURE_DURATION_MAX
+ * ticks are written as CAPTURE_DURATION_MAX).
+ *
+ * @return number of written bytes.
+ */
+int32_t CAPTURE_Encode(CAPTURE_codec_t * codec, uint8_t * buffer, const CAPTURE_record_t * record)
+{
+  int32_t size;
+
+  if (record->channel == CAPTURE_CHANNEL_EVENT)
+  {
+    size = varint_write(buffer, (record->value << 2) | CAPTURE_CHANNEL_EVENT);
+    size += varint_write(&buffer[size], record->argument);
+  }
+  else
+  {
+    /* |delta| below 2^28: the zigzag value keeps its 2 high bits free for the channel */
+    const uint32_t value = (record->value < CAPTURE_DURATION_MAX) ? record->value : CAPTURE_DURATION_MAX;
+    const int32_t delta = (int32_t)(value - codec->previous[record->channel]);
+    const uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    size = varint_write(buffer, (zigzag << 2) | (uint32_t)record->channel);
+    codec->previous[record->channel] = value;
+  }
+
+  if ((codec->flags & CAPTURE_FLAG_TIMESTAMPS) != 0)
+  {
+    size += varint_write(&buffer[size], record->timestamp - codec->timestamp);
+    codec->timestamp = record->timestamp;
+  }
+
+  return size;
+}
+
+/**
+ * Decodes a record.
+ *
+ * @param codec decoder state.
+ * @param buffer input buffer.
+ * @param len length of the buffer in bytes.
+ * @param record output record.
+ *
+ * @return number of read bytes, 0 if incomplete, -1 if invalid.
+ */
+int32_t CAPTURE_Decode(CAPTURE_codec_t * codec, const uint8_t * buffer, int32_t len, CAPTURE_record_t * record)
+{
+  uint32_t word = 0;
+  int32_t size = varint_read(buffer, len, &word);
+
+  if (size > 0)
+  {
+    record->channel = (int32_t)(word & 0x3);
+    record->argument = 0;
+
+    if (record->channel == CAPTURE_CHANNEL_EVENT)
+    {
+      const int32_t size_arg = varint_read(&buffer[size], len - size, &record->argument);
+      record->value = word >> 2;
+      size = (size_arg > 0) ? (size + size_arg) : size_arg;
+    }
+    else
+    {
+      const uint32_t zigzag = word >> 2;
+      const int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+      record->value = codec->previous[record->channel] + (uint32_t)delta;
+    }
+  }
+
+  if ((size > 0) && ((codec->flags & CAPTURE_FLAG_TIMESTAMPS) != 0))
+  {
+    uint32_t delta = 0;
+    const int32_t size_ts = varint_read(&buffer[size], len - size, &delta);
+    record->timestamp = codec->timestamp + delta;
+    size = (size_ts > 0) ? (size + size_ts) : size_ts;
+  }
+
+  /* commit the state only for a complete record */
+  if (size > 0)
+  {
+    if (record->channel != CAPTURE_CHANNEL_EVENT)
+    {
+      codec->previous[record->channel] = record->value;
+    }
+    if ((codec->flags & CAPTURE_FLAG_TIMESTAMPS) != 0)
+    {
+      codec->timestamp = record->timestamp;
+    }
+  }
+
+  return size;
+}
+
+/**
+ * Computes the CRC8 of a stream block (polynomial 0x31, initial value 0).
+ *
+ * @param buffer input buffer.
+ * @param len length of the buffer in bytes.
+ *
+ * @return CRC8.
+ */
+uint8_t CAPTURE_Crc8(const uint8_t * buffer, int32_t len)
+{
+  uint8_t crc = 0;
+  int32_t i, k;
+
+  for (i = 0; i < len; i++)
+  {
+    crc ^= buffer[i];
+    for (k = 0; k < 8; k++)
+    {
+      crc = (uint8_t)(((crc & 0x80) != 0) ? ((crc << 1) ^ 0x31) : (crc << 1));
+    }
+  }
+
+  return crc;
+}
@@ -24,7 +24,6 @@
 #include <assert.h>
 
 #include "dht22.h"
-#include "stm32f1xx_hal.h"
 
 /* DHT22 pulse properties */ 
 #define HIGH_MIN 110
@@ -33,83 +32,21 @@
 #define LOW_MAX  100
 
 /* local variable declarations */
-static TIM_HandleTypeDef * loc_htim_us = NULL;
+static PLATFORM_timer_t * loc_htim_us = NULL;
 static int32_t loc_gpio_pin = -1;
-static GPIO_TypeDef * loc_gpio_port = NULL;
+static PLATFORM_port_t * loc_gpio_port = NULL;
 
 
-/**
- * Local delay function (very approximative) based on the HAL timer.
- * 
- * @param delay delay in microsec.
- * 
- * @return void.
- */
-static void delay_us(int32_t delay)
-{
-  uint32_t old = 0xFFFFFFFF;
-
-  /* preconditions check */
-  assert(loc_htim_us != NULL);
-
-  /* loop while delay is not gone */
-  while(delay > 0)
-  {
-    if (loc_htim_us->Instance->CNT != old)
-    {
-      delay--;
-      old = loc_htim_us->Instance->CNT;
-    }
-  }
-}
-
-/**
- * Configures the GPIO PA1 as output.
- * 
- * @return void.
- */
-static void set_gpio_output(void)
-{
-  /* preconditions check */
-  assert(loc_gpio_pin != -1);
-  assert(loc_gpio_port != NULL);
-
-  /* Configure GPIO pin output: PA1 */
-  GPIO_InitTypeDef GPIO_InitStruct;
-  GPIO_InitStruct.Pin = loc_gpio_pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-  HAL_GPIO_Init(loc_gpio_port, &GPIO_InitStruct);
-}
-
-/**
- * Configures the GPIO PA1 as input.
- * 
- * @return void.
- */
-static void set_gpio_input(void)
-{
-  /* preconditions check */
-  assert(loc_gpio_pin != -1);
-  assert(loc_gpio_port != NULL);
-
-  /* Configure GPIO pin input: PA1 */
-  GPIO_InitTypeDef GPIO_InitStruct;
-  GPIO_InitStruct.Pin = loc_gpio_pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-  GPIO_InitStruct.Pull = GPIO_NOPULL;
-  HAL_GPIO_Init(loc_gpio_port, &GPIO_InitStruct);
-}
-
 /**
  * Initializes the DHT22 module.
  * 
  * @param htim_us pointer to the timer structure.
+ * @param gpio_port GPIO port of the data pin.
  * @param gpio_pin pin index.
  * 
  * @return void.
  */
-void DHT22_Init(TIM_HandleTypeDef * htim_us, GPIO_TypeDef * gpio_port, int32_t gpio_pin)
+void DHT22_Init(PLATFORM_timer_t * htim_us, PLATFORM_port_t * gpio_port, int32_t gpio_pin)
 {
   /* init */
   loc_htim_us = htim_us;
@@ -117,7 +54,7 @@ void DHT22_Init(TIM_HandleTypeDef * htim_us, GPIO_TypeDef * gpio_port, int32_t g
   loc_gpio_port = gpio_port;
 
   /* default gpio state */
-  set_gpio_input();
+  PLATFORM_PinMode(loc_gpio_port, loc_gpio_pin, 0);
 }
 
 /**
@@ -128,36 +65,36 @@ void DHT22_Init(TIM_HandleTypeDef * htim_us, GPIO_TypeDef * gpio_port, int32_t g
 void DHT22_StartSensor(void)
 {
   /* preconditions check */
+  assert(loc_htim_us != NULL);
   assert(loc_gpio_pin != -1);
   assert(loc_gpio_port != NULL);
 
   /* set the pin as output */
-  set_gpio_output();
+  PLATFORM_PinMode(loc_gpio_port, loc_gpio_pin, 1);
 
   /* pull the pin low */
-  HAL_GPIO_WritePin(loc_gpio_port, loc_gpio_pin, 0);
-  delay_us(500);
+  PLATFORM_PinWrite(loc_gpio_port, loc_gpio_pin, 0);
+  PLATFORM_DelayUs(loc_htim_us, 500);
 
   /* pull the pin high */
-  HAL_GPIO_WritePin(loc_gpio_port, loc_gpio_pin, 1);
-  delay_us(30);
+  PLATFORM_PinWrite(loc_gpio_port, loc_gpio_pin, 1);
+  PLATFORM_DelayUs(loc_htim_us, 30);
 
   /* set as input */
-  set_gpio_input();
+  PLATFORM_PinMode(loc_gpio_port, loc_gpio_pin, 0);
 }
 
-
 /**
  * Analazes the DHT22 response regarding the pulse durations.
  * 
- * @param buffer buffer where pulse durations are written.
- * @param len length of the buffer in 32-bit words.
+ * @param buffer buffer where pulse durations are written (16-bit, saturated).
+ * @param len number of pulse durations.
  * @param temper output temperature. 
  * @param rh output relative humidity.
  * 
  * @return 0 when no error.
  */
-int32_t DHT22_AnalyseData(uint32_t * buffer, int32_t len, uint32_t * temper, uint32_t * rh)
+int32_t DHT22_AnalyseData(const uint16_t * buffer, int32_t len, uint32_t * temper, uint32_t * rh)
 {
   int32_t retval = 0;
   uint32_t humidity;
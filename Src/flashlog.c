@@ -0,0 +1,432 @@
+/**
+ * @file flashlog.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "flashlog.h"
+#include "capture.h"
+
+
+/* erased half-word */
+#define FLASHLOG_ERASED  0xFFFF
+
+/* no page */
+#define FLASHLOG_NONE  (-1)
+
+
+/* flash backend */
+static const FLASHLOG_flash_t * flashlog_flash;
+
+/* last page of the log (FLASHLOG_NONE if empty), its sequence and its next free slot */
+static int32_t flashlog_head;
+static uint32_t flashlog_head_seq;
+static int32_t flashlog_slot;
+
+/* erased page waiting for its header (FLASHLOG_NONE if none) */
+static int32_t flashlog_erased;
+
+/* records staged in RAM */
+static FLASHLOG_record_t flashlog_stage[FLASHLOG_STAGE_SIZE];
+static uint32_t flashlog_stage_write;
+static uint32_t flashlog_stage_read;
+
+/* state and counters */
+static FLASHLOG_stats_t flashlog_stats;
+
+
+/**
+ * Reads a half-word of the log area.
+ *
+ * @param offset offset in bytes from the start of the area.
+ *
+ * @return half-word.
+ */
+static uint16_t half_read(uint32_t offset)
+{
+  const uint8_t * const data = &flashlog_flash->base[offset];
+
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+/**
+ * @return offset of a record slot in the log area.
+ */
+static uint32_t slot_offset(int32_t page, int32_t slot)
+{
+  return (uint32_t)page * FLASHLOG_PAGE_SIZE + FLASHLOG_HEADER_SIZE + (uint32_t)slot * FLASHLOG_RECORD_SIZE;
+}
+
+/**
+ * Reads a page header.
+ *
+ * @param page page index.
+ * @param seq output page sequence.
+ *
+ * @return 1 if the header is complete, otherwise 0.
+ */
+static int32_t page_header(int32_t page, uint32_t * seq)
+{
+  const uint32_t offset = (uint32_t)page * FLASHLOG_PAGE_SIZE;
+  const uint16_t low = half_read(offset + 2);
+  const uint16_t high = half_read(offset + 4);
+
+  *seq = ((uint32_t)high << 16) | low;
+
+  return ((half_read(offset) == FLASHLOG_MAGIC) && (half_read(offset + 6) == (uint16_t)~(low ^ high))) ? 1 : 0;
+}
+
+/**
+ * @return 1 if all the half-words of an area (header or record slot) are erased.
+ */
+static int32_t area_erased(uint32_t offset, int32_t size)
+{
+  int32_t i;
+
+  for (i = 0; i < size; i += 2)
+  {
+    if (half_read(offset + i) != FLASHLOG_ERASED)
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Computes the CRC8 of a record.
+ *
+ * @param record record.
+ *
+ * @return CRC8 of the channel, value and time bytes.
+ */
+static uint8_t record_crc(const FLASHLOG_record_t * record)
+{
+  uint8_t data[9];
+  int32_t i;
+
+  data[0] = (uint8_t)record->channel;
+  for (i = 0; i < 4; i++)
+  {
+    data[1 + i] = (uint8_t)((uint32_t)record->value >> (8 * i));
+    data[5 + i] = (uint8_t)(record->time >> (8 * i));
+  }
+
+  return CAPTURE_Crc8(data, sizeof(data));
+}
+
+/**
+ * Programs the half-words of an area, the first one last (commit marker).
+ *
+ * @param offset offset of the area in bytes.
+ * @param data half-words to program.
+ * @param count number of half-words.
+ *
+ * @return 0 if ok.
+ */
+static int32_t program(uint32_t offset, const uint16_t * data, int32_t count)
+{
+  int32_t retval = 0;
+  int32_t i;
+
+  for (i = 1; (i < count) && (retval == 0); i++)
+  {
+    retval = flashlog_flash->program(offset + 2 * i, data[i]);
+  }
+  if (retval == 0)
+  {
+    retval = flashlog_flash->program(offset, data[0]);
+  }
+  if (retval != 0)
+  {
+    flashlog_stats.errors++;
+  }
+
+  return retval;
+}
+
+/**
+ * Opens the next page of the rotation: erases it (first call), then
+ * programs its header (second call).
+ *
+ * @return void.
+ */
+static void page_open(void)
+{
+  const int32_t page = (flashlog_head == FLASHLOG_NONE) ? 0 : ((flashlog_head + 1) % flashlog_flash->pages);
+  const uint32_t seq = (flashlog_head == FLASHLOG_NONE) ? 0 : (flashlog_head_seq + 1);
+  uint32_t old_seq;
+
+  if (flashlog_erased != page)
+  {
+    /* the records of the oldest page are lost */
+    if ((seq >= (uint32_t)flashlog_flash->pages) &&
+        (flashlog_stats.first < (seq - flashlog_flash->pages + 1) * FLASHLOG_RECORDS_PER_PAGE))
+    {
+      flashlog_stats.first = (seq - flashlog_flash->pages + 1) * FLASHLOG_RECORDS_PER_PAGE;
+    }
+
+    /* a partial erase must not leave a valid header: the magic is cleared first */
+    if ((page_header(page, &old_seq) != 0) &&
+        (flashlog_flash->program((uint32_t)page * FLASHLOG_PAGE_SIZE, 0x0000) != 0))
+    {
+      flashlog_stats.errors++;
+    }
+    else
+    {
+      if (flashlog_flash->erase((uint32_t)page * FLASHLOG_PAGE_SIZE) == 0)
+      {
+        flashlog_erased = page;
+      }
+      else
+      {
+        flashlog_stats.errors++;
+      }
+      flashlog_stats.erases++;
+    }
+  }
+  else
+  {
+    uint16_t header[4];
+
+    header[0] = FLASHLOG_MAGIC;
+    header[1] = (uint16_t)seq;
+    header[2] = (uint16_t)(seq >> 16);
+    header[3] = (uint16_t)~(header[1] ^ header[2]);
+    flashlog_erased = FLASHLOG_NONE;
+
+    /* a failed header is erased again */
+    if (program((uint32_t)page * FLASHLOG_PAGE_SIZE, header, 4) == 0)
+    {
+      flashlog_head = page;
+      flashlog_head_seq = seq;
+      flashlog_slot = 0;
+      flashlog_stats.next = seq * FLASHLOG_RECORDS_PER_PAGE;
+    }
+  }
+}
+
+/**
+ * Initializes the module and recovers the state of the log: last page
+ * from the page headers, end of this page by bisection.
+ *
+ * @param flash flash backend.
+ *
+ * @return number of records in the log.
+ */
+int32_t FLASHLOG_Init(const FLASHLOG_flash_t * flash)
+{
+  uint32_t seq;
+  int32_t low, high;
+  int32_t page;
+
+  flashlog_flash = flash;
+  flashlog_head = FLASHLOG_NONE;
+  flashlog_head_seq = 0;
+  flashlog_slot = 0;
+  flashlog_erased = FLASHLOG_NONE;
+  flashlog_stage_write = 0;
+  flashlog_stage_read = 0;
+  memset(&flashlog_stats, 0, sizeof(flashlog_stats));
+
+  /* last page: highest sequence */
+  for (page = 0; page < flash->pages; page++)
+  {
+    if (page_header(page, &seq) != 0)
+    {
+      if ((flashlog_head == FLASHLOG_NONE) || (seq > flashlog_head_seq))
+      {
+        flashlog_head = page;
+        flashlog_head_seq = seq;
+      }
+    }
+    else if (area_erased((uint32_t)page * FLASHLOG_PAGE_SIZE, FLASHLOG_HEADER_SIZE) == 0)
+    {
+      /* incomplete header (power loss), erased again when the page comes next */
+      flashlog_stats.torn++;
+    }
+  }
+
+  if (flashlog_head != FLASHLOG_NONE)
+  {
+    /* oldest page of the same rotation */
+    flashlog_stats.first = flashlog_head_seq;
+    for (page = 0; page < flash->pages; page++)
+    {
+      if ((page_header(page, &seq) != 0) && (seq < flashlog_stats.first) &&
+          ((flashlog_head_seq - seq) < (uint32_t)flash->pages))
+      {
+        flashlog_stats.first = seq;
+      }
+    }
+    flashlog_stats.first *= FLASHLOG_RECORDS_PER_PAGE;
+
+    /* first erased slot: the programmed slots (torn or not) are in front */
+    low = 0;
+    high = FLASHLOG_RECORDS_PER_PAGE;
+    while (low < high)
+    {
+      const int32_t middle = (low + high) / 2;
+
+      if (area_erased(slot_offset(flashlog_head, middle), FLASHLOG_RECORD_SIZE) != 0)
+      {
+        high = middle;
+      }
+      else
+      {
+        low = middle + 1;
+      }
+    }
+    flashlog_slot = low;
+    flashlog_stats.next = flashlog_head_seq * FLASHLOG_RECORDS_PER_PAGE + (uint32_t)low;
+  }
+  flashlog_stats.boot = flashlog_stats.next;
+
+  return (int32_t)(flashlog_stats.next - flashlog_stats.first);
+}
+
+/**
+ * Stages a reading (copied in RAM, programmed by FLASHLOG_Commit()).
+ *
+ * @param channel published channel (see SENSORS_CHANNEL_e), below 255.
+ * @param value published value.
+ * @param time see FLASHLOG_TIME_WALL.
+ *
+ * @return void.
+ */
+void FLASHLOG_Append(uint32_t channel, int32_t value, uint32_t time)
+{
+  FLASHLOG_record_t * const record = &flashlog_stage[flashlog_stage_write & (FLASHLOG_STAGE_SIZE - 1)];
+
+  record->channel = channel;
+  record->value = value;
+  record->time = time;
+  flashlog_stage_write++;
+
+  /* full: the oldest record is overwritten */
+  if ((flashlog_stage_write - flashlog_stage_read) > FLASHLOG_STAGE_SIZE)
+  {
+    flashlog_stage_read++;
+    flashlog_stats.lost++;
+  }
+}
+
+/**
+ * Drops the staged records (delivered to the Linux server).
+ *
+ * @return void.
+ */
+void FLASHLOG_Delivered(void)
+{
+  flashlog_stage_read = flashlog_stage_write;
+}
+
+/**
+ * Programs the oldest staged record, or prepares the next page (one flash
+ * erase, or a few half-word programs per call).
+ *
+ * @return 1 if records are still staged, otherwise 0.
+ */
+int32_t FLASHLOG_Commit(void)
+{
+  if (flashlog_stage_read == flashlog_stage_write)
+  {
+    return 0;
+  }
+
+  if ((flashlog_head == FLASHLOG_NONE) || (flashlog_slot >= FLASHLOG_RECORDS_PER_PAGE))
+  {
+    page_open();
+  }
+  else
+  {
+    const FLASHLOG_record_t * const record = &flashlog_stage[flashlog_stage_read & (FLASHLOG_STAGE_SIZE - 1)];
+    uint16_t data[FLASHLOG_RECORD_SIZE / 2];
+
+    data[0] = (uint16_t)((record->channel & 0xFF) | (record_crc(record) << 8));
+    data[1] = (uint16_t)(uint32_t)record->value;
+    data[2] = (uint16_t)((uint32_t)record->value >> 16);
+    data[3] = (uint16_t)record->time;
+    data[4] = (uint16_t)(record->time >> 16);
+
+    /* a failed record is torn: its slot is skipped */
+    (void)program(slot_offset(flashlog_head, flashlog_slot), data, FLASHLOG_RECORD_SIZE / 2);
+    flashlog_slot++;
+    flashlog_stats.next++;
+    flashlog_stage_read++;
+  }
+
+  return (flashlog_stage_read != flashlog_stage_write) ? 1 : 0;
+}
+
+/**
+ * Reads a record of the log.
+ *
+ * @param sequence record sequence number.
+ * @param record output record.
+ *
+ * @return 1 if ok, 0 if the record is torn, -1 if it is not in the log.
+ */
+int32_t FLASHLOG_Read(uint32_t sequence, FLASHLOG_record_t * record)
+{
+  const uint32_t page_seq = sequence / FLASHLOG_RECORDS_PER_PAGE;
+  const int32_t slot = (int32_t)(sequence % FLASHLOG_RECORDS_PER_PAGE);
+  uint32_t seq;
+  int32_t page;
+  uint32_t offset;
+  uint16_t commit;
+
+  if ((sequence < flashlog_stats.first) || (sequence >= flashlog_stats.next))
+  {
+    return -1;
+  }
+
+  /* pages follow each other in the rotation */
+  page = (int32_t)((flashlog_head + flashlog_flash->pages -
+      (int32_t)((flashlog_head_seq - page_seq) % (uint32_t)flashlog_flash->pages)) % flashlog_flash->pages);
+  if ((page_header(page, &seq) == 0) || (seq != page_seq))
+  {
+    return -1;
+  }
+
+  offset = slot_offset(page, slot);
+  commit = half_read(offset);
+  record->channel = commit & 0xFF;
+  record->value = (int32_t)((uint32_t)half_read(offset + 2) | ((uint32_t)half_read(offset + 4) << 16));
+  record->time = (uint32_t)half_read(offset + 6) | ((uint32_t)half_read(offset + 8) << 16);
+
+  return ((commit != FLASHLOG_ERASED) && ((commit >> 8) == record_crc(record))) ? 1 : 0;
+}
+
+/**
+ * Gets the state and counters of the log.
+ *
+ * @param stats output state and counters.
+ *
+ * @return void.
+ */
+void FLASHLOG_StatsGet(FLASHLOG_stats_t * stats)
+{
+  *stats = flashlog_stats;
+  stats->staged = flashlog_stage_write - flashlog_stage_read;
+}
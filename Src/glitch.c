@@ -0,0 +1,88 @@
+/**
+ * @file glitch.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+
+#include "glitch.h"
+
+
+/**
+ * Initializes a filter state.
+ *
+ * @param state state to initialize.
+ * @param timestamp time of the reference edge.
+ *
+ * @return void.
+ */
+void GLITCH_Init(GLITCH_state_t * state, uint32_t timestamp)
+{
+  state->reference = timestamp;
+  state->edges = 0;
+  state->merged = 0;
+  state->dropped = 0;
+}
+
+/**
+ * Handles a falling edge (from the capture interrupt).
+ *
+ * @details A noise spike adds a falling edge inside a real duration. When
+ * it is dropped (old behaviour) the real duration is lost and the next one
+ * is shortened, so the decoder resets twice. When it is merged the
+ * reference edge is kept and the next duration is measured exactly; if
+ * the spike was just after the real edge, the error is below the runt
+ * threshold.
+ *
+ * @param state filter state.
+ * @param config configuration.
+ * @param timestamp time of the edge in ticks.
+ * @param duration output duration in ticks (when 1 is returned).
+ *
+ * @return 1 if a duration is available, otherwise 0.
+ */
+int32_t GLITCH_Edge(GLITCH_state_t * state, const GLITCH_config_t * config, uint32_t timestamp, uint32_t * duration)
+{
+  int32_t retval = 1;
+  const uint32_t value = timestamp - state->reference;
+
+  state->edges++;
+
+  if (value < config->merge_ticks)
+  {
+    if (config->mode == GLITCH_MODE_DROP)
+    {
+      state->reference = timestamp;
+      state->dropped++;
+    }
+    else
+    {
+      state->merged++;
+    }
+    retval = 0;
+  }
+  else
+  {
+    *duration = value;
+    state->reference = timestamp;
+  }
+
+  return retval;
+}
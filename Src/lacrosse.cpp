@@ -28,7 +28,7 @@
 
 
 /* number of repeats to send data in LaCrosse-like format */
-#define REPEAT_NUMBER 12
+#define REPEAT_NUMBER LACROSSE_REPEAT_NUMBER
 
 /*
  * 2 - 'start bit'
@@ -53,89 +53,226 @@
 #define RADIO_DURATION_SCALING_1     100
 #define RADIO_DURATION_SCALING_0     100
 
+/* CRC8 polynomial (x^8 + x^5 + x^4 + 1) of the checksum */
+#define CRC8_POLYNOMIAL              0x31
+
+/* receiver state when 40 bits are ready (3 start bits + 40 bits) */
+#define RADIO_STATE_DONE             43
+
+/*
+ * Calibration of the receiver windows: histogram of 128 bins of 16 microsec
+ * (up to 2048 microsec), maximal shift of a window centre from its nominal 
+ * value, minimal number of samples to move a window, histogram ageing limit.
+ */
+#define RADIO_CALIB_BIN_SHIFT        4
+#define RADIO_CALIB_BIN_NUMBER       128
+#define RADIO_CALIB_MAX_SHIFT        100
+#define RADIO_CALIB_MIN_COUNT        64
+#define RADIO_CALIB_MAX_COUNT        0x8000
+
+/* nominal receiver windows in LACROSSE_SYMBOL_e order */
+#define RADIO_WINDOW(low, high)      { (low), (high), ((low) + (high)) / 2, 0 }
+#define RADIO_WINDOWS_NOMINAL        { \
+    RADIO_WINDOW(RADIO_DURATION_2_LOW, RADIO_DURATION_2_HIGH), \
+    RADIO_WINDOW(RADIO_DURATION_21_LOW, RADIO_DURATION_21_HIGH), \
+    RADIO_WINDOW(RADIO_DURATION_10_LOW, RADIO_DURATION_10_HIGH), \
+    RADIO_WINDOW(RADIO_DURATION_00_LOW, RADIO_DURATION_00_HIGH), \
+    RADIO_WINDOW(RADIO_DURATION_01_LOW, RADIO_DURATION_01_HIGH) }
+
+
+/**
+ * 256-entry byte table.
+ */
+typedef struct {
+  uint8_t value[256];
+} byte_table_t;
 
 /**
- * CRC8 table with polynomial 0x31 and init value 0x00. 
+ * Slicing tables of the checksum: one table per payload byte (LSB first).
+ */
+typedef struct {
+  byte_table_t slice[4];
+} crc_slice_t;
+
+/**
+ * Shifts a CRC8 value by 8 bits (one CRC step with a zero byte).
  * 
- * @details For more information refer to https://tuppi.ovh/doc_lacrosse.
+ * @param crc CRC8 value.
+ * 
+ * @return shifted CRC8 value.
  */
-static const uint8_t crc_table[] = {
-                         0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97,
-                         0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
-                         0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4,
-                         0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
-                         0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11,
-                         0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
-                         0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52,
-                         0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
-                         0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA,
-                         0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
-                         0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9,
-                         0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
-                         0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C,
-                         0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
-                         0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F,
-                         0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
-                         0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED,
-                         0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
-                         0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE,
-                         0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
-                         0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B,
-                         0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
-                         0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28,
-                         0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
-                         0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0,
-                         0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
-                         0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93,
-                         0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
-                         0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56,
-                         0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
-                         0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15,
-                         0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC 
-};
+static constexpr uint32_t crc8_shift(uint32_t crc)
+{
+  int32_t i = 0;
+
+  for (i = 0; i < 8; i++)
+  {
+    crc = (crc & 0x80) ? (((crc << 1) ^ CRC8_POLYNOMIAL) & 0xFF) : ((crc << 1) & 0xFF);
+  }
+
+  return crc;
+}
 
 /**
- * Redirection table found from statistic data.
+ * Generates the CRC8 table of a byte followed by a number of zero bytes.
  * 
- * @details For more information refer to https://tuppi.ovh/doc_lacrosse.
- */ 
-static const uint8_t crc_redir_table[] = {
-                        0 	, 49	, 98	, 83	, 196	, 245	, 166	, 151	, 185	, 136	,
-                        219	, 234	, 125	, 76	, 31	, 46	, 67	, 114	, 33	, 16	,
-                        135	, 182	, 229	, 212	, 250	, 203	, 152	, 169	, 62	, 15	, 
-                        92	, 109	, 134	, 183	, 228	, 213	, 66	, 115	, 32	, 17	, 
-                        63	, 14	, 93	, 108	, 251	, 202	, 153	, 168	, 197	, 244	, 
-                        167	, 150	,  1	, 48	, 99	, 82	, 124	, 77	, 30	, 47	, 
-                        184	, 137	, 218	, 235	, 61	, 12	, 95	, 110	, 249	, 200	, 
-                        155	, 170	, 132	, 181	, 230	, 215	, 64	, 113	, 34	, 19	, 
-                        126	, 79	, 28	, 45	, 186	, 139	, 216	, 233	, 199	, 246	, 
-                        165	, 148	,  3	, 50	, 97	, 80	, 187	, 138	, 217	, 232	, 
-                        127	, 78	, 29	, 44	,  2	, 51	, 96	, 81	, 198	, 247	, 
-                        164	, 149	, 248	, 201	, 154	, 171	, 60	, 13	, 94	, 111	, 
-                        65	, 112	, 35	, 18	, 133	, 180	, 231	, 214	, 122	, 75	,
-                        24	, 41	, 190	, 143	, 220	, 237	, 195	, 242	, 161	, 144	,
-                        7	  , 54	, 101	, 84	, 57	,  8	, 91	, 106	, 253	, 204	, 
-                        159	, 174	, 128	, 177	, 226	, 211	, 68	, 117	, 38	, 23	, 
-                        252	, 205	, 158	, 175	, 56	,  9	, 90	, 107	, 69	, 116	, 
-                        39	, 22	, 129	, 176	, 227	, 210	, 191	, 142	, 221	, 236	, 
-                        123	, 74	, 25	, 40	,  6	, 55	, 100	, 85	, 194	, 243	, 
-                        160	, 145	, 71	, 118	, 37	, 20	, 131	, 178	, 225	, 208	, 
-                        254	, 207	, 156	, 173	, 58	, 11	, 88	, 105	,  4	, 53	, 
-                        102	, 87	, 192	, 241	, 162	, 147	, 189	, 140	, 223	, 238	, 
-                        121	, 72	, 27	, 42	, 193	, 240	, 163	, 146	,  5	, 52	, 
-                        103	, 86	, 120	, 73	, 26	, 43	, 188	, 141	, 222	, 239	, 
-                        130	, 179	, 224	, 209	, 70	, 119	, 36	, 21	, 59	, 10	, 
-                        89	, 104	, 255	, 206	, 157	, 172	 
-};
+ * @param zeros number of zero bytes after the indexed byte.
+ * 
+ * @return generated table.
+ */
+static constexpr byte_table_t crc_table_generate(int32_t zeros)
+{
+  byte_table_t table = {};
+  int32_t i = 0;
+  int32_t k = 0;
 
-#ifdef ARDUINO_RX_TX_ENABLED
+  for (i = 0; i < 256; i++)
+  {
+    uint32_t crc = crc8_shift(i);
+    for (k = 0; k < zeros; k++)
+    {
+      crc = crc8_shift(crc);
+    }
+    table.value[i] = crc;
+  }
+
+  return table;
+}
+
+/**
+ * Generates the slicing tables of the checksum.
+ * 
+ * @details The LaCrosse checksum is a CRC8 with polynomial 0x31 and init value 
+ * 0x00 over the 4 payload bytes, followed by the 'redirection' table found from 
+ * statistic data. This redirection is one more CRC step with a zero byte. As the 
+ * CRC is linear with a zero init value, the checksum is a XOR of 4 independent 
+ * lookups: payload byte k (LSB first) followed by k + 1 zero bytes.
+ * 
+ * @return generated tables.
+ */
+static constexpr crc_slice_t crc_slice_generate(void)
+{
+  crc_slice_t slice = {};
+  int32_t k = 0;
+
+  for (k = 0; k < 4; k++)
+  {
+    slice.slice[k] = crc_table_generate(k + 1);
+  }
+
+  return slice;
+}
+
+/**
+ * Verifies the generated tables against the CRC8 and redirection tables 
+ * of https://tuppi.ovh/doc_lacrosse.
+ * 
+ * @return error code (0 when no error).
+ */
+static constexpr int32_t crc_table_verify(void)
+{
+  /* CRC8 table with polynomial 0x31 and init value 0x00 */
+  const uint8_t crc_table[256] = {
+      0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97,
+      0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+      0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4,
+      0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+      0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11,
+      0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+      0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52,
+      0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+      0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA,
+      0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+      0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9,
+      0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+      0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C,
+      0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+      0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F,
+      0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+      0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED,
+      0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+      0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE,
+      0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+      0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B,
+      0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+      0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28,
+      0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+      0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0,
+      0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+      0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93,
+      0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+      0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56,
+      0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+      0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15,
+      0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+  };
+
+  /* redirection table found from statistic data */
+  const uint8_t crc_redir_table[256] = {
+      0 	, 49	, 98	, 83	, 196	, 245	, 166	, 151	, 185	, 136	,
+      219	, 234	, 125	, 76	, 31	, 46	, 67	, 114	, 33	, 16	,
+      135	, 182	, 229	, 212	, 250	, 203	, 152	, 169	, 62	, 15	,
+      92	, 109	, 134	, 183	, 228	, 213	, 66	, 115	, 32	, 17	,
+      63	, 14	, 93	, 108	, 251	, 202	, 153	, 168	, 197	, 244	,
+      167	, 150	,  1	, 48	, 99	, 82	, 124	, 77	, 30	, 47	,
+      184	, 137	, 218	, 235	, 61	, 12	, 95	, 110	, 249	, 200	,
+      155	, 170	, 132	, 181	, 230	, 215	, 64	, 113	, 34	, 19	,
+      126	, 79	, 28	, 45	, 186	, 139	, 216	, 233	, 199	, 246	,
+      165	, 148	,  3	, 50	, 97	, 80	, 187	, 138	, 217	, 232	,
+      127	, 78	, 29	, 44	,  2	, 51	, 96	, 81	, 198	, 247	,
+      164	, 149	, 248	, 201	, 154	, 171	, 60	, 13	, 94	, 111	,
+      65	, 112	, 35	, 18	, 133	, 180	, 231	, 214	, 122	, 75	,
+      24	, 41	, 190	, 143	, 220	, 237	, 195	, 242	, 161	, 144	,
+      7	  , 54	, 101	, 84	, 57	,  8	, 91	, 106	, 253	, 204	,
+      159	, 174	, 128	, 177	, 226	, 211	, 68	, 117	, 38	, 23	,
+      252	, 205	, 158	, 175	, 56	,  9	, 90	, 107	, 69	, 116	,
+      39	, 22	, 129	, 176	, 227	, 210	, 191	, 142	, 221	, 236	,
+      123	, 74	, 25	, 40	,  6	, 55	, 100	, 85	, 194	, 243	,
+      160	, 145	, 71	, 118	, 37	, 20	, 131	, 178	, 225	, 208	,
+      254	, 207	, 156	, 173	, 58	, 11	, 88	, 105	,  4	, 53	,
+      102	, 87	, 192	, 241	, 162	, 147	, 189	, 140	, 223	, 238	,
+      121	, 72	, 27	, 42	, 193	, 240	, 163	, 146	,  5	, 52	,
+      103	, 86	, 120	, 73	, 26	, 43	, 188	, 141	, 222	, 239	,
+      130	, 179	, 224	, 209	, 70	, 119	, 36	, 21	, 59	, 10	,
+      89	, 104	, 255	, 206	, 157	, 172
+  };
+
+  const byte_table_t table = crc_table_generate(0);
+  int32_t retval = 0;
+  int32_t i = 0;
+
+  for (i = 0; i < 256; i++)
+  {
+    if ((table.value[i] != crc_table[i]) || (table.value[i] != crc_redir_table[i]))
+    {
+      retval = -1;
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * CRC8 table with polynomial 0x31 and init value 0x00, also used as 
+ * redirection table.
+ */
+static constexpr byte_table_t crc_table = crc_table_generate(0);
+
+/**
+ * Checksum slicing tables (see @ref crc_slice_generate()).
+ */
+static constexpr crc_slice_t crc_slice = crc_slice_generate();
+
+static_assert(crc_table_verify() == 0, "generated CRC8 tables differ from the LaCrosse ones");
+
+#ifdef PLATFORM_RADIO_TX
 
 /**
  * The interest to use a simple encryption table is to not send the data by 433 MHz in clear.
  * 
  * @details used CRC8 DVB_S2 algorithm from http://www.sunshine2k.de/coding/javascript/crc/crc_js.html.
  */
-static const uint8_t encrypt_table[] = {
+static constexpr byte_table_t encrypt_table = {{
     0x00, 0xF7, 0xB9, 0x4E, 0x25, 0xD2, 0x9C, 0x6B, 0x4A, 0xBD, 0xF3, 0x04, 0x6F, 0x98, 0xD6, 0x21,
     0x94, 0x63, 0x2D, 0xDA, 0xB1, 0x46, 0x08, 0xFF, 0xDE, 0x29, 0x67, 0x90, 0xFB, 0x0C, 0x42, 0xB5,
     0x7F, 0x88, 0xC6, 0x31, 0x5A, 0xAD, 0xE3, 0x14, 0x35, 0xC2, 0x8C, 0x7B, 0x10, 0xE7, 0xA9, 0x5E,
@@ -152,41 +289,159 @@ static const uint8_t encrypt_table[] = {
     0xC1, 0x36, 0x78, 0x8F, 0xE4, 0x13, 0x5D, 0xAA, 0x8B, 0x7C, 0x32, 0xC5, 0xAE, 0x59, 0x17, 0xE0,
     0x2A, 0xDD, 0x93, 0x64, 0x0F, 0xF8, 0xB6, 0x41, 0x60, 0x97, 0xD9, 0x2E, 0x45, 0xB2, 0xFC, 0x0B,
     0xBE, 0x49, 0x07, 0xF0, 0x9B, 0x6C, 0x22, 0xD5, 0xF4, 0x03, 0x4D, 0xBA, 0xD1, 0x26, 0x68, 0x9F
-};
+}};
+
+/**
+ * Generates the inverse of the encryption table.
+ * 
+ * @return generated table.
+ */
+static constexpr byte_table_t decrypt_table_generate(void)
+{
+  byte_table_t table = {};
+  int32_t i = 0;
+
+  for (i = 0; i < 256; i++)
+  {
+    table.value[encrypt_table.value[i]] = i;
+  }
+
+  return table;
+}
+
+/**
+ * Decryption table (see @ref decrypt_table_generate()).
+ */
+static constexpr byte_table_t decrypt_table = decrypt_table_generate();
+
+/**
+ * Verifies that the decryption table is the inverse of the encryption one.
+ * 
+ * @return error code (0 when no error).
+ */
+static constexpr int32_t decrypt_table_verify(void)
+{
+  int32_t retval = 0;
+  int32_t i = 0;
+
+  for (i = 0; i < 256; i++)
+  {
+    if (decrypt_table.value[encrypt_table.value[i]] != i)
+    {
+      retval = -1;
+    }
+  }
 
-static uint8_t decrypt_table[256];
+  return retval;
+}
 
-static void (*p_pin_switch)(int32_t) = NULL;
-static void (*p_sleep_us)(int32_t) = NULL;
+static_assert(decrypt_table_verify() == 0, "encryption table is not a permutation");
+
+/* schedule played by LACROSSE_output_edge() */
+static LACROSSE_schedule_t output_schedule;
 
 #endif
 
+/**
+ * Nominal receiver windows (see RADIO_DURATION_XXX declarations).
+ * 
+ * @details '11' shares the window of '00'.
+ */
+static const LACROSSE_window_t radio_window_nominal[LACROSSE_SYMBOL_NUMBER] = RADIO_WINDOWS_NOMINAL;
 
 /**
- * Calculates a checksum for the 32-bit payload.
+ * Symbols sorted by increasing duration (to avoid window overlaps).
+ */
+static const LACROSSE_SYMBOL_e radio_window_order[LACROSSE_SYMBOL_NUMBER] = {
+    LACROSSE_SYMBOL_SHORT, LACROSSE_SYMBOL_MEDIUM, LACROSSE_SYMBOL_LONG,
+    LACROSSE_SYMBOL_FIRST, LACROSSE_SYMBOL_START
+};
+
+/* receiver state */
+static int32_t radio_state = 0;
+static uint64_t radio_register = 0;
+static int32_t bit = 0;
+
+/* receiver windows and calibration */
+static LACROSSE_window_t radio_window[LACROSSE_SYMBOL_NUMBER] = RADIO_WINDOWS_NOMINAL;
+static uint16_t radio_histogram[RADIO_CALIB_BIN_NUMBER];
+static uint32_t radio_histogram_total = 0;
+static uint16_t radio_frame_duration[RADIO_STATE_DONE];
+
+/* receiver statistics */
+static LACROSSE_stats_t radio_stats;
+
+/* link quality of the last complete word */
+static LACROSSE_word_t radio_word;
+static uint32_t radio_word_ready = 0;
+
+
+/**
+ * Calculates a checksum for the 32-bit payload byte by byte (reference).
  * 
  * @param payload payload.
  * 
  * @return calculated checksum.
  */
-static uint32_t checksum_calculate(uint32_t payload)
+static constexpr uint32_t checksum_calculate_bytewise(uint32_t payload)
 {
-  int32_t i;
-  uint32_t crc8_redir;
-  uint32_t crc8;
+  int32_t i = 0;
+  uint32_t crc8 = 0u;
 
-  crc8 = 0u;
   /* loop on 4 bytes */
   for (i = 0; i < 4; i++)
   {
     const uint32_t byte = (payload >> (8 * (3 - i))) & 0xFF;
-    crc8 = crc_table[(crc8 & 0xFF) ^ (byte & 0xFF)] & 0xFF;
+    crc8 = crc_table.value[(crc8 & 0xFF) ^ (byte & 0xFF)] & 0xFF;
+  }
+
+  /* redirection */
+  return crc_table.value[crc8];
+}
+
+/**
+ * Calculates a checksum for the 32-bit payload.
+ * 
+ * @details Fused version of @ref checksum_calculate_bytewise() (4 independent 
+ * table lookups including the redirection).
+ * 
+ * @param payload payload.
+ * 
+ * @return calculated checksum.
+ */
+static inline constexpr uint32_t checksum_calculate(uint32_t payload)
+{
+  return crc_slice.slice[0].value[(payload >> 0) & 0xFF]
+       ^ crc_slice.slice[1].value[(payload >> 8) & 0xFF]
+       ^ crc_slice.slice[2].value[(payload >> 16) & 0xFF]
+       ^ crc_slice.slice[3].value[(payload >> 24) & 0xFF];
+}
+
+/**
+ * Verifies the fused checksum against the byte by byte one.
+ * 
+ * @return error code (0 when no error).
+ */
+static constexpr int32_t checksum_verify_fused(void)
+{
+  int32_t retval = 0;
+  uint32_t payload = 0xAA000000u;
+  int32_t i = 0;
+
+  for (i = 0; i < 1024; i++)
+  {
+    if (checksum_calculate(payload) != checksum_calculate_bytewise(payload))
+    {
+      retval = -1;
+    }
+    payload = payload * 1664525u + 1013904223u;
   }
-  crc8_redir = crc_redir_table[crc8];
 
-  return crc8_redir;
+  return retval;
 }
 
+static_assert(checksum_verify_fused() == 0, "fused checksum differs from the byte by byte one");
+
 /**
  * Checksum verification regarding the Lacrosse algorithm.
  * 
@@ -203,6 +458,187 @@ static int32_t checksum_verify(uint32_t payload, uint32_t chk)
   return (chk == chk_calc) ? 0 : -1;
 }
 
+/**
+ * Checks if a duration is inside a receiver window.
+ * 
+ * @param duration pulse duration in microsec.
+ * @param symbol symbol class (see LACROSSE_SYMBOL_e).
+ * 
+ * @return 1 if inside, otherwise 0.
+ */
+static inline int32_t window_check(uint32_t duration, LACROSSE_SYMBOL_e symbol)
+{
+  return ((duration > radio_window[symbol].low) && (duration < radio_window[symbol].high)) ? 1 : 0;
+}
+
+/**
+ * Adds the durations of a valid frame to the histogram and moves the 
+ * receiver windows to the estimated cluster centres.
+ * 
+ * @details Each window keeps its nominal width and its centre can move at 
+ * most by RADIO_CALIB_MAX_SHIFT from the nominal one. The centre is the 
+ * weighted mean of the histogram inside this safe range. The histogram is 
+ * halved when full to follow the transmitter drift (temperature).
+ * 
+ * @return void.
+ */
+static void calib_update(void)
+{
+  int32_t i;
+
+  /* histogram */
+  for (i = 0; i < RADIO_STATE_DONE; i++)
+  {
+    const uint32_t bin = radio_frame_duration[i] >> RADIO_CALIB_BIN_SHIFT;
+    if (bin < RADIO_CALIB_BIN_NUMBER)
+    {
+      radio_histogram[bin]++;
+      radio_histogram_total++;
+    }
+  }
+
+  /* ageing */
+  if (radio_histogram_total >= RADIO_CALIB_MAX_COUNT)
+  {
+    radio_histogram_total = 0;
+    for (i = 0; i < RADIO_CALIB_BIN_NUMBER; i++)
+    {
+      radio_histogram[i] >>= 1;
+      radio_histogram_total += radio_histogram[i];
+    }
+  }
+
+  /* cluster centres */
+  for (i = 0; i < LACROSSE_SYMBOL_NUMBER; i++)
+  {
+    const LACROSSE_window_t * nominal = &radio_window_nominal[i];
+    const uint32_t half = (nominal->high - nominal->low) / 2;
+    const uint32_t bin_first = (nominal->centre - RADIO_CALIB_MAX_SHIFT) >> RADIO_CALIB_BIN_SHIFT;
+    const uint32_t bin_last = (nominal->centre + RADIO_CALIB_MAX_SHIFT - 1) >> RADIO_CALIB_BIN_SHIFT;
+    uint32_t sum = 0;
+    uint32_t count = 0;
+    uint32_t centre = nominal->centre;
+    uint32_t k;
+
+    for (k = bin_first; k <= bin_last; k++)
+    {
+      const uint32_t bin_centre = (k << RADIO_CALIB_BIN_SHIFT) + (1u << (RADIO_CALIB_BIN_SHIFT - 1));
+      sum += radio_histogram[k] * bin_centre;
+      count += radio_histogram[k];
+    }
+    if (count >= RADIO_CALIB_MIN_COUNT)
+    {
+      /* the bins at the ends of the range reach half a bin beyond it */
+      centre = sum / count;
+      if (centre < nominal->centre - RADIO_CALIB_MAX_SHIFT)
+      {
+        centre = nominal->centre - RADIO_CALIB_MAX_SHIFT;
+      }
+      else if (centre > nominal->centre + RADIO_CALIB_MAX_SHIFT)
+      {
+        centre = nominal->centre + RADIO_CALIB_MAX_SHIFT;
+      }
+      else
+      {
+        /* inside the safe range */
+      }
+    }
+
+    radio_window[i].centre = centre;
+    radio_window[i].low = centre - half;
+    radio_window[i].high = centre + half;
+    radio_window[i].count = count;
+  }
+
+  /* neighbour windows must not overlap */
+  for (i = 1; i < LACROSSE_SYMBOL_NUMBER; i++)
+  {
+    LACROSSE_window_t * prev = &radio_window[radio_window_order[i - 1]];
+    LACROSSE_window_t * next = &radio_window[radio_window_order[i]];
+    if (prev->high > next->low)
+    {
+      const uint32_t middle = (prev->centre + next->centre) / 2;
+      prev->high = middle;
+      next->low = middle;
+    }
+  }
+}
+
+/**
+ * Measures the deviation of the durations of the received 40-bit word from 
+ * the nominal window centres of their symbol classes.
+ * 
+ * @details The symbol class of a bit transition is given by the bits 
+ * of the register (the bit of state s is at position RADIO_STATE_DONE - 1 - s).
+ * 
+ * @param word output link quality.
+ * 
+ * @return void.
+ */
+static void word_measure(LACROSSE_word_t * word)
+{
+  uint32_t sum = 0;
+  uint32_t max = 0;
+  int32_t i;
+
+  for (i = 0; i < RADIO_STATE_DONE; i++)
+  {
+    LACROSSE_SYMBOL_e symbol = LACROSSE_SYMBOL_START;
+
+    if (i == 3)
+    {
+      symbol = LACROSSE_SYMBOL_FIRST;
+    }
+    else if (i > 3)
+    {
+      const uint32_t prev = (uint32_t)(radio_register >> (RADIO_STATE_DONE - i)) & 0x1;
+      const uint32_t next = (uint32_t)(radio_register >> (RADIO_STATE_DONE - 1 - i)) & 0x1;
+      symbol = (prev == next) ? LACROSSE_SYMBOL_MEDIUM : ((prev == 1) ? LACROSSE_SYMBOL_SHORT : LACROSSE_SYMBOL_LONG);
+    }
+
+    const uint32_t centre = radio_window_nominal[symbol].centre;
+    const uint32_t duration = radio_frame_duration[i];
+    const uint32_t deviation = (duration > centre) ? (duration - centre) : (centre - duration);
+    sum += deviation;
+    if (deviation > max)
+    {
+      max = deviation;
+    }
+  }
+
+  word->sync = (uint32_t)(radio_register >> 32) & 0xFF;
+  word->jitter_mean = sum / RADIO_STATE_DONE;
+  word->jitter_max = max;
+}
+
+/**
+ * Verifies the received 40-bit word and resets the receiver state.
+ * 
+ * @return 32-bit payload if ok, otherwise 0xFFFFFFFF.
+ */
+static uint32_t frame_complete(void)
+{
+  uint32_t retval = 0xFFFFFFFFu;
+
+  radio_state = 0;
+  word_measure(&radio_word);
+  if (checksum_verify(radio_register >> 8, radio_register & 0xFF) == 0)
+  {
+    retval = radio_register >> 8;
+    calib_update();
+    radio_stats.frames++;
+    radio_word.valid = 1;
+  }
+  else
+  {
+    radio_stats.crc_errors++;
+    radio_word.valid = 0;
+  }
+  radio_word_ready = 1;
+
+  return retval;
+}
+
 /**
  * Tries to receive 43 pulses (3 start bits + 32 bits of payload + 8 bits of checksum).
  * 
@@ -212,20 +648,22 @@ static int32_t checksum_verify(uint32_t payload, uint32_t chk)
  */
 uint32_t LACROSSE_input_handler(uint32_t duration_usec)
 {
-  static int32_t radio_state = 0;
-  static uint64_t radio_register = 0;
-  static int32_t bit = 0;
-
   uint32_t retval = 0xFFFFFFFFu;
   const uint32_t duration = duration_usec;
 
+  /* remember durations of the current frame for calibration */
+  if (radio_state < RADIO_STATE_DONE)
+  {
+    radio_frame_duration[radio_state] = (duration < 0xFFFF) ? duration : 0xFFFF;
+  }
+
   switch(radio_state)
   {
   /* start bits */
   case 0:
   case 1:
   case 2:
-    if ((duration > RADIO_DURATION_2_LOW) && (duration < RADIO_DURATION_2_HIGH))
+    if (window_check(duration, LACROSSE_SYMBOL_START))
     {
       radio_state++;
     }
@@ -237,7 +675,7 @@ uint32_t LACROSSE_input_handler(uint32_t duration_usec)
 
   /* first bit */
   case 3:
-    if ((duration > RADIO_DURATION_21_LOW) && (duration < RADIO_DURATION_21_HIGH))
+    if (window_check(duration, LACROSSE_SYMBOL_FIRST))
     {
       radio_state++;
       bit = 1;
@@ -251,32 +689,28 @@ uint32_t LACROSSE_input_handler(uint32_t duration_usec)
     break;
 
   /* 40 bits ready */
-  case 43:
-    radio_state = 0;
-    if (checksum_verify(radio_register >> 8, radio_register & 0xFF) == 0)
-    {
-      retval = radio_register >> 8;
-    }
+  case RADIO_STATE_DONE:
+    retval = frame_complete();
     break;
 
   /* from 2nd to 40th bits */
   default:
-    if ((duration > RADIO_DURATION_10_LOW) && (duration < RADIO_DURATION_10_HIGH) && (bit == 1))
+    if (window_check(duration, LACROSSE_SYMBOL_SHORT) && (bit == 1))
     {
       radio_state++;
       bit = 0;
     }
-    else if ((duration > RADIO_DURATION_00_LOW) && (duration < RADIO_DURATION_00_HIGH) && (bit == 0))
+    else if (window_check(duration, LACROSSE_SYMBOL_MEDIUM) && (bit == 0))
     {
       radio_state++;
       bit = 0;
     }
-    else if ((duration > RADIO_DURATION_11_LOW) && (duration < RADIO_DURATION_11_HIGH) && (bit == 1))
+    else if (window_check(duration, LACROSSE_SYMBOL_MEDIUM) && (bit == 1))
     {
       radio_state++;
       bit = 1;
     }
-    else if ((duration > RADIO_DURATION_01_LOW) && (duration < RADIO_DURATION_01_HIGH) && (bit == 0))
+    else if (window_check(duration, LACROSSE_SYMBOL_LONG) && (bit == 0))
     {
       radio_state++;
       bit = 1;
@@ -293,10 +727,122 @@ uint32_t LACROSSE_input_handler(uint32_t duration_usec)
   return retval;
 }
 
+/**
+ * Ends the current frame after an inter-pulse gap (no more pulses expected).
+ * 
+ * @details The 40th bit is only verified when the next pulse arrives, so the 
+ * last frame of a burst would wait for an unrelated edge. This function must 
+ * be called when no pulse has been received during the idle timeout. A 
+ * partially received frame is dropped.
+ * 
+ * @return 32-bit payload if a complete frame was pending, otherwise 0xFFFFFFFF.
+ */
+uint32_t LACROSSE_flush(void)
+{
+  uint32_t retval = 0xFFFFFFFFu;
+
+  if (radio_state == RADIO_STATE_DONE)
+  {
+    retval = frame_complete();
+  }
+  else
+  {
+    radio_state = 0;
+    bit = 0;
+  }
+
+  return retval;
+}
+
+/**
+ * Checks if the receiver waits for a start bit.
+ * 
+ * @details While idle, only durations inside ]LACROSSE_START_LOW, 
+ * LACROSSE_START_HIGH[ can change the receiver state.
+ * 
+ * @return 1 if idle, otherwise 0.
+ */
+uint32_t LACROSSE_is_idle(void)
+{
+  return (radio_state == 0) ? 1 : 0;
+}
+
+static_assert(RADIO_DURATION_2_LOW - RADIO_CALIB_MAX_SHIFT >= LACROSSE_START_LOW, "start window out of LACROSSE_START_LOW");
+static_assert(RADIO_DURATION_2_HIGH + RADIO_CALIB_MAX_SHIFT <= LACROSSE_START_HIGH, "start window out of LACROSSE_START_HIGH");
+
+/**
+ * Gets the receiver statistics.
+ * 
+ * @param stats output statistics.
+ * 
+ * @return void.
+ */
+void LACROSSE_stats_get(LACROSSE_stats_t * stats)
+{
+  *stats = radio_stats;
+}
+
+/**
+ * Gets the current receiver windows (calibration estimates).
+ * 
+ * @param windows output array of LACROSSE_SYMBOL_NUMBER windows.
+ * 
+ * @return void.
+ */
+void LACROSSE_calib_get(LACROSSE_window_t * windows)
+{
+  int32_t i;
+
+  for (i = 0; i < LACROSSE_SYMBOL_NUMBER; i++)
+  {
+    windows[i] = radio_window[i];
+  }
+}
+
+/**
+ * Resets the calibration to the nominal receiver windows.
+ * 
+ * @return void.
+ */
+void LACROSSE_calib_reset(void)
+{
+  int32_t i;
+
+  for (i = 0; i < LACROSSE_SYMBOL_NUMBER; i++)
+  {
+    radio_window[i] = radio_window_nominal[i];
+  }
+  for (i = 0; i < RADIO_CALIB_BIN_NUMBER; i++)
+  {
+    radio_histogram[i] = 0;
+  }
+  radio_histogram_total = 0;
+}
+
+/**
+ * Gets the link quality of the last complete word (once per word).
+ * 
+ * @param word output link quality.
+ * 
+ * @return 1 if a word has been completed since the last call, otherwise 0.
+ */
+uint32_t LACROSSE_word_get(LACROSSE_word_t * word)
+{
+  const uint32_t retval = radio_word_ready;
+
+  if (retval != 0)
+  {
+    *word = radio_word;
+    radio_word_ready = 0;
+  }
+
+  return retval;
+}
+
 
 /*********************************************************************************/
 
-#ifdef STM32_RX_ONLY_ENABLED
+#ifdef PLATFORM_STM32
 
 /**
  * Export C of the @ref LACROSSE_input_handler() function.
@@ -306,116 +852,288 @@ extern "C" uint32_t LACROSSE_input_handler_c(uint32_t duration_usec)
   return LACROSSE_input_handler(duration_usec);
 }
 
+/**
+ * Export C of the @ref LACROSSE_flush() function.
+ */
+extern "C" uint32_t LACROSSE_flush_c(void)
+{
+  return LACROSSE_flush();
+}
+
+/**
+ * Export C of the @ref LACROSSE_is_idle() function.
+ */
+extern "C" uint32_t LACROSSE_is_idle_c(void)
+{
+  return LACROSSE_is_idle();
+}
+
+/**
+ * Export C of the @ref LACROSSE_stats_get() function.
+ */
+extern "C" void LACROSSE_stats_get_c(LACROSSE_stats_t * stats)
+{
+  LACROSSE_stats_get(stats);
+}
+
+/**
+ * Export C of the @ref LACROSSE_calib_get() function.
+ */
+extern "C" void LACROSSE_calib_get_c(LACROSSE_window_t * windows)
+{
+  LACROSSE_calib_get(windows);
+}
+
+/**
+ * Export C of the @ref LACROSSE_calib_reset() function.
+ */
+extern "C" void LACROSSE_calib_reset_c(void)
+{
+  LACROSSE_calib_reset();
+}
+
+/**
+ * Export C of the @ref LACROSSE_word_get() function.
+ */
+extern "C" uint32_t LACROSSE_word_get_c(LACROSSE_word_t * word)
+{
+  return LACROSSE_word_get(word);
+}
+
 #endif
 
 
 /*********************************************************************************/
 
-#ifdef ARDUINO_TRANSMITTER_ENABLED
+#ifdef PLATFORM_RADIO_TX
+
+
+/**
+ * Adds a pulse (high then low level) to a schedule.
+ * 
+ * @param schedule schedule to fill.
+ * @param high duration of the high level in microsec.
+ * @param low duration of the low level in microsec.
+ * 
+ * @return void.
+ */
+static void schedule_pulse(LACROSSE_schedule_t * schedule, uint32_t high, uint32_t low)
+{
+  assert(schedule->size + 2 <= LACROSSE_SCHEDULE_SIZE);
 
+  schedule->duration[schedule->size++] = high;
+  schedule->duration[schedule->size++] = low;
+}
 
 /**
- * Sends a required number of bits.
+ * Adds a required number of bits to a schedule.
+ * 
+ * @details The receiver measures durations between falling edges: a bit 
+ * '1' is a long high level then a short low level, a bit '0' is a short 
+ * high level then a long low level. So a transition lasts the sum of two 
+ * half symbols, e.g. '1' to '0' is short + short (RADIO_DURATION_10_XXX).
+ * 
+ * @param schedule schedule to fill.
+ * @param data bits to add (MSB first).
+ * @param bits number of bits.
+ * 
+ * @return void.
  */
-static void send(uint32_t data, int32_t bits)
+static void schedule_bits(LACROSSE_schedule_t * schedule, uint32_t data, int32_t bits)
 {
   int32_t i;
 
   /* durations */
-  const uint32_t duration_short = (RADIO_DURATION_10_LOW + RADIO_DURATION_10_HIGH) >> 1;
-  const uint32_t duration_long  = (RADIO_DURATION_01_LOW + RADIO_DURATION_01_HIGH) >> 1;
-
-  /* preconditions check */
-  assert(p_pin_switch != NULL);
-  assert(p_sleep_us != NULL);
+  const uint32_t duration_short = (RADIO_DURATION_10_LOW + RADIO_DURATION_10_HIGH) >> 2;
+  const uint32_t duration_long  = (RADIO_DURATION_01_LOW + RADIO_DURATION_01_HIGH) >> 2;
 
   for (i = bits - 1; i >= 0; i--)
   {
     if ((data >> i) & 0x1)
     {
-      p_pin_switch(1);
-      p_sleep_us(duration_long);
-      p_pin_switch(0);
-      p_sleep_us(duration_short);
+      schedule_pulse(schedule, duration_long, duration_short);
     }
     else
     {
-      p_pin_switch(1);
-      p_sleep_us(duration_short);
-      p_pin_switch(0);
-      p_sleep_us(duration_long);
+      schedule_pulse(schedule, duration_short, duration_long);
     }
   }
 }
 
 /**
- * Module initialization.
+ * Compiles a LaCrosse frame into an edge schedule.
+ * 
+ * @details The schedule holds the scaling pulse followed by one repeat 
+ * (4 start bits + 32 bits of payload + 8 bits of checksum). The repeat is 
+ * played REPEAT_NUMBER times.
  * 
- * @param pin_switch function pointer to activate/deactivate 433 MHz.
- * @param sleep_us function pointer to sleep.
+ * @param schedule output schedule.
+ * @param sync sync byte.
+ * @param data 24-bit data (not encrypted).
  * 
  * @return void.
  */
-void LACROSSE_init(void (*pin_switch)(int32_t), void (*sleep_us)(int32_t))
+void LACROSSE_schedule_build(LACROSSE_schedule_t * schedule, uint32_t sync, uint32_t data)
 {
+  const uint32_t data_encrypted = LACROSSE_encrypt_24bits(data);
+  const uint32_t payload = (sync << 24) | data_encrypted;
+  const uint32_t checksum = checksum_calculate(payload);
+
+  const uint32_t duration_start = (RADIO_DURATION_2_LOW + RADIO_DURATION_2_HIGH) >> 2;
+
   int32_t i;
 
-  /* pointers */
-  p_pin_switch = pin_switch;
-  p_sleep_us = sleep_us;
+  schedule->size = 0;
 
-  /* form decrypt table */
-  for (i = 0; i < 256; i++)
+  /* scaling */
+  schedule_pulse(schedule, RADIO_DURATION_SCALING_1, RADIO_DURATION_SCALING_0);
+  schedule->repeat_start = schedule->size;
+
+  /* start bits */
+  for (i = 0; i < 4; i++)
   {
-    decrypt_table[encrypt_table[i]] = 0; /* TODO */
+    schedule_pulse(schedule, duration_start, duration_start);
   }
+
+  /* payload */
+  schedule_bits(schedule, payload, 32);
+
+  /* checksum */
+  schedule_bits(schedule, checksum, 8);
+
+  /* player */
+  schedule->index = 0;
+  schedule->repeat = 0;
 }
 
 /**
- * Sends N packets regarding a LaCrosse protocol.
- */ 
-void LACROSSE_output_send(uint32_t sync, uint32_t data)
+ * Gets the next level of a schedule.
+ * 
+ * @param schedule schedule to play.
+ * @param level output level (1 - high, 0 - low).
+ * @param duration_usec output duration of the level in microsec.
+ * 
+ * @return 0 if a level is returned, -1 when the schedule is finished.
+ */
+int32_t LACROSSE_schedule_next(LACROSSE_schedule_t * schedule, int32_t * level, uint32_t * duration_usec)
 {
-  const uint32_t data_encrypted = LACROSSE_encrypt_24bits(data);
-  const uint32_t payload = (sync << 24) | data_encrypted;
-  const uint32_t checksum = checksum_calculate(payload);
+  int32_t retval = -1;
 
-  const uint32_t duration_start = (RADIO_DURATION_2_LOW + RADIO_DURATION_2_HIGH) >> 2;
-  
-  int32_t i, k;
-  
-  /* preconditions check */
-  assert(p_pin_switch != NULL);
-  assert(p_sleep_us != NULL);
-  
-  /* scaling */
-  p_pin_switch(1);
-  p_sleep_us(RADIO_DURATION_SCALING_1);
-  p_pin_switch(0);
-  p_sleep_us(RADIO_DURATION_SCALING_0);
-  
-  /* repeat for N times */
-  for (k = 0; k < REPEAT_NUMBER; k++)
+  /* end of a repeat */
+  if ((schedule->index == schedule->size) && (schedule->repeat + 1 < REPEAT_NUMBER))
   {
-    /* start bits */
-    for (i = 0; i < 4; i++)
-    {
-      p_pin_switch(1);
-      p_sleep_us(duration_start);
-      p_pin_switch(0);
-      p_sleep_us(duration_start);
-    }
+    schedule->index = schedule->repeat_start;
+    schedule->repeat++;
+  }
 
-    /* payload */
-    send(payload, 32);
-    
-    /* checksum */
-    send(checksum, 8);
+  if (schedule->index < schedule->size)
+  {
+    /* levels alternate, high first */
+    *level = ((schedule->index & 1) == 0) ? 1 : 0;
+    *duration_usec = schedule->duration[schedule->index++];
+    retval = 0;
+  }
+
+  return retval;
+}
+
+/**
+ * Applies the next level of a schedule with a platform policy.
+ * 
+ * @tparam platform transmitter policy (see platform_radio_tx).
+ * @param schedule schedule to play.
+ * 
+ * @return duration of the applied level in microsec, 0 when finished.
+ */
+template <typename platform>
+static inline uint32_t output_edge(LACROSSE_schedule_t * schedule)
+{
+  int32_t level = 0;
+  uint32_t duration = 0;
+
+  /* the output stays low at the end */
+  (void)LACROSSE_schedule_next(schedule, &level, &duration);
+  platform::pin_write(level);
+
+  return duration;
+}
+
+/**
+ * Plays a whole schedule with a platform policy (blocking).
+ * 
+ * @details The pin write and the delay are inlined: no call between two 
+ * edges other than the delay loop itself.
+ * 
+ * @tparam platform transmitter policy (see platform_radio_tx).
+ * @param schedule schedule to play (built by @ref LACROSSE_schedule_build()).
+ * 
+ * @return void.
+ */
+template <typename platform>
+static inline void output_send(LACROSSE_schedule_t * schedule)
+{
+  uint32_t duration;
+
+  for (duration = output_edge<platform>(schedule); duration != 0; duration = output_edge<platform>(schedule))
+  {
+    platform::delay_us((int32_t)duration);
   }
 }
 
 /**
- * Decrypts 24-bit data.
+ * Module initialization (transmitter pin of the platform).
+ * 
+ * @return void.
+ */
+void LACROSSE_init(void)
+{
+  platform_radio_tx::init();
+
+  /* nothing to play */
+  output_schedule.size = 0;
+  output_schedule.index = 0;
+  output_schedule.repeat = REPEAT_NUMBER;
+}
+
+/**
+ * Starts to send N packets regarding a LaCrosse protocol without blocking.
+ * 
+ * @details The first level is applied immediately. Then the caller must 
+ * call @ref LACROSSE_output_edge() when the returned duration is gone, 
+ * typically from a timer interrupt.
+ * 
+ * @param sync sync byte.
+ * @param data 24-bit data (not encrypted).
+ * 
+ * @return duration of the first level in microsec.
+ */
+uint32_t LACROSSE_output_start(uint32_t sync, uint32_t data)
+{
+  LACROSSE_schedule_build(&output_schedule, sync, data);
+  return LACROSSE_output_edge();
+}
+
+/**
+ * Applies the next level of the current schedule.
+ * 
+ * @return duration of the applied level in microsec, 0 when finished.
+ */
+uint32_t LACROSSE_output_edge(void)
+{
+  return output_edge<platform_radio_tx>(&output_schedule);
+}
+
+/**
+ * Sends N packets regarding a LaCrosse protocol (blocking).
+ */ 
+void LACROSSE_output_send(uint32_t sync, uint32_t data)
+{
+  LACROSSE_schedule_build(&output_schedule, sync, data);
+  output_send<platform_radio_tx>(&output_schedule);
+}
+
+/**
+ * Decrypts 24-bit data (inverse of @ref LACROSSE_encrypt_24bits()).
  */
 uint32_t LACROSSE_decrypt_24bits(uint32_t data)
 {
@@ -423,7 +1141,7 @@ uint32_t LACROSSE_decrypt_24bits(uint32_t data)
   const uint32_t byte_2 = (data >> 8) & 0xFF;
   const uint32_t byte_1 = (data >> 0) & 0xFF;
 
-  return (decrypt_table[byte_0] << 16) | (decrypt_table[byte_2] << 8) | (decrypt_table[byte_1] << 0);
+  return (decrypt_table.value[byte_2] << 16) | (decrypt_table.value[byte_1] << 8) | (decrypt_table.value[byte_0] << 0);
 }
 
 /**
@@ -437,7 +1155,7 @@ uint32_t LACROSSE_encrypt_24bits(uint32_t data)
   const uint32_t byte_1 = (data >> 8) & 0xFF;
   const uint32_t byte_0 = (data >> 0) & 0xFF;
 
-  return (encrypt_table[byte_0] << 16) | (encrypt_table[byte_2] << 8) | (encrypt_table[byte_1] << 0);
+  return (encrypt_table.value[byte_0] << 16) | (encrypt_table.value[byte_2] << 8) | (encrypt_table.value[byte_1] << 0);
 }
 
 #endif
@@ -0,0 +1,144 @@
+/**
+ * @file latency.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+
+
+/* maximal length of a formatted number with its separator */
+#define LATENCY_FIELD_MAX  12
+
+
+/**
+ * Probe names.
+ */
+#define LATENCY_NAME(name, channel, stage)  channel "." stage,
+static const char * const latency_name[LATENCY_PROBE_NUMBER] = {
+  LATENCY_PROBES(LATENCY_NAME)
+};
+
+/* histograms */
+static LATENCY_histogram_t latency_histogram[LATENCY_PROBE_NUMBER];
+
+
+/**
+ * Initializes the module.
+ *
+ * @return void.
+ */
+void LATENCY_Init(void)
+{
+  LATENCY_Reset();
+}
+
+/**
+ * Records a latency.
+ *
+ * @param probe probe (see LATENCY_PROBE_e).
+ * @param usec latency in microsec.
+ *
+ * @return void.
+ */
+void LATENCY_Record(int32_t probe, uint32_t usec)
+{
+  LATENCY_histogram_t * histogram = &latency_histogram[probe];
+  uint32_t bucket = (usec != 0) ? (32 - __CLZ(usec)) : 0;
+
+  if (bucket >= LATENCY_BUCKET_NUMBER)
+  {
+    bucket = LATENCY_BUCKET_NUMBER - 1;
+  }
+  if (histogram->bucket[bucket] != 0xFFFF)
+  {
+    histogram->bucket[bucket]++;
+  }
+  if (usec > histogram->max)
+  {
+    histogram->max = usec;
+  }
+  histogram->count++;
+}
+
+/**
+ * Gets the histogram of a probe.
+ *
+ * @param probe probe (see LATENCY_PROBE_e).
+ * @param histogram output histogram.
+ *
+ * @return void.
+ */
+void LATENCY_Get(int32_t probe, LATENCY_histogram_t * histogram)
+{
+  *histogram = latency_histogram[probe];
+}
+
+/**
+ * Formats the histogram of a probe as "channel.stage,count,max,first,counts"
+ * where counts are the buckets from the first to the last non-empty one.
+ *
+ * @param probe probe (see LATENCY_PROBE_e).
+ * @param buffer output text.
+ * @param size size of the buffer in bytes (the last buckets are cut if too small).
+ *
+ * @return length of the text, 0 if the buffer is too small.
+ */
+int32_t LATENCY_Format(int32_t probe, char * buffer, int32_t size)
+{
+  const LATENCY_histogram_t * histogram = &latency_histogram[probe];
+  int32_t first = 0;
+  int32_t last = LATENCY_BUCKET_NUMBER - 1;
+  int32_t len = 0;
+  int32_t i;
+
+  while ((first < last) && (histogram->bucket[first] == 0))
+  {
+    first++;
+  }
+  while ((last > first) && (histogram->bucket[last] == 0))
+  {
+    last--;
+  }
+
+  if (size > (int32_t)strlen(latency_name[probe]) + (3 * LATENCY_FIELD_MAX))
+  {
+    len = sprintf(buffer, "%s,%lu,%lu,%d", latency_name[probe], (unsigned long)histogram->count,
+        (unsigned long)histogram->max, (int)first);
+    for (i = first; (i <= last) && ((size - len) > LATENCY_FIELD_MAX); i++)
+    {
+      len += sprintf(&buffer[len], ",%u", (unsigned)histogram->bucket[i]);
+    }
+  }
+
+  return len;
+}
+
+/**
+ * Clears all histograms (e.g. after a report).
+ *
+ * @return void.
+ */
+void LATENCY_Reset(void)
+{
+  memset(latency_histogram, 0, sizeof(latency_histogram));
+}
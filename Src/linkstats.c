@@ -0,0 +1,273 @@
+/**
+ * @file linkstats.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "linkstats.h"
+
+
+/* maximal length of a formatted line */
+#define LINKSTATS_LINE_MAX  80
+
+
+/* sensors */
+static LINKSTATS_sensor_t linkstats_sensor[LINKSTATS_SENSOR_NUMBER];
+
+/* checksum errors of unknown IDs */
+static uint32_t linkstats_unknown;
+
+/* repeats of a frame in a burst */
+static uint32_t linkstats_repeats;
+
+
+/**
+ * Finds the entry of a sensor ID.
+ *
+ * @param id sensor ID.
+ * @param add 1 to add the ID if not found.
+ *
+ * @return entry, NULL if not found or if the table is full.
+ */
+static LINKSTATS_sensor_t * sensor_get(uint32_t id, int32_t add)
+{
+  LINKSTATS_sensor_t * free_sensor = NULL;
+  int32_t i;
+
+  for (i = 0; i < LINKSTATS_SENSOR_NUMBER; i++)
+  {
+    LINKSTATS_sensor_t * const sensor = &linkstats_sensor[i];
+
+    if ((sensor->used != 0) && (sensor->id == id))
+    {
+      return sensor;
+    }
+    if ((sensor->used == 0) && (free_sensor == NULL))
+    {
+      free_sensor = sensor;
+    }
+  }
+
+  if ((add != 0) && (free_sensor != NULL))
+  {
+    memset(free_sensor, 0, sizeof(*free_sensor));
+    free_sensor->id = (uint8_t)id;
+    free_sensor->used = 1;
+    return free_sensor;
+  }
+
+  return NULL;
+}
+
+/**
+ * Ends the current burst of a sensor.
+ *
+ * @param sensor sensor entry.
+ *
+ * @return void.
+ */
+static void burst_end(LINKSTATS_sensor_t * sensor)
+{
+  if (sensor->burst_count != 0)
+  {
+    sensor->bursts++;
+    sensor->burst_frames += sensor->burst_count;
+    sensor->burst_count = 0;
+  }
+}
+
+/**
+ * Initializes the module.
+ *
+ * @param repeats repeats of a frame sent in a burst.
+ *
+ * @return void.
+ */
+void LINKSTATS_Init(uint32_t repeats)
+{
+  memset(linkstats_sensor, 0, sizeof(linkstats_sensor));
+  linkstats_unknown = 0;
+  linkstats_repeats = repeats;
+}
+
+/**
+ * Records a frame with a valid checksum.
+ *
+ * @param id sensor ID.
+ * @param timestamp time of the frame in microsec (see timebase.h).
+ * @param jitter_mean mean deviation of the pulses from their nominal durations in microsec.
+ * @param jitter_max maximal deviation in microsec.
+ *
+ * @return void.
+ */
+void LINKSTATS_Frame(uint32_t id, uint32_t timestamp, uint32_t jitter_mean, uint32_t jitter_max)
+{
+  LINKSTATS_sensor_t * const sensor = sensor_get(id, 1);
+
+  if (sensor == NULL)
+  {
+    return;
+  }
+
+  /* new burst: interval from the start of the previous one */
+  if ((sensor->burst_count == 0) || ((timestamp - sensor->burst_last) >= LINKSTATS_BURST_GAP_US))
+  {
+    if (sensor->burst_start != 0)
+    {
+      const uint32_t interval = (timestamp - sensor->burst_start) / 1000;
+
+      if (sensor->interval_last != 0)
+      {
+        sensor->interval_change_sum += (interval > sensor->interval_last) ?
+            (interval - sensor->interval_last) : (sensor->interval_last - interval);
+        sensor->interval_changes++;
+      }
+      sensor->interval_last = interval;
+      sensor->interval_sum += interval;
+      sensor->intervals++;
+    }
+    burst_end(sensor);
+    sensor->burst_start = (timestamp != 0) ? timestamp : 1;
+  }
+  sensor->burst_last = timestamp;
+  sensor->burst_count++;
+
+  sensor->frames++;
+  sensor->jitter_sum += jitter_mean;
+  if (jitter_max > sensor->jitter_max)
+  {
+    sensor->jitter_max = (uint16_t)jitter_max;
+  }
+}
+
+/**
+ * Records a frame with an invalid checksum.
+ *
+ * @param id sensor ID read from the frame (counted only if the ID is known).
+ *
+ * @return void.
+ */
+void LINKSTATS_CrcError(uint32_t id)
+{
+  LINKSTATS_sensor_t * const sensor = sensor_get(id, 0);
+
+  if (sensor != NULL)
+  {
+    sensor->crc_errors++;
+  }
+  else
+  {
+    linkstats_unknown++;
+  }
+}
+
+/**
+ * Formats the statistics of a sensor as
+ * "id,frames,crc_errors,crc_permille,bursts,repeats_percent,jitter_mean,jitter_max,interval,interval_change"
+ * with the jitters in microsec and the mean intervals in millisec, or the
+ * checksum errors of the unknown IDs as "unknown,crc_errors" (index
+ * LINKSTATS_SENSOR_NUMBER).
+ *
+ * @param index sensor entry, LINKSTATS_SENSOR_NUMBER for the unknown IDs.
+ * @param now current time in microsec (ends the bursts older than the burst gap).
+ * @param buffer output text.
+ * @param size size of the buffer in bytes.
+ *
+ * @return length of the text, 0 if the entry has no statistics or if the buffer is too small.
+ */
+int32_t LINKSTATS_Format(int32_t index, uint32_t now, char * buffer, int32_t size)
+{
+  int32_t len = 0;
+
+  if ((index < 0) || (index > LINKSTATS_SENSOR_NUMBER) || (size < LINKSTATS_LINE_MAX))
+  {
+    return 0;
+  }
+
+  if (index == LINKSTATS_SENSOR_NUMBER)
+  {
+    if (linkstats_unknown != 0)
+    {
+      len = sprintf(buffer, "unknown,%lu", (unsigned long)linkstats_unknown);
+    }
+  }
+  else
+  {
+    LINKSTATS_sensor_t * const sensor = &linkstats_sensor[index];
+
+    if ((sensor->used != 0) && ((now - sensor->burst_last) >= LINKSTATS_BURST_GAP_US))
+    {
+      burst_end(sensor);
+    }
+    if ((sensor->used != 0) && ((sensor->frames != 0) || (sensor->crc_errors != 0)))
+    {
+      const uint32_t words = sensor->frames + sensor->crc_errors;
+      const uint32_t expected = sensor->bursts * linkstats_repeats;
+
+      len = sprintf(buffer, "%02lx,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", (unsigned long)sensor->id,
+          (unsigned long)sensor->frames, (unsigned long)sensor->crc_errors,
+          (unsigned long)((words != 0) ? (sensor->crc_errors * 1000 / words) : 0),
+          (unsigned long)sensor->bursts,
+          (unsigned long)((expected != 0) ? (sensor->burst_frames * 100 / expected) : 0),
+          (unsigned long)((sensor->frames != 0) ? (sensor->jitter_sum / sensor->frames) : 0),
+          (unsigned long)sensor->jitter_max,
+          (unsigned long)((sensor->intervals != 0) ? (sensor->interval_sum / sensor->intervals) : 0),
+          (unsigned long)((sensor->interval_changes != 0) ?
+              (sensor->interval_change_sum / sensor->interval_changes) : 0));
+    }
+  }
+
+  return len;
+}
+
+/**
+ * Clears the statistics (e.g. after a report), the burst state of the
+ * sensors is kept. The entries of the IDs without valid frame in the period
+ * are freed (new ID after a battery change, sensors of the neighbours).
+ *
+ * @return void.
+ */
+void LINKSTATS_Reset(void)
+{
+  int32_t i;
+
+  for (i = 0; i < LINKSTATS_SENSOR_NUMBER; i++)
+  {
+    LINKSTATS_sensor_t * const sensor = &linkstats_sensor[i];
+
+    if (sensor->frames == 0)
+    {
+      sensor->used = 0;
+    }
+    sensor->frames = 0;
+    sensor->crc_errors = 0;
+    sensor->bursts = 0;
+    sensor->burst_frames = 0;
+    sensor->jitter_sum = 0;
+    sensor->jitter_max = 0;
+    sensor->intervals = 0;
+    sensor->interval_sum = 0;
+    sensor->interval_changes = 0;
+    sensor->interval_change_sum = 0;
+  }
+  linkstats_unknown = 0;
+}
@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include "mysensors.h"
 
@@ -30,201 +31,237 @@
  * Buffer sizes in bytes.
  */
 #define UART_BUFFER_SIZE      128
-#define PAYLOAD_BUFFER_SIZE   32
-
-
-/*
- * API UART codes.
- */
-#define MYSENSORS_NODE_ID_LOCAL  100
-#define MYSENSORS_NODE_ID_EXT    103
-#define MYSENSORS_NODE_ID_DEBUG  133
-
-#define MYSENSORS_CHILD_ID_TEMP   0
-#define MYSENSORS_CHILD_ID_HUM    1
-#define MYSENSORS_CHILD_ID_DEBUG  33
-
-#define MYSENSORS_CMD_PRESENTATION   0
-#define MYSENSORS_CMD_SET            1
-
-#define MYSENSORS_ACK_NONE  0
-
-#define MYSENSORS_TYPE_PRES_TEMP    6
-#define MYSENSORS_TYPE_PRES_HUM     7
-#define MYSENSORS_TYPE_PRES_CUSTOM  23
-#define MYSENSORS_TYPE_PRES_INFO    36
-
-#define MYSENSORS_TYPE_SET_TEMP    0
-#define MYSENSORS_TYPE_SET_HUM     1
-#define MYSENSORS_TYPE_SET_VAR1    24
-#define MYSENSORS_TYPE_SET_TEXT    47
-#define MYSENSORS_TYPE_SET_CUSTOM  48
-
-
-/**
- * MySensors structure. 
- */ 
-typedef struct
-{
-  int32_t node_id; /*!< node ID (see MYSENSORS_NODE_ID_XXX declarations) */
-  int32_t child_sensor_id; /*!< child ID (see MYSENSORS_CHILD_ID_XXX declarations) */
-  int32_t command; /*!< command (see MYSENSORS_CMD_XXX declarations) */
-  int32_t ack; /*!< acknowledge (see MYSENSORS_ACK_XXX declarations) */
-  int32_t type; /*!< payload type (see MYSENSORS_TYPE_XXX declarations) */
-  char * payload; /*!< payload */
-} MYSENSORS_t;
 
 
 /* 
  * Variables and buffers.
  */
-static UART_HandleTypeDef * mysens_huart;
+static PLATFORM_uart_t * mysens_huart;
 static uint32_t mysens_uart_buf[UART_BUFFER_SIZE / sizeof(uint32_t)];
-static uint32_t mysens_payload_buf[PAYLOAD_BUFFER_SIZE / sizeof(uint32_t)];
+
+/* reception: line being received (interrupt), complete line waiting for MYSENSORS_Receive() */
+static uint8_t mysens_rx_byte;
+static char mysens_rx_line[MYSENSORS_RX_LINE_MAX];
+static int32_t mysens_rx_len;
+static char mysens_rx_ready_line[MYSENSORS_RX_LINE_MAX];
+static volatile int32_t mysens_rx_ready;
+static void (*mysens_rx_handler)(void);
 
 
 /**
- * Sends a MySensors message by UART to the Linux server.
+ * Initializes the module.
  * 
- * @param sersor pointer to MySensors structure.
+ * @param huart pointer to UART structure.
  * 
  * @return void.
  */
-static void send(MYSENSORS_t * sensor)
+void MYSENSORS_Init(PLATFORM_uart_t * huart)
 {
-  /* form message */
-  int32_t size = sprintf((char *)&mysens_uart_buf[0], "%d;%d;%d;%d;%d;%s\n",
-      (int)sensor->node_id, (int)sensor->child_sensor_id, (int)sensor->command,
-      (int)sensor->ack, (int)sensor->type, sensor->payload);
-
-  /* check */
-  assert(size < UART_BUFFER_SIZE);
-
-  /* send message */
-  HAL_UART_Transmit(mysens_huart, (uint8_t *)mysens_uart_buf, size, 10000);
+  mysens_huart = huart;
 }
 
 /**
- * Sends a measurement to the Linux server.
+ * Sends a MySensors message by UART to the Linux server.
  * 
- * @param node node ID.
- * @param child child ID.
- * @param type variable type.
- * @param data_x10 variable multiplied by 10 (to manipulate as integer).
+ * @param header precomputed message header "node;child;command;ack;type;".
+ * @param header_len length of the header in bytes.
+ * @param value value to send.
+ * @param format payload format (see MYSENSORS_FORMAT_e).
  * 
  * @return void.
  */
-static void send_temper_hum(int32_t node, int32_t child, int32_t type, int32_t data_x10)
+void MYSENSORS_Send(const char * header, int32_t header_len, int32_t value, int32_t format)
 {
-  /* default structure */
-  MYSENSORS_t sens = {
-      node, child,
-      MYSENSORS_CMD_SET, MYSENSORS_ACK_NONE,
-      type, (char *)mysens_payload_buf
-  };
+  char * buffer = (char *)mysens_uart_buf;
+  int32_t size;
+
+  /* check */
+  assert(header_len < (UART_BUFFER_SIZE - 16));
+
+  /* header */
+  memcpy(buffer, header, header_len);
 
   /* payload */
-  const int32_t val_left = data_x10 / 10;
-  const int32_t val_right = data_x10 % 10;
-  const int32_t size = sprintf((char *)mysens_payload_buf, "%d.%d", (int)val_left, (int)val_right);
+  if (format == MYSENSORS_FORMAT_X10)
+  {
+    const int32_t val_left = value / 10;
+    const int32_t val_right = (value < 0) ? (-value % 10) : (value % 10);
+    size = sprintf(&buffer[header_len], "%s%d.%d\n",
+        ((value < 0) && (val_left == 0)) ? "-" : "", (int)val_left, (int)val_right);
+  }
+  else if (format == MYSENSORS_FORMAT_UINT)
+  {
+    size = sprintf(&buffer[header_len], "%lu\n", (unsigned long)(uint32_t)value);
+  }
+  else
+  {
+    size = sprintf(&buffer[header_len], "%d\n", (int)value);
+  }
 
-  /* send */
+  /* send message */
   if (size > 0)
   {
-    send(&sens);
+    PLATFORM_UartWrite(mysens_huart, (const uint8_t *)buffer, header_len + size);
   }
 }
 
 /**
- * Initializes the module.
+ * Sends a MySensors text message (telemetry) by UART to the Linux server.
  * 
- * @param huart pointer to UART structure.
+ * @param node node ID.
+ * @param child child ID.
+ * @param type value type (e.g. MYSENSORS_TYPE_SET_CUSTOM).
+ * @param text payload (up to MYSENSORS_TEXT_MAX bytes, without separators ';').
  * 
  * @return void.
  */
-void MYSENSORS_Init(UART_HandleTypeDef * huart)
+void MYSENSORS_SendText(int32_t node, int32_t child, int32_t type, const char * text)
 {
-  mysens_huart = huart;
-}
+  char * buffer = (char *)mysens_uart_buf;
+  int32_t size;
 
-/**
- * Sends the local temperature to the Linux server.
- * 
- * @param temper temperature multiplied by 10 (to manipulate as integer).
- * 
- * @return void.
- */
-void MYSENSORS_LocalTemperSend(int32_t temper)
-{
-  send_temper_hum(MYSENSORS_NODE_ID_LOCAL,
-      MYSENSORS_CHILD_ID_TEMP,
-      MYSENSORS_TYPE_SET_TEMP, temper);
+  /* check */
+  assert(strlen(text) <= MYSENSORS_TEXT_MAX);
+
+  /* message */
+  size = sprintf(buffer, "%d;%d;%d;%d;%d;%s\n", (int)node, (int)child, MYSENSORS_CMD_SET, MYSENSORS_ACK_NONE,
+      (int)type, text);
+
+  /* send message */
+  if (size > 0)
+  {
+    PLATFORM_UartWrite(mysens_huart, (const uint8_t *)buffer, size);
+  }
 }
 
 /**
- * Sends the local humidity to the Linux server.
+ * Starts the reception of the messages of the Linux server (one interrupt
+ * per byte).
  * 
- * @param hum humidity multiplied by 10 (to manipulate as integer).
+ * @param ready called by the interrupt when a line is complete (e.g. posts
+ * the task calling MYSENSORS_Receive()).
  * 
  * @return void.
  */
-void MYSENSORS_LocalHumiditySend(int32_t hum)
+void MYSENSORS_ReceiveStart(void (*ready)(void))
 {
-  send_temper_hum(MYSENSORS_NODE_ID_LOCAL,
-      MYSENSORS_CHILD_ID_HUM,
-      MYSENSORS_TYPE_SET_HUM, hum);
+  mysens_rx_handler = ready;
+  mysens_rx_len = 0;
+  mysens_rx_ready = 0;
+  HAL_UART_Receive_IT(mysens_huart, &mysens_rx_byte, 1);
 }
 
 /**
- * Sends the external temperature to the Linux server.
+ * UART Rx Transfer Completed Callback (one byte). Overwrites default callback.
  * 
- * @param temper temperature multiplied by 10 (to manipulate as integer).
+ * @param huart pointer to HAL UART structure.
  * 
  * @return void.
  */
-void MYSENSORS_ExtTemperSend(int32_t temper)
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef * huart)
 {
-  send_temper_hum(MYSENSORS_NODE_ID_EXT,
-      MYSENSORS_CHILD_ID_TEMP,
-      MYSENSORS_TYPE_SET_TEMP, temper);
+  if (huart == mysens_huart)
+  {
+    if (mysens_rx_byte == '\n')
+    {
+      /* complete line, dropped if too long or if the previous one is still waiting */
+      if ((mysens_rx_len < MYSENSORS_RX_LINE_MAX) && (mysens_rx_ready == 0))
+      {
+        memcpy(mysens_rx_ready_line, mysens_rx_line, mysens_rx_len);
+        mysens_rx_ready_line[mysens_rx_len] = '\0';
+        mysens_rx_ready = 1;
+        mysens_rx_handler();
+      }
+      mysens_rx_len = 0;
+    }
+    else if (mysens_rx_len < (MYSENSORS_RX_LINE_MAX - 1))
+    {
+      mysens_rx_line[mysens_rx_len++] = (char)mysens_rx_byte;
+    }
+    else
+    {
+      /* too long: skipped up to its end */
+      mysens_rx_len = MYSENSORS_RX_LINE_MAX;
+    }
+
+    HAL_UART_Receive_IT(mysens_huart, &mysens_rx_byte, 1);
+  }
 }
 
 /**
- * Sends the external humidity to the Linux server.
+ * UART Error Callback (e.g. overrun while the flash is busy). Overwrites
+ * default callback.
  * 
- * @param hum humidity multiplied by 10 (to manipulate as integer).
+ * @param huart pointer to HAL UART structure.
  * 
  * @return void.
  */
-void MYSENSORS_ExtHumiditySend(int32_t hum)
+void HAL_UART_ErrorCallback(UART_HandleTypeDef * huart)
 {
-  send_temper_hum(MYSENSORS_NODE_ID_EXT,
-      MYSENSORS_CHILD_ID_HUM,
-      MYSENSORS_TYPE_SET_HUM, hum);
+  if (huart == mysens_huart)
+  {
+    /* the current line is lost, the reception goes on */
+    mysens_rx_len = MYSENSORS_RX_LINE_MAX;
+    HAL_UART_Receive_IT(mysens_huart, &mysens_rx_byte, 1);
+  }
 }
 
 /**
- * Sends a debug code to the  Linux server.
+ * Gets the last received message "node;child;command;ack;type;payload".
  * 
- * @param debug debug code to send.
+ * @param message output message.
  * 
- * @return void.
+ * @return 1 if a valid message has been received, otherwise 0.
  */
-void MYSENSORS_DebugSend(int32_t debug)
+int32_t MYSENSORS_Receive(MYSENSORS_message_t * message)
 {
-  /* default structure */
-  MYSENSORS_t sens = {
-      MYSENSORS_NODE_ID_DEBUG, MYSENSORS_CHILD_ID_DEBUG,
-      MYSENSORS_CMD_SET, MYSENSORS_ACK_NONE,
-      MYSENSORS_TYPE_SET_TEXT, (char *)mysens_payload_buf
-  };
+  int32_t fields[5];
+  int32_t retval = 0;
+  const char * line = mysens_rx_ready_line;
+  int32_t i;
 
-  /* payload */
-  const int32_t size = sprintf((char *)mysens_payload_buf, "%d", (int)debug);
-
-  /* send */
-  if (size > 0)
+  if (mysens_rx_ready != 0)
   {
-    send(&sens);
+    retval = 1;
+
+    /* numeric fields, each one followed by ';' */
+    for (i = 0; (i < 5) && (retval != 0); i++)
+    {
+      fields[i] = 0;
+      if ((*line < '0') || (*line > '9'))
+      {
+        retval = 0;
+      }
+      while ((*line >= '0') && (*line <= '9') && (fields[i] < 1000))
+      {
+        fields[i] = fields[i] * 10 + (*line++ - '0');
+      }
+      if (*line++ != ';')
+      {
+        retval = 0;
+      }
+    }
+
+    if (retval != 0)
+    {
+      message->node = fields[0];
+      message->child = fields[1];
+      message->command = fields[2];
+      message->ack = fields[3];
+      message->type = fields[4];
+      strcpy(message->payload, line);
+
+      /* Windows line ending */
+      i = (int32_t)strlen(message->payload);
+      if ((i > 0) && (message->payload[i - 1] == '\r'))
+      {
+        message->payload[i - 1] = '\0';
+      }
+    }
+
+    /* the next line can be received */
+    mysens_rx_ready = 0;
   }
+
+  return retval;
 }
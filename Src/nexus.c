@@ -0,0 +1,161 @@
+/**
+ * @file nexus.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+
+#include "nexus.h"
+
+
+/*
+ * Each bit is a ~500 microsec pulse followed by a ~1000 microsec gap for '0'
+ * or a ~2000 microsec gap for '1'. Rows are separated by a ~4000 microsec
+ * gap. Durations are measured between falling edges (gap + next pulse).
+ */
+#define NEXUS_DURATION_0_LOW   1200
+#define NEXUS_DURATION_0_HIGH  1800
+#define NEXUS_DURATION_1_LOW   2200
+#define NEXUS_DURATION_1_HIGH  2800
+
+/* number of bits in a row */
+#define NEXUS_BITS  36
+
+/* receiver state when waiting for a sync */
+#define NEXUS_STATE_IDLE  (-1)
+
+
+/* receiver state (number of received bits) */
+static int32_t nexus_state = NEXUS_STATE_IDLE;
+static uint64_t nexus_register = 0;
+
+/* last complete row (a frame is accepted when repeated) */
+static uint64_t nexus_row_last = 0;
+
+
+/**
+ * Verifies a complete row and fills the frame.
+ *
+ * @details Row: 8-bit ID, battery, 0, 2-bit channel, 12-bit signed
+ * temperature x10, 4-bit constant 0xF, 8-bit humidity. There is no checksum,
+ * so the row must be received twice in a row.
+ *
+ * @param row 36-bit row.
+ * @param frame output frame.
+ *
+ * @return OOK_FLAG_FRAME if ok, otherwise 0.
+ */
+static int32_t row_complete(uint64_t row, OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+
+  const uint32_t id = (row >> 28) & 0xFF;
+  const uint32_t channel = (row >> 24) & 0x3;
+  const uint32_t temper = (row >> 12) & 0xFFF;
+  const uint32_t constant = (row >> 8) & 0xF;
+  const uint32_t hum = row & 0xFF;
+
+  if ((row == nexus_row_last) && (constant == 0xF) && (hum <= 100))
+  {
+    frame->id = id;
+    frame->channel = (int32_t)channel;
+    frame->temper = (temper & 0x800) ? ((int32_t)temper - 0x1000) : (int32_t)temper;
+    frame->hum = (int32_t)hum * 10;
+    retval = OOK_FLAG_FRAME;
+  }
+  nexus_row_last = row;
+
+  return retval;
+}
+
+/**
+ * Handles a 433 MHz pulse duration.
+ *
+ * @param duration pulse duration in microsec.
+ * @param frame output frame (valid when OOK_FLAG_FRAME is returned).
+ *
+ * @return decoder status (see OOK_FLAG_XXX declarations).
+ */
+int32_t NEXUS_InputHandler(uint32_t duration, OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+
+  /* sync: ends the previous row and starts a new one */
+  if ((duration > NEXUS_SYNC_LOW) && (duration < NEXUS_SYNC_HIGH))
+  {
+    if (nexus_state == NEXUS_BITS)
+    {
+      retval = row_complete(nexus_register, frame);
+    }
+    nexus_state = 0;
+    nexus_register = 0;
+  }
+  /* bits */
+  else if ((nexus_state >= 0) && (nexus_state < NEXUS_BITS) &&
+      (duration > NEXUS_DURATION_0_LOW) && (duration < NEXUS_DURATION_0_HIGH))
+  {
+    nexus_register = (nexus_register << 1) | 0;
+    nexus_state++;
+  }
+  else if ((nexus_state >= 0) && (nexus_state < NEXUS_BITS) &&
+      (duration > NEXUS_DURATION_1_LOW) && (duration < NEXUS_DURATION_1_HIGH))
+  {
+    nexus_register = (nexus_register << 1) | 1;
+    nexus_state++;
+  }
+  /* last row of a burst ends with a longer gap */
+  else if (nexus_state == NEXUS_BITS)
+  {
+    retval = row_complete(nexus_register, frame);
+    nexus_state = NEXUS_STATE_IDLE;
+  }
+  else
+  {
+    nexus_state = NEXUS_STATE_IDLE;
+  }
+
+  if (nexus_state != NEXUS_STATE_IDLE)
+  {
+    retval |= OOK_FLAG_BUSY;
+  }
+
+  return retval;
+}
+
+/**
+ * Ends the current row after an inter-pulse gap.
+ *
+ * @param frame output frame (valid when OOK_FLAG_FRAME is returned).
+ *
+ * @return decoder status (see OOK_FLAG_XXX declarations).
+ */
+int32_t NEXUS_Flush(OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+
+  if (nexus_state == NEXUS_BITS)
+  {
+    retval = row_complete(nexus_register, frame);
+  }
+  nexus_state = NEXUS_STATE_IDLE;
+  nexus_row_last = 0;
+
+  return retval;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file ook.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stddef.h>
+#include <assert.h>
+
+#include "ook.h"
+
+
+/**
+ * Registered decoder.
+ */
+typedef struct
+{
+  const OOK_decoder_t * decoder; /*!< decoder description */
+  int32_t flags; /*!< last status (see OOK_FLAG_XXX declarations) */
+  int32_t valid; /*!< last frame is valid */
+  OOK_frame_t last; /*!< last frame sent to the handler */
+} OOK_entry_t;
+
+
+/* registry */
+static OOK_entry_t ook_entry[OOK_DECODER_MAX];
+static int32_t ook_entry_number = 0;
+
+/* time of the last pulse (stamped on the frames) */
+static uint32_t ook_timestamp = 0;
+
+/* frame handler */
+static void (*ook_handler)(const OOK_decoder_t *, const OOK_frame_t *) = NULL;
+
+
+/**
+ * Forwards a decoded frame to the handler if it is new (for database size).
+ *
+ * @param entry registered decoder.
+ * @param frame decoded frame (stamped with the time of the last pulse).
+ *
+ * @return void.
+ */
+static void frame_forward(OOK_entry_t * entry, OOK_frame_t * frame)
+{
+  frame->timestamp = ook_timestamp;
+
+  if ((entry->valid == 0) ||
+      (entry->last.id != frame->id) || (entry->last.channel != frame->channel) ||
+      (entry->last.temper != frame->temper) || (entry->last.hum != frame->hum))
+  {
+    ook_handler(entry->decoder, frame);
+    entry->last = *frame;
+    entry->valid = 1;
+  }
+}
+
+/**
+ * Initializes the module.
+ *
+ * @param handler function called for each new decoded frame.
+ *
+ * @return void.
+ */
+void OOK_Init(void (*handler)(const OOK_decoder_t * decoder, const OOK_frame_t * frame))
+{
+  ook_handler = handler;
+  ook_entry_number = 0;
+}
+
+/**
+ * Registers a protocol decoder.
+ *
+ * @param decoder decoder description (must stay valid).
+ *
+ * @return 0 when no error.
+ */
+int32_t OOK_Register(const OOK_decoder_t * decoder)
+{
+  int32_t retval = -1;
+
+  if (ook_entry_number < OOK_DECODER_MAX)
+  {
+    OOK_entry_t * entry = &ook_entry[ook_entry_number++];
+    entry->decoder = decoder;
+    entry->flags = 0;
+    entry->valid = 0;
+    retval = 0;
+  }
+
+  return retval;
+}
+
+/**
+ * Gives a pulse duration to all registered decoders.
+ *
+ * @details An idle decoder only gets durations which can start a frame,
+ * so idle decoders cost one comparison per pulse.
+ *
+ * @param duration pulse duration in microsec.
+ * @param timestamp time of the pulse end in microsec (see timebase.h).
+ *
+ * @return void.
+ */
+void OOK_InputHandler(uint32_t duration, uint32_t timestamp)
+{
+  int32_t i;
+
+  /* preconditions check */
+  assert(ook_handler != NULL);
+
+  ook_timestamp = timestamp;
+
+  for (i = 0; i < ook_entry_number; i++)
+  {
+    OOK_entry_t * entry = &ook_entry[i];
+    const OOK_decoder_t * decoder = entry->decoder;
+
+    /* early rejection */
+    if (((entry->flags & OOK_FLAG_BUSY) != 0) ||
+        ((duration > decoder->sync_low) && (duration < decoder->sync_high)))
+    {
+      OOK_frame_t frame;
+      entry->flags = decoder->input(duration, &frame);
+
+      if ((entry->flags & OOK_FLAG_FRAME) != 0)
+      {
+        frame_forward(entry, &frame);
+      }
+    }
+  }
+}
+
+/**
+ * Ends the current frame of all decoders (no more pulses during the idle timeout).
+ *
+ * @return void.
+ */
+void OOK_Flush(void)
+{
+  int32_t i;
+
+  /* preconditions check */
+  assert(ook_handler != NULL);
+
+  for (i = 0; i < ook_entry_number; i++)
+  {
+    OOK_entry_t * entry = &ook_entry[i];
+
+    if ((entry->flags & OOK_FLAG_BUSY) != 0)
+    {
+      OOK_frame_t frame;
+      entry->flags = entry->decoder->flush(&frame);
+
+      if ((entry->flags & OOK_FLAG_FRAME) != 0)
+      {
+        frame_forward(entry, &frame);
+      }
+    }
+  }
+}
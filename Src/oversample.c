@@ -0,0 +1,129 @@
+/**
+ * @file oversample.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+
+#include "oversample.h"
+
+/* count leading zeros (CLZ instruction, builtin on a host build for tools) */
+#ifdef OVERSAMPLE_HOST
+#define OVERSAMPLE_CLZ(x)  ((uint32_t)__builtin_clz(x))
+#else
+#include "stm32f1xx_hal.h"
+#define OVERSAMPLE_CLZ(x)  __CLZ(x)
+#endif
+
+/* samples of a scanned word */
+#define OVERSAMPLE_WORD_BITS  32
+
+
+/**
+ * Initializes an extraction state.
+ *
+ * @param state state to initialize.
+ * @param time time of the first sample in microsec.
+ * @param tick_num sample period numerator (e.g. SPI prescaler).
+ * @param tick_den sample period denominator (e.g. SPI clock in MHz).
+ * @param edge falling edge handler, called with the edge time in microsec.
+ *
+ * @return void.
+ */
+void OVERSAMPLE_Init(OVERSAMPLE_state_t * state, uint32_t time, uint32_t tick_num, uint32_t tick_den,
+    void (*edge)(uint32_t timestamp))
+{
+  state->level = 0;
+  state->time = time;
+  state->remainder = 0;
+  state->tick_num = tick_num;
+  state->tick_den = tick_den;
+  state->edges = 0;
+  state->edge = edge;
+}
+
+/**
+ * Extracts the falling edges of a block of samples.
+ *
+ * @details Words without a falling edge cost a few instructions; each edge
+ * costs a CLZ, a division and the handler call.
+ *
+ * @param state extraction state.
+ * @param samples 16-bit sample words, MSB first.
+ * @param count number of words (even).
+ *
+ * @return void.
+ */
+void OVERSAMPLE_Extract(OVERSAMPLE_state_t * state, const uint16_t * samples, int32_t count)
+{
+  const uint32_t tick_num = state->tick_num;
+  const uint32_t tick_den = state->tick_den;
+  const uint32_t word_num = OVERSAMPLE_WORD_BITS * tick_num;
+  uint32_t level = state->level;
+  uint32_t time = state->time;
+  uint32_t remainder = state->remainder;
+  int32_t i;
+
+  for (i = 0; i + 1 < count; i += 2)
+  {
+    const uint32_t word = ((uint32_t)samples[i] << 16) | samples[i + 1];
+
+    /* each bit compared with the previous sample */
+    uint32_t falling = ((word >> 1) | (level << 31)) & ~word;
+    level = word & 0x1;
+
+    while (falling != 0)
+    {
+      const uint32_t position = OVERSAMPLE_CLZ(falling);
+      const uint32_t offset = position * tick_num + remainder;
+
+      falling &= ~(0x80000000u >> position);
+      state->edges++;
+      state->edge(time + (offset / tick_den));
+    }
+
+    /* next word */
+    remainder += word_num;
+    time += remainder / tick_den;
+    remainder %= tick_den;
+  }
+
+  state->level = level;
+  state->time = time;
+  state->remainder = remainder;
+}
+
+/**
+ * Skips a block of samples (lost on an overrun): the time goes on, the
+ * level restarts low.
+ *
+ * @param state extraction state.
+ * @param count number of 16-bit words.
+ *
+ * @return void.
+ */
+void OVERSAMPLE_Skip(OVERSAMPLE_state_t * state, int32_t count)
+{
+  const uint32_t remainder = state->remainder + (uint32_t)count * (OVERSAMPLE_WORD_BITS / 2) * state->tick_num;
+
+  state->time += remainder / state->tick_den;
+  state->remainder = remainder % state->tick_den;
+  state->level = 0;
+}
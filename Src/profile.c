@@ -0,0 +1,336 @@
+/**
+ * @file profile.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "profile.h"
+
+/* only in the profiling variant (the wrappers need the --wrap linker options) */
+#ifdef PROFILE_ENABLED
+
+
+/* hash of the (parent, function) keys */
+#define PROFILE_NODE_MASK  (PROFILE_NODE_NUMBER - 1)
+
+/* node index of the calls that are not profiled (table or stack full) */
+#define PROFILE_NODE_NONE  0xFF
+
+/* probes of the hash table before dropping a call */
+#define PROFILE_PROBE_MAX  8
+
+
+/**
+ * Node of the calling context tree.
+ */
+typedef struct {
+  uint32_t function; /*!< function address, 0 if unused */
+  uint8_t parent; /*!< parent node */
+  uint32_t calls; /*!< calls since the last report */
+  uint32_t self; /*!< self cycles since the last report */
+} profile_node_t;
+
+/**
+ * Call in progress.
+ */
+typedef struct {
+  uint8_t node; /*!< node of the call */
+  uint32_t start; /*!< cycle counter at the entry or at the last report */
+  uint32_t children; /*!< cycles of the callees since start */
+} profile_frame_t;
+
+
+/* calling context tree (node 0 is the root) */
+static profile_node_t profile_nodes[PROFILE_NODE_NUMBER];
+static uint32_t profile_node_count;
+
+/* calls in progress, deeper calls are only counted in profile_overflow */
+static profile_frame_t profile_stack[PROFILE_DEPTH_MAX];
+static uint32_t profile_depth;
+static uint32_t profile_overflow;
+
+/* calls dropped since the last report, start of the report interval */
+static uint32_t profile_dropped;
+static uint32_t profile_interval_start;
+
+
+/* library calls separated with -Wl,--wrap=xxx */
+int __real_sprintf(char * buffer, const char * format, ...);
+HAL_StatusTypeDef __real_HAL_UART_Transmit(UART_HandleTypeDef * huart, uint8_t * data, uint16_t size, uint32_t timeout);
+void __real_SCHED_Sleep(void);
+
+
+/**
+ * Finds or adds the node of a function called from a parent node.
+ *
+ * @param parent parent node.
+ * @param function function address.
+ *
+ * @return node, PROFILE_NODE_NONE if the table is full.
+ */
+static uint32_t __attribute__((no_instrument_function)) node_get(uint32_t parent, uint32_t function)
+{
+  uint32_t index = ((function >> 1) ^ (parent * 0x9E37u)) & PROFILE_NODE_MASK;
+  uint32_t probe;
+
+  for (probe = 0; probe < PROFILE_PROBE_MAX; probe++)
+  {
+    profile_node_t * const node = &profile_nodes[index];
+
+    if ((node->function == function) && (node->parent == parent) && (index != 0))
+    {
+      return index;
+    }
+    if ((node->function == 0) && (index != 0) && (profile_node_count < (PROFILE_NODE_NUMBER - 1)))
+    {
+      node->function = function;
+      node->parent = (uint8_t)parent;
+      profile_node_count++;
+      return index;
+    }
+    index = (index + 1) & PROFILE_NODE_MASK;
+  }
+
+  return PROFILE_NODE_NONE;
+}
+
+/**
+ * Entry hook of the instrumented functions (-finstrument-functions), from any context.
+ *
+ * @param function address of the called function.
+ * @param site call site.
+ *
+ * @return void.
+ */
+void __cyg_profile_func_enter(void * function, void * site)
+{
+  const uint32_t primask = __get_PRIMASK();
+  (void)site;
+
+  __disable_irq();
+  if (profile_depth >= PROFILE_DEPTH_MAX)
+  {
+    profile_overflow++;
+    profile_dropped++;
+  }
+  else
+  {
+    const uint32_t parent = (profile_depth > 0) ? profile_stack[profile_depth - 1].node : 0;
+    uint32_t node = PROFILE_NODE_NONE;
+
+    if (parent != PROFILE_NODE_NONE)
+    {
+      node = node_get(parent, (uint32_t)(uintptr_t)function);
+    }
+    if (node != PROFILE_NODE_NONE)
+    {
+      profile_nodes[node].calls++;
+    }
+    else
+    {
+      profile_dropped++;
+    }
+    profile_stack[profile_depth].node = (uint8_t)node;
+    profile_stack[profile_depth].children = 0;
+    profile_stack[profile_depth].start = DWT->CYCCNT;
+    profile_depth++;
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * Exit hook of the instrumented functions (-finstrument-functions), from any context.
+ *
+ * @param function address of the called function.
+ * @param site call site.
+ *
+ * @return void.
+ */
+void __cyg_profile_func_exit(void * function, void * site)
+{
+  const uint32_t now = DWT->CYCCNT;
+  const uint32_t primask = __get_PRIMASK();
+  (void)function;
+  (void)site;
+
+  __disable_irq();
+  if (profile_overflow > 0)
+  {
+    profile_overflow--;
+  }
+  else if (profile_depth > 0)
+  {
+    const profile_frame_t * const frame = &profile_stack[--profile_depth];
+    const uint32_t elapsed = now - frame->start;
+
+    /* the cycles of the dropped calls stay in the self cycles of the caller */
+    if (frame->node != PROFILE_NODE_NONE)
+    {
+      profile_nodes[frame->node].self += elapsed - frame->children;
+      if (profile_depth > 0)
+      {
+        profile_stack[profile_depth - 1].children += elapsed;
+      }
+    }
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * Wrapper of sprintf() (-Wl,--wrap=sprintf): formatting in its own node.
+ */
+int __attribute__((no_instrument_function)) __wrap_sprintf(char * buffer, const char * format, ...)
+{
+  va_list args;
+  int retval;
+
+  __cyg_profile_func_enter((void *)__real_sprintf, __builtin_return_address(0));
+  va_start(args, format);
+  retval = vsprintf(buffer, format, args);
+  va_end(args);
+  __cyg_profile_func_exit((void *)__real_sprintf, __builtin_return_address(0));
+
+  return retval;
+}
+
+/**
+ * Wrapper of HAL_UART_Transmit() (-Wl,--wrap=HAL_UART_Transmit): blocking
+ * UART transmission in its own node.
+ */
+HAL_StatusTypeDef __attribute__((no_instrument_function)) __wrap_HAL_UART_Transmit(UART_HandleTypeDef * huart,
+    uint8_t * data, uint16_t size, uint32_t timeout)
+{
+  HAL_StatusTypeDef retval;
+
+  __cyg_profile_func_enter((void *)__real_HAL_UART_Transmit, __builtin_return_address(0));
+  retval = __real_HAL_UART_Transmit(huart, data, size, timeout);
+  __cyg_profile_func_exit((void *)__real_HAL_UART_Transmit, __builtin_return_address(0));
+
+  return retval;
+}
+
+/**
+ * Wrapper of SCHED_Sleep() (-Wl,--wrap=SCHED_Sleep): idle time in its own node.
+ */
+void __attribute__((no_instrument_function)) __wrap_SCHED_Sleep(void)
+{
+  __cyg_profile_func_enter((void *)__real_SCHED_Sleep, __builtin_return_address(0));
+  __real_SCHED_Sleep();
+  __cyg_profile_func_exit((void *)__real_SCHED_Sleep, __builtin_return_address(0));
+}
+
+/**
+ * Initializes the module and starts the cycle counter (the calls in
+ * progress are not profiled).
+ *
+ * @return void.
+ */
+void PROFILE_Init(void)
+{
+  memset(profile_nodes, 0, sizeof(profile_nodes));
+  profile_node_count = 0;
+  profile_depth = 0;
+  profile_overflow = 0;
+  profile_dropped = 0;
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  profile_interval_start = DWT->CYCCNT;
+}
+
+/**
+ * Formats a line of the profile report and restarts the counters of the
+ * line. The header line (node -1) closes the report interval:
+ *   h,<interval cycles>,<nodes>,<dropped calls>
+ * then one line per used node:
+ *   <node>,<parent node>,<function address>,<calls>,<self cycles>
+ *
+ * @param node node index, -1 for the header line.
+ * @param buffer output buffer.
+ * @param size size of the buffer (at least 48 bytes).
+ *
+ * @return number of written characters, 0 if the node is not used.
+ */
+int32_t PROFILE_Format(int32_t node, char * buffer, int32_t size)
+{
+  const uint32_t primask = __get_PRIMASK();
+  uint32_t values[4];
+  int32_t len = 0;
+  uint32_t i;
+
+  if ((node < -1) || (node >= PROFILE_NODE_NUMBER) || (size < 48))
+  {
+    return 0;
+  }
+
+  __disable_irq();
+  if (node < 0)
+  {
+    const uint32_t now = DWT->CYCCNT;
+
+    /* the calls in progress report their self cycles up to now */
+    for (i = 0; i < profile_depth; i++)
+    {
+      profile_frame_t * const frame = &profile_stack[i];
+      if (frame->node != PROFILE_NODE_NONE)
+      {
+        profile_nodes[frame->node].self += (now - frame->start) - frame->children;
+      }
+      frame->start = now;
+      frame->children = 0;
+    }
+    values[0] = now - profile_interval_start;
+    values[1] = profile_node_count;
+    values[2] = profile_dropped;
+    profile_interval_start = now;
+    profile_dropped = 0;
+  }
+  else
+  {
+    values[0] = profile_nodes[node].parent;
+    values[1] = profile_nodes[node].function;
+    values[2] = profile_nodes[node].calls;
+    values[3] = profile_nodes[node].self;
+    profile_nodes[node].calls = 0;
+    profile_nodes[node].self = 0;
+  }
+  __set_PRIMASK(primask);
+
+  /* sprintf() of the report is not profiled */
+  if (node < 0)
+  {
+    len = __real_sprintf(buffer, "h,%lu,%lu,%lu", (unsigned long)values[0], (unsigned long)values[1],
+        (unsigned long)values[2]);
+  }
+  else if (values[1] != 0)
+  {
+    len = __real_sprintf(buffer, "%ld,%lu,%08lx,%lu,%lu", (long)node, (unsigned long)values[0],
+        (unsigned long)values[1], (unsigned long)values[2], (unsigned long)values[3]);
+  }
+
+  return len;
+}
+
+#endif
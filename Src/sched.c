@@ -0,0 +1,319 @@
+/**
+ * @file sched.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stddef.h>
+
+#include "sched.h"
+
+
+#define SCHED_WHEEL_MASK  (SCHED_WHEEL_SIZE - 1)
+
+
+/* systicks counted by the interrupt and handled by the wheel */
+static volatile uint32_t sched_tick;
+static uint32_t sched_wheel_tick;
+
+/* timer wheel: tasks are linked in the slot of their expiry */
+static SCHED_task_t * sched_wheel[SCHED_WHEEL_SIZE];
+
+/* event tasks and their posted bits */
+static SCHED_task_t * sched_event[SCHED_EVENT_NUMBER];
+static int32_t sched_event_number;
+static volatile uint32_t sched_posted;
+
+
+/**
+ * Inserts an armed task into the slot of its expiry.
+ *
+ * @param task task to insert.
+ *
+ * @return void.
+ */
+static void wheel_insert(SCHED_task_t * task)
+{
+  SCHED_task_t ** slot = &sched_wheel[task->expiry & SCHED_WHEEL_MASK];
+
+  task->next = *slot;
+  *slot = task;
+  task->armed = 1;
+}
+
+/**
+ * Removes an armed task from its slot.
+ *
+ * @param task task to remove.
+ *
+ * @return void.
+ */
+static void wheel_remove(SCHED_task_t * task)
+{
+  SCHED_task_t ** link = &sched_wheel[task->expiry & SCHED_WHEEL_MASK];
+
+  while ((*link != NULL) && (*link != task))
+  {
+    link = &(*link)->next;
+  }
+  if (*link != NULL)
+  {
+    *link = task->next;
+  }
+  task->next = NULL;
+  task->armed = 0;
+}
+
+/**
+ * Takes the first task of a slot which expires now (tasks of later wheel
+ * turns stay in the slot).
+ *
+ * @param slot wheel slot.
+ * @param tick current wheel tick.
+ *
+ * @return expired task, NULL if none.
+ */
+static SCHED_task_t * wheel_expired(SCHED_task_t ** slot, uint32_t tick)
+{
+  SCHED_task_t * task = *slot;
+
+  while ((task != NULL) && (task->expiry != tick))
+  {
+    task = task->next;
+  }
+  if (task != NULL)
+  {
+    wheel_remove(task);
+  }
+
+  return task;
+}
+
+/**
+ * Advances the wheel by one systick and runs the expired tasks.
+ *
+ * @details The expired tasks are taken one by one so that a handler may
+ * start or stop any timer, including its own one.
+ *
+ * @return number of tasks run.
+ */
+static int32_t wheel_advance(void)
+{
+  const uint32_t tick = ++sched_wheel_tick;
+  SCHED_task_t ** slot = &sched_wheel[tick & SCHED_WHEEL_MASK];
+  SCHED_task_t * task;
+  int32_t number = 0;
+
+  while ((task = wheel_expired(slot, tick)) != NULL)
+  {
+    /* periodic timer: next expiry without drift */
+    if (task->period != 0)
+    {
+      task->expiry = tick + task->period;
+      wheel_insert(task);
+    }
+
+    task->handler();
+    number++;
+  }
+
+  return number;
+}
+
+/**
+ * Initializes the module.
+ *
+ * @return void.
+ */
+void SCHED_Init(void)
+{
+  int32_t i;
+
+  sched_tick = 0;
+  sched_wheel_tick = 0;
+  sched_event_number = 0;
+  sched_posted = 0;
+  for (i = 0; i < SCHED_WHEEL_SIZE; i++)
+  {
+    sched_wheel[i] = NULL;
+  }
+  for (i = 0; i < SCHED_EVENT_NUMBER; i++)
+  {
+    sched_event[i] = NULL;
+  }
+}
+
+/**
+ * Registers a task: it can then be posted and used as a timer.
+ *
+ * @details Posted tasks run in the order of their registration, so the
+ * most latency sensitive tasks should be registered first.
+ *
+ * @param task task to register.
+ * @param name task name.
+ * @param handler function called in the main loop when the task runs.
+ *
+ * @return 0 if ok, -1 if the event table is full.
+ */
+int32_t SCHED_Register(SCHED_task_t * task, const char * name, void (*handler)(void))
+{
+  int32_t retval = -1;
+
+  task->name = name;
+  task->handler = handler;
+  task->period = 0;
+  task->expiry = 0;
+  task->armed = 0;
+  task->event = -1;
+  task->next = NULL;
+
+  if (sched_event_number < SCHED_EVENT_NUMBER)
+  {
+    task->event = sched_event_number;
+    sched_event[sched_event_number++] = task;
+    retval = 0;
+  }
+
+  return retval;
+}
+
+/**
+ * Makes a task runnable (from any context, e.g. a capture interrupt).
+ *
+ * @param task registered task.
+ *
+ * @return void.
+ */
+void SCHED_Post(SCHED_task_t * task)
+{
+  if (task->event >= 0)
+  {
+    const uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    sched_posted |= 1u << task->event;
+    __set_PRIMASK(primask);
+  }
+}
+
+/**
+ * Starts (or restarts) the timer of a task (main loop only).
+ *
+ * @param task registered task.
+ * @param delay systicks to the first run (at least 1).
+ * @param period systicks between the next runs, 0 for a one-shot timer.
+ *
+ * @return void.
+ */
+void SCHED_TimerStart(SCHED_task_t * task, uint32_t delay, uint32_t period)
+{
+  if (task->armed != 0)
+  {
+    wheel_remove(task);
+  }
+
+  task->expiry = sched_wheel_tick + ((delay != 0) ? delay : 1);
+  task->period = period;
+  wheel_insert(task);
+}
+
+/**
+ * Stops the timer of a task (main loop only).
+ *
+ * @param task registered task.
+ *
+ * @return void.
+ */
+void SCHED_TimerStop(SCHED_task_t * task)
+{
+  if (task->armed != 0)
+  {
+    wheel_remove(task);
+  }
+}
+
+/**
+ * Counts a systick (SysTick interrupt).
+ *
+ * @return void.
+ */
+void SCHED_Tick(void)
+{
+  sched_tick++;
+}
+
+/**
+ * @return number of systicks since the initialisation.
+ */
+uint32_t SCHED_TickGet(void)
+{
+  return sched_tick;
+}
+
+/**
+ * Runs the posted tasks then the expired timers. Called all time in while(1).
+ *
+ * @return number of tasks run.
+ */
+int32_t SCHED_Run(void)
+{
+  uint32_t posted;
+  int32_t number = 0;
+  int32_t i;
+
+  /* posted tasks (priority of the registration order) */
+  __disable_irq();
+  posted = sched_posted;
+  sched_posted = 0;
+  __enable_irq();
+
+  for (i = 0; posted != 0; i++, posted >>= 1)
+  {
+    if ((posted & 1) != 0)
+    {
+      sched_event[i]->handler();
+      number++;
+    }
+  }
+
+  /* expired timers (late systicks are caught up) */
+  while (sched_wheel_tick != sched_tick)
+  {
+    number += wheel_advance();
+  }
+
+  return number;
+}
+
+/**
+ * Sleeps until the next interrupt if nothing is runnable.
+ *
+ * @return void.
+ */
+void SCHED_Sleep(void)
+{
+  /* sleep: an interrupt pending after the check still wakes the core up */
+  __disable_irq();
+  if ((sched_posted == 0) && (sched_wheel_tick == sched_tick))
+  {
+    __DSB();
+    __WFI();
+  }
+  __enable_irq();
+}
@@ -0,0 +1,164 @@
+/**
+ * @file sensors.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensors.h"
+
+
+/* compile-time message header "node;child;command;ack;type;" */
+#define SENSORS_STR_(x)  #x
+#define SENSORS_STR(x)   SENSORS_STR_(x)
+#define SENSORS_HEADER(node, child, type) \
+    SENSORS_STR(node) ";" SENSORS_STR(child) ";" SENSORS_STR(MYSENSORS_CMD_SET) ";" \
+    SENSORS_STR(MYSENSORS_ACK_NONE) ";" SENSORS_STR(type) ";"
+
+/* table entry of an enabled channel */
+#define SENSORS_ENTRY(name, enabled, source, sensor, quantity, node, child, type, mul, offset, format, policy) \
+    SENSORS_IF_##enabled({ SENSORS_HEADER(node, child, type), sizeof(SENSORS_HEADER(node, child, type)) - 1, \
+        source, sensor, quantity, mul, offset, format, policy },)
+
+
+/**
+ * Published channel.
+ */
+typedef struct
+{
+  const char * header; /*!< precomputed MySensors header */
+  uint8_t header_len; /*!< header length in bytes */
+  uint8_t source; /*!< see SENSORS_SOURCE_e */
+  uint8_t sensor; /*!< sensor channel of the source */
+  uint8_t quantity; /*!< see SENSORS_QUANTITY_e */
+  int16_t mul; /*!< scaling factor */
+  int16_t offset; /*!< scaling offset */
+  uint8_t format; /*!< see MYSENSORS_FORMAT_e */
+  uint8_t policy; /*!< see SENSORS_PUBLISH_e */
+} SENSORS_channel_t;
+
+
+/* configuration table (flash) */
+static const SENSORS_channel_t sensors_channel[SENSORS_CHANNEL_NUMBER] = {
+    SENSORS_CONFIG(SENSORS_ENTRY)
+};
+
+/* last published values (for SENSORS_PUBLISH_ON_CHANGE) */
+static int32_t sensors_last[SENSORS_CHANNEL_NUMBER];
+static uint8_t sensors_valid[SENSORS_CHANNEL_NUMBER];
+
+/* handler of the sent readings (NULL if none) */
+static void (*sensors_handler)(int32_t channel, int32_t quantity, int32_t value);
+
+
+/**
+ * Initializes the module.
+ *
+ * @param handler called for each sent reading with its channel (see
+ * SENSORS_CHANNEL_e), quantity and scaled value, NULL if none.
+ *
+ * @return void.
+ */
+void SENSORS_Init(void (*handler)(int32_t channel, int32_t quantity, int32_t value))
+{
+  sensors_handler = handler;
+  SENSORS_Reset();
+}
+
+/**
+ * Publishes a reading on its configured channel.
+ *
+ * @param source reading source (see SENSORS_SOURCE_e).
+ * @param sensor sensor channel of the source.
+ * @param quantity measured quantity (see SENSORS_QUANTITY_e).
+ * @param raw raw reading (scaled as configured).
+ *
+ * @return 1 if a message has been sent, 0 if not (unchanged or not configured).
+ */
+int32_t SENSORS_Publish(int32_t source, int32_t sensor, int32_t quantity, int32_t raw)
+{
+  int32_t retval = 0;
+  int32_t i;
+
+  for (i = 0; i < SENSORS_CHANNEL_NUMBER; i++)
+  {
+    const SENSORS_channel_t * channel = &sensors_channel[i];
+
+    if ((channel->source == source) && (channel->sensor == sensor) && (channel->quantity == quantity))
+    {
+      const int32_t value = raw * channel->mul + channel->offset;
+
+      if ((channel->policy == SENSORS_PUBLISH_ALWAYS) ||
+          (sensors_valid[i] == 0) || (sensors_last[i] != value))
+      {
+        MYSENSORS_Send(channel->header, channel->header_len, value, channel->format);
+        sensors_last[i] = value;
+        sensors_valid[i] = 1;
+        retval = 1;
+
+        if (sensors_handler != NULL)
+        {
+          sensors_handler(i, channel->quantity, value);
+        }
+      }
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Forgets the last published values (the next readings are sent).
+ *
+ * @return void.
+ */
+void SENSORS_Reset(void)
+{
+  int32_t i;
+
+  for (i = 0; i < SENSORS_CHANNEL_NUMBER; i++)
+  {
+    sensors_valid[i] = 0;
+  }
+}
+
+/**
+ * Sends again a logged reading of a channel (replay).
+ *
+ * @param channel channel (see SENSORS_CHANNEL_e).
+ * @param value value as published.
+ *
+ * @return 1 if a message has been sent, 0 if the channel does not exist.
+ */
+int32_t SENSORS_Resend(int32_t channel, int32_t value)
+{
+  int32_t retval = 0;
+
+  if ((channel >= 0) && (channel < SENSORS_CHANNEL_NUMBER))
+  {
+    const SENSORS_channel_t * const entry = &sensors_channel[channel];
+
+    MYSENSORS_Send(entry->header, entry->header_len, value, entry->format);
+    retval = 1;
+  }
+
+  return retval;
+}
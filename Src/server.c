@@ -23,23 +23,125 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 
 #include "server.h"
 #include "mysensors.h"
+#include "sensors.h"
 #include "dht22.h"
 #include "lacrosse.h"
+#include "ook.h"
+#include "nexus.h"
+#include "capture.h"
+#include "sniffer.h"
+#include "timebase.h"
+#include "glitch.h"
+#include "sched.h"
+#include "latency.h"
+#include "trace.h"
+#include "linkstats.h"
+#include "oversample.h"
+#include "profile.h"
+#include "flashlog.h"
+
+/* the diagnostic variants share the 8 KB of RAM of the STM32F100C8 */
+#if defined(PROFILE_ENABLED) && defined(OVERSAMPLE_ENABLED)
+#error "PROFILE_ENABLED and OVERSAMPLE_ENABLED do not fit together in RAM"
+#endif
+
+/* the profile is reported on the UART which carries the capture blocks in sniffer mode */
+#if defined(PROFILE_ENABLED) && defined(SNIFFER_ENABLED)
+#error "PROFILE_ENABLED and SNIFFER_ENABLED share the UART"
+#endif
 
 /* Data server version */
 #define SERVER_VERSION  4
 
+/* systick rate (HAL_SetTickFreq() in SERV_Init()), the periods below are in systicks */
+#define SERV_SYSTICK_HZ  10
+
 /* period to execute routines */
 #define DHT22_SYSTICK_PERIOD (60 * 1000)  /* 60 sec */
 #define VERSION_SYSTICK_PERIOD (70 * 1000)  /* 70 sec */
 
+/* LED on or off time of the version blinks */
+#define VERSION_BLINK_SYSTICKS  1
+
+/* period of the latency telemetry */
+#define TELEMETRY_SYSTICK_PERIOD (10 * 60 * SERV_SYSTICK_HZ)  /* 10 min */
+
+/* period of the trace drain */
+#define TRACE_SYSTICK_PERIOD  1  /* every systick */
+
+/* period of the 433 MHz link quality report */
+#define LINKSTATS_SYSTICK_PERIOD (10 * 60 * SERV_SYSTICK_HZ)  /* 10 min */
+
+/* period of the function profile report (profiling variant), below 2^32 cycles */
+#define PROFILE_SYSTICK_PERIOD (60 * SERV_SYSTICK_HZ)  /* 60 sec */
+#define PROFILE_CPU_HZ  24000000u  /* DWT cycle counter (HCLK) */
+
+/* the cycle counter (32 bits, 179 sec) must not wrap between two profile reports */
+#if ((PROFILE_SYSTICK_PERIOD * PROFILE_CPU_HZ) / SERV_SYSTICK_HZ) > 0xFFFFFFFFu
+#error "PROFILE_SYSTICK_PERIOD is longer than the DWT cycle counter period"
+#endif
+
+/* period of the persistent log task (flash programs and replay batches) */
+#define FLASHLOG_SYSTICK_PERIOD  1  /* every systick */
+
+/* MySensors node of the telemetry messages */
+#define TELEMETRY_NODE_ID  133
+
+/*
+ * Persistent reading log (see flashlog.h) in the last pages of the internal
+ * flash of the STM32F100C8 (64 KB), removed from the FLASH region of the
+ * linker script (LENGTH = 48K).
+ * The Linux server sends a time message (heartbeat) every minute: the
+ * readings sent while it is silent for LINK_TIMEOUT_MS are kept in flash
+ * until it requests their replay.
+ */
+#define FLASHLOG_FLASH_END     0x08010000  /* 64 KB */
+#define FLASHLOG_PAGE_NUMBER   16  /* 1616 records, about 2 hours of readings */
+#define FLASHLOG_ADDRESS       (FLASHLOG_FLASH_END - FLASHLOG_PAGE_NUMBER * FLASHLOG_PAGE_SIZE)
+#define LINK_HEARTBEAT_MS      (60 * 1000)  /* heartbeat period of the Linux server */
+#define LINK_TIMEOUT_MS        (LINK_HEARTBEAT_MS + 15 * 1000)  /* one period and a margin */
+#define FLASHLOG_REPLAY_BATCH  4  /* records sent per run of the log task */
+#define FLASHLOG_DEFER_MAX     (5 * SERV_SYSTICK_HZ / FLASHLOG_SYSTICK_PERIOD)  /* 5 sec waiting for a 433 MHz pause */
+
+/* 433 MHz inter-pulse gap to end a frame (in microsec) */
+#define RADIO_IDLE_TIMEOUT_US  CAPTURE_IDLE_TIMEOUT_US  /* same gap in the capture replay */
+
+/*
+ * Sniffer mode (build with -DSNIFFER_ENABLED): the raw durations are
+ * streamed to the Linux server (see sniffer.h) instead of the decoded frames.
+ */
+
+/*
+ * Oversampling mode (build with -DOVERSAMPLE_ENABLED): the 433 MHz data pin
+ * is also wired to the MISO pin of an SPI receiver (receive only master,
+ * 16-bit frames, circular DMA), sampled every OVERSAMPLE_PRESCALER /
+ * OVERSAMPLE_CLOCK_MHZ microsec. The falling edges are extracted from each
+ * half of the DMA buffer by a task (see oversample.h) instead of the
+ * capture interrupts of channel 3: two interrupts per buffer whatever the
+ * RF noise.
+ */
+#define OVERSAMPLE_BUFFER_WORDS  512  /* 2 x 4096 samples, 43.7 ms per half */
+#define OVERSAMPLE_PRESCALER     256  /* SPI baud rate prescaler */
+#define OVERSAMPLE_CLOCK_MHZ     24   /* SPI clock (APB2) */
+
 /* Masks to define the size of the circular buffers */ 
 #define DHT22_PULSE_MASK     63
-#define RADIO_PULSE_MASK     511
+#define RADIO_PULSE_MASK     1023
+
+/* buffer entries handled per run of the radio task before yielding */
+#define RADIO_PULSE_BATCH    64
+
+/*
+ * Durations are stored on 16 bits. A longer radio duration is stored as
+ * PULSE_ESCAPE followed by the 32-bit timestamp of its edge (low half first).
+ */
+#define PULSE_DURATION_MAX   0xFFFE
+#define PULSE_ESCAPE         0xFFFF
 
 /*
  * Defines of GPIO pins.
@@ -62,20 +164,67 @@ typedef enum {
 /* pointers */
 static UART_HandleTypeDef * serv_huart = NULL;
 static TIM_HandleTypeDef * serv_htim = NULL;
+#ifdef OVERSAMPLE_ENABLED
+static SPI_HandleTypeDef * serv_hspi = NULL;
+#endif
 
 /* DHT22 sensor */
-static uint32_t dht22_duration_buffer[DHT22_PULSE_MASK + 1];
+static uint16_t dht22_duration_buffer[DHT22_PULSE_MASK + 1];
 static uint32_t dht22_duration_buffer_write;
-static uint32_t dht22_compare_old;
+static uint32_t dht22_timestamp_old;
 
 /* radio */
-static uint32_t radio_duration_buffer[RADIO_PULSE_MASK + 1];
-static uint32_t radio_duration_buffer_write;
+static uint16_t radio_duration_buffer[RADIO_PULSE_MASK + 1];
+static volatile uint32_t radio_duration_buffer_write;
 static uint32_t radio_duration_buffer_read;
-static uint32_t radio_compare_old;
+static uint32_t radio_time;
+static const GLITCH_config_t radio_glitch_default = {
+    GLITCH_HW_FILTER_DEFAULT, GLITCH_MERGE_TICKS_DEFAULT, GLITCH_MODE_MERGE
+};
+static GLITCH_config_t radio_glitch_config;
+static GLITCH_state_t radio_glitch;
+static volatile uint32_t radio_timestamp_last;
+static uint32_t radio_flushed;
+
+#ifdef OVERSAMPLE_ENABLED
+/* oversampled 433 MHz data pin (halves completed by the DMA, scanned by the task) */
+static uint16_t oversample_buffer[OVERSAMPLE_BUFFER_WORDS];
+static OVERSAMPLE_state_t oversample_state;
+static volatile uint32_t oversample_write;
+static uint32_t oversample_read;
+#endif
+
+/* scheduler tasks */
+static SCHED_task_t radio_task;
+#ifdef OVERSAMPLE_ENABLED
+static SCHED_task_t oversample_task;
+#endif
+static SCHED_task_t dht22_task;
+static SCHED_task_t version_task;
+static SCHED_task_t version_blink_task;
+static SCHED_task_t telemetry_task;
+static SCHED_task_t linkstats_task;
+static SCHED_task_t command_task;
+static SCHED_task_t flashlog_task;
+#ifdef PROFILE_ENABLED
+static SCHED_task_t profile_task;
+#endif
+
+/* remaining LED switches of the version show */
+static int32_t version_blinks;
+
+/* link to the Linux server: last heartbeat (HAL tick in millisec), seconds since epoch at boot (0 if unknown) */
+static uint32_t link_heartbeat;
+static uint32_t link_epoch;
+/* a heartbeat has been received since boot, the staged readings must be programmed (late heartbeat) */
+static uint32_t link_alive;
+static uint32_t link_lost;
 
-/* systick */
-static uint64_t systick;
+/* replay of the persistent log: next record, end of the replay */
+static uint32_t flashlog_replay;
+static uint32_t flashlog_replay_end;
+/* runs of the log task deferred by 433 MHz bursts since the last complete commit */
+static uint32_t flashlog_deferred;
 
 
 /**
@@ -91,113 +240,413 @@ static void led_switch(SWITCH_e sw)
 }
 
 /**
- * DHT22 sensor routine.
+ * DHT22 sensor routine (periodic task).
  */
 static void dht22_routine(void)
 {
-  static uint64_t systick_last = 0;
-  static uint32_t temper_last = 0;
-  static uint32_t rh_last = 0;
+#ifdef SNIFFER_ENABLED
+  uint32_t i;
 
-  /* current systick */
-  const uint64_t systick_now = systick;
+  /* stream old conversion, it is analysed by the host on the start event */
+  for (i = 0; (i < dht22_duration_buffer_write) && (i <= DHT22_PULSE_MASK); i++)
+  {
+    SNIFFER_Input(CAPTURE_CHANNEL_DHT22, dht22_duration_buffer[i]);
+  }
+  SNIFFER_Event(CAPTURE_EVENT_DHT22_START, 0);
+#else
+  uint32_t temper;
+  uint32_t rh;
+
+  /* read old conversion */
+  const int32_t result = \
+      DHT22_AnalyseData(dht22_duration_buffer, dht22_duration_buffer_write, &temper, &rh);
 
-  /* DHT22 read sensor */
-  if ((systick_now - systick_last) >= DHT22_SYSTICK_PERIOD)
+  /* send temperature if ok */
+  if (result == 0)
   {
-    uint32_t temper;
-    uint32_t rh;
+    const uint32_t start = TIMEBASE_NowUs();
+    uint32_t stop;
 
-    /* read old conversion */
-    const int32_t result = \
-        DHT22_AnalyseData(dht22_duration_buffer, dht22_duration_buffer_write, &temper, &rh);
+    TRACE2(DHT22_OK, temper, rh);
 
-    /* send temperature if ok */
-    if (result == 0)
+    /* led on */
+    led_switch(SWITCH_ON);
+
+    /* send data to raspberry pi (publish policy of the configuration table) */
+    if ((SENSORS_Publish(SENSORS_SOURCE_DHT22, 0, SENSORS_QUANTITY_TEMPER, (int32_t)temper) |
+        SENSORS_Publish(SENSORS_SOURCE_DHT22, 0, SENSORS_QUANTITY_HUM, (int32_t)rh)) != 0)
     {
-      /* send only if new data (for database size) */
-      if ((temper_last != temper) || (rh_last != rh))
-      {
-        /* led on */
-        led_switch(SWITCH_ON);
+      SENSORS_Publish(SENSORS_SOURCE_DHT22, 0, SENSORS_QUANTITY_TIMESTAMP, (int32_t)dht22_timestamp_old);
+    }
 
-        /* send data to raspberry pi */
-        MYSENSORS_LocalTemperSend((int32_t)temper);
-        MYSENSORS_LocalHumiditySend((int32_t)rh);
+    /* led off */
+    led_switch(SWITCH_OFF);
 
-        /* led off */
-        led_switch(SWITCH_OFF);
+    /* latencies: the conversion is analysed one period after its capture */
+    stop = TIMEBASE_NowUs();
+    LATENCY_Record(LATENCY_PROBE_DHT22_DECODE, start - dht22_timestamp_old);
+    LATENCY_Record(LATENCY_PROBE_DHT22_UART, stop - start);
+    LATENCY_Record(LATENCY_PROBE_DHT22_TOTAL, stop - dht22_timestamp_old);
+  }
+  else
+  {
+    TRACE1(DHT22_FAILED, dht22_duration_buffer_write);
+  }
+#endif
 
-        /* remember last values */
-        temper_last = temper;
-        rh_last = rh;
-      }
-    }
+  /* reset counter for a new conversion */
+  dht22_duration_buffer_write = 0;
 
-    /* reset counter for a new conversion */
-    dht22_duration_buffer_write = 0;
+  /* start new conversion */
+  DHT22_StartSensor();
+}
 
-    /* start new conversion */
-    DHT22_StartSensor();
+/**
+ * Converts a Lacrosse payload into a raw temperature/humidity frame (scaled
+ * by the configuration table).
+ * 
+ * @param payload 32-bit payload.
+ * @param frame output frame.
+ * 
+ * @return OOK_FLAG_FRAME if ok, otherwise 0.
+ */
+static int32_t lacrosse_frame(uint32_t payload, OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+  const uint32_t sync = (payload >> 24) & 0xFF;
+  const uint32_t temper = (payload >> 8) & 0xFFF;
+  const uint32_t hum = payload & 0xFF;
 
-    /* remember systick */
-    systick_last = systick_now;
+  if (sync == 0xAA)
+  {
+    frame->id = sync;
+    frame->channel = 0;
+    frame->temper = (int32_t)temper;
+    frame->hum = (int32_t)hum;
+    retval = OOK_FLAG_FRAME;
   }
+
+  return retval;
 }
 
 /**
- * Lacrosse temperature/humidity sensor handler.
+ * Records the link quality of a complete Lacrosse word (valid or not).
+ * 
+ * @return void.
  */
-static void lacrosse_handler(uint32_t payload)
+static void lacrosse_link(void)
 {
-  static uint32_t payload_last = 0;
+  LACROSSE_word_t word;
 
-  /* Analyze only if new data (for database size) */
-  if (payload != payload_last)
+  if (LACROSSE_word_get_c(&word) != 0)
   {
-    const uint32_t sync = (payload >> 24) & 0xFF;
-    const uint32_t temper = (payload >> 8) & 0xFFF;
-    const uint32_t hum = payload & 0xFF;
-    
-    if (sync == 0xAA)
+    if (word.valid != 0)
     {
-      /* led on */
-      led_switch(SWITCH_ON);
+      LINKSTATS_Frame(word.sync, radio_time, word.jitter_mean, word.jitter_max);
+    }
+    else
+    {
+      LINKSTATS_CrcError(word.sync);
+    }
+  }
+}
+
+/**
+ * Lacrosse pulse handler for the OOK registry.
+ * 
+ * @param duration pulse duration in microsec.
+ * @param frame output frame.
+ * 
+ * @return decoder status (see OOK_FLAG_XXX declarations).
+ */
+static int32_t lacrosse_input(uint32_t duration, OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+  const uint32_t value = LACROSSE_input_handler_c(duration);
+
+  lacrosse_link();
+
+  /* handle lacrosse data */
+  if (value != 0xFFFFFFFF)
+  {
+    retval = lacrosse_frame(value, frame);
+  }
+  if (LACROSSE_is_idle_c() == 0)
+  {
+    retval |= OOK_FLAG_BUSY;
+  }
+
+  return retval;
+}
+
+/**
+ * Lacrosse end of burst handler for the OOK registry.
+ * 
+ * @param frame output frame.
+ * 
+ * @return decoder status (see OOK_FLAG_XXX declarations).
+ */
+static int32_t lacrosse_flush(OOK_frame_t * frame)
+{
+  int32_t retval = 0;
+  const uint32_t value = LACROSSE_flush_c();
+
+  lacrosse_link();
+
+  /* handle lacrosse data */
+  if (value != 0xFFFFFFFF)
+  {
+    retval = lacrosse_frame(value, frame);
+  }
+
+  return retval;
+}
+
+/**
+ * Registered 433 MHz decoders.
+ */
+static const OOK_decoder_t radio_decoder_lacrosse = {
+    "lacrosse", SENSORS_SOURCE_LACROSSE,
+    LACROSSE_START_LOW, LACROSSE_START_HIGH,
+    lacrosse_input, lacrosse_flush
+};
+static const OOK_decoder_t radio_decoder_nexus = {
+    "nexus", SENSORS_SOURCE_NEXUS,
+    NEXUS_SYNC_LOW, NEXUS_SYNC_HIGH,
+    NEXUS_InputHandler, NEXUS_Flush
+};
+
+/**
+ * Temperature/humidity handler of new decoded 433 MHz frames.
+ * 
+ * @param decoder decoder of the frame.
+ * @param frame decoded frame.
+ * 
+ * @return void.
+ */
+static void radio_handler(const OOK_decoder_t * decoder, const OOK_frame_t * frame)
+{
+  const int32_t source = decoder->source;
+  const uint32_t start = TIMEBASE_NowUs();
+  uint32_t stop;
+
+  TRACE3(OOK_FRAME, source, frame->temper, frame->hum);
+
+  /* led on */
+  led_switch(SWITCH_ON);
 
-      /* send data to raspberry pi */
-      MYSENSORS_ExtTemperSend((int32_t)temper - 500);
-      MYSENSORS_ExtHumiditySend((int32_t)hum * 10);
-      //MYSENSORS_DebugSend((temper << 16) | (hum << 8) | (chk));
+  /* send data to raspberry pi (channels of the configuration table) */
+  SENSORS_Publish(source, frame->channel, SENSORS_QUANTITY_TEMPER, frame->temper);
+  SENSORS_Publish(source, frame->channel, SENSORS_QUANTITY_HUM, frame->hum);
+  SENSORS_Publish(source, frame->channel, SENSORS_QUANTITY_TIMESTAMP, (int32_t)frame->timestamp);
 
-      /* led off */
-      led_switch(SWITCH_OFF);
+  /* led off */
+  led_switch(SWITCH_OFF);
+
+  /* latencies from the last edge of the frame */
+  stop = TIMEBASE_NowUs();
+  LATENCY_Record(LATENCY_PROBE_RADIO_DECODE, start - frame->timestamp);
+  LATENCY_Record(LATENCY_PROBE_RADIO_UART, stop - start);
+  LATENCY_Record(LATENCY_PROBE_RADIO_TOTAL, stop - frame->timestamp);
+}
+
+/**
+ * Handles the 433 MHz pulse durations from a circular buffer (task posted by
+ * the capture interrupt, and by the timer overflows until the idle flush).
+ * 
+ * @return void.
+ */
+static void radio_routine(void)
+{
+  uint32_t write = radio_duration_buffer_write;
+  uint32_t count = 0;
+
+  /* overrun: restart from the last stored pulse (an escape may be overwritten) */
+  if ((write - radio_duration_buffer_read) > (RADIO_PULSE_MASK + 1))
+  {
+    __disable_irq();
+    write = radio_duration_buffer_write;
+    radio_time = radio_timestamp_last;
+    __enable_irq();
+
+    TRACE1(RADIO_OVERRUN, write - radio_duration_buffer_read);
+#ifdef SNIFFER_ENABLED
+    SNIFFER_Dropped(write - radio_duration_buffer_read);
+#endif
+    radio_duration_buffer_read = write;
+  }
+
+  while ((radio_duration_buffer_read < write) && (count < RADIO_PULSE_BATCH))
+  {
+    uint32_t duration = radio_duration_buffer[(radio_duration_buffer_read++) & RADIO_PULSE_MASK];
+
+    /* long duration: timestamp of the edge (the 3 entries are written at once) */
+    if (duration == PULSE_ESCAPE)
+    {
+      const uint32_t low = radio_duration_buffer[(radio_duration_buffer_read++) & RADIO_PULSE_MASK];
+      const uint32_t high = radio_duration_buffer[(radio_duration_buffer_read++) & RADIO_PULSE_MASK];
+      const uint32_t timestamp = (high << 16) | low;
 
-      /* remember last value */
-      payload_last = payload;
+      duration = timestamp - radio_time;
     }
+    radio_time += duration;
+
+    /* ring wait of the oldest pulse of the batch */
+    if (count == 0)
+    {
+      LATENCY_Record(LATENCY_PROBE_RADIO_RING, TIMEBASE_NowUs() - radio_time);
+    }
+
+#ifdef SNIFFER_ENABLED
+    /* raw duration to the Linux server */
+    SNIFFER_Input(CAPTURE_CHANNEL_RADIO, duration);
+#else
+    /* all decoders */
+    OOK_InputHandler(duration, radio_time);
+#endif
+
+    /* a new pulse re-arms the idle timeout */
+    radio_flushed = 0;
+    count++;
+  }
+
+  if (radio_duration_buffer_read < write)
+  {
+    /* let the other tasks run, continue on the next run */
+    SCHED_Post(&radio_task);
+  }
+  /* no pulse during the idle timeout: end the last frame of the burst */
+  else if ((radio_flushed == 0) && ((TIMEBASE_NowUs() - radio_timestamp_last) >= RADIO_IDLE_TIMEOUT_US))
+  {
+    TRACE1(RADIO_FLUSH, TIMEBASE_NowUs() - radio_timestamp_last);
+#ifdef SNIFFER_ENABLED
+    SNIFFER_Event(CAPTURE_EVENT_IDLE, 0);
+#else
+    OOK_Flush();
+#endif
+
+    /* flush only once per gap */
+    radio_flushed = 1;
   }
 }
 
 /**
- * Handles a 433 MHz pulse duration from a circular buffer.
+ * Stores the duration of a 433 MHz falling edge in the circular buffer
+ * (capture interrupt, or oversampling task).
+ * 
+ * @param timestamp time of the edge in microsec.
  * 
  * @return void.
  */
-static void lacrosse_routine(void)
+static void radio_edge(uint32_t timestamp)
 {
-  if (radio_duration_buffer_read < radio_duration_buffer_write)
+  uint32_t value;
+
+  /* stock capture if not a runt (merged into the next duration) */
+  if (GLITCH_Edge(&radio_glitch, &radio_glitch_config, timestamp, &value) != 0)
   {
-    const uint32_t duration = radio_duration_buffer[(radio_duration_buffer_read++) & RADIO_PULSE_MASK];
-    const uint32_t value = LACROSSE_input_handler_c(duration);
+    const uint32_t write = radio_duration_buffer_write;
 
-    /* handle lacrosse data */
-    if (value != 0xFFFFFFFF)
+    if (value <= PULSE_DURATION_MAX)
+    {
+      radio_duration_buffer[write & RADIO_PULSE_MASK] = (uint16_t)value;
+      radio_duration_buffer_write = write + 1;
+    }
+    else
     {
-      lacrosse_handler(value);
+      TRACE1(RADIO_GAP, value);
+      radio_duration_buffer[write & RADIO_PULSE_MASK] = PULSE_ESCAPE;
+      radio_duration_buffer[(write + 1) & RADIO_PULSE_MASK] = (uint16_t)timestamp;
+      radio_duration_buffer[(write + 2) & RADIO_PULSE_MASK] = (uint16_t)(timestamp >> 16);
+      radio_duration_buffer_write = write + 3;
     }
+    radio_timestamp_last = timestamp;
+
+    /* wake the radio task up */
+    SCHED_Post(&radio_task);
   }
 }
 
+#ifdef OVERSAMPLE_ENABLED
+/**
+ * Extracts the 433 MHz falling edges of the completed halves of the
+ * oversampling buffer (task posted by the DMA interrupts).
+ * 
+ * @return void.
+ */
+static void oversample_routine(void)
+{
+  const uint32_t write = oversample_write;
+  const uint32_t half = OVERSAMPLE_BUFFER_WORDS / 2;
+
+  /* overrun: only the last completed half is still intact */
+  if ((write - oversample_read) > 1)
+  {
+    TRACE1(SAMPLE_OVERRUN, write - oversample_read - 1);
+    OVERSAMPLE_Skip(&oversample_state, (int32_t)((write - oversample_read - 1) * half));
+    oversample_read = write - 1;
+  }
+
+  while (oversample_read != write)
+  {
+    OVERSAMPLE_Extract(&oversample_state, &oversample_buffer[(oversample_read & 1) * half], (int32_t)half);
+    oversample_read++;
+  }
+}
+
+/**
+ * SPI Rx Half Transfer Completed Callback (first half of the oversampling
+ * buffer). Overwrites default callback.
+ * 
+ * @param hspi pointer to HAL SPI structure.
+ * 
+ * @return void.
+ */
+void HAL_SPI_RxHalfCpltCallback(SPI_HandleTypeDef * hspi)
+{
+  if (hspi == serv_hspi)
+  {
+    oversample_write++;
+    SCHED_Post(&oversample_task);
+  }
+}
+
+/**
+ * SPI Rx Transfer Completed Callback (second half of the oversampling
+ * buffer, the circular DMA goes on). Overwrites default callback.
+ * 
+ * @param hspi pointer to HAL SPI structure.
+ * 
+ * @return void.
+ */
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef * hspi)
+{
+  if (hspi == serv_hspi)
+  {
+    oversample_write++;
+    SCHED_Post(&oversample_task);
+  }
+}
+
+/**
+ * Starts the oversampling of the 433 MHz data pin instead of the capture
+ * channel 3 (after SERV_Init()).
+ * 
+ * @param hspi pointer to HAL SPI configured as receive only master with
+ * 16-bit frames and a circular DMA channel.
+ * 
+ * @return void.
+ */
+void SERV_OversampleStart(SPI_HandleTypeDef * hspi)
+{
+  serv_hspi = hspi;
+  oversample_write = 0;
+  oversample_read = 0;
+  OVERSAMPLE_Init(&oversample_state, TIMEBASE_NowUs(), OVERSAMPLE_PRESCALER, OVERSAMPLE_CLOCK_MHZ, radio_edge);
+  HAL_SPI_Receive_DMA(serv_hspi, (uint8_t *)oversample_buffer, OVERSAMPLE_BUFFER_WORDS);
+}
+#endif
+
 /**
  * Timer Capture Callback. Overwrites default callback.
  * 
@@ -214,88 +663,434 @@ void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef * htim)
     if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1)
     {
       /* read compare register */
-      const uint32_t compare =  __HAL_TIM_GET_COMPARE(htim, TIM_CHANNEL_1);
+      const uint32_t timestamp = TIMEBASE_Extend(__HAL_TIM_GET_COMPARE(htim, TIM_CHANNEL_1));
 
-      /* value */
-      const uint32_t value = (compare >= dht22_compare_old) ?
-          (compare - dht22_compare_old) : (0x10000 + compare - dht22_compare_old);
+      /* value (no aliasing of gaps longer than the timer period) */
+      const uint32_t value = timestamp - dht22_timestamp_old;
 
-      /* stock capture */
-      dht22_duration_buffer[(dht22_duration_buffer_write++) & DHT22_PULSE_MASK] = value;
+      /* stock capture (saturated, only the bit durations matter) */
+      dht22_duration_buffer[(dht22_duration_buffer_write++) & DHT22_PULSE_MASK] =
+          (uint16_t)((value < PULSE_DURATION_MAX) ? value : PULSE_DURATION_MAX);
 
-      /* memorize compare */
-      dht22_compare_old = compare;
+      /* memorize timestamp */
+      dht22_timestamp_old = timestamp;
     }
     /* timer of 433 MHz sensor */
     else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3)
     {
       /* read compare register */
-      const uint32_t compare =  __HAL_TIM_GET_COMPARE(htim, TIM_CHANNEL_3);
+      radio_edge(TIMEBASE_Extend(__HAL_TIM_GET_COMPARE(htim, TIM_CHANNEL_3)));
+    }
+    else
+    {
+      /* do nothing */
+    }
+  }
+}
 
-      /* value */
-      const uint32_t value = (compare >= radio_compare_old) ?
-          (compare - radio_compare_old) : (0x10000 + compare - radio_compare_old);
+/**
+ * Timer Period Elapsed Callback (overflow of the microsec timer). Overwrites default callback.
+ * 
+ * @param htim pointer to HAL Timer structure.
+ * 
+ * @return void.
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim)
+{
+  if (htim == serv_htim)
+  {
+    TIMEBASE_OverflowHandler();
 
-      /* stock capture if pulse more than 100 microsec */
-      if (value >= 400)
+    /* check the radio idle timeout until the flush */
+    if (radio_flushed == 0)
+    {
+      SCHED_Post(&radio_task);
+    }
+  }
+}
+
+/**
+ * Configures the 433 MHz glitch suppression (timer input filter and runt merging).
+ * 
+ * @param config new configuration.
+ * 
+ * @return void.
+ */
+void SERV_GlitchConfigSet(const GLITCH_config_t * config)
+{
+  /* hardware filter of the 433 MHz capture channel */
+  MODIFY_REG(serv_htim->Instance->CCMR2, TIM_CCMR2_IC3F, (config->hw_filter & 0xF) << TIM_CCMR2_IC3F_Pos);
+
+  /* software filter (used by the capture interrupt) */
+  __disable_irq();
+  radio_glitch_config = *config;
+  __enable_irq();
+}
+
+/**
+ * Gets the 433 MHz glitch suppression counters.
+ * 
+ * @param state output counters.
+ * 
+ * @return void.
+ */
+void SERV_GlitchStatsGet(GLITCH_state_t * state)
+{
+  __disable_irq();
+  *state = radio_glitch;
+  __enable_irq();
+}
+
+/**
+ * Version LED blink (one-shot task re-armed until the end of the show).
+ */
+static void version_blink_routine(void)
+{
+  /* on for even remaining switches, off for odd ones (off at the end) */
+  led_switch(((version_blinks & 1) == 0) ? SWITCH_ON : SWITCH_OFF);
+
+  if ((--version_blinks) > 0)
+  {
+    SCHED_TimerStart(&version_blink_task, VERSION_BLINK_SYSTICKS, 0);
+  }
+}
+
+/**
+ * Version show routine (periodic task): blinks the LED SERVER_VERSION times
+ * without blocking the other tasks.
+ */
+static void version_routine(void)
+{
+  version_blinks = 2 * SERVER_VERSION;
+  SCHED_TimerStart(&version_blink_task, VERSION_BLINK_SYSTICKS, 0);
+}
+
+/**
+ * Programs a half-word of the persistent log area (flash backend).
+ * 
+ * @param offset offset in bytes in the log area.
+ * @param value half-word to program.
+ * 
+ * @return 0 if ok.
+ */
+static int32_t flashlog_program(uint32_t offset, uint16_t value)
+{
+  HAL_StatusTypeDef status;
+
+  HAL_FLASH_Unlock();
+  status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, FLASHLOG_ADDRESS + offset, value);
+  HAL_FLASH_Lock();
+
+  return (status == HAL_OK) ? 0 : -1;
+}
+
+/**
+ * Erases a page of the persistent log area (flash backend).
+ * 
+ * @param offset offset of the page in bytes in the log area.
+ * 
+ * @return 0 if ok.
+ */
+static int32_t flashlog_erase(uint32_t offset)
+{
+  FLASH_EraseInitTypeDef erase;
+  uint32_t error = 0;
+  HAL_StatusTypeDef status;
+
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.Banks = FLASH_BANK_1;
+  erase.PageAddress = FLASHLOG_ADDRESS + offset;
+  erase.NbPages = 1;
+
+  HAL_FLASH_Unlock();
+  status = HAL_FLASHEx_Erase(&erase, &error);
+  HAL_FLASH_Lock();
+
+  return (status == HAL_OK) ? 0 : -1;
+}
+
+/**
+ * Internal flash backend of the persistent log.
+ */
+static const FLASHLOG_flash_t flashlog_internal = {
+    (const uint8_t *)FLASHLOG_ADDRESS, FLASHLOG_PAGE_NUMBER, flashlog_program, flashlog_erase
+};
+
+/**
+ * @return time of a new record (see FLASHLOG_TIME_WALL).
+ */
+static uint32_t link_time(void)
+{
+  const uint32_t uptime = HAL_GetTick() / 1000;
+
+  return (link_epoch != 0) ? (link_epoch + uptime) : uptime;
+}
+
+/**
+ * Handler of the sent readings: temperatures and humidities are staged in
+ * the persistent log until the Linux server acknowledges them.
+ * 
+ * @param channel channel (see SENSORS_CHANNEL_e).
+ * @param quantity measured quantity (see SENSORS_QUANTITY_e).
+ * @param value sent value.
+ * 
+ * @return void.
+ */
+static void sensors_sent(int32_t channel, int32_t quantity, int32_t value)
+{
+  if ((quantity == SENSORS_QUANTITY_TEMPER) || (quantity == SENSORS_QUANTITY_HUM))
+  {
+    FLASHLOG_Append((uint32_t)channel, value, link_time());
+  }
+}
+
+/**
+ * Wakes the command task up (UART interrupt, complete line).
+ */
+static void command_ready(void)
+{
+  SCHED_Post(&command_task);
+}
+
+/**
+ * Command routine (task posted by the UART reception): heartbeat of the
+ * Linux server ("133;255;3;0;1;<seconds since epoch>"), replay request of
+ * the persistent log ("133;37;2;0;24;<first sequence>").
+ */
+static void command_routine(void)
+{
+  MYSENSORS_message_t message;
+  FLASHLOG_stats_t stats;
+  char text[MYSENSORS_TEXT_MAX + 1];
+
+  if ((MYSENSORS_Receive(&message) != 0) && (message.node == TELEMETRY_NODE_ID))
+  {
+    if ((message.child == MYSENSORS_CHILD_ID_INTERNAL) && (message.command == MYSENSORS_CMD_INTERNAL) &&
+        (message.type == MYSENSORS_TYPE_INTERNAL_TIME))
+    {
+      const uint32_t now = (uint32_t)strtoul(message.payload, NULL, 10);
+      const uint32_t tick = HAL_GetTick();
+
+      /*
+       * Previous heartbeat one period ago: the readings sent since then 
+       * have been received. Otherwise the server may have been away (or 
+       * restarted) in between: the staged readings are programmed.
+       */
+      if ((link_alive != 0) && ((tick - link_heartbeat) < LINK_TIMEOUT_MS))
+      {
+        FLASHLOG_Delivered();
+      }
+      else
+      {
+        link_lost = 1;
+      }
+      link_alive = 1;
+      link_heartbeat = tick;
+      if (now >= FLASHLOG_TIME_WALL)
+      {
+        link_epoch = now - link_heartbeat / 1000;
+      }
+    }
+    else if ((message.child == MYSENSORS_CHILD_ID_FLASHLOG) && (message.command == MYSENSORS_CMD_REQ))
+    {
+      FLASHLOG_StatsGet(&stats);
+      flashlog_replay = (uint32_t)strtoul(message.payload, NULL, 10);
+      if ((flashlog_replay < stats.first) || (flashlog_replay > stats.next))
       {
-        radio_duration_buffer[(radio_duration_buffer_write++) & RADIO_PULSE_MASK] = value;
+        flashlog_replay = stats.first;
       }
+      flashlog_replay_end = stats.next;
 
-      /* memorize compare */
-      radio_compare_old = compare;
+      /* header "h,first,next,replayed" */
+      if (flashlog_replay < flashlog_replay_end)
+      {
+        snprintf(text, sizeof(text), "h,%lu,%lu,%lu", (unsigned long)stats.first, (unsigned long)stats.next,
+            (unsigned long)(flashlog_replay_end - flashlog_replay));
+        MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_FLASHLOG, MYSENSORS_TYPE_SET_CUSTOM, text);
+      }
     }
     else
     {
-      /* do nothing */
+      /* unknown command */
     }
   }
 }
 
 /**
- * Version show routine.
+ * Replays a record of the persistent log: "r,sequence,time" (time in
+ * seconds since epoch, 0 if unknown) then the reading as it was sent.
+ * 
+ * @param sequence record sequence.
+ * 
+ * @return void.
  */
-static void version_routine(void)
+static void flashlog_send(uint32_t sequence)
+{
+  FLASHLOG_record_t record;
+  FLASHLOG_stats_t stats;
+  char text[MYSENSORS_TEXT_MAX + 1];
+  uint32_t time = 0;
+
+  if (FLASHLOG_Read(sequence, &record) > 0)
+  {
+    FLASHLOG_StatsGet(&stats);
+    if (record.time >= FLASHLOG_TIME_WALL)
+    {
+      time = record.time;
+    }
+    /* seconds since boot: known for this boot only */
+    else if ((sequence >= stats.boot) && (link_epoch != 0))
+    {
+      time = link_epoch + record.time;
+    }
+    else
+    {
+      /* unknown */
+    }
+
+    snprintf(text, sizeof(text), "r,%lu,%lu", (unsigned long)sequence, (unsigned long)time);
+    MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_FLASHLOG, MYSENSORS_TYPE_SET_CUSTOM, text);
+    SENSORS_Resend((int32_t)record.channel, record.value);
+  }
+}
+
+/**
+ * Persistent log routine (periodic task): sends a batch of the requested
+ * replay, or programs the staged readings while the Linux server is silent.
+ * The log is armed by the first heartbeat: without Linux server (or behind
+ * an aggregator) the flash is never programmed.
+ * The programs wait for a pause between two 433 MHz bursts, at most
+ * FLASHLOG_DEFER_MAX runs on a busy band.
+ */
+static void flashlog_routine(void)
+{
+  int32_t i;
+
+  if (flashlog_replay < flashlog_replay_end)
+  {
+    for (i = 0; (i < FLASHLOG_REPLAY_BATCH) && (flashlog_replay < flashlog_replay_end); i++)
+    {
+      flashlog_send(flashlog_replay++);
+    }
+  }
+  else if ((link_lost != 0) || ((link_alive != 0) && ((HAL_GetTick() - link_heartbeat) >= LINK_TIMEOUT_MS)))
+  {
+    /* the flash stalls the CPU (up to 40 ms per page erase) */
+    if ((radio_flushed == 0) && (flashlog_deferred < FLASHLOG_DEFER_MAX))
+    {
+      flashlog_deferred++;
+    }
+    else if (FLASHLOG_Commit() == 0)
+    {
+      /* all programmed */
+      link_lost = 0;
+      flashlog_deferred = 0;
+    }
+    else
+    {
+      /* next record on the next run */
+    }
+  }
+  else
+  {
+    /* link ok: the staged readings wait for the next heartbeat */
+    flashlog_deferred = 0;
+  }
+}
+
+/**
+ * Latency telemetry routine (periodic task): sends one MySensors message per
+ * probe with samples, then restarts the histograms.
+ */
+static void telemetry_routine(void)
 {
-  /* systick */
-  static uint64_t systick_last = VERSION_SYSTICK_PERIOD;
-  const uint64_t systick_now = systick;
+  char text[MYSENSORS_TEXT_MAX + 1];
+  LATENCY_histogram_t histogram;
+  int32_t i;
 
-  /* version show */
-  if ((systick_now - systick_last) >= VERSION_SYSTICK_PERIOD)
+  for (i = 0; i < LATENCY_PROBE_NUMBER; i++)
   {
-    int32_t i;
+    LATENCY_Get(i, &histogram);
+    if ((histogram.count != 0) && (LATENCY_Format(i, text, sizeof(text)) > 0))
+    {
+      MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_LATENCY + i, MYSENSORS_TYPE_SET_CUSTOM, text);
+    }
+  }
+
+  LATENCY_Reset();
+}
+
+/**
+ * 433 MHz link quality routine (periodic task): sends one MySensors message
+ * per sensor ID and the calibrated LaCrosse receiver windows
+ * "w,centre,count,..." (per symbol class, see LACROSSE_SYMBOL_e), then
+ * restarts the statistics.
+ */
+static void linkstats_routine(void)
+{
+  char text[MYSENSORS_TEXT_MAX + 1];
+  LACROSSE_window_t windows[LACROSSE_SYMBOL_NUMBER];
+  const uint32_t now = TIMEBASE_NowUs();
+  int32_t len;
+  int32_t i;
 
-    /* show the version */
-    for (i = 0; i < SERVER_VERSION; i++)
+  for (i = 0; i <= LINKSTATS_SENSOR_NUMBER; i++)
+  {
+    if (LINKSTATS_Format(i, now, text, sizeof(text)) > 0)
     {
-      volatile int32_t k;
-      led_switch(SWITCH_ON);
-      for (k = 0; k < 200000; k++);
-      led_switch(SWITCH_OFF);
-      for (k = 0; k < 200000; k++);
+      MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_LINK, MYSENSORS_TYPE_SET_CUSTOM, text);
     }
+  }
+
+  LACROSSE_calib_get_c(windows);
+  len = sprintf(text, "w");
+  for (i = 0; i < LACROSSE_SYMBOL_NUMBER; i++)
+  {
+    len += sprintf(&text[len], ",%lu,%lu", (unsigned long)windows[i].centre, (unsigned long)windows[i].count);
+  }
+  MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_LINK, MYSENSORS_TYPE_SET_CUSTOM, text);
+
+  LINKSTATS_Reset();
+}
+
+#ifdef PROFILE_ENABLED
+/**
+ * Function profile routine (periodic task, profiling variant): sends the
+ * header then one MySensors message per node of the calling context tree,
+ * and restarts the counters.
+ */
+static void profile_routine(void)
+{
+  char text[MYSENSORS_TEXT_MAX + 1];
+  int32_t i;
 
-    /* remember systick */
-    systick_last = systick_now;
+  for (i = -1; i < PROFILE_NODE_NUMBER; i++)
+  {
+    if (PROFILE_Format(i, text, sizeof(text)) > 0)
+    {
+      MYSENSORS_SendText(TELEMETRY_NODE_ID, MYSENSORS_CHILD_ID_PROFILE, MYSENSORS_TYPE_SET_CUSTOM, text);
+    }
   }
 }
+#endif
 
 /**
- * Routine called all time in while(1).
+ * Routine called all time in while(1): runs the ready tasks, then sleeps
+ * until the next interrupt.
  * 
  * @return void.
  */
 void SERV_Routine(void)
 {
-  /* version show routine */
-  version_routine();
+  const uint32_t start = TIMEBASE_NowUs();
 
-  /* DHT22 routine */
-  dht22_routine();
+  /* worst case iteration (without the sleep) */
+  if (SCHED_Run() != 0)
+  {
+    LATENCY_Record(LATENCY_PROBE_SERVER_ITERATION, TIMEBASE_NowUs() - start);
+  }
 
-  /* 433 MHz routine */
-  lacrosse_routine();
+  SCHED_Sleep();
 }
 
 /**
@@ -303,7 +1098,7 @@ void SERV_Routine(void)
  */  
 void SERV_TickIncrement(void)
 {
-  systick++;
+  SCHED_Tick();
 }
 
 /**
@@ -320,34 +1115,105 @@ void SERV_Init(UART_HandleTypeDef * huart, TIM_HandleTypeDef * htim)
   serv_huart = huart;
   serv_htim = htim;
 
+#ifdef PROFILE_ENABLED
+  /* cycle counter of the function profile */
+  PROFILE_Init();
+#endif
+
   /* led switch off */
   led_switch(SWITCH_OFF);
 
-  /* mysensors init */
+  /* scheduler (the 433 MHz task first: highest priority of the posted tasks) */
+  SCHED_Init();
+  SCHED_Register(&radio_task, "radio", radio_routine);
+#ifdef OVERSAMPLE_ENABLED
+  SCHED_Register(&oversample_task, "oversample", oversample_routine);
+#endif
+  SCHED_Register(&dht22_task, "dht22", dht22_routine);
+  SCHED_Register(&version_task, "version", version_routine);
+  SCHED_Register(&version_blink_task, "version_blink", version_blink_routine);
+  SCHED_Register(&telemetry_task, "telemetry", telemetry_routine);
+  SCHED_Register(&linkstats_task, "linkstats", linkstats_routine);
+  SCHED_Register(&command_task, "command", command_routine);
+  SCHED_Register(&flashlog_task, "flashlog", flashlog_routine);
+  LATENCY_Init();
+  TRACE_Init();
+#ifdef PROFILE_ENABLED
+  SCHED_Register(&profile_task, "profile", profile_routine);
+#endif
+
+  /* mysensors init, commands of the Linux server */
   MYSENSORS_Init(serv_huart);
+  MYSENSORS_ReceiveStart(command_ready);
+#ifdef SNIFFER_ENABLED
+  SNIFFER_Init(serv_huart);
+#endif
 
   /* systick 100 ms */
   HAL_SetTickFreq(HAL_TICK_FREQ_10HZ);
   /* capture mode for DHT22 */
   HAL_TIM_IC_Start_IT(serv_htim, TIM_CHANNEL_1);
-  /* capture mode for 433MHz */
+#ifndef OVERSAMPLE_ENABLED
+  /* capture mode for 433MHz (see SERV_OversampleStart() otherwise) */
   HAL_TIM_IC_Start_IT(serv_htim, TIM_CHANNEL_3);
-  /* start microsec timer */
-  HAL_TIM_Base_Start(serv_htim);
+#endif
+  /* start microsec timer, its overflows extend the timestamps to 32 bits */
+  TIMEBASE_Init(serv_htim);
+  HAL_TIM_Base_Start_IT(serv_htim);
 
   /* DHT22 init */
   dht22_duration_buffer_write = 0;
-  dht22_compare_old = 0;
+  dht22_timestamp_old = 0;
   DHT22_Init(htim, GPIOA, GPIO_PIN_DHT22);
 
   /* 433 MHz init */
   radio_duration_buffer_write = 0;
   radio_duration_buffer_read = 0;
-  radio_compare_old = 0;
+  GLITCH_Init(&radio_glitch, 0);
+  radio_timestamp_last = 0;
+  radio_flushed = 1;
   memset(radio_duration_buffer, 0, sizeof(radio_duration_buffer));
+  radio_time = 0;
+
+  /* 433 MHz glitch suppression */
+  SERV_GlitchConfigSet(&radio_glitch_default);
+
+  /* persistent log of the sent readings (recovery scan of the flash) */
+  link_heartbeat = HAL_GetTick();
+  link_epoch = 0;
+  link_alive = 0;
+  link_lost = 0;
+  flashlog_replay = 0;
+  flashlog_replay_end = 0;
+  flashlog_deferred = 0;
+  (void)FLASHLOG_Init(&flashlog_internal);
+  SENSORS_Init(sensors_sent);
+
+  /* 433 MHz decoders and link quality per sensor */
+  LINKSTATS_Init(LACROSSE_REPEAT_NUMBER);
+  OOK_Init(radio_handler);
+  OOK_Register(&radio_decoder_lacrosse);
+  OOK_Register(&radio_decoder_nexus);
+
+  /* periodic tasks: version show first, DHT22 conversions */
+  version_blinks = 0;
+  SCHED_TimerStart(&version_task, 1, VERSION_SYSTICK_PERIOD);
+  SCHED_TimerStart(&dht22_task, DHT22_SYSTICK_PERIOD, DHT22_SYSTICK_PERIOD);
+#ifndef SNIFFER_ENABLED
+  /* telemetry lines (the UART carries the capture blocks in sniffer mode) */
+  SCHED_TimerStart(&telemetry_task, TELEMETRY_SYSTICK_PERIOD, TELEMETRY_SYSTICK_PERIOD);
+  SCHED_TimerStart(&linkstats_task, LINKSTATS_SYSTICK_PERIOD, LINKSTATS_SYSTICK_PERIOD);
+  SCHED_TimerStart(&flashlog_task, FLASHLOG_SYSTICK_PERIOD, FLASHLOG_SYSTICK_PERIOD);
+#endif
+#ifdef PROFILE_ENABLED
+  SCHED_TimerStart(&profile_task, PROFILE_SYSTICK_PERIOD, PROFILE_SYSTICK_PERIOD);
+#endif
 
-  /* init systick */
-  systick = 0;
+  /* trace lines (the UART carries the capture blocks in sniffer mode) */
+  TRACE1(BOOT, SERVER_VERSION);
+#ifndef SNIFFER_ENABLED
+  TRACE_Start(TRACE_SYSTICK_PERIOD);
+#endif
 }
 
 
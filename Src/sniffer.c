@@ -0,0 +1,258 @@
+/**
+ * @file sniffer.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sniffer.h"
+#include "capture.h"
+#include "sched.h"
+
+/* only in the sniffer variant (the DMA callback would take over the UART) */
+#ifdef SNIFFER_ENABLED
+
+/* double buffer: one block is filled while the other one is sent by DMA */
+#define SNIFFER_BLOCK_NUMBER  2
+
+
+/* UART */
+static UART_HandleTypeDef * sniffer_huart = NULL;
+static volatile int32_t sniffer_dma_busy;
+
+/* blocks */
+static uint8_t sniffer_block[SNIFFER_BLOCK_NUMBER][CAPTURE_BLOCK_SIZE_MAX];
+static int32_t sniffer_fill;
+static int32_t sniffer_len;
+static uint8_t sniffer_sequence;
+static CAPTURE_codec_t sniffer_codec;
+
+/* task sending the blocks (posted by new records and DMA completions) */
+static SCHED_task_t sniffer_task;
+
+/* dropped durations: total and not yet reported in the stream */
+static uint32_t sniffer_dropped;
+static uint32_t sniffer_dropped_report;
+
+
+/**
+ * Starts a new block in the free buffer.
+ *
+ * @details The delta encoding restarts in each block so that the host can
+ * decode a block without the previous ones.
+ *
+ * @return void.
+ */
+static void block_open(void)
+{
+  sniffer_fill = (sniffer_fill + 1) % SNIFFER_BLOCK_NUMBER;
+  sniffer_len = 0;
+  CAPTURE_CodecInit(&sniffer_codec, 0);
+}
+
+/**
+ * Sends the filled block by DMA if the previous one is sent.
+ *
+ * @details If the transfer cannot start, the block is kept and sent again
+ * by the next record or task run.
+ *
+ * @return 0 if the block has been sent, -1 if the DMA is busy or the
+ * transfer cannot start.
+ */
+static int32_t block_send(void)
+{
+  int32_t retval = -1;
+
+  if (sniffer_dma_busy == 0)
+  {
+    uint8_t * block = sniffer_block[sniffer_fill];
+
+    block[0] = CAPTURE_BLOCK_SYNC_0;
+    block[1] = CAPTURE_BLOCK_SYNC_1;
+    block[2] = (uint8_t)sniffer_len;
+    block[3] = sniffer_sequence;
+    block[CAPTURE_BLOCK_HEADER_SIZE + sniffer_len] =
+        CAPTURE_Crc8(&block[2], CAPTURE_BLOCK_HEADER_SIZE - 2 + sniffer_len);
+
+    sniffer_dma_busy = 1;
+    if (HAL_UART_Transmit_DMA(sniffer_huart, block, CAPTURE_BLOCK_HEADER_SIZE + sniffer_len + 1) == HAL_OK)
+    {
+      sniffer_sequence++;
+      block_open();
+      retval = 0;
+    }
+    else
+    {
+      sniffer_dma_busy = 0;
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Appends a record to the current block.
+ *
+ * @param record record to append.
+ *
+ * @return 0 if ok, -1 if no space is available (the record is dropped).
+ */
+static int32_t record_append(const CAPTURE_record_t * record)
+{
+  int32_t retval = 0;
+  const int32_t size_max = (sniffer_dropped_report != 0) ? (2 * CAPTURE_RECORD_MAX) : CAPTURE_RECORD_MAX;
+
+  /* block full: send it */
+  if ((sniffer_len + size_max) > CAPTURE_BLOCK_PAYLOAD_MAX)
+  {
+    retval = block_send();
+  }
+
+  if (retval == 0)
+  {
+    /* report the dropped durations first */
+    if (sniffer_dropped_report != 0)
+    {
+      const CAPTURE_record_t dropped = {
+          CAPTURE_CHANNEL_EVENT, CAPTURE_EVENT_DROPPED, sniffer_dropped_report, 0
+      };
+      sniffer_len += CAPTURE_Encode(&sniffer_codec,
+          &sniffer_block[sniffer_fill][CAPTURE_BLOCK_HEADER_SIZE + sniffer_len], &dropped);
+      sniffer_dropped_report = 0;
+    }
+
+    sniffer_len += CAPTURE_Encode(&sniffer_codec,
+        &sniffer_block[sniffer_fill][CAPTURE_BLOCK_HEADER_SIZE + sniffer_len], record);
+
+    /* send it once the current task is done */
+    SCHED_Post(&sniffer_task);
+  }
+
+  return retval;
+}
+
+/**
+ * Sniffer task: sends the current block as soon as the UART is free (small
+ * blocks on a quiet band, full blocks on a busy one).
+ *
+ * @return void.
+ */
+static void sniffer_routine(void)
+{
+  if ((sniffer_len > 0) && (sniffer_dma_busy == 0))
+  {
+    (void)block_send();
+  }
+}
+
+/**
+ * UART DMA transfer complete. Overwrites default callback.
+ *
+ * @param huart pointer to HAL UART structure.
+ *
+ * @return void.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef * huart)
+{
+  if (huart == sniffer_huart)
+  {
+    sniffer_dma_busy = 0;
+
+    /* next block */
+    SCHED_Post(&sniffer_task);
+  }
+}
+
+/**
+ * Initializes the module (after SCHED_Init()).
+ *
+ * @param huart pointer to UART structure (with a DMA TX channel).
+ *
+ * @return void.
+ */
+void SNIFFER_Init(UART_HandleTypeDef * huart)
+{
+  sniffer_huart = huart;
+  sniffer_dma_busy = 0;
+  sniffer_fill = 0;
+  sniffer_sequence = 0;
+  sniffer_dropped = 0;
+  sniffer_dropped_report = 0;
+  memset(sniffer_block, 0, sizeof(sniffer_block));
+  block_open();
+  SCHED_Register(&sniffer_task, "sniffer", sniffer_routine);
+}
+
+/**
+ * Streams a pulse duration.
+ *
+ * @param channel capture channel (see CAPTURE_CHANNEL_e).
+ * @param duration duration in timer ticks (microsec).
+ *
+ * @return void.
+ */
+void SNIFFER_Input(int32_t channel, uint32_t duration)
+{
+  const CAPTURE_record_t record = { channel, duration, 0, 0 };
+
+  if (record_append(&record) != 0)
+  {
+    SNIFFER_Dropped(1);
+  }
+}
+
+/**
+ * Streams an event.
+ *
+ * @param event event (see CAPTURE_EVENT_e).
+ * @param argument event argument.
+ *
+ * @return void.
+ */
+void SNIFFER_Event(uint32_t event, uint32_t argument)
+{
+  const CAPTURE_record_t record = { CAPTURE_CHANNEL_EVENT, event, argument, 0 };
+
+  (void)record_append(&record);
+}
+
+/**
+ * Counts durations lost before the sniffer (e.g. circular buffer overrun).
+ *
+ * @param number number of dropped durations.
+ *
+ * @return void.
+ */
+void SNIFFER_Dropped(uint32_t number)
+{
+  sniffer_dropped += number;
+  sniffer_dropped_report += number;
+}
+
+/**
+ * @return total number of dropped durations since the initialisation.
+ */
+uint32_t SNIFFER_DroppedGet(void)
+{
+  return sniffer_dropped;
+}
+
+#endif
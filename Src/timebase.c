@@ -0,0 +1,117 @@
+/**
+ * @file timebase.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stddef.h>
+
+#include "timebase.h"
+
+
+/* half of the timer period: captured values below were taken after a wrap */
+#define TIMEBASE_HALF_PERIOD  0x8000
+
+
+/* timer */
+static TIM_HandleTypeDef * timebase_htim = NULL;
+
+/* number of timer overflows (upper 16 bits of the time) */
+static volatile uint32_t timebase_overflow = 0;
+
+
+/**
+ * Initializes the module.
+ *
+ * @details The timer must count microsec with a 16-bit period (ARR 0xFFFF)
+ * and its update interrupt must call @ref TIMEBASE_OverflowHandler().
+ *
+ * @param htim pointer to HAL timer (capture timer).
+ *
+ * @return void.
+ */
+void TIMEBASE_Init(TIM_HandleTypeDef * htim)
+{
+  timebase_htim = htim;
+  timebase_overflow = 0;
+}
+
+/**
+ * Counts a timer overflow (update interrupt).
+ *
+ * @return void.
+ */
+void TIMEBASE_OverflowHandler(void)
+{
+  timebase_overflow++;
+}
+
+/**
+ * Extends a captured 16-bit timer value to a 32-bit microsec timestamp.
+ *
+ * @details Called from the capture interrupt. HAL_TIM_IRQHandler() handles
+ * the captures before the update, so an overflow may be pending: a small
+ * captured value was then latched after the wrap.
+ *
+ * @param compare captured timer value.
+ *
+ * @return timestamp in microsec.
+ */
+uint32_t TIMEBASE_Extend(uint32_t compare)
+{
+  uint32_t overflow = timebase_overflow;
+
+  if (__HAL_TIM_GET_FLAG(timebase_htim, TIM_FLAG_UPDATE) && ((compare & 0xFFFF) < TIMEBASE_HALF_PERIOD))
+  {
+    overflow++;
+  }
+
+  return (overflow << 16) | (compare & 0xFFFF);
+}
+
+/**
+ * Reads the current time without tearing from any context.
+ *
+ * @details The read is retried if an overflow is counted in the middle.
+ * A pending overflow (read from a higher priority interrupt) is handled as
+ * in @ref TIMEBASE_Extend().
+ *
+ * @return current time in microsec.
+ */
+uint32_t TIMEBASE_NowUs(void)
+{
+  uint32_t overflow;
+  uint32_t counter;
+  uint32_t pending;
+
+  do
+  {
+    overflow = timebase_overflow;
+    counter = __HAL_TIM_GET_COUNTER(timebase_htim) & 0xFFFF;
+    pending = __HAL_TIM_GET_FLAG(timebase_htim, TIM_FLAG_UPDATE);
+  }
+  while (overflow != timebase_overflow);
+
+  if (pending && (counter < TIMEBASE_HALF_PERIOD))
+  {
+    overflow++;
+  }
+
+  return (overflow << 16) | counter;
+}
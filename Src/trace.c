@@ -0,0 +1,233 @@
+/**
+ * @file trace.c
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "trace.h"
+#include "mysensors.h"
+#include "timebase.h"
+#include "sched.h"
+
+
+/* ring index mask */
+#define TRACE_RING_MASK  (TRACE_RING_SIZE - 1)
+
+/* trace lines sent per run of the task before yielding */
+#define TRACE_LINES_PER_RUN  2
+
+/* hex digits of a word */
+#define TRACE_WORD_DIGITS  8
+
+/* words of the report of the lost records */
+#define TRACE_LOST_WORDS  (TRACE_HEADER_WORDS + 1)
+
+
+/* ring of records (written from any context, read by the task) */
+static uint32_t trace_ring[TRACE_RING_SIZE];
+static volatile uint32_t trace_write;
+static volatile uint32_t trace_read;
+
+/* records lost since the last report, time of the first one */
+static volatile uint32_t trace_lost;
+static uint32_t trace_lost_time;
+
+/* drain task */
+static SCHED_task_t trace_task;
+
+
+/**
+ * Appends a word in hex to a line.
+ *
+ * @param text line.
+ * @param word word to append.
+ *
+ * @return number of written characters.
+ */
+static int32_t hex_append(char * text, uint32_t word)
+{
+  static const char digits[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                   '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+  int32_t i;
+
+  for (i = TRACE_WORD_DIGITS - 1; i >= 0; i--)
+  {
+    text[i] = digits[word & 0xF];
+    word >>= 4;
+  }
+
+  return TRACE_WORD_DIGITS;
+}
+
+/**
+ * Appends the report of the lost records if there is space, in order with
+ * the other records (interrupts masked).
+ *
+ * @param write write index.
+ *
+ * @return new write index.
+ */
+static uint32_t lost_append(uint32_t write)
+{
+  if ((trace_lost != 0) && ((write + TRACE_LOST_WORDS - trace_read) <= TRACE_RING_SIZE))
+  {
+    trace_ring[write & TRACE_RING_MASK] = TRACE_HEADER(LOST);
+    trace_ring[(write + 1) & TRACE_RING_MASK] = trace_lost_time;
+    trace_ring[(write + 2) & TRACE_RING_MASK] = trace_lost;
+    trace_lost = 0;
+    write += TRACE_LOST_WORDS;
+  }
+
+  return write;
+}
+
+/**
+ * Trace task: sends the records of the ring, whole records per line.
+ *
+ * @return void.
+ */
+static void trace_routine(void)
+{
+  char text[MYSENSORS_TEXT_MAX + 1];
+  int32_t lines;
+
+  for (lines = 0; (lines < TRACE_LINES_PER_RUN) && ((trace_read != trace_write) || (trace_lost != 0)); lines++)
+  {
+    uint32_t read = trace_read;
+    uint32_t write;
+    int32_t len = 0;
+
+    /* report of the lost records once space is freed */
+    if (trace_lost != 0)
+    {
+      const uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+      trace_write = lost_append(trace_write);
+      __set_PRIMASK(primask);
+    }
+    write = trace_write;
+
+    while (read != write)
+    {
+      const uint32_t size = TRACE_HEADER_WORDS + ((trace_ring[read & TRACE_RING_MASK] >> 8) & 0x3);
+      uint32_t k;
+
+      if ((len + (int32_t)(size * TRACE_WORD_DIGITS)) > MYSENSORS_TEXT_MAX)
+      {
+        break;
+      }
+      for (k = 0; k < size; k++)
+      {
+        len += hex_append(&text[len], trace_ring[(read + k) & TRACE_RING_MASK]);
+      }
+      read += size;
+    }
+
+    /* free the space of the formatted records */
+    trace_read = read;
+
+    text[len] = '\0';
+    MYSENSORS_SendText(TRACE_MYSENSORS_NODE, TRACE_MYSENSORS_CHILD, TRACE_MYSENSORS_TYPE, text);
+  }
+
+  if ((trace_read != trace_write) || (trace_lost != 0))
+  {
+    /* let the other tasks run, continue on the next run */
+    SCHED_Post(&trace_task);
+  }
+}
+
+/**
+ * Initializes the module (after SCHED_Init()).
+ *
+ * @return void.
+ */
+void TRACE_Init(void)
+{
+  trace_write = 0;
+  trace_read = 0;
+  trace_lost = 0;
+  trace_lost_time = 0;
+  memset(trace_ring, 0, sizeof(trace_ring));
+  SCHED_Register(&trace_task, "trace", trace_routine);
+}
+
+/**
+ * Starts sending the records (after MYSENSORS_Init(), not in sniffer mode:
+ * the records are then kept until the ring is full).
+ *
+ * @param period period of the task in systicks.
+ *
+ * @return void.
+ */
+void TRACE_Start(uint32_t period)
+{
+  SCHED_TimerStart(&trace_task, period, period);
+}
+
+/**
+ * Records an event (use the TRACEn() macros), from any context.
+ *
+ * @param header event and number of arguments (TRACE_HEADER()).
+ * @param a first argument.
+ * @param b second argument.
+ * @param c third argument.
+ *
+ * @return void.
+ */
+void TRACE_Record(uint32_t header, uint32_t a, uint32_t b, uint32_t c)
+{
+  const uint32_t args = (header >> 8) & 0x3;
+  const uint32_t now = TIMEBASE_NowUs();
+  const uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  uint32_t write = (trace_lost != 0) ? lost_append(trace_write) : trace_write;
+  if ((write + TRACE_HEADER_WORDS + args - trace_read) > TRACE_RING_SIZE)
+  {
+    if (trace_lost == 0)
+    {
+      trace_lost_time = now;
+    }
+    trace_lost++;
+  }
+  else
+  {
+    trace_ring[write & TRACE_RING_MASK] = header;
+    trace_ring[(write + 1) & TRACE_RING_MASK] = now;
+    if (args > 0)
+    {
+      trace_ring[(write + 2) & TRACE_RING_MASK] = a;
+    }
+    if (args > 1)
+    {
+      trace_ring[(write + 3) & TRACE_RING_MASK] = b;
+    }
+    if (args > 2)
+    {
+      trace_ring[(write + 4) & TRACE_RING_MASK] = c;
+    }
+    write += TRACE_HEADER_WORDS + args;
+  }
+  trace_write = write;
+  __set_PRIMASK(primask);
+}
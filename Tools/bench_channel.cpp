@@ -0,0 +1,318 @@
+/**
+ * @file bench_channel.cpp
+ *
+ * @brief Host benchmark of the LaCrosse receiver through the channel model
+ * (channel_model.h): frame yield, false positives and decoding speed of
+ * LACROSSE_input_handler() for a set of impairment scenarios.
+ *
+ * Build and run on the host:
+ *   gcc -std=c99 -O2 -IInc -c Src/glitch.c
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -IInc -ITools Tools/bench_channel.cpp Src/lacrosse.cpp \
+ *       glitch.o -o bench_channel
+ *   ./bench_channel [-n bursts] [-s seed] [scenario...] > results.csv
+ *
+ * A custom scenario is given as
+ * name:jitter_usec:drift_ppm:drop:extra:interferer_hz:hw_filter:runt_ticks:mode[:nominal] (mode
+ * 0 - merge, 1 - drop; nominal 1 - receiver windows kept nominal, 0 - calibrated, the default),
+ * e.g. "mine:40:-20000:0.01:0.02:2:15:400:0". Results are CSV on stdout (one line
+ * per scenario, with the receiver windows at the end) to compare decoder changes, e.g. with
+ *   column -s, -t results.csv
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "channel_model.h"
+
+/* LaCrosse sync byte */
+#define BENCH_SYNC  0xAA
+
+/* firmware glitch suppression (merge), the former one (drop) and the drop with the input filter */
+#define BENCH_GLITCH_MERGE        { GLITCH_HW_FILTER_DEFAULT, GLITCH_MERGE_TICKS_DEFAULT, GLITCH_MODE_MERGE }
+#define BENCH_GLITCH_DROP         { 0, GLITCH_MERGE_TICKS_DEFAULT, GLITCH_MODE_DROP }
+#define BENCH_GLITCH_DROP_FILTER  { GLITCH_HW_FILTER_DEFAULT, GLITCH_MERGE_TICKS_DEFAULT, GLITCH_MODE_DROP }
+
+/* frames per burst (REPEAT_NUMBER of the transmitter) */
+#define BENCH_REPEAT_NUMBER  12
+
+/* silence between two bursts in microsec (more than the idle timeout) */
+#define BENCH_BURST_GAP  400000.0
+
+
+/**
+ * Benchmark scenario.
+ */
+typedef struct
+{
+  const char * name; /*!< scenario name */
+  channel_config_t config; /*!< impairments */
+  int32_t nominal; /*!< 1 - receiver windows kept nominal (calibration reset after each frame) */
+} bench_scenario_t;
+
+/**
+ * Scenario result.
+ */
+typedef struct
+{
+  uint32_t bursts; /*!< transmitted bursts */
+  uint32_t frames_sent; /*!< transmitted frames (BENCH_REPEAT_NUMBER per burst) */
+  uint32_t frames_ok; /*!< decoded frames equal to the transmitted one */
+  uint32_t bursts_ok; /*!< bursts with at least one correct frame */
+  uint32_t false_positives; /*!< decoded frames different from the transmitted one */
+  uint64_t pulses; /*!< durations given to the decoder */
+  uint32_t merged; /*!< runt edges merged by the glitch suppression */
+  uint32_t dropped; /*!< runt intervals dropped by the glitch suppression */
+  double mpulses_per_sec; /*!< decoding speed */
+  LACROSSE_window_t windows[LACROSSE_SYMBOL_NUMBER]; /*!< receiver windows at the end */
+} bench_result_t;
+
+/**
+ * Predefined scenarios.
+ */
+static const bench_scenario_t bench_scenarios[] = {
+    /* name                      jitter  drift    drop   extra  interf  glitch (filter, runt, mode)    nominal */
+    { "clean",                  { 0.0,    0.0,     0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "jitter20",               { 20.0,   0.0,     0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "jitter50",               { 50.0,   0.0,     0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "jitter80",               { 80.0,   0.0,     0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drift+3%",               { 10.0,   30000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drift-3%",               { 10.0,  -30000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drift+8%",               { 10.0,   80000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drift+8%-nominal",       { 10.0,   80000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          1 },
+    { "drift-6%",               { 10.0,  -60000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drift-6%-nominal",       { 10.0,  -60000.0, 0.0,   0.0,   0.0,   BENCH_GLITCH_MERGE },          1 },
+    { "drop0.5%",               { 10.0,   0.0,     0.005, 0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "drop2%",                 { 10.0,   0.0,     0.02,  0.0,   0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "extra1%",                { 10.0,   0.0,     0.0,   0.01,  0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "extra1%-drop",           { 10.0,   0.0,     0.0,   0.01,  0.0,   BENCH_GLITCH_DROP },           0 },
+    { "extra1%-drop+filter",    { 10.0,   0.0,     0.0,   0.01,  0.0,   BENCH_GLITCH_DROP_FILTER },    0 },
+    { "extra5%",                { 10.0,   0.0,     0.0,   0.05,  0.0,   BENCH_GLITCH_MERGE },          0 },
+    { "extra5%-drop",           { 10.0,   0.0,     0.0,   0.05,  0.0,   BENCH_GLITCH_DROP },           0 },
+    { "extra5%-drop+filter",    { 10.0,   0.0,     0.0,   0.05,  0.0,   BENCH_GLITCH_DROP_FILTER },    0 },
+    { "extra5%-nofilter",       { 10.0,   0.0,     0.0,   0.05,  0.0,   { 0, 0, GLITCH_MODE_MERGE } }, 0 },
+    { "interferer",             { 10.0,   0.0,     0.0,   0.0,   5.0,   BENCH_GLITCH_MERGE },          0 },
+    { "interferer-drop",        { 10.0,   0.0,     0.0,   0.0,   5.0,   BENCH_GLITCH_DROP },           0 },
+    { "interferer-drop+filter", { 10.0,   0.0,     0.0,   0.0,   5.0,   BENCH_GLITCH_DROP_FILTER },    0 },
+    { "field",                  { 40.0,   20000.0, 0.005, 0.02,  2.0,   BENCH_GLITCH_MERGE },          0 },
+    { "field-drop",             { 40.0,   20000.0, 0.005, 0.02,  2.0,   BENCH_GLITCH_DROP },           0 },
+    { "field-drop+filter",      { 40.0,   20000.0, 0.005, 0.02,  2.0,   BENCH_GLITCH_DROP_FILTER },    0 },
+};
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Runs a scenario.
+ *
+ * @param scenario scenario to run.
+ * @param bursts number of transmitted bursts.
+ * @param seed random seed (same signal for the same seed).
+ * @param result output result.
+ *
+ * @return void.
+ */
+static void bench_run(const bench_scenario_t & scenario, uint32_t bursts, uint32_t seed, bench_result_t * result)
+{
+  std::vector<channel_pulse_t> pulses;
+  std::vector<channel_duration_t> durations;
+  std::vector<double> burst_start;
+  std::vector<uint32_t> expected;
+  std::vector<uint32_t> burst_frames(bursts, 0);
+  pulse_random_t random = { seed };
+  double time = BENCH_BURST_GAP;
+  uint32_t i;
+
+  /* transmitted signal and expected decoder outputs */
+  for (i = 0; i < bursts; i++)
+  {
+    const uint32_t data = pulse_random(&random) & 0xFFFFFF;
+
+    burst_start.push_back(time);
+    expected.push_back((BENCH_SYNC << 24) | LACROSSE_encrypt_24bits(data));
+    time = channel_lacrosse(pulses, time, BENCH_SYNC, data, scenario.config.drift_ppm) + BENCH_BURST_GAP;
+  }
+
+  /* channel and receiver interrupt */
+  GLITCH_state_t glitch;
+  channel_impair(pulses, scenario.config, time, &random);
+  channel_hw_filter(pulses, scenario.config.glitch.hw_filter);
+  channel_receive(pulses, burst_start, scenario.config.glitch, durations, &glitch);
+
+  /* decoder (timed separately from the checks) */
+  std::vector<uint32_t> values(durations.size());
+  LACROSSE_calib_reset();
+  const uint64_t start = time_ns();
+  for (i = 0; i < durations.size(); i++)
+  {
+    const uint32_t duration = durations[i].duration;
+    values[i] = (duration != 0) ? LACROSSE_input_handler(duration) : LACROSSE_flush();
+    if ((scenario.nominal != 0) && (values[i] != 0xFFFFFFFFu))
+    {
+      /* one frame stays below the minimal count of the estimation */
+      LACROSSE_calib_reset();
+    }
+  }
+  const uint64_t stop = time_ns();
+
+  memset(result, 0, sizeof(*result));
+  LACROSSE_calib_get(result->windows);
+  for (i = 0; i < durations.size(); i++)
+  {
+    if (values[i] != 0xFFFFFFFFu)
+    {
+      if (values[i] == expected[durations[i].burst])
+      {
+        result->frames_ok++;
+        burst_frames[durations[i].burst]++;
+      }
+      else
+      {
+        result->false_positives++;
+      }
+    }
+  }
+  for (i = 0; i < bursts; i++)
+  {
+    result->bursts_ok += (burst_frames[i] != 0) ? 1 : 0;
+  }
+  result->bursts = bursts;
+  result->frames_sent = bursts * BENCH_REPEAT_NUMBER;
+  result->pulses = durations.size();
+  result->merged = glitch.merged;
+  result->dropped = glitch.dropped;
+  result->mpulses_per_sec = (stop > start) ? ((double)durations.size() * 1000.0 / (stop - start)) : 0.0;
+}
+
+/**
+ * Parses a custom scenario "name:jitter:drift:drop:extra:interferer:filter:runt:mode[:nominal]".
+ *
+ * @return 0 if ok.
+ */
+static int32_t bench_parse(char * text, bench_scenario_t * scenario)
+{
+  double value[8];
+  char * field = strtok(text, ":");
+  int32_t i;
+
+  scenario->name = field;
+  for (i = 0; (i < 8) && (field != NULL); i++)
+  {
+    field = strtok(NULL, ":");
+    value[i] = (field != NULL) ? strtod(field, NULL) : 0.0;
+  }
+  scenario->config.jitter_usec = value[0];
+  scenario->config.drift_ppm = value[1];
+  scenario->config.drop_rate = value[2];
+  scenario->config.extra_rate = value[3];
+  scenario->config.interferer_hz = value[4];
+  scenario->config.glitch.hw_filter = (uint32_t)value[5];
+  scenario->config.glitch.merge_ticks = (uint32_t)value[6];
+  scenario->config.glitch.mode = (int32_t)value[7];
+  scenario->nominal = 0;
+  if (field != NULL)
+  {
+    const char * option = strtok(NULL, ":");
+    scenario->nominal = (option != NULL) ? (int32_t)strtol(option, NULL, 0) : 0;
+  }
+
+  return (field != NULL) ? 0 : -1;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  std::vector<bench_scenario_t> scenarios;
+  uint32_t bursts = 2000;
+  uint32_t seed = 0x12345678u;
+  int opt;
+  size_t i;
+  int32_t k;
+
+  while ((opt = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n': bursts = (uint32_t)strtoul(optarg, NULL, 0); break;
+    case 's': seed = (uint32_t)strtoul(optarg, NULL, 0) | 1u; break;
+    default:
+      fprintf(stderr, "usage: %s [-n bursts] [-s seed] [name:jitter:drift:drop:extra:interferer:filter:runt:mode[:nominal]...]\n", argv[0]);
+      return 2;
+    }
+  }
+  for (; optind < argc; optind++)
+  {
+    bench_scenario_t scenario;
+    if (bench_parse(argv[optind], &scenario) != 0)
+    {
+      fprintf(stderr, "%s: bad scenario\n", argv[optind]);
+      return 2;
+    }
+    scenarios.push_back(scenario);
+  }
+  if (scenarios.empty())
+  {
+    scenarios.assign(bench_scenarios, bench_scenarios + sizeof(bench_scenarios) / sizeof(bench_scenarios[0]));
+  }
+
+  printf("scenario,jitter_usec,drift_ppm,drop_rate,extra_rate,interferer_hz,hw_filter,runt_ticks,glitch_mode,"
+      "bursts,frames_sent,frames_ok,frame_yield,burst_yield,false_positives,false_positive_rate,"
+      "pulses,merged,dropped,mpulses_per_sec,windows,window_centres\n");
+
+  for (i = 0; i < scenarios.size(); i++)
+  {
+    const bench_scenario_t & scenario = scenarios[i];
+    bench_result_t result;
+
+    bench_run(scenario, bursts, seed, &result);
+
+    printf("%s,%.1f,%.0f,%.4f,%.4f,%.2f,%u,%u,%s,%u,%u,%u,%.4f,%.4f,%u,%.6f,%llu,%u,%u,%.2f,%s,",
+        scenario.name, scenario.config.jitter_usec, scenario.config.drift_ppm,
+        scenario.config.drop_rate, scenario.config.extra_rate, scenario.config.interferer_hz,
+        (unsigned)scenario.config.glitch.hw_filter, (unsigned)scenario.config.glitch.merge_ticks,
+        (scenario.config.glitch.mode == GLITCH_MODE_DROP) ? "drop" : "merge",
+        (unsigned)result.bursts, (unsigned)result.frames_sent, (unsigned)result.frames_ok,
+        (double)result.frames_ok / result.frames_sent, (double)result.bursts_ok / result.bursts,
+        (unsigned)result.false_positives,
+        (double)result.false_positives / (result.frames_ok + result.false_positives + 1e-9),
+        (unsigned long long)result.pulses, (unsigned)result.merged, (unsigned)result.dropped,
+        result.mpulses_per_sec, (scenario.nominal != 0) ? "nominal" : "calibrated");
+    for (k = 0; k < LACROSSE_SYMBOL_NUMBER; k++)
+    {
+      printf("%s%u", (k != 0) ? "/" : "", (unsigned)result.windows[k].centre);
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
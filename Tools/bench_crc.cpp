@@ -0,0 +1,96 @@
+/**
+ * @file bench_crc.cpp
+ *
+ * @brief Host benchmark of the LaCrosse checksum: byte by byte reference
+ * versus fused slicing lookup.
+ *
+ * Build and run on the host:
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -IInc Tools/bench_crc.cpp -o bench_crc
+ *   ./bench_crc [candidates]
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+/* static checksum functions are benchmarked directly */
+#include "../Src/lacrosse.cpp"
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Runs a checksum function on a number of candidates.
+ *
+ * @param name function name.
+ * @param func checksum function.
+ * @param number number of candidates.
+ *
+ * @return accumulated checksum (to keep the computation alive).
+ */
+static uint32_t bench(const char * name, uint32_t (*func)(uint32_t), uint32_t number)
+{
+  uint32_t acc = 0;
+  uint32_t payload = 0xAA000000u;
+  uint32_t i;
+
+  const uint64_t start = time_ns();
+  for (i = 0; i < number; i++)
+  {
+    acc += func(payload);
+    payload = payload * 1664525u + 1013904223u;
+  }
+  const uint64_t stop = time_ns();
+
+  printf("%-10s %10u candidates %8.3f ns/candidate\n", name, (unsigned)number,
+      (double)(stop - start) / number);
+
+  return acc;
+}
+
+static uint32_t run_bytewise(uint32_t payload) { return checksum_calculate_bytewise(payload); }
+static uint32_t run_fused(uint32_t payload) { return checksum_calculate(payload); }
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  const uint32_t number = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000000u;
+
+  const uint32_t acc_bytewise = bench("bytewise", run_bytewise, number);
+  const uint32_t acc_fused = bench("fused", run_fused, number);
+
+  if (acc_bytewise != acc_fused)
+  {
+    printf("error: results differ\n");
+    return 1;
+  }
+
+  return 0;
+}
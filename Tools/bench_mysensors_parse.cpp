@@ -0,0 +1,334 @@
+/**
+ * @file bench_mysensors_parse.cpp
+ *
+ * @brief Host benchmark of the MySensors line parsers (mysensors_line.h) on
+ * serial logs: strtol/strtod on a copy of each line (as a script does),
+ * per-line parsing after memchr(), and the SIMD delimiter scan. The payloads
+ * are converted to tenths and the results of all parsers are compared.
+ *
+ * Build and run on the host:
+ *   g++ -std=c++14 -O2 -ITools Tools/bench_mysensors_parse.cpp -o bench_mysensors_parse
+ *   ./bench_mysensors_parse serial.log...   (logs are memory-mapped, any size)
+ *   ./bench_mysensors_parse -g 2048         (synthetic log of 2048 MB in memory)
+ * Add -DMYSENSORS_LINE_SCALAR to measure the scalar fallback of the scan.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "mysensors_line.h"
+
+
+/**
+ * Parse results (identical for all parsers).
+ */
+typedef struct
+{
+  uint64_t lines; /*!< valid lines */
+  uint64_t invalid; /*!< invalid lines */
+  uint64_t numbers; /*!< fixed-point payloads */
+  int64_t sum; /*!< sum of the fields and of the tenths */
+} bench_result_t;
+
+
+/**
+ * Returns a pseudo-random number (xorshift32, reproducible logs).
+ */
+static inline uint32_t bench_random(uint32_t * state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Accumulates a parsed line.
+ */
+static inline void bench_line(const mysensors_line_t & line, int32_t valid, bench_result_t * result)
+{
+  int32_t tenths;
+
+  if (valid != 0)
+  {
+    result->lines++;
+    result->sum += line.node + line.child + line.command + line.ack + line.type;
+    if (mysensors_line_tenths(line.payload, line.payload_len, &tenths) == 0)
+    {
+      result->numbers++;
+      result->sum += tenths;
+    }
+  }
+  else
+  {
+    result->invalid++;
+  }
+}
+
+/**
+ * Reference parser: strtol/strtod on an allocated copy of each line.
+ */
+static void bench_strtod(const char * data, size_t len, bench_result_t * result)
+{
+  size_t offset = 0;
+
+  while (offset < len)
+  {
+    const char * end = (const char *)memchr(&data[offset], '\n', len - offset);
+    if (end == NULL)
+    {
+      break;
+    }
+    std::string text(&data[offset], end - &data[offset]);
+    mysensors_line_t line;
+    long field[5];
+    char * cursor = &text[0];
+    char * next;
+    int32_t valid = 1;
+    int i;
+
+    for (i = 0; (i < 5) && valid; i++)
+    {
+      field[i] = strtol(cursor, &next, 10);
+      valid = ((next != cursor) && (*next == ';') && (field[i] >= 0) && (field[i] <= MYSENSORS_LINE_ID_MAX));
+      cursor = next + 1;
+    }
+    valid = valid && (field[2] <= MYSENSORS_LINE_COMMAND_MAX) && (field[3] <= MYSENSORS_LINE_ACK_MAX);
+    if (valid)
+    {
+      size_t payload_len = text.size() - (cursor - &text[0]);
+      line.node = (int32_t)field[0];
+      line.child = (int32_t)field[1];
+      line.command = (int32_t)field[2];
+      line.ack = (int32_t)field[3];
+      line.type = (int32_t)field[4];
+      if ((payload_len > 0) && (cursor[payload_len - 1] == '\r'))
+      {
+        cursor[--payload_len] = 0;
+      }
+      result->lines++;
+      result->sum += line.node + line.child + line.command + line.ack + line.type;
+
+      /* number with at most one decimal */
+      const char * dot = strchr(cursor, '.');
+      const double value = strtod(cursor, &next);
+      if ((payload_len > 0) && (next == cursor + payload_len) && ((cursor[0] == '-') || ((cursor[0] >= '0') && (cursor[0] <= '9'))) &&
+          ((dot == NULL) || ((dot + 2 == next) && (dot > cursor) && (dot[-1] != '-'))) && (strpbrk(cursor, "eExXnNiI") == NULL) &&
+          (value * 10.0 < 2147483647.5) && (value * 10.0 > -2147483647.5))
+      {
+        result->numbers++;
+        result->sum += (int64_t)(value * 10.0 + ((value < 0) ? -0.5 : 0.5));
+      }
+    }
+    else
+    {
+      result->invalid++;
+    }
+    offset = end - data + 1;
+  }
+}
+
+/**
+ * Per-line parser after memchr() (the parser of the daemons).
+ */
+static void bench_memchr(const char * data, size_t len, bench_result_t * result)
+{
+  mysensors_line_split(data, len, [result](const mysensors_line_t & line, int32_t valid)
+      {
+        bench_line(line, valid, result);
+      });
+}
+
+/**
+ * SIMD delimiter scan.
+ */
+static void bench_scan(const char * data, size_t len, bench_result_t * result)
+{
+  mysensors_line_scan(data, len, [result](const mysensors_line_t & line, int32_t valid)
+      {
+        bench_line(line, valid, result);
+      });
+}
+
+/**
+ * Generates a synthetic log of the firmware messages (with a few corrupted lines).
+ */
+static void bench_generate(std::vector<char> & log, size_t size)
+{
+  static const char * const telemetry = "radio.total,120,5210,9,1,4,35,70,8,2";
+  uint32_t random = 0x2468ACEu;
+  char line[128];
+
+  log.reserve(size + 128);
+  while (log.size() < size)
+  {
+    const uint32_t r = bench_random(&random);
+    const int node = 100 + (int)(r % 8);
+    int len;
+
+    switch ((r >> 8) % 8)
+    {
+    case 0: case 1: case 2:
+      len = sprintf(line, "%d;0;1;0;0;%s%d.%d\n", node, ((r >> 12) & 1) ? "-" : "", (int)((r >> 13) % 40),
+          (int)((r >> 20) % 10));
+      break;
+    case 3: case 4:
+      len = sprintf(line, "%d;1;1;0;1;%d.%d\n", node, (int)((r >> 13) % 100), (int)((r >> 20) % 10));
+      break;
+    case 5: case 6:
+      len = sprintf(line, "%d;0;1;0;24;%u\n", node, (unsigned)bench_random(&random));
+      break;
+    default:
+      if (((r >> 12) % 16) == 0)
+      {
+        /* line cut by a serial error */
+        len = sprintf(line, "%d;0;1\n", node);
+      }
+      else
+      {
+        len = sprintf(line, "133;%d;1;0;48;%s\n", 40 + (int)((r >> 12) % 8), telemetry);
+      }
+      break;
+    }
+    log.insert(log.end(), line, line + len);
+  }
+}
+
+/**
+ * Runs a parser and prints its throughput.
+ */
+static bench_result_t bench(const char * name, void (*parser)(const char *, size_t, bench_result_t *),
+    const char * data, size_t len)
+{
+  bench_result_t result;
+
+  memset(&result, 0, sizeof(result));
+  const uint64_t start = time_ns();
+  parser(data, len, &result);
+  const uint64_t elapsed = time_ns() - start;
+
+  printf("%-8s %8.1f MB/s %7.2f Mlines/s  (%llu lines, %llu invalid, %llu numbers)\n", name,
+      (double)len * 1000.0 / elapsed, (double)(result.lines + result.invalid) * 1000.0 / elapsed,
+      (unsigned long long)result.lines, (unsigned long long)result.invalid, (unsigned long long)result.numbers);
+
+  return result;
+}
+
+/**
+ * Benchmarks all parsers on a log.
+ *
+ * @return 0 if all parsers give identical results.
+ */
+static int32_t bench_log(const char * data, size_t len)
+{
+  const bench_result_t reference = bench("strtod", bench_strtod, data, len);
+  const bench_result_t line = bench("memchr", bench_memchr, data, len);
+  const bench_result_t scan = bench("scan", bench_scan, data, len);
+  int32_t retval = 0;
+
+  if ((memcmp(&reference, &line, sizeof(reference)) != 0) || (memcmp(&reference, &scan, sizeof(reference)) != 0))
+  {
+    printf("results differ\n");
+    retval = 1;
+  }
+
+  return retval;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  int32_t retval = 0;
+  int i;
+
+#if defined(MYSENSORS_LINE_SSE2)
+  printf("scan: SSE2\n");
+#elif defined(MYSENSORS_LINE_NEON)
+  printf("scan: NEON\n");
+#else
+  printf("scan: scalar\n");
+#endif
+
+  for (i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-g") == 0) && (i + 1 < argc))
+    {
+      std::vector<char> log;
+      bench_generate(log, (size_t)strtoul(argv[++i], NULL, 0) << 20);
+      printf("synthetic log: %zu MB\n", log.size() >> 20);
+      retval |= bench_log(log.data(), log.size());
+      continue;
+    }
+
+    struct stat st;
+    const int fd = open(argv[i], O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      retval = 1;
+      continue;
+    }
+    const char * data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      fprintf(stderr, "%s: cannot map\n", argv[i]);
+      close(fd);
+      retval = 1;
+      continue;
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+    printf("%s: %lld MB\n", argv[i], (long long)(st.st_size >> 20));
+    retval |= bench_log(data, st.st_size);
+    munmap((void *)data, st.st_size);
+    close(fd);
+  }
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s [-g size_mb] [serial.log]...\n", argv[0]);
+    retval = 2;
+  }
+
+  return retval;
+}
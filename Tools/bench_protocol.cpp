@@ -0,0 +1,202 @@
+/**
+ * @file bench_protocol.cpp
+ *
+ * @brief Host benchmark of the LaCrosse decoder: hand-written
+ * LACROSSE_input_handler() versus the decoder generated from the protocol
+ * description (ook_protocol.h).
+ *
+ * Build and run on the host:
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -IInc -ITools Tools/bench_protocol.cpp -o bench_protocol
+ *   ./bench_protocol [bursts]
+ *
+ * Code size of both decoders (host, -Os):
+ *   g++ -std=c++14 -Os -c -DLACROSSE_HOST -IInc -ITools Tools/bench_protocol.cpp -o bench_protocol.o
+ *   nm -C -S --size-sort bench_protocol.o | grep -E "input_handler|flush"
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+/* static decoders are benchmarked directly */
+#include "../Src/lacrosse.cpp"
+#include "ook_protocol.h"
+#include "pulse_train.h"
+
+
+/**
+ * Verification of a 40-bit word (payload + checksum) for the protocol description.
+ * 
+ * @param word received 40-bit word.
+ * 
+ * @return error code (0 when no error).
+ */
+static int32_t word_verify(uint64_t word)
+{
+  return checksum_verify(word >> 8, word & 0xFF);
+}
+
+/**
+ * LaCrosse protocol description (see ook_protocol.h) with the nominal windows.
+ * 
+ * @details Same format as @ref LACROSSE_input_handler() without calibration: 
+ * 3 start bits, a first '1' bit after the start bits, 39 bits coded by 
+ * transitions, a trailing pulse.
+ */
+static constexpr ook_protocol_t lacrosse_protocol = {
+    { RADIO_DURATION_2_LOW, RADIO_DURATION_2_HIGH }, 3,
+    {
+        { { RADIO_DURATION_21_LOW, RADIO_DURATION_21_HIGH }, OOK_PREV_START, 1 },
+        { { RADIO_DURATION_10_LOW, RADIO_DURATION_10_HIGH }, OOK_PREV_1, 0 },
+        { { RADIO_DURATION_00_LOW, RADIO_DURATION_00_HIGH }, OOK_PREV_0, 0 },
+        { { RADIO_DURATION_11_LOW, RADIO_DURATION_11_HIGH }, OOK_PREV_1, 1 },
+        { { RADIO_DURATION_01_LOW, RADIO_DURATION_01_HIGH }, OOK_PREV_0, 1 }
+    }, 5,
+    40, OOK_TRAILER_CONSUME, word_verify
+};
+
+/* decoder generated from the protocol description */
+static ook_decoder<lacrosse_protocol> lacrosse_decoder;
+
+/**
+ * Same as @ref LACROSSE_input_handler() with the generated decoder.
+ * 
+ * @param duration_usec pulse duration un microsec.
+ * 
+ * @return 32-bit payload if ok, otherwise 0xFFFFFFFF.
+ */
+static uint32_t protocol_input_handler(uint32_t duration_usec)
+{
+  uint64_t word;
+  return (lacrosse_decoder.input(duration_usec, &word) == 0) ? (uint32_t)(word >> 8) : 0xFFFFFFFFu;
+}
+
+/**
+ * Same as @ref LACROSSE_flush() with the generated decoder.
+ * 
+ * @return 32-bit payload if ok, otherwise 0xFFFFFFFF.
+ */
+static uint32_t protocol_flush(void)
+{
+  uint64_t word;
+  return (lacrosse_decoder.flush(&word) == 0) ? (uint32_t)(word >> 8) : 0xFFFFFFFFu;
+}
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Feeds the durations to a decoder.
+ *
+ * @param name decoder name.
+ * @param input pulse handler.
+ * @param flush end of burst handler (called on long gaps).
+ * @param durations pulse durations.
+ *
+ * @return number of decoded frames.
+ */
+static uint32_t bench(const char * name, uint32_t (*input)(uint32_t), uint32_t (*flush)(void),
+    const std::vector<uint32_t> & durations)
+{
+  uint32_t frames = 0;
+  size_t i;
+
+  const uint64_t start = time_ns();
+  for (i = 0; i < durations.size(); i++)
+  {
+    const uint32_t duration = durations[i];
+    const uint32_t value = (duration != 0) ? input(duration) : flush();
+    frames += (value != 0xFFFFFFFFu) ? 1 : 0;
+  }
+  const uint64_t stop = time_ns();
+
+  printf("%-12s %10u pulses %8u frames %8.3f ns/pulse\n", name, (unsigned)durations.size(),
+      (unsigned)frames, (double)(stop - start) / durations.size());
+
+  return frames;
+}
+
+/**
+ * Checks that both decoders give identical results pulse by pulse (nominal windows).
+ *
+ * @param durations pulse durations.
+ *
+ * @return number of differences.
+ */
+static uint32_t compare(const std::vector<uint32_t> & durations)
+{
+  uint32_t errors = 0;
+  size_t i;
+
+  for (i = 0; i < durations.size(); i++)
+  {
+    const uint32_t duration = durations[i];
+    const uint32_t value = (duration != 0) ? LACROSSE_input_handler(duration) : LACROSSE_flush();
+    const uint32_t value_protocol = (duration != 0) ? protocol_input_handler(duration) : protocol_flush();
+
+    errors += (value != value_protocol) ? 1 : 0;
+    if (value != 0xFFFFFFFFu)
+    {
+      /* keep the hand-written decoder on nominal windows */
+      LACROSSE_calib_reset();
+    }
+  }
+
+  return errors;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  const uint32_t bursts = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000u;
+  std::vector<uint32_t> durations;
+  pulse_random_t random = { 0x12345678u };
+  uint32_t i, k;
+
+  /* bursts separated by random noise, 0 is a flush */
+  for (i = 0; i < bursts; i++)
+  {
+    pulse_train_lacrosse(durations, 0xAA, pulse_random(&random) & 0xFFFFFF, 10000);
+    durations.push_back(0);
+    for (k = 0; k < 64; k++)
+    {
+      durations.push_back(400 + (pulse_random(&random) % 2000));
+    }
+  }
+
+  const uint32_t errors = compare(durations);
+  printf("identical results: %s\n", (errors == 0) ? "yes" : "no");
+
+  LACROSSE_calib_reset();
+  bench("hand-written", LACROSSE_input_handler, LACROSSE_flush, durations);
+  bench("protocol", protocol_input_handler, protocol_flush, durations);
+
+  return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+/**
+ * @file capture_check.cpp
+ *
+ * @brief Host check of the capture record codec (capture.h): random records
+ * of all the channels are encoded with CAPTURE_Encode() and decoded back
+ * with CAPTURE_Decode(), with and without timestamps. The durations above
+ * CAPTURE_DURATION_MAX must come back clamped, a truncated record must be
+ * reported incomplete without changing the decoder state, and the varints
+ * longer than 32 bits must be rejected.
+ *
+ * Build and run on the host:
+ *   gcc -std=c99 -O2 -IInc -c Src/capture.c
+ *   g++ -std=c++14 -O2 -IInc Tools/capture_check.cpp capture.o -o capture_check
+ *   ./capture_check [-n records] [-s seed]
+ *     -n  records per pass (default 100000)
+ *     -s  random seed (default 1)
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "capture.h"
+
+
+/**
+ * Random generator state (xorshift32).
+ */
+typedef struct
+{
+  uint32_t state; /*!< non-zero state */
+} check_random_t;
+
+
+/**
+ * @return next 32-bit random value.
+ */
+static uint32_t check_random(check_random_t * random)
+{
+  uint32_t x = random->state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random->state = x;
+  return x;
+}
+
+/**
+ * Generates a record: short and long durations of the pulse channels (some
+ * above CAPTURE_DURATION_MAX), or an event.
+ *
+ * @param random random generator.
+ *
+ * @return record.
+ */
+static CAPTURE_record_t record_generate(check_random_t * random)
+{
+  CAPTURE_record_t record;
+  const uint32_t r = check_random(random);
+
+  record.channel = ((r & 7) == 0) ? CAPTURE_CHANNEL_EVENT : (int32_t)((r >> 3) & 1);
+  record.argument = 0;
+  record.timestamp = check_random(random);
+  if (record.channel == CAPTURE_CHANNEL_EVENT)
+  {
+    /* the event takes the 30 high bits of the first varint */
+    record.value = check_random(random) >> 2;
+    record.argument = check_random(random);
+  }
+  else if (((r >> 4) & 15) == 0)
+  {
+    record.value = check_random(random);
+  }
+  else
+  {
+    record.value = check_random(random) & 0xFFFF;
+  }
+
+  return record;
+}
+
+/**
+ * Compares a decoded record with the encoded one.
+ *
+ * @param sent encoded record.
+ * @param received decoded record.
+ * @param flags header flags of the codec.
+ *
+ * @return 1 if they differ, otherwise 0.
+ */
+static uint32_t record_differ(const CAPTURE_record_t * sent, const CAPTURE_record_t * received, uint8_t flags)
+{
+  uint32_t value = sent->value;
+
+  if ((sent->channel != CAPTURE_CHANNEL_EVENT) && (value > CAPTURE_DURATION_MAX))
+  {
+    value = CAPTURE_DURATION_MAX;
+  }
+
+  return ((received->channel != sent->channel) || (received->value != value) ||
+      (received->argument != sent->argument) ||
+      (((flags & CAPTURE_FLAG_TIMESTAMPS) != 0) && (received->timestamp != sent->timestamp))) ? 1 : 0;
+}
+
+/**
+ * Compares two decoder states.
+ *
+ * @return 1 if they differ, otherwise 0.
+ */
+static uint32_t codec_differ(const CAPTURE_codec_t * a, const CAPTURE_codec_t * b)
+{
+  return ((memcmp(a->previous, b->previous, sizeof(a->previous)) != 0) || (a->timestamp != b->timestamp)) ? 1 : 0;
+}
+
+/**
+ * Encodes random records and decodes them back, each record first from all
+ * its truncated prefixes (incomplete, decoder state not updated).
+ *
+ * @param records number of records.
+ * @param flags header flags of the codec.
+ * @param random random generator.
+ * @param clamped output number of clamped durations.
+ *
+ * @return number of errors.
+ */
+static uint32_t roundtrip_check(uint32_t records, uint8_t flags, check_random_t * random, uint32_t * clamped)
+{
+  std::vector<CAPTURE_record_t> sent;
+  std::vector<uint8_t> stream;
+  CAPTURE_codec_t encoder;
+  CAPTURE_codec_t decoder;
+  CAPTURE_record_t record;
+  uint8_t buffer[CAPTURE_RECORD_MAX];
+  uint32_t errors = 0;
+  uint32_t i;
+  size_t offset = 0;
+
+  CAPTURE_CodecInit(&encoder, flags);
+  for (i = 0; i < records; i++)
+  {
+    const CAPTURE_record_t generated = record_generate(random);
+    const int32_t size = CAPTURE_Encode(&encoder, buffer, &generated);
+
+    errors += ((size <= 0) || (size > CAPTURE_RECORD_MAX)) ? 1 : 0;
+    *clamped += ((generated.channel != CAPTURE_CHANNEL_EVENT) && (generated.value > CAPTURE_DURATION_MAX)) ? 1 : 0;
+    sent.push_back(generated);
+    stream.insert(stream.end(), buffer, buffer + size);
+  }
+
+  CAPTURE_CodecInit(&decoder, flags);
+  for (i = 0; (i < records) && (offset < stream.size()); i++)
+  {
+    const int32_t left = (int32_t)(stream.size() - offset);
+    const int32_t len = (left > CAPTURE_RECORD_MAX) ? CAPTURE_RECORD_MAX : left;
+    const CAPTURE_codec_t before = decoder;
+    CAPTURE_codec_t full = decoder;
+    const int32_t size = CAPTURE_Decode(&full, &stream[offset], len, &record);
+    int32_t k;
+
+    if (size <= 0)
+    {
+      errors++;
+      break;
+    }
+    for (k = 0; k < size; k++)
+    {
+      errors += (CAPTURE_Decode(&decoder, &stream[offset], k, &record) != 0) ? 1 : 0;
+      errors += codec_differ(&decoder, &before);
+    }
+    errors += (CAPTURE_Decode(&decoder, &stream[offset], len, &record) != size) ? 1 : 0;
+    errors += codec_differ(&decoder, &full);
+    errors += record_differ(&sent[i], &record, flags);
+    offset += (size_t)size;
+  }
+  errors += ((i != records) || (offset != stream.size())) ? 1 : 0;
+
+  return errors;
+}
+
+/**
+ * Checks the clamp at the limits of the delta encoding: the largest
+ * durations alternate with zero (largest deltas in both directions).
+ *
+ * @return number of errors.
+ */
+static uint32_t clamp_check(void)
+{
+  static const uint32_t values[] = { 0, CAPTURE_DURATION_MAX, 0, CAPTURE_DURATION_MAX + 1, 0, 0xFFFFFFFFu, 1,
+      0x80000000u, CAPTURE_DURATION_MAX - 1 };
+  CAPTURE_codec_t encoder;
+  CAPTURE_codec_t decoder;
+  CAPTURE_record_t sent = { CAPTURE_CHANNEL_RADIO, 0, 0, 0 };
+  CAPTURE_record_t received;
+  uint8_t buffer[CAPTURE_RECORD_MAX];
+  uint32_t errors = 0;
+  size_t i;
+
+  CAPTURE_CodecInit(&encoder, 0);
+  CAPTURE_CodecInit(&decoder, 0);
+  for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+  {
+    sent.value = values[i];
+    const int32_t size = CAPTURE_Encode(&encoder, buffer, &sent);
+    errors += (CAPTURE_Decode(&decoder, buffer, size, &received) != size) ? 1 : 0;
+    errors += record_differ(&sent, &received, 0);
+  }
+
+  return errors;
+}
+
+/**
+ * Checks the rejection of the varints longer than 32 bits, in the first
+ * field and in the timestamp of a record.
+ *
+ * @return number of errors.
+ */
+static uint32_t overlong_check(void)
+{
+  /* 5th byte with more than the 4 high bits of the value, or followed by a 6th one */
+  static const uint8_t overlong[][6] = {
+    { 0x80, 0x80, 0x80, 0x80, 0x10, 0x00 },
+    { 0xFC, 0xFF, 0xFF, 0xFF, 0x8F, 0x00 },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 },
+  };
+  /* largest 32-bit value: event 0x3FFFFFFF, argument 0 */
+  static const uint8_t longest[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00 };
+  CAPTURE_codec_t codec;
+  CAPTURE_record_t record;
+  uint8_t buffer[1 + sizeof(overlong[0])];
+  uint32_t errors = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof(overlong) / sizeof(overlong[0]); i++)
+  {
+    CAPTURE_CodecInit(&codec, 0);
+    errors += (CAPTURE_Decode(&codec, overlong[i], sizeof(overlong[i]), &record) != -1) ? 1 : 0;
+
+    /* radio duration 0, then the timestamp */
+    CAPTURE_CodecInit(&codec, CAPTURE_FLAG_TIMESTAMPS);
+    buffer[0] = CAPTURE_CHANNEL_RADIO;
+    memcpy(&buffer[1], overlong[i], sizeof(overlong[i]));
+    errors += (CAPTURE_Decode(&codec, buffer, sizeof(buffer), &record) != -1) ? 1 : 0;
+    errors += ((codec.previous[CAPTURE_CHANNEL_RADIO] != 0) || (codec.timestamp != 0)) ? 1 : 0;
+  }
+
+  CAPTURE_CodecInit(&codec, 0);
+  errors += (CAPTURE_Decode(&codec, longest, sizeof(longest), &record) != 6) ? 1 : 0;
+  errors += ((record.channel != CAPTURE_CHANNEL_EVENT) || (record.value != 0x3FFFFFFFu)) ? 1 : 0;
+
+  return errors;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  uint32_t records = 100000;
+  check_random_t random = { 1 };
+  uint32_t clamped = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      records = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      random.state = (uint32_t)strtoul(optarg, NULL, 0) | 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n records] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const uint32_t errors_plain = roundtrip_check(records, 0, &random, &clamped);
+  const uint32_t errors_time = roundtrip_check(records, CAPTURE_FLAG_TIMESTAMPS, &random, &clamped);
+  const uint32_t errors_clamp = clamp_check();
+  const uint32_t errors_overlong = overlong_check();
+  const uint32_t errors = errors_plain + errors_time + errors_clamp + errors_overlong;
+
+  printf("round trip     %u records, %u errors\n", (unsigned)records, (unsigned)errors_plain);
+  printf("timestamps     %u records, %u errors\n", (unsigned)records, (unsigned)errors_time);
+  printf("clamp          %u random durations, %u errors at the limits\n", (unsigned)clamped,
+      (unsigned)errors_clamp);
+  printf("overlong       %u errors\n", (unsigned)errors_overlong);
+  printf("result         %s\n", (errors == 0) ? "ok" : "FAILED");
+
+  return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file capture_replay.cpp
+ *
+ * @brief Host replay of pulse capture files (see capture.h) through the
+ * LaCrosse and DHT22 decoders of the firmware.
+ *
+ * Build on the host:
+ *   gcc -std=c99 -O2 -DDHT22_HOST -IInc -c Src/dht22.c Src/capture.c
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -DDHT22_HOST -IInc Tools/capture_replay.cpp \
+ *       Src/lacrosse.cpp dht22.o capture.o -o capture_replay
+ *
+ * Usage:
+ *   capture_replay [-q] file...
+ *     -q  do not print the decoded frames, only the summary
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "lacrosse.h"
+#include "dht22.h"
+
+/* DHT22 conversion buffer (same as the firmware) */
+#define REPLAY_DHT22_PULSE_MASK  63
+
+
+/**
+ * Replay statistics.
+ */
+typedef struct
+{
+  uint64_t records; /*!< decoded records */
+  uint64_t pulses; /*!< 433 MHz durations */
+  uint64_t dht22_pulses; /*!< DHT22 durations */
+  uint64_t dropped; /*!< durations dropped by the firmware */
+  uint64_t frames; /*!< LaCrosse frames */
+  uint64_t dht22_ok; /*!< DHT22 conversions */
+  uint64_t dht22_errors; /*!< DHT22 failed conversions */
+  uint64_t bytes; /*!< capture bytes */
+  int32_t errors; /*!< format errors */
+} replay_stats_t;
+
+/* print decoded frames */
+static int32_t replay_verbose = 1;
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Handles a LaCrosse decoder result.
+ */
+static void replay_lacrosse(uint32_t value, uint64_t offset, replay_stats_t * stats)
+{
+  if (value != 0xFFFFFFFFu)
+  {
+    stats->frames++;
+    if (replay_verbose)
+    {
+      printf("%10llu lacrosse sync 0x%02X temper %d hum %u (0x%08X)\n", (unsigned long long)offset,
+          (unsigned)((value >> 24) & 0xFF), (int)((value >> 8) & 0xFFF) - 500,
+          (unsigned)(value & 0xFF), (unsigned)value);
+    }
+  }
+}
+
+/**
+ * Analyses a DHT22 conversion.
+ */
+static void replay_dht22(const uint16_t * buffer, int32_t len, uint64_t offset, replay_stats_t * stats)
+{
+  uint32_t temper;
+  uint32_t rh;
+
+  if (len > 0)
+  {
+    if (DHT22_AnalyseData(buffer, len, &temper, &rh) == 0)
+    {
+      stats->dht22_ok++;
+      if (replay_verbose)
+      {
+        printf("%10llu dht22 temper %u rh %u\n", (unsigned long long)offset, (unsigned)temper, (unsigned)rh);
+      }
+    }
+    else
+    {
+      stats->dht22_errors++;
+    }
+  }
+}
+
+/**
+ * Replays a memory-mapped capture.
+ *
+ * @param data capture content.
+ * @param len capture size in bytes.
+ * @param stats statistics to update.
+ *
+ * @return 0 when no error.
+ */
+static int32_t replay(const uint8_t * data, int64_t len, replay_stats_t * stats)
+{
+  CAPTURE_header_t header;
+  CAPTURE_codec_t codec;
+  CAPTURE_record_t record;
+  uint16_t dht22_buffer[REPLAY_DHT22_PULSE_MASK + 1];
+  int32_t dht22_len = 0;
+  uint32_t radio_timestamp = 0;
+  int64_t offset;
+
+  offset = CAPTURE_HeaderRead(data, (len > CAPTURE_HEADER_SIZE) ? CAPTURE_HEADER_SIZE : (int32_t)len, &header);
+  if (offset < 0)
+  {
+    return -1;
+  }
+  CAPTURE_CodecInit(&codec, header.flags);
+
+  const uint32_t tick_ns = (header.tick_ns != 0) ? header.tick_ns : 1000;
+  const uint32_t idle_ticks = (uint32_t)((uint64_t)CAPTURE_IDLE_TIMEOUT_US * 1000 / tick_ns);
+
+  while (offset < len)
+  {
+    const int64_t left = len - offset;
+    const int32_t size = CAPTURE_Decode(&codec, &data[offset], (left > 64) ? 64 : (int32_t)left, &record);
+    if (size <= 0)
+    {
+      stats->errors++;
+      break;
+    }
+    offset += size;
+    stats->records++;
+
+    switch (record.channel)
+    {
+    case CAPTURE_CHANNEL_RADIO:
+      /* long gap: same as the firmware idle timeout */
+      if (((header.flags & CAPTURE_FLAG_TIMESTAMPS) != 0) &&
+          ((uint32_t)(record.timestamp - radio_timestamp) >= idle_ticks))
+      {
+        replay_lacrosse(LACROSSE_flush(), offset, stats);
+      }
+      radio_timestamp = record.timestamp;
+      /* durations are in microsec for the decoder */
+      replay_lacrosse(LACROSSE_input_handler((uint32_t)((uint64_t)record.value * tick_ns / 1000)), offset, stats);
+      stats->pulses++;
+      break;
+
+    case CAPTURE_CHANNEL_DHT22:
+      dht22_buffer[(dht22_len++) & REPLAY_DHT22_PULSE_MASK] =
+          (uint16_t)((record.value < 0xFFFF) ? record.value : 0xFFFF);
+      stats->dht22_pulses++;
+      break;
+
+    case CAPTURE_CHANNEL_EVENT:
+      if (record.value == CAPTURE_EVENT_IDLE)
+      {
+        replay_lacrosse(LACROSSE_flush(), offset, stats);
+      }
+      else if (record.value == CAPTURE_EVENT_DHT22_START)
+      {
+        replay_dht22(dht22_buffer, dht22_len, offset, stats);
+        dht22_len = 0;
+      }
+      else if (record.value == CAPTURE_EVENT_DROPPED)
+      {
+        stats->dropped += record.argument;
+      }
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  /* end of capture */
+  replay_lacrosse(LACROSSE_flush(), offset, stats);
+
+  return 0;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  replay_stats_t stats;
+  LACROSSE_stats_t lacrosse_stats;
+  uint64_t elapsed = 0;
+  int32_t retval = 0;
+  int i;
+
+  memset(&stats, 0, sizeof(stats));
+
+  for (i = 1; i < argc; i++)
+  {
+    struct stat st;
+    int fd;
+
+    if (strcmp(argv[i], "-q") == 0)
+    {
+      replay_verbose = 0;
+      continue;
+    }
+
+    fd = open(argv[i], O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      retval = 1;
+      continue;
+    }
+
+    const uint8_t * data = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      fprintf(stderr, "%s: cannot map\n", argv[i]);
+      close(fd);
+      retval = 1;
+      continue;
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    const uint64_t start = time_ns();
+    if (replay(data, st.st_size, &stats) != 0)
+    {
+      fprintf(stderr, "%s: not a capture file\n", argv[i]);
+      retval = 1;
+    }
+    elapsed += time_ns() - start;
+    stats.bytes += st.st_size;
+
+    munmap((void *)data, st.st_size);
+    close(fd);
+  }
+
+  LACROSSE_stats_get(&lacrosse_stats);
+
+  printf("records        %llu\n", (unsigned long long)stats.records);
+  printf("433 MHz pulses %llu (dropped by firmware %llu)\n", (unsigned long long)stats.pulses,
+      (unsigned long long)stats.dropped);
+  printf("lacrosse       %llu frames, %u CRC failures\n", (unsigned long long)stats.frames,
+      (unsigned)lacrosse_stats.crc_errors);
+  printf("dht22          %llu conversions, %llu failures (%llu pulses)\n", (unsigned long long)stats.dht22_ok,
+      (unsigned long long)stats.dht22_errors, (unsigned long long)stats.dht22_pulses);
+  printf("format errors  %d\n", (int)stats.errors);
+  if (elapsed > 0)
+  {
+    printf("throughput     %.1f Mpulses/s, %.1f MB/s\n",
+        (double)(stats.pulses + stats.dht22_pulses) * 1000.0 / elapsed, (double)stats.bytes * 1000.0 / elapsed);
+  }
+
+  return (stats.errors == 0) ? retval : 1;
+}
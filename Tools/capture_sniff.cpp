@@ -0,0 +1,319 @@
+/**
+ * @file capture_sniff.cpp
+ *
+ * @brief Host receiver of the firmware sniffer stream (see sniffer.h): reads
+ * the blocks from the serial port and writes a capture file for
+ * capture_replay.
+ *
+ * Build on the host:
+ *   gcc -std=c99 -O2 -IInc -c Src/capture.c
+ *   g++ -std=c++14 -O2 -IInc Tools/capture_sniff.cpp capture.o -o capture_sniff
+ *
+ * Usage:
+ *   capture_sniff [-b baudrate] [-t seconds] -o capture.dspc device
+ *     -b  baudrate of a serial device (default 115200)
+ *     -t  stop after this time (default: until Ctrl-C or end of file)
+ *     -o  output capture file
+ *   The device can also be a file of a recorded raw stream.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/time.h>
+
+#include "capture.h"
+
+/* firmware timer tick */
+#define SNIFF_TICK_NS  1000
+
+
+/**
+ * Stream statistics.
+ */
+typedef struct
+{
+  uint64_t bytes; /*!< received bytes */
+  uint64_t blocks; /*!< valid blocks */
+  uint64_t lost; /*!< blocks lost (sequence gaps) */
+  uint64_t crc_errors; /*!< blocks with a bad CRC */
+  uint64_t records; /*!< written records */
+  uint64_t dropped; /*!< durations dropped by the firmware */
+} sniff_stats_t;
+
+/* stop request (signal) */
+static volatile sig_atomic_t sniff_stop = 0;
+
+
+/**
+ * Signal handler.
+ */
+static void sniff_signal(int sig)
+{
+  (void)sig;
+  sniff_stop = 1;
+}
+
+/**
+ * Converts a baudrate to the termios constant.
+ *
+ * @return termios constant, B0 if not supported.
+ */
+static speed_t sniff_speed(long baudrate)
+{
+  switch (baudrate)
+  {
+  case 9600: return B9600;
+  case 19200: return B19200;
+  case 38400: return B38400;
+  case 57600: return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 921600: return B921600;
+  default: return B0;
+  }
+}
+
+/**
+ * Configures a serial device in raw mode (nothing is done for other files).
+ *
+ * @return 0 if ok.
+ */
+static int32_t sniff_configure(int fd, long baudrate)
+{
+  struct termios tio;
+  int32_t retval = 0;
+
+  if (isatty(fd))
+  {
+    const speed_t speed = sniff_speed(baudrate);
+
+    if ((speed == B0) || (tcgetattr(fd, &tio) != 0))
+    {
+      retval = -1;
+    }
+    else
+    {
+      cfmakeraw(&tio);
+      cfsetispeed(&tio, speed);
+      cfsetospeed(&tio, speed);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cc[VMIN] = 1;
+      tio.c_cc[VTIME] = 1;
+      retval = (tcsetattr(fd, TCSANOW, &tio) == 0) ? 0 : -1;
+      tcflush(fd, TCIFLUSH);
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Writes a record to the capture file.
+ */
+static void sniff_write(FILE * out, CAPTURE_codec_t * codec, const CAPTURE_record_t * record, sniff_stats_t * stats)
+{
+  uint8_t buffer[CAPTURE_RECORD_MAX];
+
+  fwrite(buffer, 1, CAPTURE_Encode(codec, buffer, record), out);
+  stats->records++;
+}
+
+/**
+ * Decodes a valid block and appends its records to the capture file.
+ *
+ * @param block block (header, payload and CRC).
+ * @param sequence expected sequence number (-1 for the first block), updated.
+ *
+ * @return void.
+ */
+static void sniff_block(const uint8_t * block, int32_t * sequence, FILE * out,
+    CAPTURE_codec_t * codec, sniff_stats_t * stats)
+{
+  CAPTURE_codec_t block_codec;
+  CAPTURE_record_t record;
+  const int32_t len = block[2];
+  int32_t offset = 0;
+
+  /* lost blocks: the decoders of the replay are flushed */
+  if ((*sequence >= 0) && (block[3] != (uint8_t)*sequence))
+  {
+    const CAPTURE_record_t idle = { CAPTURE_CHANNEL_EVENT, CAPTURE_EVENT_IDLE, 0, 0 };
+
+    stats->lost += (uint8_t)(block[3] - *sequence);
+    sniff_write(out, codec, &idle, stats);
+  }
+  *sequence = (uint8_t)(block[3] + 1);
+  stats->blocks++;
+
+  /* the delta encoding restarts in each block */
+  CAPTURE_CodecInit(&block_codec, 0);
+  while (offset < len)
+  {
+    const int32_t size = CAPTURE_Decode(&block_codec, &block[CAPTURE_BLOCK_HEADER_SIZE + offset], len - offset, &record);
+    if (size <= 0)
+    {
+      stats->crc_errors++;
+      break;
+    }
+    offset += size;
+
+    if ((record.channel == CAPTURE_CHANNEL_EVENT) && (record.value == CAPTURE_EVENT_DROPPED))
+    {
+      stats->dropped += record.argument;
+    }
+    sniff_write(out, codec, &record, stats);
+  }
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  const char * output = NULL;
+  long baudrate = 115200;
+  double timeout = 0.0;
+  sniff_stats_t stats;
+  CAPTURE_header_t header;
+  CAPTURE_codec_t codec;
+  uint8_t buffer[4096];
+  int32_t len = 0;
+  int32_t sequence = -1;
+  struct timeval now;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:t:o:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b': baudrate = strtol(optarg, NULL, 0); break;
+    case 't': timeout = strtod(optarg, NULL); break;
+    case 'o': output = optarg; break;
+    default: output = NULL; optind = argc + 1; break;
+    }
+  }
+  if ((output == NULL) || (optind != argc - 1))
+  {
+    fprintf(stderr, "usage: %s [-b baudrate] [-t seconds] -o capture.dspc device\n", argv[0]);
+    return 2;
+  }
+
+  const int fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+  if ((fd < 0) || (sniff_configure(fd, baudrate) != 0))
+  {
+    fprintf(stderr, "%s: cannot open or configure\n", argv[optind]);
+    return 1;
+  }
+  FILE * out = fopen(output, "wb");
+  if (out == NULL)
+  {
+    fprintf(stderr, "%s: cannot create\n", output);
+    return 1;
+  }
+
+  signal(SIGINT, sniff_signal);
+  signal(SIGTERM, sniff_signal);
+  if (timeout > 0.0)
+  {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value.tv_sec = (time_t)timeout;
+    timer.it_value.tv_usec = (suseconds_t)((timeout - (double)(time_t)timeout) * 1e6);
+    signal(SIGALRM, sniff_signal);
+    setitimer(ITIMER_REAL, &timer, NULL);
+  }
+
+  /* capture header */
+  gettimeofday(&now, NULL);
+  header.version = CAPTURE_VERSION;
+  header.flags = 0;
+  header.tick_ns = SNIFF_TICK_NS;
+  header.start_us = (uint64_t)now.tv_sec * 1000000u + now.tv_usec;
+  fwrite(buffer, 1, CAPTURE_HeaderWrite(buffer, &header), out);
+  CAPTURE_CodecInit(&codec, header.flags);
+  memset(&stats, 0, sizeof(stats));
+
+  while (sniff_stop == 0)
+  {
+    const ssize_t size = read(fd, &buffer[len], sizeof(buffer) - len);
+    int32_t offset = 0;
+
+    if (size <= 0)
+    {
+      break;
+    }
+    stats.bytes += size;
+    len += (int32_t)size;
+
+    /* all complete blocks of the buffer */
+    while ((len - offset) >= (CAPTURE_BLOCK_HEADER_SIZE + 1))
+    {
+      const uint8_t * block = &buffer[offset];
+      const int32_t payload = block[2];
+
+      /* synchronisation */
+      if ((block[0] != CAPTURE_BLOCK_SYNC_0) || (block[1] != CAPTURE_BLOCK_SYNC_1) ||
+          (payload > CAPTURE_BLOCK_PAYLOAD_MAX))
+      {
+        offset++;
+        continue;
+      }
+      if ((len - offset) < (CAPTURE_BLOCK_HEADER_SIZE + payload + 1))
+      {
+        break;
+      }
+
+      if (CAPTURE_Crc8(&block[2], CAPTURE_BLOCK_HEADER_SIZE - 2 + payload) == block[CAPTURE_BLOCK_HEADER_SIZE + payload])
+      {
+        sniff_block(block, &sequence, out, &codec, &stats);
+        offset += CAPTURE_BLOCK_HEADER_SIZE + payload + 1;
+      }
+      else
+      {
+        /* false sync or corrupted block: search the next sync */
+        stats.crc_errors++;
+        offset++;
+      }
+    }
+
+    memmove(buffer, &buffer[offset], len - offset);
+    len -= offset;
+  }
+
+  fclose(out);
+  close(fd);
+
+  fprintf(stderr, "received %llu bytes, %llu blocks (%llu lost, %llu CRC errors)\n",
+      (unsigned long long)stats.bytes, (unsigned long long)stats.blocks,
+      (unsigned long long)stats.lost, (unsigned long long)stats.crc_errors);
+  fprintf(stderr, "written  %llu records, %llu durations dropped by the firmware\n",
+      (unsigned long long)stats.records, (unsigned long long)stats.dropped);
+
+  return 0;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file channel_model.h
+ *
+ * @brief Host model of the 433 MHz channel between a LaCrosse transmitter
+ * and the receiver interrupt: transmitter clock drift, edge jitter, missed
+ * pulses, runt pulses, interferer bursts, the timer input filter and the
+ * glitch filter of HAL_TIM_IC_CaptureCallback() (glitch.h).
+ *
+ * @details The signal is a sorted list of high levels (rise and fall times in
+ * microsec). The receiver measures the durations between falling edges on
+ * the 32-bit microsec time base, exactly as the interrupt does.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef CHANNEL_MODEL_H
+#define CHANNEL_MODEL_H
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "pulse_train.h"
+#include "glitch.h"
+#include "capture.h"
+
+/* timer kernel clock for the input filter in MHz */
+#define CHANNEL_TIMER_CLOCK_MHZ  24.0
+
+/* idle timeout of the firmware to flush the decoders */
+#define CHANNEL_IDLE_USEC  ((double)CAPTURE_IDLE_TIMEOUT_US)
+
+
+/**
+ * High level of the signal.
+ */
+typedef struct
+{
+  double rise; /*!< rising edge in microsec */
+  double fall; /*!< falling edge in microsec */
+} channel_pulse_t;
+
+/**
+ * Channel impairments.
+ */
+typedef struct
+{
+  double jitter_usec; /*!< standard deviation of each edge in microsec */
+  double drift_ppm; /*!< transmitter clock error in ppm */
+  double drop_rate; /*!< probability that a pulse is missed */
+  double extra_rate; /*!< probability of a runt pulse after a pulse */
+  double interferer_hz; /*!< interferer bursts per second */
+  GLITCH_config_t glitch; /*!< receiver glitch suppression */
+} channel_config_t;
+
+/**
+ * Received duration.
+ */
+typedef struct
+{
+  uint32_t duration; /*!< duration in microsec, 0 for an idle flush */
+  uint32_t burst; /*!< index of the last transmitted burst */
+} channel_duration_t;
+
+
+/**
+ * @return uniform random value in [0, 1).
+ */
+static inline double channel_uniform(pulse_random_t * random)
+{
+  return (pulse_random(random) >> 8) * (1.0 / 16777216.0);
+}
+
+/**
+ * @return normal random value (mean 0, standard deviation 1, Irwin-Hall approximation).
+ */
+static inline double channel_normal(pulse_random_t * random)
+{
+  double sum = 0.0;
+  int32_t i;
+
+  for (i = 0; i < 12; i++)
+  {
+    sum += channel_uniform(random);
+  }
+
+  return sum - 6.0;
+}
+
+/**
+ * Appends the high levels of a whole LaCrosse burst (LACROSSE_output_send() timing).
+ *
+ * @param pulses output high levels.
+ * @param start start time in microsec.
+ * @param sync sync byte.
+ * @param data 24-bit data (not encrypted).
+ * @param drift_ppm transmitter clock error in ppm.
+ *
+ * @return end time of the burst in microsec.
+ */
+static inline double channel_lacrosse(std::vector<channel_pulse_t> & pulses, double start,
+    uint32_t sync, uint32_t data, double drift_ppm)
+{
+  LACROSSE_schedule_t schedule;
+  const double scale = 1.0 + drift_ppm * 1e-6;
+  double time = start;
+  int32_t level;
+  uint32_t duration;
+
+  LACROSSE_schedule_build(&schedule, sync, data);
+  while (LACROSSE_schedule_next(&schedule, &level, &duration) == 0)
+  {
+    if (level == 1)
+    {
+      pulses.push_back({ time, time + duration * scale });
+    }
+    time += duration * scale;
+  }
+
+  return time;
+}
+
+/**
+ * Appends an interferer burst (another OOK device with random timings).
+ *
+ * @return void.
+ */
+static inline void channel_interferer(std::vector<channel_pulse_t> & pulses, double start, pulse_random_t * random)
+{
+  const uint32_t number = 10 + (pulse_random(random) % 50);
+  double time = start;
+  uint32_t i;
+
+  for (i = 0; i < number; i++)
+  {
+    const double high = 100.0 + channel_uniform(random) * 1400.0;
+    const double low = 100.0 + channel_uniform(random) * 2900.0;
+
+    pulses.push_back({ time, time + high });
+    time += high + low;
+  }
+}
+
+/**
+ * Applies the impairments of the radio link to the transmitted signal.
+ *
+ * @param pulses high levels, sorted and merged on return.
+ * @param config impairments.
+ * @param end end time of the signal in microsec.
+ * @param random random generator.
+ *
+ * @return void.
+ */
+static inline void channel_impair(std::vector<channel_pulse_t> & pulses, const channel_config_t & config,
+    double end, pulse_random_t * random)
+{
+  std::vector<channel_pulse_t> output;
+  size_t i;
+
+  output.reserve(pulses.size() + pulses.size() / 8);
+
+  for (i = 0; i < pulses.size(); i++)
+  {
+    channel_pulse_t pulse = pulses[i];
+
+    /* missed pulse */
+    if ((config.drop_rate > 0.0) && (channel_uniform(random) < config.drop_rate))
+    {
+      continue;
+    }
+
+    /* edge jitter (a pulse keeps at least 1 microsec) */
+    if (config.jitter_usec > 0.0)
+    {
+      pulse.rise += channel_normal(random) * config.jitter_usec;
+      pulse.fall += channel_normal(random) * config.jitter_usec;
+      pulse.fall = std::max(pulse.fall, pulse.rise + 1.0);
+    }
+    output.push_back(pulse);
+
+    /* runt pulse of 20..300 microsec shortly after the pulse */
+    if ((config.extra_rate > 0.0) && (channel_uniform(random) < config.extra_rate))
+    {
+      const double rise = pulse.fall + 50.0 + channel_uniform(random) * 400.0;
+      output.push_back({ rise, rise + 20.0 + channel_uniform(random) * 280.0 });
+    }
+  }
+
+  /* interferer bursts (Poisson process) */
+  if (config.interferer_hz > 0.0)
+  {
+    double time = 0.0;
+    for (;;)
+    {
+      time += -log(1.0 - channel_uniform(random)) * 1e6 / config.interferer_hz;
+      if (time >= end)
+      {
+        break;
+      }
+      channel_interferer(output, time, random);
+    }
+  }
+
+  /* sort and merge overlapping levels (the receiver sees the OR of the transmitters) */
+  std::sort(output.begin(), output.end(),
+      [](const channel_pulse_t & a, const channel_pulse_t & b) { return a.rise < b.rise; });
+  pulses.clear();
+  for (i = 0; i < output.size(); i++)
+  {
+    if (!pulses.empty() && (output[i].rise <= pulses.back().fall))
+    {
+      pulses.back().fall = std::max(pulses.back().fall, output[i].fall);
+    }
+    else
+    {
+      pulses.push_back(output[i]);
+    }
+  }
+}
+
+/**
+ * Returns the shortest level kept by the timer input filter (ICxF).
+ *
+ * @param filter ICxF value (0 to 15).
+ *
+ * @return level duration in microsec (0 - no filter).
+ */
+static inline double channel_hw_filter_usec(uint32_t filter)
+{
+  /* sampling clock divider and number of samples (RM0041, TIMx_CCMR1 ICxF) */
+  static const uint8_t divider[16] = { 1, 1, 1, 1, 2, 2, 4, 4, 8, 8, 16, 16, 16, 32, 32, 32 };
+  static const uint8_t samples[16] = { 0, 2, 4, 8, 6, 8, 6, 8, 6, 8, 5, 6, 8, 5, 6, 8 };
+
+  filter &= 0xF;
+  return divider[filter] * samples[filter] / CHANNEL_TIMER_CLOCK_MHZ;
+}
+
+/**
+ * Removes the levels shorter than the timer input filter (high spikes and
+ * low notches).
+ *
+ * @param pulses high levels (sorted), filtered on return.
+ * @param filter ICxF value (0 to 15).
+ *
+ * @return void.
+ */
+static inline void channel_hw_filter(std::vector<channel_pulse_t> & pulses, uint32_t filter)
+{
+  const double width = channel_hw_filter_usec(filter);
+  std::vector<channel_pulse_t> output;
+  size_t i;
+
+  for (i = 0; (width > 0.0) && (i < pulses.size()); i++)
+  {
+    if ((pulses[i].fall - pulses[i].rise) < width)
+    {
+      continue;
+    }
+    if (!output.empty() && ((pulses[i].rise - output.back().fall) < width))
+    {
+      output.back().fall = pulses[i].fall;
+    }
+    else
+    {
+      output.push_back(pulses[i]);
+    }
+  }
+  if (width > 0.0)
+  {
+    pulses.swap(output);
+  }
+}
+
+/**
+ * Measures the durations between falling edges like the receiver interrupt
+ * (32-bit microsec time base, glitch suppression) and adds the idle flushes
+ * of the firmware.
+ *
+ * @param pulses received high levels (sorted, after the input filter).
+ * @param bursts start times of the transmitted bursts (sorted).
+ * @param glitch glitch suppression.
+ * @param durations output durations.
+ * @param state output glitch counters.
+ *
+ * @return void.
+ */
+static inline void channel_receive(const std::vector<channel_pulse_t> & pulses, const std::vector<double> & bursts,
+    const GLITCH_config_t & glitch, std::vector<channel_duration_t> & durations, GLITCH_state_t * state)
+{
+  double stored_last = 0.0;
+  uint32_t stored_burst = 0;
+  uint32_t burst = 0;
+  size_t i;
+
+  GLITCH_Init(state, 0);
+  for (i = 0; i < pulses.size(); i++)
+  {
+    const double fall = pulses[i].fall;
+    uint32_t value;
+
+    while (((burst + 1) < bursts.size()) && (bursts[burst + 1] <= fall))
+    {
+      burst++;
+    }
+
+    if (GLITCH_Edge(state, &glitch, (uint32_t)llround(fall), &value) != 0)
+    {
+      /* no pulse during the idle timeout: the firmware flushes the decoders */
+      if ((fall - stored_last) >= CHANNEL_IDLE_USEC)
+      {
+        durations.push_back({ 0, stored_burst });
+      }
+      durations.push_back({ value, burst });
+      stored_last = fall;
+      stored_burst = burst;
+    }
+  }
+  durations.push_back({ 0, burst });
+}
+
+#endif
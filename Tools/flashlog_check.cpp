@@ -0,0 +1,398 @@
+/**
+ * @file flashlog_check.cpp
+ *
+ * @brief Host check of the persistent reading log (flashlog.h) on a
+ * simulated flash: NOR semantics (erased half-words only are programmed),
+ * power cuts in the middle of a program or an erase, recovery scan at each
+ * reboot. Each record committed before a cut must be read back unchanged
+ * while it is in the log, at most one torn record or page is left per cut,
+ * and the erases must be spread evenly over the pages.
+ *
+ * Build and run on the host:
+ *   gcc -std=c99 -O2 -IInc -c Src/flashlog.c Src/capture.c
+ *   g++ -std=c++14 -O2 -IInc Tools/flashlog_check.cpp flashlog.o capture.o -o flashlog_check
+ *   ./flashlog_check [-c cycles] [-p pages] [-s seed]
+ *     -c  power cycles (default 2000)
+ *     -p  pages of the log area (default 16)
+ *     -s  random seed (default 1)
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "flashlog.h"
+
+/* flash operations of a power cycle at most (the cut happens before) */
+#define CHECK_OPERATIONS_MAX  2000
+
+/* channels of the generated readings */
+#define CHECK_CHANNELS  18
+
+
+/**
+ * Random generator state (xorshift32).
+ */
+typedef struct
+{
+  uint32_t state; /*!< non-zero state */
+} check_random_t;
+
+/**
+ * Simulated flash.
+ */
+typedef struct
+{
+  std::vector<uint8_t> memory; /*!< log area */
+  std::vector<uint32_t> erases; /*!< erases per page */
+  uint32_t operations; /*!< operations of the power cycle */
+  uint32_t cut; /*!< operation interrupted by the power cut */
+  uint32_t open_cuts; /*!< power cuts while a page is opened (erase or header) */
+  check_random_t random; /*!< state of the partial operations */
+} check_flash_t;
+
+static check_flash_t check_flash;
+
+
+/**
+ * @return next 32-bit random value.
+ */
+static uint32_t check_random(check_random_t * random)
+{
+  uint32_t x = random->state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random->state = x;
+  return x;
+}
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Programs a half-word: only erased bits are cleared, a partial program
+ * clears a random part of them at the power cut, nothing is done after.
+ */
+static int32_t check_program(uint32_t offset, uint16_t value)
+{
+  uint8_t * const data = &check_flash.memory[offset];
+  const uint16_t current = (uint16_t)(data[0] | (data[1] << 8));
+  uint16_t result = value;
+
+  if (check_flash.operations > check_flash.cut)
+  {
+    return -1;
+  }
+  if (check_flash.operations++ == check_flash.cut)
+  {
+    result = (uint16_t)(value | check_random(&check_flash.random));
+    check_flash.open_cuts += ((offset % FLASHLOG_PAGE_SIZE) < FLASHLOG_HEADER_SIZE) ? 1 : 0;
+  }
+  /* STM32F1: a half-word which is not erased is not programmed (except 0x0000) */
+  if ((current != 0xFFFF) && (value != 0x0000))
+  {
+    return -1;
+  }
+
+  data[0] = (uint8_t)result;
+  data[1] = (uint8_t)(result >> 8);
+
+  return (check_flash.operations > check_flash.cut) ? -1 : 0;
+}
+
+/**
+ * Erases a page: a partial erase sets the start or the end of the page to
+ * 0xFF at the power cut, nothing is done after.
+ */
+static int32_t check_erase(uint32_t offset)
+{
+  uint32_t start = 0;
+  uint32_t size = FLASHLOG_PAGE_SIZE;
+
+  if (check_flash.operations > check_flash.cut)
+  {
+    return -1;
+  }
+  if (check_flash.operations++ == check_flash.cut)
+  {
+    /* the start or the end of the page is erased */
+    const uint32_t random = check_random(&check_flash.random);
+    size = random % FLASHLOG_PAGE_SIZE;
+    start = ((random & 0x80000000u) != 0) ? (FLASHLOG_PAGE_SIZE - size) : 0;
+    check_flash.open_cuts++;
+  }
+  memset(&check_flash.memory[offset + start], 0xFF, size);
+  check_flash.erases[offset / FLASHLOG_PAGE_SIZE]++;
+
+  return (check_flash.operations > check_flash.cut) ? -1 : 0;
+}
+
+/**
+ * Compares the log with the records committed before the power cuts.
+ *
+ * @param committed committed records by sequence.
+ * @param torn torn records found in the log, new ones are added.
+ *
+ * @return number of errors.
+ */
+static uint32_t check_log(const std::map<uint32_t, FLASHLOG_record_t> & committed, std::set<uint32_t> & torn)
+{
+  FLASHLOG_stats_t stats;
+  FLASHLOG_record_t record;
+  uint32_t errors = 0;
+  uint32_t sequence;
+
+  FLASHLOG_StatsGet(&stats);
+  for (sequence = stats.first; sequence < stats.next; sequence++)
+  {
+    const auto expected = committed.find(sequence);
+    const int32_t status = FLASHLOG_Read(sequence, &record);
+
+    if (status == 0)
+    {
+      torn.insert(sequence);
+    }
+    if (expected != committed.end())
+    {
+      /* committed: present and unchanged */
+      if ((status != 1) || (record.channel != expected->second.channel) ||
+          (record.value != expected->second.value) || (record.time != expected->second.time))
+      {
+        printf("sequence %u: committed record lost (status %d)\n", (unsigned)sequence, (int)status);
+        errors++;
+      }
+    }
+    else if (status == 1)
+    {
+      /* interrupted by the cut: torn, or complete with the expected content */
+      if ((uint32_t)record.value != record.time)
+      {
+        printf("sequence %u: unexpected record\n", (unsigned)sequence);
+        errors++;
+      }
+    }
+  }
+
+  /* committed records below the first one have been erased by the rotation */
+  const auto last = committed.empty() ? committed.end() : std::prev(committed.end());
+  if ((last != committed.end()) && (last->first >= stats.next))
+  {
+    printf("sequence %u: after the end of the log (%u)\n", (unsigned)last->first, (unsigned)stats.next);
+    errors++;
+  }
+
+  return errors;
+}
+
+/**
+ * Appends and commits readings until the power cut (or CHECK_OPERATIONS_MAX
+ * flash operations without cut).
+ *
+ * @param random random state.
+ * @param reading next reading number (value and time of the record).
+ * @param committed output committed records by sequence.
+ * @param append_ns output time spent in FLASHLOG_Append().
+ *
+ * @return number of appends.
+ */
+static uint32_t check_cycle(check_random_t * random, uint32_t * reading,
+    std::map<uint32_t, FLASHLOG_record_t> & committed, uint64_t * append_ns)
+{
+  std::deque<FLASHLOG_record_t> staged;
+  FLASHLOG_stats_t before, after;
+  uint32_t appends = 0;
+
+  while ((check_flash.operations <= check_flash.cut) && (check_flash.operations < CHECK_OPERATIONS_MAX))
+  {
+    /* a few readings between two commit runs, value = time to check the torn records */
+    const uint32_t count = 1 + check_random(random) % 4;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+      const FLASHLOG_record_t record = { *reading % CHECK_CHANNELS, (int32_t)*reading, *reading };
+      const uint64_t start = time_ns();
+
+      FLASHLOG_Append(record.channel, record.value, record.time);
+      *append_ns += time_ns() - start;
+      staged.push_back(record);
+      if (staged.size() > FLASHLOG_STAGE_SIZE)
+      {
+        staged.pop_front();
+      }
+      (*reading)++;
+      appends++;
+    }
+
+    /* the Linux server acknowledges the staged readings from time to time */
+    if ((check_random(random) % 16) == 0)
+    {
+      FLASHLOG_Delivered();
+      staged.clear();
+    }
+
+    /* commit steps: a record is committed when its programs are all done */
+    FLASHLOG_StatsGet(&before);
+    while ((before.staged > 0) && (check_flash.operations <= check_flash.cut))
+    {
+      (void)FLASHLOG_Commit();
+      FLASHLOG_StatsGet(&after);
+      if (after.next == (before.next + 1))
+      {
+        if ((after.errors == before.errors) && (check_flash.operations <= check_flash.cut))
+        {
+          committed[before.next] = staged.front();
+        }
+        staged.pop_front();
+      }
+      before = after;
+    }
+  }
+
+  return appends;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  FLASHLOG_flash_t backend = { NULL, 16, check_program, check_erase };
+  std::map<uint32_t, FLASHLOG_record_t> committed;
+  check_random_t random = { 1 };
+  FLASHLOG_stats_t stats;
+  uint32_t cycles = 2000;
+  std::set<uint32_t> torn;
+  uint32_t errors = 0;
+  uint32_t torn_pages = 0;
+  uint32_t reading = 0;
+  uint64_t scan_ns = 0;
+  uint64_t append_ns = 0;
+  uint64_t appends = 0;
+  uint64_t records = 0;
+  uint32_t cycle;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:p:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      cycles = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      backend.pages = (int32_t)strtol(optarg, NULL, 0);
+      break;
+    case 's':
+      random.state = (uint32_t)strtoul(optarg, NULL, 0) | 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-c cycles] [-p pages] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (backend.pages < 2)
+  {
+    return 1;
+  }
+
+  /* blank flash */
+  check_flash.memory.assign((size_t)backend.pages * FLASHLOG_PAGE_SIZE, 0xFF);
+  check_flash.erases.assign((size_t)backend.pages, 0);
+  check_flash.open_cuts = 0;
+  check_flash.random.state = random.state ^ 0x5A5A5A5A;
+  backend.base = check_flash.memory.data();
+
+  for (cycle = 0; cycle <= cycles; cycle++)
+  {
+    const size_t torn_before = torn.size();
+
+    /* reboot: recovery scan, then the log is compared with the committed records */
+    check_flash.operations = 0;
+    check_flash.cut = 0xFFFFFFFFu;
+    const uint64_t start = time_ns();
+    records += (uint64_t)FLASHLOG_Init(&backend);
+    scan_ns += time_ns() - start;
+    FLASHLOG_StatsGet(&stats);
+    torn_pages += stats.torn;
+    errors += check_log(committed, torn);
+    committed.erase(committed.begin(), committed.lower_bound(stats.first));
+
+    /* at most one torn record or page per power cut */
+    if (((torn.size() - torn_before) + stats.torn) > 1)
+    {
+      printf("cycle %u: %u new torn records, %u torn pages\n", (unsigned)cycle,
+          (unsigned)(torn.size() - torn_before), (unsigned)stats.torn);
+      errors++;
+    }
+
+    /* appends and commits up to the power cut, every 4th cycle is shut down cleanly */
+    if (cycle < cycles)
+    {
+      check_flash.cut = ((cycle % 4) == 3) ? 0xFFFFFFFFu : (check_random(&random) % CHECK_OPERATIONS_MAX);
+      appends += check_cycle(&random, &reading, committed, &append_ns);
+    }
+  }
+
+  /* wear: erases per page (a page is erased again after a cut while it is opened) */
+  uint32_t erase_min = 0xFFFFFFFFu;
+  uint32_t erase_max = 0;
+  size_t page;
+  for (page = 0; page < check_flash.erases.size(); page++)
+  {
+    erase_min = (check_flash.erases[page] < erase_min) ? check_flash.erases[page] : erase_min;
+    erase_max = (check_flash.erases[page] > erase_max) ? check_flash.erases[page] : erase_max;
+  }
+  if ((erase_max - erase_min) > (check_flash.open_cuts + 1))
+  {
+    printf("uneven wear\n");
+    errors++;
+  }
+
+  FLASHLOG_StatsGet(&stats);
+  printf("cycles         %u (%u records per page, %d pages)\n", (unsigned)cycles,
+      (unsigned)FLASHLOG_RECORDS_PER_PAGE, (int)backend.pages);
+  printf("appends        %llu, last sequence %u\n", (unsigned long long)appends, (unsigned)stats.next);
+  printf("recovered      %llu records in total, %u torn records, %u torn pages\n",
+      (unsigned long long)records, (unsigned)torn.size(), (unsigned)torn_pages);
+  printf("erases/page    min %u max %u (%u cuts while a page is opened)\n", (unsigned)erase_min,
+      (unsigned)erase_max, (unsigned)check_flash.open_cuts);
+  printf("append         %.1f ns\n", (appends > 0) ? ((double)append_ns / appends) : 0.0);
+  printf("recovery scan  %.1f us\n", (double)scan_ns / 1000.0 / (cycles + 1));
+  printf("errors         %u\n", (unsigned)errors);
+
+  return (errors == 0) ? 0 : 1;
+}
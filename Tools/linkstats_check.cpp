@@ -0,0 +1,299 @@
+/**
+ * @file linkstats_check.cpp
+ *
+ * @brief Host check of the 433 MHz link quality statistics (linkstats.h):
+ * synthetic LaCrosse bursts with a pulse jitter go through
+ * LACROSSE_input_handler() and the link records of the decoder are given to
+ * the statistics as the firmware does. One repeat per sensor is corrupted
+ * (checksum error). The report of each sensor is checked against the
+ * transmitted bursts, then the freeing of the IDs silent during a report
+ * period is checked.
+ *
+ * Build and run on the host:
+ *   gcc -std=c99 -O2 -IInc -c Src/linkstats.c
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -IInc -ITools Tools/linkstats_check.cpp linkstats.o -o linkstats_check
+ *   ./linkstats_check [-n bursts] [-j jitter_usec] [-s seed]
+ *     -n  bursts per sensor (default 10)
+ *     -j  maximal pulse jitter in microsec (default 30)
+ *     -s  random seed (default 0x13579BDF)
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* checksum and nominal windows of the decoder */
+#include "../Src/lacrosse.cpp"
+#include "pulse_train.h"
+#include "linkstats.h"
+
+/* sensor IDs of the check (sync bytes, the first bit of a frame is '1') */
+#define CHECK_SENSOR_FIRST   0xA0
+#define CHECK_SENSOR_NUMBER  3
+
+/* interval between two bursts of a sensor in microsec */
+#define CHECK_INTERVAL_US  60000000u
+
+/* silence before a burst in microsec */
+#define CHECK_GAP_US  10000
+
+/* report line buffer (text of a MySensors message) */
+#define CHECK_LINE_MAX  97
+
+/* durations of a frame: start bits, first bit, 39 bits, trailing pulse */
+#define CHECK_FRAME_DURATIONS  44
+
+
+/**
+ * Corrupts the last bit of a repeat: its transition gets the class of the
+ * other bit value, so the word is complete with a wrong checksum.
+ *
+ * @param durations durations of a burst (without jitter).
+ * @param repeat repeat to corrupt.
+ * @param last_bit last bit of the transmitted word.
+ *
+ * @return void.
+ */
+static void repeat_corrupt(std::vector<uint32_t> & durations, uint32_t repeat, uint32_t last_bit)
+{
+  /* last duration of the repeat, after the gap and the scaling pulse */
+  const size_t index = 2 + (size_t)repeat * CHECK_FRAME_DURATIONS + CHECK_FRAME_DURATIONS - 2;
+  const uint32_t short_us = (RADIO_DURATION_10_LOW + RADIO_DURATION_10_HIGH) / 2;
+  const uint32_t medium_us = (RADIO_DURATION_00_LOW + RADIO_DURATION_00_HIGH) / 2;
+  const uint32_t long_us = (RADIO_DURATION_01_LOW + RADIO_DURATION_01_HIGH) / 2;
+
+  if (durations[index] == medium_us)
+  {
+    /* '0' after '0' becomes '1' after '0', '1' after '1' becomes '0' after '1' */
+    durations[index] = (last_bit == 0) ? long_us : short_us;
+  }
+  else
+  {
+    durations[index] = medium_us;
+  }
+}
+
+/**
+ * Gives the link record of a complete word to the statistics (same as the
+ * firmware).
+ *
+ * @param now time of the word in microsec.
+ *
+ * @return void.
+ */
+static void word_record(uint32_t now)
+{
+  LACROSSE_word_t word;
+
+  if (LACROSSE_word_get(&word) != 0)
+  {
+    if (word.valid != 0)
+    {
+      LINKSTATS_Frame(word.sync, now, word.jitter_mean, word.jitter_max);
+    }
+    else
+    {
+      LINKSTATS_CrcError(word.sync);
+    }
+  }
+}
+
+/**
+ * Checks the report of the sensors after the bursts.
+ *
+ * @param bursts bursts per sensor.
+ * @param jitter maximal pulse jitter in microsec.
+ * @param random random generator.
+ * @param now output time at the end in microsec.
+ *
+ * @return number of errors.
+ */
+static uint32_t report_check(uint32_t bursts, uint32_t jitter, pulse_random_t * random, uint32_t * now)
+{
+  std::vector<uint32_t> durations;
+  char text[CHECK_LINE_MAX];
+  uint32_t errors = 0;
+  uint32_t time = 0;
+  uint32_t i, s;
+  size_t k;
+  int32_t index;
+  int32_t lines = 0;
+
+  for (i = 0; i < bursts; i++)
+  {
+    for (s = 0; s < CHECK_SENSOR_NUMBER; s++)
+    {
+      const uint32_t sync = CHECK_SENSOR_FIRST + s;
+      const uint32_t data = pulse_random(random) & 0xFFFFFF;
+      const uint32_t payload = (sync << 24) | LACROSSE_encrypt_24bits(data);
+
+      durations.clear();
+      pulse_train_lacrosse(durations, sync, data, CHECK_GAP_US);
+      if (i == (bursts / 2))
+      {
+        repeat_corrupt(durations, s, checksum_calculate(payload) & 1);
+      }
+
+      /* sensors spread over the interval */
+      time = i * CHECK_INTERVAL_US + s * (CHECK_INTERVAL_US / CHECK_SENSOR_NUMBER);
+      for (k = 0; k < durations.size(); k++)
+      {
+        const uint32_t noise = (k == 0) ? 0 : ((pulse_random(random) % (2 * jitter + 1)));
+        const uint32_t duration = durations[k] + noise - jitter;
+
+        time += duration;
+        (void)LACROSSE_input_handler(duration);
+        word_record(time);
+      }
+      (void)LACROSSE_flush();
+      word_record(time);
+    }
+  }
+
+  /* one line per sensor: id,frames,crc_errors,crc_permille,bursts,repeats_percent,jitter_mean,jitter_max,... */
+  *now = time + CHECK_INTERVAL_US;
+  for (index = 0; index <= LINKSTATS_SENSOR_NUMBER; index++)
+  {
+    unsigned id, frames, crc_errors, crc_permille, burst_count, repeats, jitter_mean, jitter_max, interval, change;
+
+    if (LINKSTATS_Format(index, *now, text, sizeof(text)) == 0)
+    {
+      continue;
+    }
+    printf("report         %s\n", text);
+    if (sscanf(text, "%x,%u,%u,%u,%u,%u,%u,%u,%u,%u", &id, &frames, &crc_errors, &crc_permille, &burst_count,
+        &repeats, &jitter_mean, &jitter_max, &interval, &change) != 10)
+    {
+      errors++;
+      continue;
+    }
+    lines++;
+    errors += ((id < CHECK_SENSOR_FIRST) || (id >= (CHECK_SENSOR_FIRST + CHECK_SENSOR_NUMBER))) ? 1 : 0;
+    errors += (frames != (bursts * LACROSSE_REPEAT_NUMBER - 1)) ? 1 : 0;
+    errors += (crc_errors != 1) ? 1 : 0;
+    errors += (burst_count != bursts) ? 1 : 0;
+    errors += (repeats != ((bursts * LACROSSE_REPEAT_NUMBER - 1) * 100 / (bursts * LACROSSE_REPEAT_NUMBER))) ? 1 : 0;
+    errors += ((jitter_mean == 0) || (jitter_mean > jitter) || (jitter_max > 2 * jitter)) ? 1 : 0;
+    errors += ((bursts > 1) && ((interval < (CHECK_INTERVAL_US / 1000 - 100)) ||
+        (interval > (CHECK_INTERVAL_US / 1000 + 100)))) ? 1 : 0;
+  }
+  errors += (lines != CHECK_SENSOR_NUMBER) ? 1 : 0;
+
+  return errors;
+}
+
+/**
+ * Checks that the IDs silent during a report period are freed: the table is
+ * filled, a new ID is unknown while all the IDs are active, then takes the
+ * entry of a silent one.
+ *
+ * @param now time in microsec.
+ *
+ * @return number of errors.
+ */
+static uint32_t free_check(uint32_t now)
+{
+  char text[CHECK_LINE_MAX];
+  uint32_t errors = 0;
+  uint32_t id;
+  int32_t index;
+  int32_t lines = 0;
+
+  LINKSTATS_Reset();
+
+  /* period 1: table full, the new ID is unknown */
+  for (id = 0; id < LINKSTATS_SENSOR_NUMBER; id++)
+  {
+    LINKSTATS_Frame(0x40 + id, now, 10, 20);
+  }
+  LINKSTATS_Frame(0x80, now, 10, 20);
+  LINKSTATS_CrcError(0x80);
+  errors += (LINKSTATS_Format(LINKSTATS_SENSOR_NUMBER, now, text, sizeof(text)) == 0) ? 1 : 0;
+  LINKSTATS_Reset();
+
+  /* period 2: the first ID is silent, its entry is freed at the report */
+  for (id = 1; id < LINKSTATS_SENSOR_NUMBER; id++)
+  {
+    LINKSTATS_Frame(0x40 + id, now, 10, 20);
+  }
+  LINKSTATS_Reset();
+
+  /* period 3: the new ID is followed */
+  LINKSTATS_Frame(0x80, now, 10, 20);
+  for (index = 0; index < LINKSTATS_SENSOR_NUMBER; index++)
+  {
+    if ((LINKSTATS_Format(index, now, text, sizeof(text)) > 0) && (strtoul(text, NULL, 16) == 0x80))
+    {
+      lines++;
+    }
+  }
+  errors += (lines != 1) ? 1 : 0;
+
+  return errors;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  uint32_t bursts = 10;
+  uint32_t jitter = 30;
+  pulse_random_t random = { 0x13579BDFu };
+  uint32_t now = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:j:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      bursts = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'j':
+      jitter = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      random.state = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n bursts] [-j jitter_usec] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+  if ((random.state == 0) || (bursts == 0) || (jitter == 0) || (jitter > 90))
+  {
+    return 1;
+  }
+
+  LACROSSE_calib_reset();
+  LINKSTATS_Init(LACROSSE_REPEAT_NUMBER);
+
+  const uint32_t errors_report = report_check(bursts, jitter, &random, &now);
+  const uint32_t errors_free = free_check(now);
+
+  printf("report         %u sensors x %u bursts, %u errors\n", (unsigned)CHECK_SENSOR_NUMBER, (unsigned)bursts,
+      (unsigned)errors_report);
+  printf("freed entries  %u errors\n", (unsigned)errors_free);
+  printf("result         %s\n", ((errors_report + errors_free) == 0) ? "ok" : "FAILED");
+
+  return ((errors_report + errors_free) == 0) ? 0 : 1;
+}
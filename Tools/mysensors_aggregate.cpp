@@ -0,0 +1,676 @@
+/**
+ * @file mysensors_aggregate.cpp
+ *
+ * @brief Host aggregator of the MySensors streams of several receiver boards:
+ * one epoll event source per serial port, the lines merged into one output
+ * in arrival order, and the copies of a radio reading heard by several
+ * boards reduced to the best one.
+ *
+ * @details A radio reading is the group of lines that a board sends for a
+ * decoded frame (temperature, humidity, then the board clock, see
+ * radio_handler() in server.c). Every line waits the deduplication window in
+ * a queue. When a reading leaves the queue, the later copies of the window
+ * are merged into it: same node and same payload for each child/type both
+ * copies have (the board clock differs between boards and is not
+ * compared). The copy kept is the most complete one, then the one of the
+ * port with the lowest rate of invalid lines, then the first one.
+ * The other lines (local DHT22, telemetry) are passed through in order.
+ *
+ * Build on the host (Raspberry Pi):
+ *   g++ -std=c++14 -O2 -ITools Tools/mysensors_aggregate.cpp -o mysensors_aggregate
+ *
+ * Usage:
+ *   mysensors_aggregate [-b baudrate] [-w window_ms] [-r first:last] [-t] device...
+ *     -b  baudrate of the serial devices (default 115200)
+ *     -w  deduplication window (default 1000 ms), also the output delay
+ *     -r  radio nodes to deduplicate (default 103:107, see sensors_config.h)
+ *     -t  lines prefixed by the host time in seconds (series_store import format)
+ *   The merged lines are written to stdout, e.g. to feed mysensors_ingest:
+ *     mysensors_aggregate /dev/ttyUSB0 /dev/ttyUSB1 | socat - pty,raw,echo=0,link=/tmp/merged &
+ *     mysensors_ingest -t 0 -o readings.db /tmp/merged
+ *   The heartbeats and the replay requests of mysensors_ingest are not
+ *   forwarded to the boards (one replay sequence per board): their
+ *   persistent logs stay disarmed, so run it with -t 0.
+ *   Lost devices are reopened every second. SIGINT/SIGTERM flush the queue,
+ *   the statistics of each port are printed to stderr.
+ *
+ * Test without the boards, with pseudo-terminals standing in for the ports:
+ *   socat -d -d pty,raw,echo=0,link=/tmp/board0 pty,raw,echo=0,link=/tmp/serial0 &
+ *   socat -d -d pty,raw,echo=0,link=/tmp/board1 pty,raw,echo=0,link=/tmp/serial1 &
+ *   ./mysensors_aggregate /tmp/serial0 /tmp/serial1 &
+ *   printf '103;0;1;0;0;21.5\n103;1;1;0;1;55.0\n103;0;1;0;24;1000\n' > /tmp/board0
+ *   printf '103;0;1;0;0;21.5\n103;1;1;0;1;55.0\n103;0;1;0;24;7000\n' > /tmp/board1
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <deque>
+#include <string>
+
+#include "mysensors_line.h"
+#include "serial_port.h"
+
+/* receive buffer of a port (longest accepted line) */
+#define AGGREGATE_BUFFER_SIZE  4096
+
+/* serial ports at most */
+#define AGGREGATE_PORT_MAX  8
+
+/* lines of a radio reading at most, and their maximal spread */
+#define AGGREGATE_GROUP_LINES  4
+#define AGGREGATE_GROUP_MS     200
+
+/* board clock sent after a radio reading (MYSENSORS_TYPE_SET_VAR1), differs between boards */
+#define AGGREGATE_TYPE_CLOCK  24
+
+/* delay before reopening a lost serial device */
+#define AGGREGATE_REOPEN_MS  1000
+
+/* epoll tags (ports are tagged by their index) */
+#define AGGREGATE_TAG_TIMER   100
+#define AGGREGATE_TAG_REOPEN  101
+#define AGGREGATE_TAG_SIGNAL  102
+
+
+/**
+ * Port statistics.
+ */
+typedef struct
+{
+  uint64_t lines; /*!< valid lines */
+  uint64_t invalid; /*!< invalid or too long lines */
+  uint64_t readings; /*!< radio readings */
+  uint64_t kept; /*!< radio readings written (best copy) */
+  uint64_t duplicates; /*!< radio readings dropped as copies */
+  uint64_t reopens; /*!< device reopenings */
+} aggregate_stats_t;
+
+/**
+ * Serial port state.
+ */
+typedef struct
+{
+  const char * device; /*!< device path */
+  int fd; /*!< device fd, -1 when closed */
+  char buffer[AGGREGATE_BUFFER_SIZE]; /*!< partial line */
+  int32_t len; /*!< bytes in the buffer */
+  int32_t discard; /*!< rest of a too long line is skipped */
+  uint64_t group; /*!< sequence number of the open radio reading, 0 if none */
+  aggregate_stats_t stats; /*!< statistics */
+} aggregate_port_t;
+
+/**
+ * Queued lines: a radio reading or a passed through line.
+ */
+typedef struct
+{
+  uint64_t seq; /*!< sequence number */
+  int64_t arrival; /*!< arrival of the first line (monotonic millisec) */
+  int64_t time; /*!< arrival of the first line (millisec since epoch) */
+  int32_t port; /*!< receiving port */
+  int32_t node; /*!< node ID */
+  int32_t radio; /*!< radio reading (deduplicated) */
+  int32_t merged; /*!< copy merged into an earlier reading */
+  int32_t count; /*!< number of lines */
+  int32_t child[AGGREGATE_GROUP_LINES]; /*!< child of the lines */
+  int32_t type[AGGREGATE_GROUP_LINES]; /*!< type of the lines */
+  std::string lines[AGGREGATE_GROUP_LINES]; /*!< lines (with '\n') */
+} aggregate_entry_t;
+
+/**
+ * Aggregator state.
+ */
+typedef struct
+{
+  aggregate_port_t ports[AGGREGATE_PORT_MAX]; /*!< serial ports */
+  int32_t port_count; /*!< number of ports */
+  long baudrate; /*!< baudrate of the ports */
+  int64_t window_ms; /*!< deduplication window */
+  int32_t radio_first; /*!< first deduplicated node */
+  int32_t radio_last; /*!< last deduplicated node */
+  int32_t timestamps; /*!< output lines prefixed by the host time */
+  int epoll; /*!< epoll fd */
+  int timer; /*!< output timer fd */
+  int reopen; /*!< reopening timer fd */
+  uint64_t seq; /*!< last sequence number */
+  std::deque<aggregate_entry_t> queue; /*!< lines in arrival order */
+} aggregate_t;
+
+
+/**
+ * Returns a monotonic time in millisec.
+ */
+static int64_t time_monotonic_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Returns the wall-clock time in millisec since epoch.
+ */
+static int64_t time_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Arms a timer (one-shot).
+ *
+ * @param fd timer fd.
+ * @param at expiry (monotonic millisec), 0 to disarm.
+ *
+ * @return void.
+ */
+static void aggregate_timer(int fd, int64_t at)
+{
+  struct itimerspec spec;
+
+  memset(&spec, 0, sizeof(spec));
+  if (at > 0)
+  {
+    spec.it_value.tv_sec = at / 1000;
+    spec.it_value.tv_nsec = (long)(at % 1000) * 1000000;
+  }
+  timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/**
+ * Opens a serial port and adds it to epoll.
+ *
+ * @return 0 if ok.
+ */
+static int32_t aggregate_open(aggregate_t * aggregate, int32_t index)
+{
+  aggregate_port_t * port = &aggregate->ports[index];
+  struct epoll_event event;
+  int32_t retval = -1;
+
+  port->fd = serial_port_open(port->device, aggregate->baudrate);
+  if (port->fd >= 0)
+  {
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = (uint32_t)index;
+    retval = epoll_ctl(aggregate->epoll, EPOLL_CTL_ADD, port->fd, &event);
+  }
+
+  if ((retval != 0) && (port->fd >= 0))
+  {
+    close(port->fd);
+    port->fd = -1;
+  }
+  port->len = 0;
+  port->discard = 0;
+  port->group = 0;
+
+  return retval;
+}
+
+/**
+ * Closes a lost serial port and schedules its reopening.
+ *
+ * @return void.
+ */
+static void aggregate_close(aggregate_t * aggregate, int32_t index)
+{
+  aggregate_port_t * port = &aggregate->ports[index];
+
+  if (port->fd >= 0)
+  {
+    epoll_ctl(aggregate->epoll, EPOLL_CTL_DEL, port->fd, NULL);
+    close(port->fd);
+    port->fd = -1;
+  }
+  aggregate_timer(aggregate->reopen, time_monotonic_ms() + AGGREGATE_REOPEN_MS);
+}
+
+/**
+ * Returns a queued entry from its sequence number.
+ *
+ * @return entry, NULL if already written.
+ */
+static aggregate_entry_t * aggregate_entry(aggregate_t * aggregate, uint64_t seq)
+{
+  if ((seq == 0) || aggregate->queue.empty() || (seq < aggregate->queue.front().seq))
+  {
+    return NULL;
+  }
+
+  return &aggregate->queue[seq - aggregate->queue.front().seq];
+}
+
+/**
+ * Checks that two radio readings are copies of the same frame.
+ *
+ * @return 1 if copies, otherwise 0.
+ */
+static int32_t aggregate_same(const aggregate_entry_t * a, const aggregate_entry_t * b)
+{
+  int32_t common = 0;
+  int32_t i, k;
+
+  if (a->node != b->node)
+  {
+    return 0;
+  }
+  for (i = 0; i < a->count; i++)
+  {
+    for (k = 0; k < b->count; k++)
+    {
+      if ((a->child[i] == b->child[k]) && (a->type[i] == b->type[k]) && (a->type[i] != AGGREGATE_TYPE_CLOCK))
+      {
+        if (a->lines[i] != b->lines[k])
+        {
+          return 0;
+        }
+        common++;
+      }
+    }
+  }
+
+  return (common > 0) ? 1 : 0;
+}
+
+/**
+ * Compares the quality of two copies of a radio reading.
+ *
+ * @return 1 if the copy b is better than a, otherwise 0.
+ */
+static int32_t aggregate_better(const aggregate_t * aggregate, const aggregate_entry_t * a, const aggregate_entry_t * b)
+{
+  const aggregate_stats_t * stats_a = &aggregate->ports[a->port].stats;
+  const aggregate_stats_t * stats_b = &aggregate->ports[b->port].stats;
+
+  if (b->count != a->count)
+  {
+    return (b->count > a->count) ? 1 : 0;
+  }
+
+  /* invalid line rates of the ports: invalid_b / total_b < invalid_a / total_a */
+  return ((double)stats_b->invalid * (stats_a->lines + stats_a->invalid) <
+      (double)stats_a->invalid * (stats_b->lines + stats_b->invalid)) ? 1 : 0;
+}
+
+/**
+ * Writes the queued lines older than the window (all if flush), the later
+ * copies of a radio reading being merged into it.
+ *
+ * @return void.
+ */
+static void aggregate_output(aggregate_t * aggregate, int64_t now, int32_t flush)
+{
+  int32_t written = 0;
+  int32_t i;
+
+  while (!aggregate->queue.empty() && (flush || (aggregate->queue.front().arrival + aggregate->window_ms <= now)))
+  {
+    aggregate_entry_t * entry = &aggregate->queue.front();
+
+    if ((entry->merged == 0) && (entry->radio != 0))
+    {
+      for (auto it = aggregate->queue.begin() + 1;
+          (it != aggregate->queue.end()) && (it->arrival - entry->arrival < aggregate->window_ms); ++it)
+      {
+        if ((it->merged == 0) && (it->radio != 0) && aggregate_same(entry, &*it))
+        {
+          int32_t dropped = it->port;
+          if (aggregate_better(aggregate, entry, &*it))
+          {
+            /* the best copy is written at the place of the first one */
+            dropped = entry->port;
+            entry->port = it->port;
+            entry->count = it->count;
+            for (i = 0; i < it->count; i++)
+            {
+              entry->child[i] = it->child[i];
+              entry->type[i] = it->type[i];
+              entry->lines[i] = it->lines[i];
+            }
+          }
+          aggregate->ports[dropped].stats.duplicates++;
+          it->merged = 1;
+        }
+      }
+      aggregate->ports[entry->port].stats.kept++;
+    }
+
+    if (entry->merged == 0)
+    {
+      for (i = 0; i < entry->count; i++)
+      {
+        if (aggregate->timestamps)
+        {
+          printf("%lld.%03d ", (long long)(entry->time / 1000), (int)(entry->time % 1000));
+        }
+        fputs(entry->lines[i].c_str(), stdout);
+      }
+      written = 1;
+    }
+    aggregate->queue.pop_front();
+  }
+
+  if (written)
+  {
+    fflush(stdout);
+  }
+  aggregate_timer(aggregate->timer, aggregate->queue.empty() ? 0 :
+      (aggregate->queue.front().arrival + aggregate->window_ms));
+}
+
+/**
+ * Queues a valid line: added to the open radio reading of the port or
+ * queued alone.
+ *
+ * @return void.
+ */
+static void aggregate_line(aggregate_t * aggregate, int32_t index, const mysensors_line_t * line, int64_t now,
+    int64_t time)
+{
+  aggregate_port_t * port = &aggregate->ports[index];
+  aggregate_entry_t * group = aggregate_entry(aggregate, port->group);
+  const int32_t radio = ((line->node >= aggregate->radio_first) && (line->node <= aggregate->radio_last)) ? 1 : 0;
+  char text[MYSENSORS_LINE_ID_MAX + 64];
+  int32_t i;
+
+  if ((radio == 0) || (group == NULL) || (group->node != line->node) || (now - group->arrival >= AGGREGATE_GROUP_MS) ||
+      (group->count == AGGREGATE_GROUP_LINES))
+  {
+    group = NULL;
+  }
+  for (i = 0; (group != NULL) && (i < group->count); i++)
+  {
+    if ((group->child[i] == line->child) && (group->type[i] == line->type))
+    {
+      /* next frame of the sensor */
+      group = NULL;
+    }
+  }
+
+  if (group == NULL)
+  {
+    aggregate->queue.emplace_back();
+    group = &aggregate->queue.back();
+    group->seq = ++aggregate->seq;
+    group->arrival = now;
+    group->time = time;
+    group->port = index;
+    group->node = line->node;
+    group->radio = radio;
+    group->merged = 0;
+    group->count = 0;
+    port->group = radio ? group->seq : 0;
+    port->stats.readings += radio;
+  }
+
+  snprintf(text, sizeof(text), "%d;%d;%d;%d;%d;", (int)line->node, (int)line->child, (int)line->command,
+      (int)line->ack, (int)line->type);
+  group->child[group->count] = line->child;
+  group->type[group->count] = line->type;
+  group->lines[group->count].assign(text);
+  group->lines[group->count].append(line->payload, line->payload_len);
+  group->lines[group->count].push_back('\n');
+  group->count++;
+
+  /* the board clock ends a radio reading */
+  if (line->type == AGGREGATE_TYPE_CLOCK)
+  {
+    port->group = 0;
+  }
+}
+
+/**
+ * Parses the complete lines of the buffer of a port, the partial last one is kept.
+ *
+ * @return void.
+ */
+static void aggregate_lines(aggregate_t * aggregate, int32_t index)
+{
+  aggregate_port_t * port = &aggregate->ports[index];
+  const int64_t now = time_monotonic_ms();
+  const int64_t time = time_ms();
+  int32_t offset;
+
+  offset = (int32_t)mysensors_line_split(port->buffer, port->len,
+      [aggregate, port, index, now, time](const mysensors_line_t & line, int32_t valid)
+      {
+        if (port->discard != 0)
+        {
+          port->discard = 0;
+        }
+        else if (valid != 0)
+        {
+          port->stats.lines++;
+          aggregate_line(aggregate, index, &line, now, time);
+        }
+        else
+        {
+          port->stats.invalid++;
+        }
+      });
+
+  /* too long line: dropped up to its end */
+  if ((offset == 0) && (port->len == AGGREGATE_BUFFER_SIZE))
+  {
+    port->stats.invalid++;
+    port->discard = 1;
+    offset = port->len;
+  }
+
+  memmove(port->buffer, &port->buffer[offset], port->len - offset);
+  port->len -= offset;
+}
+
+/**
+ * Reads a serial port until it would block.
+ *
+ * @return 0 if ok, -1 if the device is lost.
+ */
+static int32_t aggregate_read(aggregate_t * aggregate, int32_t index)
+{
+  aggregate_port_t * port = &aggregate->ports[index];
+  int32_t retval = 0;
+
+  for (;;)
+  {
+    const ssize_t size = read(port->fd, &port->buffer[port->len], AGGREGATE_BUFFER_SIZE - port->len);
+
+    if (size > 0)
+    {
+      port->len += (int32_t)size;
+      aggregate_lines(aggregate, index);
+    }
+    else if ((size < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+    {
+      break;
+    }
+    else
+    {
+      /* end of file or I/O error (device unplugged, pty master closed) */
+      retval = -1;
+      break;
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  static aggregate_t aggregate;
+  struct epoll_event event;
+  sigset_t signals;
+  int running = 1;
+  int opt;
+  int32_t i;
+
+  aggregate.baudrate = 115200;
+  aggregate.window_ms = 1000;
+  aggregate.radio_first = 103;
+  aggregate.radio_last = 107;
+
+  while ((opt = getopt(argc, argv, "b:w:r:t")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b': aggregate.baudrate = strtol(optarg, NULL, 0); break;
+    case 'w': aggregate.window_ms = strtol(optarg, NULL, 0); break;
+    case 'r':
+      if (sscanf(optarg, "%d:%d", &aggregate.radio_first, &aggregate.radio_last) != 2)
+      {
+        fprintf(stderr, "-r expects first:last\n");
+        return 2;
+      }
+      break;
+    case 't': aggregate.timestamps = 1; break;
+    default:
+      return 2;
+    }
+  }
+  if ((optind == argc) || (argc - optind > AGGREGATE_PORT_MAX) || (aggregate.window_ms < 0) ||
+      (serial_port_speed(aggregate.baudrate) == B0))
+  {
+    fprintf(stderr, "usage: %s [-b baudrate] [-w window_ms] [-r first:last] [-t] device... (%d at most)\n",
+        argv[0], AGGREGATE_PORT_MAX);
+    return 2;
+  }
+
+  /* signals are read from a descriptor */
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+
+  aggregate.epoll = epoll_create1(EPOLL_CLOEXEC);
+  aggregate.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  aggregate.reopen = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  const int signal = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if ((aggregate.epoll < 0) || (aggregate.timer < 0) || (aggregate.reopen < 0) || (signal < 0))
+  {
+    perror("epoll");
+    return 1;
+  }
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = AGGREGATE_TAG_TIMER;
+  epoll_ctl(aggregate.epoll, EPOLL_CTL_ADD, aggregate.timer, &event);
+  event.data.u32 = AGGREGATE_TAG_REOPEN;
+  epoll_ctl(aggregate.epoll, EPOLL_CTL_ADD, aggregate.reopen, &event);
+  event.data.u32 = AGGREGATE_TAG_SIGNAL;
+  epoll_ctl(aggregate.epoll, EPOLL_CTL_ADD, signal, &event);
+
+  for (; optind < argc; optind++)
+  {
+    const int32_t index = aggregate.port_count++;
+    aggregate.ports[index].device = argv[optind];
+    if (aggregate_open(&aggregate, index) != 0)
+    {
+      fprintf(stderr, "%s: cannot open, retrying\n", argv[optind]);
+      aggregate_timer(aggregate.reopen, time_monotonic_ms() + AGGREGATE_REOPEN_MS);
+    }
+  }
+
+  while (running)
+  {
+    struct epoll_event events[AGGREGATE_PORT_MAX + 3];
+    const int number = epoll_wait(aggregate.epoll, events, AGGREGATE_PORT_MAX + 3, -1);
+    uint64_t expirations;
+
+    for (i = 0; (i < number) && running; i++)
+    {
+      const uint32_t tag = events[i].data.u32;
+
+      if (tag < (uint32_t)aggregate.port_count)
+      {
+        if ((aggregate.ports[tag].fd >= 0) && (aggregate_read(&aggregate, (int32_t)tag) != 0))
+        {
+          aggregate_close(&aggregate, (int32_t)tag);
+        }
+      }
+      else if (tag == AGGREGATE_TAG_TIMER)
+      {
+        if (read(aggregate.timer, &expirations, sizeof(expirations)) > 0)
+        {
+          aggregate_output(&aggregate, time_monotonic_ms(), 0);
+        }
+      }
+      else if (tag == AGGREGATE_TAG_REOPEN)
+      {
+        if (read(aggregate.reopen, &expirations, sizeof(expirations)) > 0)
+        {
+          int32_t closed = 0;
+          int32_t k;
+          for (k = 0; k < aggregate.port_count; k++)
+          {
+            if ((aggregate.ports[k].fd < 0) && (aggregate_open(&aggregate, k) == 0))
+            {
+              aggregate.ports[k].stats.reopens++;
+            }
+            closed |= (aggregate.ports[k].fd < 0) ? 1 : 0;
+          }
+          if (closed)
+          {
+            aggregate_timer(aggregate.reopen, time_monotonic_ms() + AGGREGATE_REOPEN_MS);
+          }
+        }
+      }
+      else if (tag == AGGREGATE_TAG_SIGNAL)
+      {
+        running = 0;
+      }
+    }
+
+    /* arms the output timer for the new lines */
+    if (running)
+    {
+      aggregate_output(&aggregate, time_monotonic_ms(), 0);
+    }
+  }
+
+  aggregate_output(&aggregate, time_monotonic_ms(), 1);
+
+  for (i = 0; i < aggregate.port_count; i++)
+  {
+    const aggregate_stats_t * stats = &aggregate.ports[i].stats;
+    fprintf(stderr, "%s: %llu lines (%llu invalid), %llu radio readings: %llu kept, %llu duplicates, "
+        "%llu reopenings\n", aggregate.ports[i].device, (unsigned long long)stats->lines,
+        (unsigned long long)stats->invalid, (unsigned long long)stats->readings, (unsigned long long)stats->kept,
+        (unsigned long long)stats->duplicates, (unsigned long long)stats->reopens);
+  }
+
+  return 0;
+}
@@ -0,0 +1,656 @@
+/**
+ * @file mysensors_ingest.cpp
+ *
+ * @brief Linux ingestion daemon of the MySensors serial stream of the
+ * firmware: epoll on a non-blocking serial port, lines parsed in place
+ * (mysensors_line.h) and readings written to SQLite in batched transactions.
+ * A heartbeat is sent to the board every minute, with the replay request of
+ * its persistent log of the readings sent while the daemon was away
+ * (flashlog.h): the replayed readings are stored with their original time.
+ *
+ * Build on the host (Raspberry Pi):
+ *   g++ -std=c++14 -O2 -IInc -ITools Tools/mysensors_ingest.cpp -lsqlite3 -o mysensors_ingest
+ *
+ * Usage:
+ *   mysensors_ingest [-b baudrate] [-f flush_ms] [-n rows] [-t heartbeat_s] -o database device
+ *     -b  baudrate of the serial device (default 115200)
+ *     -f  maximal time of the readings in memory before a commit (default 5000 ms)
+ *     -n  rows committed at once at most (default 1000)
+ *     -t  heartbeat and replay request period, 0 to disable (default 60 s)
+ *     -o  SQLite database (table mysensors is created if needed)
+ *   The serial device is reopened every second when it disappears (USB).
+ *   SIGINT/SIGTERM commit the pending readings before exiting.
+ *
+ * Test without the board, with a pseudo-terminal standing in for the serial port:
+ *   socat -d -d pty,raw,echo=0,link=/tmp/board pty,raw,echo=0,link=/tmp/serial &
+ *   ./mysensors_ingest -f 1000 -o test.db /tmp/serial &
+ *   printf '103;0;1;0;0;21.5\n103;1;1;0;1;55.0\n' > /tmp/board
+ *   sqlite3 test.db 'select * from mysensors'
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sqlite3.h>
+
+#include "mysensors_line.h"
+#include "serial_port.h"
+
+/* receive buffer (longest accepted line) */
+#define INGEST_BUFFER_SIZE  4096
+
+/* delay before reopening a lost serial device */
+#define INGEST_REOPEN_MS  1000
+
+/* epoll tags */
+#define INGEST_TAG_SERIAL     0
+#define INGEST_TAG_TIMER      1
+#define INGEST_TAG_SIGNAL     2
+#define INGEST_TAG_HEARTBEAT  3
+
+/* board node and child of the replayed records "r,sequence,time" (see server.c) */
+#define INGEST_BOARD_NODE      133
+#define INGEST_FLASHLOG_CHILD  37
+
+
+/**
+ * Daemon statistics.
+ */
+typedef struct
+{
+  uint64_t bytes; /*!< received bytes */
+  uint64_t lines; /*!< valid lines */
+  uint64_t invalid; /*!< invalid or too long lines */
+  uint64_t rows; /*!< committed rows */
+  uint64_t commits; /*!< committed transactions */
+  uint64_t reopens; /*!< serial device reopenings */
+  uint64_t replayed; /*!< replayed readings */
+} ingest_stats_t;
+
+/**
+ * Daemon state.
+ */
+typedef struct
+{
+  const char * device; /*!< serial device path */
+  long baudrate; /*!< serial baudrate */
+  int serial; /*!< serial fd, -1 when closed */
+  int epoll; /*!< epoll fd */
+  int timer; /*!< flush and reopen timer fd */
+  int heartbeat; /*!< heartbeat timer fd */
+  int32_t heartbeat_s; /*!< heartbeat period, 0 if disabled */
+  int32_t heartbeat_skip; /*!< periods left without time message after an open */
+  uint32_t replay_next; /*!< first record of the next replay request */
+  int64_t replay_time; /*!< time of the next replayed reading, -1 if none */
+  int64_t replay_last; /*!< time of the last replayed reading, -1 if none */
+  sqlite3 * db; /*!< database */
+  sqlite3_stmt * insert; /*!< prepared insert */
+  sqlite3_stmt * begin; /*!< prepared BEGIN */
+  sqlite3_stmt * commit; /*!< prepared COMMIT */
+  int32_t pending; /*!< rows of the open transaction */
+  int32_t batch_max; /*!< rows committed at once at most */
+  int32_t flush_ms; /*!< flush interval */
+  char buffer[INGEST_BUFFER_SIZE]; /*!< partial line */
+  int32_t len; /*!< bytes in the buffer */
+  int32_t discard; /*!< rest of a too long line is skipped */
+  ingest_stats_t stats; /*!< statistics */
+} ingest_t;
+
+
+/**
+ * Returns the wall-clock time in millisec since epoch.
+ */
+static int64_t time_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Arms the timer (one-shot).
+ *
+ * @param ms delay in millisec, 0 to disarm.
+ *
+ * @return void.
+ */
+static void ingest_timer(ingest_t * ingest, int32_t ms)
+{
+  struct itimerspec spec;
+
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = ms / 1000;
+  spec.it_value.tv_nsec = (long)(ms % 1000) * 1000000;
+  timerfd_settime(ingest->timer, 0, &spec, NULL);
+}
+
+/**
+ * Opens the serial device in raw non-blocking mode and adds it to epoll.
+ *
+ * @return 0 if ok.
+ */
+static int32_t ingest_open(ingest_t * ingest)
+{
+  struct epoll_event event;
+  int32_t retval = -1;
+
+  ingest->serial = serial_port_open(ingest->device, ingest->baudrate);
+  if (ingest->serial >= 0)
+  {
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = INGEST_TAG_SERIAL;
+    retval = epoll_ctl(ingest->epoll, EPOLL_CTL_ADD, ingest->serial, &event);
+  }
+
+  if ((retval != 0) && (ingest->serial >= 0))
+  {
+    close(ingest->serial);
+    ingest->serial = -1;
+  }
+  ingest->len = 0;
+  ingest->discard = 0;
+
+  /* the readings sent before the open are unknown: no acknowledge for a full period */
+  ingest->heartbeat_skip = 1;
+
+  return retval;
+}
+
+/**
+ * Closes the lost serial device and schedules its reopening.
+ *
+ * @return void.
+ */
+static void ingest_close(ingest_t * ingest)
+{
+  if (ingest->serial >= 0)
+  {
+    epoll_ctl(ingest->epoll, EPOLL_CTL_DEL, ingest->serial, NULL);
+    close(ingest->serial);
+    ingest->serial = -1;
+  }
+  ingest_timer(ingest, INGEST_REOPEN_MS);
+}
+
+/**
+ * Executes a prepared statement without result.
+ *
+ * @return 0 if ok.
+ */
+static int32_t ingest_step(ingest_t * ingest, sqlite3_stmt * stmt)
+{
+  const int rc = sqlite3_step(stmt);
+
+  sqlite3_reset(stmt);
+  if (rc != SQLITE_DONE)
+  {
+    fprintf(stderr, "sqlite: %s\n", sqlite3_errmsg(ingest->db));
+  }
+
+  return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
+/**
+ * Commits the open transaction.
+ *
+ * @return void.
+ */
+static void ingest_commit(ingest_t * ingest)
+{
+  if (ingest->pending > 0)
+  {
+    if (ingest_step(ingest, ingest->commit) == 0)
+    {
+      ingest->stats.rows += ingest->pending;
+      ingest->stats.commits++;
+    }
+    ingest->pending = 0;
+  }
+}
+
+/**
+ * Sends the heartbeat (time message) and the replay request of the
+ * persistent log of the board.
+ *
+ * @details The board takes a heartbeat one period after the previous one
+ * as the acknowledge of the readings sent in between. After an open (start,
+ * lost device) the daemon has not seen the readings of the last period: the
+ * time message is sent from the second period on, so that the board finds
+ * the heartbeat late and programs its staged readings (replayed later).
+ * The readings of the open transaction are committed before the time
+ * message: once acknowledged they are not kept by the board any more.
+ *
+ * @param ingest daemon state.
+ * @param periodic 1 when called by the heartbeat timer, 0 after an open.
+ *
+ * @return void.
+ */
+static void ingest_heartbeat(ingest_t * ingest, int32_t periodic)
+{
+  char text[96];
+  int len = 0;
+
+  if ((ingest->serial >= 0) && (ingest->heartbeat_s > 0))
+  {
+    if ((periodic != 0) && (ingest->heartbeat_skip == 0))
+    {
+      ingest_commit(ingest);
+      len = snprintf(text, sizeof(text), "%d;255;3;0;1;%lld\n", INGEST_BOARD_NODE, (long long)(time_ms() / 1000));
+    }
+    else if (periodic != 0)
+    {
+      ingest->heartbeat_skip--;
+    }
+    len += snprintf(&text[len], sizeof(text) - len, "%d;%d;2;0;24;%u\n", INGEST_BOARD_NODE, INGEST_FLASHLOG_CHILD,
+        (unsigned)ingest->replay_next);
+
+    /* a few bytes: lost if the output buffer is full, sent again on the next period */
+    if (write(ingest->serial, text, len) != len)
+    {
+      fprintf(stderr, "%s: heartbeat not sent\n", ingest->device);
+    }
+  }
+}
+
+/**
+ * Inserts a reading in the open transaction (the first one opens it and
+ * arms the flush timer).
+ *
+ * @param time time of the reading in millisec since epoch.
+ *
+ * @return void.
+ */
+static void ingest_insert(ingest_t * ingest, const mysensors_line_t * line, int64_t time)
+{
+  sqlite3_stmt * stmt = ingest->insert;
+
+  if (ingest->pending == 0)
+  {
+    if (ingest_step(ingest, ingest->begin) != 0)
+    {
+      return;
+    }
+    if (ingest->serial >= 0)
+    {
+      ingest_timer(ingest, ingest->flush_ms);
+    }
+  }
+
+  /* the payload is bound in place: it stays valid until the step */
+  sqlite3_bind_int64(stmt, 1, time);
+  sqlite3_bind_int(stmt, 2, line->node);
+  sqlite3_bind_int(stmt, 3, line->child);
+  sqlite3_bind_int(stmt, 4, line->command);
+  sqlite3_bind_int(stmt, 5, line->ack);
+  sqlite3_bind_int(stmt, 6, line->type);
+  sqlite3_bind_text(stmt, 7, line->payload, line->payload_len, SQLITE_STATIC);
+  if (ingest_step(ingest, stmt) == 0)
+  {
+    ingest->pending++;
+  }
+
+  if (ingest->pending >= ingest->batch_max)
+  {
+    ingest_commit(ingest);
+  }
+}
+
+/**
+ * Follows the replay of the persistent log of the board: a record line
+ * "r,sequence,time" gives the time of the next reading (time 0: unknown,
+ * the time of the previous replayed reading is used).
+ *
+ * @param line received line.
+ * @param now reception time in millisec since epoch.
+ *
+ * @return time of the reading in millisec since epoch.
+ */
+static int64_t ingest_replay(ingest_t * ingest, const mysensors_line_t * line, int64_t now)
+{
+  int64_t retval = now;
+  unsigned sequence;
+  long long time;
+  char text[64];
+
+  if ((line->node == INGEST_BOARD_NODE) && (line->child == INGEST_FLASHLOG_CHILD))
+  {
+    const int32_t len = (line->payload_len < (int32_t)sizeof(text)) ? line->payload_len : (int32_t)sizeof(text) - 1;
+
+    memcpy(text, line->payload, len);
+    text[len] = '\0';
+    if (sscanf(text, "r,%u,%lld", &sequence, &time) == 2)
+    {
+      ingest->replay_next = sequence + 1;
+      ingest->replay_time = (time != 0) ? (int64_t)time * 1000 : ((ingest->replay_last >= 0) ? ingest->replay_last : now);
+      ingest->replay_last = ingest->replay_time;
+    }
+  }
+  else if (ingest->replay_time >= 0)
+  {
+    retval = ingest->replay_time;
+    ingest->replay_time = -1;
+    ingest->stats.replayed++;
+  }
+
+  return retval;
+}
+
+/**
+ * Parses the complete lines of the buffer, the partial last one is kept.
+ *
+ * @return void.
+ */
+static void ingest_lines(ingest_t * ingest)
+{
+  const int64_t now = time_ms();
+  int32_t offset;
+
+  offset = (int32_t)mysensors_line_split(ingest->buffer, ingest->len,
+      [ingest, now](const mysensors_line_t & line, int32_t valid)
+      {
+        if (ingest->discard != 0)
+        {
+          ingest->discard = 0;
+        }
+        else if (valid != 0)
+        {
+          ingest->stats.lines++;
+          ingest_insert(ingest, &line, ingest_replay(ingest, &line, now));
+        }
+        else
+        {
+          ingest->stats.invalid++;
+        }
+      });
+
+  /* too long line: dropped up to its end */
+  if ((offset == 0) && (ingest->len == INGEST_BUFFER_SIZE))
+  {
+    ingest->stats.invalid++;
+    ingest->discard = 1;
+    offset = ingest->len;
+  }
+
+  memmove(ingest->buffer, &ingest->buffer[offset], ingest->len - offset);
+  ingest->len -= offset;
+}
+
+/**
+ * Reads the serial device until it would block.
+ *
+ * @return 0 if ok, -1 if the device is lost.
+ */
+static int32_t ingest_read(ingest_t * ingest)
+{
+  int32_t retval = 0;
+
+  for (;;)
+  {
+    const ssize_t size = read(ingest->serial, &ingest->buffer[ingest->len], INGEST_BUFFER_SIZE - ingest->len);
+
+    if (size > 0)
+    {
+      ingest->stats.bytes += size;
+      ingest->len += (int32_t)size;
+      ingest_lines(ingest);
+    }
+    else if ((size < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+    {
+      break;
+    }
+    else
+    {
+      /* end of file or I/O error (device unplugged, pty master closed) */
+      retval = -1;
+      break;
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Opens the database and prepares the statements.
+ *
+ * @return 0 if ok.
+ */
+static int32_t ingest_database(ingest_t * ingest, const char * path)
+{
+  static const char * const schema =
+      "PRAGMA journal_mode=WAL;"
+      "PRAGMA synchronous=NORMAL;"
+      "CREATE TABLE IF NOT EXISTS mysensors ("
+      "time INTEGER NOT NULL, node INTEGER NOT NULL, child INTEGER NOT NULL, "
+      "command INTEGER NOT NULL, ack INTEGER NOT NULL, type INTEGER NOT NULL, payload TEXT);";
+  int32_t retval = -1;
+
+  if ((sqlite3_open(path, &ingest->db) == SQLITE_OK) &&
+      (sqlite3_exec(ingest->db, schema, NULL, NULL, NULL) == SQLITE_OK) &&
+      (sqlite3_prepare_v2(ingest->db, "INSERT INTO mysensors VALUES (?, ?, ?, ?, ?, ?, ?)", -1,
+          &ingest->insert, NULL) == SQLITE_OK) &&
+      (sqlite3_prepare_v2(ingest->db, "BEGIN", -1, &ingest->begin, NULL) == SQLITE_OK) &&
+      (sqlite3_prepare_v2(ingest->db, "COMMIT", -1, &ingest->commit, NULL) == SQLITE_OK))
+  {
+    retval = 0;
+  }
+  else
+  {
+    fprintf(stderr, "%s: %s\n", path, sqlite3_errmsg(ingest->db));
+  }
+
+  return retval;
+}
+
+/**
+ * Finds the next record to request from the last replayed one in the database.
+ *
+ * @return void.
+ */
+static void ingest_replay_init(ingest_t * ingest)
+{
+  sqlite3_stmt * stmt = NULL;
+  unsigned sequence;
+
+  ingest->replay_next = 0;
+  ingest->replay_time = -1;
+  ingest->replay_last = -1;
+  if (sqlite3_prepare_v2(ingest->db, "SELECT payload FROM mysensors WHERE node = ? AND child = ? AND "
+      "payload LIKE 'r,%' ORDER BY rowid DESC LIMIT 1", -1, &stmt, NULL) == SQLITE_OK)
+  {
+    sqlite3_bind_int(stmt, 1, INGEST_BOARD_NODE);
+    sqlite3_bind_int(stmt, 2, INGEST_FLASHLOG_CHILD);
+    if ((sqlite3_step(stmt) == SQLITE_ROW) &&
+        (sscanf((const char *)sqlite3_column_text(stmt, 0), "r,%u", &sequence) == 1))
+    {
+      ingest->replay_next = sequence + 1;
+    }
+  }
+  sqlite3_finalize(stmt);
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  static ingest_t ingest;
+  const char * output = NULL;
+  struct epoll_event event;
+  sigset_t signals;
+  int running = 1;
+  int opt;
+
+  memset(&ingest, 0, sizeof(ingest));
+  ingest.baudrate = 115200;
+  ingest.flush_ms = 5000;
+  ingest.batch_max = 1000;
+  ingest.serial = -1;
+  ingest.heartbeat_s = 60;
+
+  while ((opt = getopt(argc, argv, "b:f:n:t:o:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b': ingest.baudrate = strtol(optarg, NULL, 0); break;
+    case 'f': ingest.flush_ms = (int32_t)strtol(optarg, NULL, 0); break;
+    case 'n': ingest.batch_max = (int32_t)strtol(optarg, NULL, 0); break;
+    case 't': ingest.heartbeat_s = (int32_t)strtol(optarg, NULL, 0); break;
+    case 'o': output = optarg; break;
+    default: output = NULL; optind = argc + 1; break;
+    }
+  }
+  if ((output == NULL) || (optind != argc - 1) || (ingest.flush_ms <= 0) || (ingest.batch_max <= 0) ||
+      (ingest.heartbeat_s < 0))
+  {
+    fprintf(stderr, "usage: %s [-b baudrate] [-f flush_ms] [-n rows] [-t heartbeat_s] -o database device\n", argv[0]);
+    return 2;
+  }
+  ingest.device = argv[optind];
+
+  if (ingest_database(&ingest, output) != 0)
+  {
+    return 1;
+  }
+  ingest_replay_init(&ingest);
+
+  /* signals are read from a descriptor: the commit is never interrupted */
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+
+  ingest.epoll = epoll_create1(EPOLL_CLOEXEC);
+  ingest.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  ingest.heartbeat = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  const int signal = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if ((ingest.epoll < 0) || (ingest.timer < 0) || (ingest.heartbeat < 0) || (signal < 0))
+  {
+    perror("epoll");
+    return 1;
+  }
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = INGEST_TAG_TIMER;
+  epoll_ctl(ingest.epoll, EPOLL_CTL_ADD, ingest.timer, &event);
+  event.data.u32 = INGEST_TAG_SIGNAL;
+  epoll_ctl(ingest.epoll, EPOLL_CTL_ADD, signal, &event);
+  event.data.u32 = INGEST_TAG_HEARTBEAT;
+  epoll_ctl(ingest.epoll, EPOLL_CTL_ADD, ingest.heartbeat, &event);
+  if (ingest.heartbeat_s > 0)
+  {
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = ingest.heartbeat_s;
+    spec.it_interval.tv_sec = ingest.heartbeat_s;
+    timerfd_settime(ingest.heartbeat, 0, &spec, NULL);
+  }
+
+  if (ingest_open(&ingest) != 0)
+  {
+    fprintf(stderr, "%s: cannot open, retrying\n", ingest.device);
+    ingest_timer(&ingest, INGEST_REOPEN_MS);
+  }
+  ingest_heartbeat(&ingest, 0);
+
+  while (running)
+  {
+    struct epoll_event events[4];
+    const int number = epoll_wait(ingest.epoll, events, 4, -1);
+    int i;
+
+    for (i = 0; (i < number) && running; i++)
+    {
+      switch (events[i].data.u32)
+      {
+      case INGEST_TAG_SERIAL:
+        if ((ingest.serial >= 0) && (ingest_read(&ingest) != 0))
+        {
+          /* keep the readings of the lost device */
+          ingest_commit(&ingest);
+          ingest_close(&ingest);
+        }
+        break;
+
+      case INGEST_TAG_TIMER:
+      {
+        uint64_t expirations;
+        if (read(ingest.timer, &expirations, sizeof(expirations)) > 0)
+        {
+          /* flush interval, or reopening delay of a lost device */
+          ingest_commit(&ingest);
+          if ((ingest.serial < 0) && (ingest_open(&ingest) == 0))
+          {
+            ingest.stats.reopens++;
+            ingest_heartbeat(&ingest, 0);
+          }
+          else if (ingest.serial < 0)
+          {
+            ingest_timer(&ingest, INGEST_REOPEN_MS);
+          }
+        }
+        break;
+      }
+
+      case INGEST_TAG_HEARTBEAT:
+      {
+        uint64_t expirations;
+        if (read(ingest.heartbeat, &expirations, sizeof(expirations)) > 0)
+        {
+          ingest_heartbeat(&ingest, 1);
+        }
+        break;
+      }
+
+      case INGEST_TAG_SIGNAL:
+        running = 0;
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+
+  ingest_commit(&ingest);
+  sqlite3_finalize(ingest.insert);
+  sqlite3_finalize(ingest.begin);
+  sqlite3_finalize(ingest.commit);
+  sqlite3_close(ingest.db);
+
+  fprintf(stderr, "received %llu bytes, %llu lines (%llu invalid)\n", (unsigned long long)ingest.stats.bytes,
+      (unsigned long long)ingest.stats.lines, (unsigned long long)ingest.stats.invalid);
+  fprintf(stderr, "written  %llu rows in %llu transactions, %llu reopenings\n", (unsigned long long)ingest.stats.rows,
+      (unsigned long long)ingest.stats.commits, (unsigned long long)ingest.stats.reopens);
+  fprintf(stderr, "replayed %llu readings of the board log\n", (unsigned long long)ingest.stats.replayed);
+
+  return 0;
+}
@@ -0,0 +1,320 @@
+/**
+ * @file oversample_check.cpp
+ *
+ * @brief Host check of the oversampling receiver (oversample.h): synthetic
+ * LaCrosse bursts with jitter and noise spikes are sampled into packed bit
+ * buffers, and the extracted durations are compared with the durations of
+ * the capture interrupt (falling edge timestamps through the glitch filter).
+ *
+ * Build and run on the host:
+ *   gcc -std=c99 -O2 -DOVERSAMPLE_HOST -IInc -c Src/oversample.c Src/glitch.c
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -DOVERSAMPLE_HOST -IInc -ITools Tools/oversample_check.cpp \
+ *       Src/lacrosse.cpp oversample.o glitch.o -o oversample_check
+ *   ./oversample_check [-n bursts] [-s spikes] [-p prescaler] [-c clock_mhz]
+ *     -n  bursts (default 200)
+ *     -s  noise spikes per burst (default 8)
+ *     -p  sample period numerator, SPI prescaler (default 256)
+ *     -c  sample period denominator, SPI clock in MHz (default 24)
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "lacrosse.h"
+#include "glitch.h"
+#include "oversample.h"
+#include "pulse_train.h"
+
+/* half of the DMA buffer of the firmware in 16-bit words */
+#define CHECK_BLOCK_WORDS  256
+
+/* pulse jitter of the transmitter in microsec (+/-) */
+#define CHECK_JITTER_US  20
+
+/* noise spikes: width in microsec, distance of their interval from the runt threshold */
+#define CHECK_SPIKE_MIN_US     22
+#define CHECK_SPIKE_MAX_US     60
+#define CHECK_SPIKE_MARGIN_US  50
+
+
+/**
+ * Level of the data pin.
+ */
+typedef struct
+{
+  uint32_t level; /*!< 1 - high, 0 - low */
+  uint32_t duration; /*!< duration in microsec */
+} check_level_t;
+
+/* glitch filter of the extracted edges and their durations */
+static const GLITCH_config_t check_glitch_config = { GLITCH_HW_FILTER_DEFAULT, GLITCH_MERGE_TICKS_DEFAULT,
+                                                     GLITCH_MODE_MERGE };
+static GLITCH_state_t check_glitch;
+static std::vector<uint32_t> check_durations;
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Falling edge handler: same processing as the capture interrupt.
+ */
+static void check_edge(uint32_t timestamp)
+{
+  uint32_t duration;
+
+  if (GLITCH_Edge(&check_glitch, &check_glitch_config, timestamp, &duration) != 0)
+  {
+    check_durations.push_back(duration);
+  }
+}
+
+/**
+ * Appends a level, merged with the previous one if equal.
+ */
+static void level_add(std::vector<check_level_t> & levels, uint32_t level, uint32_t duration)
+{
+  if (!levels.empty() && (levels.back().level == level))
+  {
+    levels.back().duration += duration;
+  }
+  else
+  {
+    levels.push_back({ level, duration });
+  }
+}
+
+/**
+ * Builds the levels of the data pin: silence, then a LaCrosse burst with
+ * jitter and noise spikes in its low levels.
+ *
+ * @details A spike splits a low level. Its falling edge is kept away from
+ * the runt threshold of the glitch filter so that the interrupt and the
+ * sampled edges take the same merge decision (the quantization of the
+ * sampled edges moves the durations by up to one sample period).
+ */
+static void burst_add(std::vector<check_level_t> & levels, pulse_random_t * random, uint32_t spikes)
+{
+  LACROSSE_schedule_t schedule;
+  std::vector<check_level_t> burst;
+  int32_t level;
+  uint32_t duration;
+  uint32_t i;
+
+  level_add(levels, 0, 20000 + (pulse_random(random) % 40000));
+
+  LACROSSE_schedule_build(&schedule, 0xAA, pulse_random(random) & 0xFFFFFF);
+  while (LACROSSE_schedule_next(&schedule, &level, &duration) == 0)
+  {
+    const int32_t jitter = (int32_t)(pulse_random(random) % (2 * CHECK_JITTER_US + 1)) - CHECK_JITTER_US;
+    burst.push_back({ (uint32_t)level, (uint32_t)((int32_t)duration + jitter) });
+  }
+
+  for (i = 0; i < spikes; i++)
+  {
+    const size_t index = pulse_random(random) % burst.size();
+    const uint32_t width = CHECK_SPIKE_MIN_US + (pulse_random(random) % (CHECK_SPIKE_MAX_US - CHECK_SPIKE_MIN_US));
+
+    /* one spike per low level (its neighbours are not spikes) */
+    if ((burst[index].level != 0) || (burst[index].duration <= width + 40) || (index == 0) ||
+        (burst[index - 1].duration <= CHECK_SPIKE_MAX_US) ||
+        ((index + 1 < burst.size()) && (burst[index + 1].duration <= CHECK_SPIKE_MAX_US)))
+    {
+      continue;
+    }
+    /* the previous falling edge is the start of this low level */
+    const uint32_t before = 20 + (pulse_random(random) % (burst[index].duration - width - 40));
+    const uint32_t interval = before + width;
+    if ((interval + CHECK_SPIKE_MARGIN_US > GLITCH_MERGE_TICKS_DEFAULT) &&
+        (interval < GLITCH_MERGE_TICKS_DEFAULT + CHECK_SPIKE_MARGIN_US))
+    {
+      continue;
+    }
+    const uint32_t after = burst[index].duration - before - width;
+    burst[index].duration = before;
+    burst.insert(burst.begin() + index + 1, { 1, width });
+    burst.insert(burst.begin() + index + 2, { 0, after });
+  }
+
+  for (i = 0; i < burst.size(); i++)
+  {
+    level_add(levels, burst[i].level, burst[i].duration);
+  }
+}
+
+/**
+ * Decodes durations with the LaCrosse receiver.
+ *
+ * @return decoded payloads.
+ */
+static std::vector<uint32_t> decode(const std::vector<uint32_t> & durations)
+{
+  std::vector<uint32_t> frames;
+  size_t i;
+
+  LACROSSE_calib_reset();
+  LACROSSE_flush();
+  for (i = 0; i <= durations.size(); i++)
+  {
+    const uint32_t value = (i < durations.size()) ? LACROSSE_input_handler(durations[i]) : LACROSSE_flush();
+    if (value != 0xFFFFFFFFu)
+    {
+      frames.push_back(value);
+    }
+  }
+
+  return frames;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  uint32_t bursts = 200;
+  uint32_t spikes = 8;
+  uint32_t tick_num = 256;
+  uint32_t tick_den = 24;
+  pulse_random_t random = { 0x2468ACE1u };
+  std::vector<check_level_t> levels;
+  std::vector<uint32_t> reference;
+  std::vector<uint16_t> samples;
+  uint64_t edges = 0;
+  uint64_t time = 0;
+  int opt;
+  size_t i;
+
+  while ((opt = getopt(argc, argv, "n:s:p:c:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      bursts = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      spikes = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      tick_num = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      tick_den = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n bursts] [-s spikes] [-p prescaler] [-c clock_mhz]\n", argv[0]);
+      return 1;
+    }
+  }
+  if ((tick_num == 0) || (tick_den == 0))
+  {
+    return 1;
+  }
+
+  for (i = 0; i < bursts; i++)
+  {
+    burst_add(levels, &random, spikes);
+  }
+  level_add(levels, 0, 200000);
+
+  /* capture interrupt: one timestamp per falling edge */
+  GLITCH_Init(&check_glitch, 0);
+  check_durations.clear();
+  for (i = 0; i < levels.size(); i++)
+  {
+    if ((i > 0) && (levels[i].level == 0) && (levels[i - 1].level == 1))
+    {
+      check_edge((uint32_t)time);
+      edges++;
+    }
+    time += levels[i].duration;
+  }
+  reference.swap(check_durations);
+
+  /* sampling: the level at each sample time, 16 samples per word MSB first */
+  const uint64_t sample_count = time * tick_den / tick_num;
+  samples.assign((size_t)((sample_count + 15) / 16 + CHECK_BLOCK_WORDS) & ~(size_t)(CHECK_BLOCK_WORDS - 1), 0);
+  size_t level_index = 0;
+  uint64_t level_end = levels[0].duration;
+  uint64_t k;
+  for (k = 0; k < sample_count; k++)
+  {
+    const uint64_t sample_time = (k * tick_num + tick_den - 1) / tick_den;
+    while (sample_time >= level_end)
+    {
+      level_end += levels[++level_index].duration;
+    }
+    samples[(size_t)(k / 16)] |= (uint16_t)(levels[level_index].level << (15 - (k % 16)));
+  }
+
+  /* extraction by blocks (DMA half buffers) */
+  OVERSAMPLE_state_t state;
+  OVERSAMPLE_Init(&state, 0, tick_num, tick_den, check_edge);
+  GLITCH_Init(&check_glitch, 0);
+  check_durations.clear();
+  check_durations.reserve(reference.size());
+  const uint64_t start = time_ns();
+  for (i = 0; i < samples.size(); i += CHECK_BLOCK_WORDS)
+  {
+    OVERSAMPLE_Extract(&state, &samples[i], CHECK_BLOCK_WORDS);
+  }
+  const uint64_t elapsed = time_ns() - start;
+
+  /* durations within one sample period */
+  const uint32_t tolerance = (tick_num + tick_den - 1) / tick_den;
+  uint32_t error_max = 0;
+  uint32_t errors = 0;
+  for (i = 0; (i < reference.size()) && (i < check_durations.size()); i++)
+  {
+    const uint32_t error = (reference[i] > check_durations[i]) ? (reference[i] - check_durations[i]) :
+        (check_durations[i] - reference[i]);
+    error_max = (error > error_max) ? error : error_max;
+    errors += (error > tolerance) ? 1 : 0;
+  }
+  const std::vector<uint32_t> frames_reference = decode(reference);
+  const std::vector<uint32_t> frames = decode(check_durations);
+  const int32_t ok = (reference.size() == check_durations.size()) && (errors == 0) && (frames == frames_reference);
+
+  const double seconds = time / 1e6;
+  printf("signal         %.1f s, sample period %.3f us, %llu samples\n", seconds, (double)tick_num / tick_den,
+      (unsigned long long)sample_count);
+  printf("durations      %zu interrupt, %zu oversampled, max error %u us (tolerance %u us), %u out\n",
+      reference.size(), check_durations.size(), (unsigned)error_max, (unsigned)tolerance, (unsigned)errors);
+  printf("frames         %zu interrupt, %zu oversampled, identical: %s\n", frames_reference.size(), frames.size(),
+      (frames == frames_reference) ? "yes" : "no");
+  printf("interrupts     %.0f/s capture (edges), %.1f/s DMA (half buffers)\n", edges / seconds,
+      (double)samples.size() / CHECK_BLOCK_WORDS / seconds);
+  printf("extraction     %.2f ns per 32 samples on the host\n", (double)elapsed * 2 / samples.size());
+  printf("result         %s\n", ok ? "ok" : "FAILED");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,424 @@
+/**
+ * @file profile_report.cpp
+ *
+ * @brief Host report of the function profile of the profiling firmware
+ * variant (profile.h): flat profile and folded stacks for flame graphs.
+ *
+ * Build on the host:
+ *   g++ -std=c++14 -O2 -IInc Tools/profile_report.cpp -o profile_report
+ *
+ * Usage:
+ *   profile_report [-e elf] [-a addr2line] [-f hz] [-o folded] [-n lines] [log...]
+ *     -e  firmware ELF of the profiling variant to name the functions
+ *     -a  addr2line command (default arm-none-eabi-addr2line)
+ *     -f  CPU frequency in Hz (default 24000000)
+ *     -o  folded stacks output (one "caller;callee self_cycles" line per
+ *         calling context), input of flamegraph.pl
+ *     -n  lines of the flat profile (default 40)
+ *   Reads the serial logs (stdin if none): raw MySensors lines or lines
+ *   prefixed by the host time. The reports of all intervals are summed; the
+ *   cycles outside the instrumented functions (scheduler, interrupt entry,
+ *   HAL callbacks of other files) are shown as "(not instrumented)".
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/* MySensors header of the profile lines (TELEMETRY_NODE_ID and MYSENSORS_CHILD_ID_PROFILE) */
+#define REPORT_MYSENSORS_NODE   133
+#define REPORT_MYSENSORS_CHILD  35
+#define REPORT_MYSENSORS_TYPE   48
+
+/* node table of the firmware (PROFILE_NODE_NUMBER) */
+#define REPORT_NODE_NUMBER  64
+
+/* longest line */
+#define REPORT_LINE_MAX  1024
+
+
+/**
+ * Node of the firmware calling context tree (valid until a reboot).
+ */
+typedef struct
+{
+  uint32_t function; /*!< function address, 0 if unknown */
+  uint32_t parent; /*!< parent node */
+  uint64_t calls; /*!< calls of the current interval */
+  uint64_t self; /*!< self cycles of the current interval */
+} report_node_t;
+
+/**
+ * Totals of a calling context (path of function addresses from the root).
+ */
+typedef struct
+{
+  uint64_t calls; /*!< calls */
+  uint64_t self; /*!< self cycles */
+} report_context_t;
+
+/**
+ * Report state.
+ */
+typedef struct
+{
+  report_node_t nodes[REPORT_NODE_NUMBER]; /*!< firmware tree */
+  uint32_t node_count; /*!< nodes of the firmware tree */
+  int32_t open; /*!< an interval is being read */
+  std::map<std::vector<uint32_t>, report_context_t> contexts; /*!< totals per calling context */
+  uint64_t interval; /*!< cycles of the complete intervals */
+  uint64_t dropped; /*!< calls dropped by the firmware */
+  uint64_t intervals; /*!< complete intervals */
+  uint64_t reboots; /*!< node tables restarted */
+  uint64_t invalid; /*!< invalid lines */
+} report_t;
+
+/**
+ * Flat profile entry.
+ */
+typedef struct
+{
+  uint32_t function; /*!< function address */
+  uint64_t calls; /*!< calls */
+  uint64_t self; /*!< self cycles */
+  uint64_t total; /*!< self cycles and cycles of the callees */
+} report_flat_t;
+
+
+/**
+ * Adds the nodes of the interval being read to the calling contexts.
+ *
+ * @return void.
+ */
+static void report_close(report_t * report)
+{
+  uint32_t i;
+
+  for (i = 1; (i < REPORT_NODE_NUMBER) && report->open; i++)
+  {
+    report_node_t * const node = &report->nodes[i];
+    std::vector<uint32_t> path;
+    uint32_t index = i;
+    uint32_t depth;
+
+    if ((node->function == 0) || ((node->calls == 0) && (node->self == 0)))
+    {
+      continue;
+    }
+
+    /* path from the root (a parent that was not received ends the path) */
+    for (depth = 0; (index != 0) && (depth < REPORT_NODE_NUMBER); depth++)
+    {
+      if (report->nodes[index].function == 0)
+      {
+        break;
+      }
+      path.push_back(report->nodes[index].function);
+      index = report->nodes[index].parent;
+    }
+    std::reverse(path.begin(), path.end());
+
+    report_context_t & context = report->contexts[path];
+    context.calls += node->calls;
+    context.self += node->self;
+    node->calls = 0;
+    node->self = 0;
+  }
+  report->open = 0;
+}
+
+/**
+ * Handles the payload of a profile line.
+ *
+ * @return 0 if ok, -1 if invalid.
+ */
+static int32_t report_line(report_t * report, const char * text)
+{
+  unsigned long values[4];
+  long index;
+
+  if (sscanf(text, "h,%lu,%lu,%lu", &values[0], &values[1], &values[2]) == 3)
+  {
+    report_close(report);
+
+    /* fewer nodes: the firmware restarted, node indexes are reused */
+    if (values[1] < report->node_count)
+    {
+      memset(report->nodes, 0, sizeof(report->nodes));
+      report->reboots++;
+    }
+    report->node_count = (uint32_t)values[1];
+    report->interval += values[0];
+    report->dropped += values[2];
+    report->intervals++;
+    report->open = 1;
+    return 0;
+  }
+
+  if ((sscanf(text, "%ld,%lu,%lx,%lu,%lu", &index, &values[0], &values[1], &values[2], &values[3]) != 5) ||
+      (index <= 0) || (index >= REPORT_NODE_NUMBER) || (values[0] >= REPORT_NODE_NUMBER) || !report->open)
+  {
+    return -1;
+  }
+
+  report_node_t * const node = &report->nodes[index];
+  node->function = (uint32_t)values[1];
+  node->parent = (uint32_t)values[0];
+  node->calls += values[2];
+  node->self += values[3];
+
+  return 0;
+}
+
+/**
+ * Reads the profile lines of a log.
+ *
+ * @return void.
+ */
+static void report_file(report_t * report, FILE * file)
+{
+  char header[64];
+  char line[REPORT_LINE_MAX];
+
+  const int header_len = snprintf(header, sizeof(header), "%d;%d;1;0;%d;", REPORT_MYSENSORS_NODE,
+      REPORT_MYSENSORS_CHILD, REPORT_MYSENSORS_TYPE);
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    const char * start = strstr(line, header);
+
+    /* profile lines only, at the start of the line or after the host time */
+    if ((start == NULL) || ((start != line) && (start[-1] != ' ') && (start[-1] != '\t')))
+    {
+      continue;
+    }
+    if (report_line(report, start + header_len) != 0)
+    {
+      report->invalid++;
+    }
+  }
+}
+
+/**
+ * Names the functions with addr2line (addresses in hex without the ELF).
+ *
+ * @param addresses function addresses.
+ * @param elf firmware ELF, NULL if none.
+ * @param addr2line addr2line command.
+ *
+ * @return names by address.
+ */
+static std::map<uint32_t, std::string> report_symbols(const std::vector<uint32_t> & addresses, const char * elf,
+    const char * addr2line)
+{
+  std::map<uint32_t, std::string> names;
+  char text[REPORT_LINE_MAX];
+  size_t i;
+
+  for (i = 0; i < addresses.size(); i++)
+  {
+    snprintf(text, sizeof(text), "0x%08x", (unsigned)addresses[i]);
+    names[addresses[i]] = text;
+  }
+  if ((elf == NULL) || addresses.empty())
+  {
+    return names;
+  }
+
+  /* one addr2line run: the function name then the file:line of each address */
+  std::string command = std::string(addr2line) + " -f -C -e '" + elf + "'";
+  for (i = 0; i < addresses.size(); i++)
+  {
+    snprintf(text, sizeof(text), " 0x%x", (unsigned)addresses[i]);
+    command += text;
+  }
+  FILE * pipe = popen(command.c_str(), "r");
+  if (pipe == NULL)
+  {
+    fprintf(stderr, "cannot run %s\n", addr2line);
+    return names;
+  }
+  for (i = 0; (i < addresses.size()) && (fgets(text, sizeof(text), pipe) != NULL); i++)
+  {
+    char location[REPORT_LINE_MAX];
+
+    text[strcspn(text, "\r\n")] = '\0';
+    if ((fgets(location, sizeof(location), pipe) != NULL) && (strcmp(text, "??") != 0))
+    {
+      names[addresses[i]] = text;
+    }
+  }
+  pclose(pipe);
+
+  return names;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  static report_t report;
+  const char * elf = NULL;
+  const char * addr2line = "arm-none-eabi-addr2line";
+  const char * folded = NULL;
+  double frequency = 24e6;
+  uint32_t lines = 40;
+  int32_t retval = 0;
+  int opt;
+  int i;
+
+  while ((opt = getopt(argc, argv, "e:a:f:o:n:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'e':
+      elf = optarg;
+      break;
+    case 'a':
+      addr2line = optarg;
+      break;
+    case 'f':
+      frequency = strtod(optarg, NULL);
+      break;
+    case 'o':
+      folded = optarg;
+      break;
+    case 'n':
+      lines = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-e elf] [-a addr2line] [-f hz] [-o folded] [-n lines] [log...]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    report_file(&report, stdin);
+  }
+  for (i = optind; i < argc; i++)
+  {
+    FILE * file = fopen(argv[i], "r");
+    if (file == NULL)
+    {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      retval = 1;
+      continue;
+    }
+    report_file(&report, file);
+    fclose(file);
+  }
+  report_close(&report);
+
+  if ((report.intervals == 0) || (report.interval == 0))
+  {
+    fprintf(stderr, "no profile lines\n");
+    return 1;
+  }
+
+  /* flat profile: the callees of a function count once in its total (recursion) */
+  std::map<uint32_t, report_flat_t> flat;
+  uint64_t self_sum = 0;
+  for (const auto & entry : report.contexts)
+  {
+    const std::vector<uint32_t> & path = entry.first;
+    size_t k;
+
+    report_flat_t & function = flat[path.back()];
+    function.function = path.back();
+    function.calls += entry.second.calls;
+    function.self += entry.second.self;
+    self_sum += entry.second.self;
+    for (k = 0; k < path.size(); k++)
+    {
+      if (std::find(path.begin(), path.begin() + k, path[k]) == path.begin() + k)
+      {
+        report_flat_t & caller = flat[path[k]];
+        caller.function = path[k];
+        caller.total += entry.second.self;
+      }
+    }
+  }
+
+  std::vector<report_flat_t> sorted;
+  std::vector<uint32_t> addresses;
+  for (const auto & entry : flat)
+  {
+    sorted.push_back(entry.second);
+    addresses.push_back(entry.first);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+      [](const report_flat_t & a, const report_flat_t & b) { return a.self > b.self; });
+  std::map<uint32_t, std::string> names = report_symbols(addresses, elf, addr2line);
+
+  const double interval = (double)report.interval;
+  printf("%llu intervals, %.1f s, %llu calls dropped, %llu restarts, %llu invalid lines\n\n",
+      (unsigned long long)report.intervals, interval / frequency, (unsigned long long)report.dropped,
+      (unsigned long long)report.reboots, (unsigned long long)report.invalid);
+  printf("  self%%  total%%      self ms     total ms        calls  cycles/call  function\n");
+  for (i = 0; (i < (int)sorted.size()) && (i < (int)lines); i++)
+  {
+    const report_flat_t & function = sorted[i];
+    printf("%6.2f %7.2f %12.3f %12.3f %12llu %12.0f  %s\n", 100.0 * function.self / interval,
+        100.0 * function.total / interval, 1e3 * function.self / frequency, 1e3 * function.total / frequency,
+        (unsigned long long)function.calls, (function.calls != 0) ? (double)function.self / function.calls : 0.0,
+        names[function.function].c_str());
+  }
+  if (report.interval > self_sum)
+  {
+    printf("%6.2f %7s %12.3f %12s %12s %12s  (not instrumented)\n", 100.0 * (report.interval - self_sum) / interval,
+        "", 1e3 * (report.interval - self_sum) / frequency, "", "", "");
+  }
+
+  if (folded != NULL)
+  {
+    FILE * file = fopen(folded, "w");
+    if (file == NULL)
+    {
+      fprintf(stderr, "%s: cannot create\n", folded);
+      return 1;
+    }
+    for (const auto & entry : report.contexts)
+    {
+      size_t k;
+
+      for (k = 0; k < entry.first.size(); k++)
+      {
+        fprintf(file, "%s%s", (k > 0) ? ";" : "", names[entry.first[k]].c_str());
+      }
+      fprintf(file, " %llu\n", (unsigned long long)entry.second.self);
+    }
+    if (report.interval > self_sum)
+    {
+      fprintf(file, "(not instrumented) %llu\n", (unsigned long long)(report.interval - self_sum));
+    }
+    fclose(file);
+  }
+
+  return retval;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file pulse_train.h
+ *
+ * @brief Host helpers to generate the 433 MHz durations seen by the receiver
+ * from a LaCrosse transmitter schedule.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef PULSE_TRAIN_H
+#define PULSE_TRAIN_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "lacrosse.h"
+
+
+/**
+ * Random generator of the host tools (xorshift32, reproducible).
+ */
+typedef struct
+{
+  uint32_t state; /*!< generator state (not 0) */
+} pulse_random_t;
+
+/**
+ * @return next 32-bit random value.
+ */
+static inline uint32_t pulse_random(pulse_random_t * random)
+{
+  uint32_t x = random->state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random->state = x;
+  return x;
+}
+
+/**
+ * Appends the durations measured by the receiver (between falling edges)
+ * for a whole LaCrosse burst.
+ *
+ * @details The first falling edge is measured from @p gap_usec before the
+ * burst. The end of the burst has no falling edge: the decoder needs
+ * LACROSSE_flush() after it.
+ *
+ * @param durations output durations in microsec.
+ * @param sync sync byte.
+ * @param data 24-bit data (not encrypted).
+ * @param gap_usec silence before the burst in microsec.
+ *
+ * @return void.
+ */
+static inline void pulse_train_lacrosse(std::vector<uint32_t> & durations,
+    uint32_t sync, uint32_t data, uint32_t gap_usec)
+{
+  LACROSSE_schedule_t schedule;
+  int32_t level;
+  int32_t level_prev = 0;
+  uint32_t duration;
+  uint32_t since_fall = gap_usec;
+
+  LACROSSE_schedule_build(&schedule, sync, data);
+  while (LACROSSE_schedule_next(&schedule, &level, &duration) == 0)
+  {
+    if ((level_prev == 1) && (level == 0))
+    {
+      durations.push_back(since_fall);
+      since_fall = 0;
+    }
+    since_fall += duration;
+    level_prev = level;
+  }
+}
+
+#endif
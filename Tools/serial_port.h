@@ -0,0 +1,92 @@
+/**
+ * @file serial_port.h
+ *
+ * @brief Opening of the serial device of a board on the host (raw,
+ * non-blocking), shared by the host daemons.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+
+/**
+ * Converts a baudrate to the termios constant.
+ *
+ * @return termios constant, B0 if not supported.
+ */
+static inline speed_t serial_port_speed(long baudrate)
+{
+  switch (baudrate)
+  {
+  case 9600: return B9600;
+  case 19200: return B19200;
+  case 38400: return B38400;
+  case 57600: return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 921600: return B921600;
+  default: return B0;
+  }
+}
+
+/**
+ * Opens a serial device in raw non-blocking mode (read, and write of the
+ * commands to the board).
+ *
+ * @param device device path (a pseudo-terminal for the tests).
+ * @param baudrate baudrate.
+ *
+ * @return file descriptor, -1 if error.
+ */
+static inline int serial_port_open(const char * device, long baudrate)
+{
+  struct termios tio;
+  const speed_t speed = serial_port_speed(baudrate);
+  int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+  if ((fd >= 0) && ((speed == B0) || (tcgetattr(fd, &tio) != 0)))
+  {
+    close(fd);
+    fd = -1;
+  }
+  if (fd >= 0)
+  {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  return fd;
+}
+
+#endif
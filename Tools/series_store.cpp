@@ -0,0 +1,737 @@
+/**
+ * @file series_store.cpp
+ *
+ * @brief Host tool of the columnar store of the sensor readings
+ * (series_store.h): import of timestamped serial logs, range queries and a
+ * query benchmark on a year of 60 s samples.
+ *
+ * Build on the host:
+ *   g++ -std=c++14 -O2 -ITools Tools/series_store.cpp -o series_store
+ *
+ * Usage:
+ *   series_store import -d dir [log...]
+ *     Imports the temperature and humidity readings of serial logs (stdin if
+ *     none) whose lines are prefixed by the host time in seconds since epoch,
+ *     e.g. captured with: ts %.s < /dev/ttyUSB0 > serial.log
+ *       1611500000.125 103;0;1;0;0;21.5
+ *     Lines without a time get the time of the previous line. Samples that
+ *     are not after the last stored one are dropped, so importing the same
+ *     log twice adds nothing.
+ *   series_store query -d dir -n node -c child [-s start] [-e end] [-b bucket] [-v low:high]
+ *     Prints "start_ms,count,min,max,mean" for the samples of [start, end)
+ *     (seconds since epoch) with a value in [low, high], by buckets of bucket
+ *     seconds (a single bucket by default).
+ *   series_store bench [-y years] [-d dir]
+ *     Imports years of 60 s samples (temperature and humidity of a node) into
+ *     dir (a temporary directory by default) and times dashboard queries.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+#include "mysensors_line.h"
+#include "series_store.h"
+
+/* stored readings (MYSENSORS_CMD_SET, MYSENSORS_TYPE_SET_TEMP/HUM of mysensors.h) */
+#define STORE_CMD_SET    1
+#define STORE_TYPE_TEMP  0
+#define STORE_TYPE_HUM   1
+
+/* benchmark series */
+#define BENCH_NODE        103
+#define BENCH_PERIOD_MS   60000
+#define BENCH_START_MS    1577836800000LL  /* 2020-01-01 */
+#define BENCH_REPEAT      20
+
+
+/**
+ * Import statistics.
+ */
+typedef struct
+{
+  uint64_t lines; /*!< read lines */
+  uint64_t samples; /*!< stored samples */
+  uint64_t ignored; /*!< invalid lines or other messages */
+  uint64_t undated; /*!< readings before the first host time */
+  uint64_t dropped; /*!< readings not after the last stored sample */
+  uint64_t errors; /*!< write errors */
+} store_stats_t;
+
+/**
+ * Import state.
+ */
+typedef struct
+{
+  const char * dir; /*!< store directory */
+  std::unordered_map<int32_t, series_writer_t *> writers; /*!< open series by node << 8 | child */
+  int64_t time; /*!< last host time in millisec, -1 if none */
+  store_stats_t stats; /*!< statistics */
+} store_import_t;
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Parses the host time prefix of a line: seconds since epoch, an optional
+ * fraction and a blank.
+ *
+ * @return length of the prefix, 0 if none.
+ */
+static int32_t store_line_time(const char * line, int32_t len, int64_t * time)
+{
+  int64_t seconds = 0;
+  int64_t ms = 0;
+  int32_t scale = 100;
+  int32_t i = 0;
+
+  while ((i < len) && ((uint32_t)(line[i] - '0') <= 9) && (i < 12))
+  {
+    seconds = (seconds * 10) + (line[i++] - '0');
+  }
+  if ((i == 0) || (i == len))
+  {
+    return 0;
+  }
+  if (line[i] == '.')
+  {
+    for (i++; (i < len) && ((uint32_t)(line[i] - '0') <= 9); i++)
+    {
+      ms += (line[i] - '0') * scale;
+      scale /= 10;
+    }
+  }
+  if ((i == len) || ((line[i] != ' ') && (line[i] != '\t')))
+  {
+    return 0;
+  }
+  *time = (seconds * 1000) + ms;
+
+  return i + 1;
+}
+
+/**
+ * Returns the open series of a node/child.
+ *
+ * @return series, NULL if it cannot be opened.
+ */
+static series_writer_t * store_writer(store_import_t * import, int32_t node, int32_t child)
+{
+  const int32_t key = (node << 8) | child;
+  auto it = import->writers.find(key);
+
+  if (it != import->writers.end())
+  {
+    return it->second;
+  }
+
+  series_writer_t * writer = new series_writer_t;
+  if (series_writer_open(writer, import->dir, node, child) != 0)
+  {
+    fprintf(stderr, "%s: cannot open series %d_%d\n", import->dir, (int)node, (int)child);
+    series_writer_close(writer);
+    delete writer;
+    writer = NULL;
+  }
+  import->writers[key] = writer;
+
+  return writer;
+}
+
+/**
+ * Imports the readings of a log.
+ *
+ * @param import import state.
+ * @param data log content.
+ * @param len log size in bytes (an unterminated last line is ignored).
+ *
+ * @return void.
+ */
+static void store_import(store_import_t * import, const char * data, size_t len)
+{
+  mysensors_line_t line;
+  size_t offset = 0;
+
+  while (offset < len)
+  {
+    const char * start = &data[offset];
+    const char * end = (const char *)memchr(start, '\n', len - offset);
+    if (end == NULL)
+    {
+      break;
+    }
+    offset = end - data + 1;
+    import->stats.lines++;
+
+    const int32_t prefix = store_line_time(start, (int32_t)(end - start), &import->time);
+    int32_t tenths;
+    if ((mysensors_line_parse(start + prefix, (int32_t)(end - start - prefix), &line) != 0) ||
+        (line.command != STORE_CMD_SET) || ((line.type != STORE_TYPE_TEMP) && (line.type != STORE_TYPE_HUM)) ||
+        (mysensors_line_tenths(line.payload, line.payload_len, &tenths) != 0))
+    {
+      import->stats.ignored++;
+      continue;
+    }
+    if (import->time < 0)
+    {
+      import->stats.undated++;
+      continue;
+    }
+
+    series_writer_t * writer = store_writer(import, line.node, line.child);
+    const int32_t status = (writer != NULL) ? series_writer_append(writer, import->time, tenths) : -2;
+    if (status == 0)
+    {
+      import->stats.samples++;
+    }
+    else if (status == -1)
+    {
+      import->stats.dropped++;
+    }
+    else
+    {
+      import->stats.errors++;
+    }
+  }
+}
+
+/**
+ * Writes the open blocks and closes the series of an import.
+ *
+ * @return 0 if ok, -1 if write error.
+ */
+static int32_t store_close(store_import_t * import)
+{
+  int32_t retval = (import->stats.errors == 0) ? 0 : -1;
+
+  for (auto & it : import->writers)
+  {
+    if (it.second != NULL)
+    {
+      retval |= series_writer_close(it.second);
+      delete it.second;
+    }
+  }
+  import->writers.clear();
+
+  return retval;
+}
+
+/**
+ * Import command.
+ */
+static int store_command_import(int argc, char ** argv)
+{
+  store_import_t import;
+  const char * dir = NULL;
+  int32_t retval = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:")) != -1)
+  {
+    if (opt == 'd')
+    {
+      dir = optarg;
+    }
+    else
+    {
+      return 2;
+    }
+  }
+  if (dir == NULL)
+  {
+    fprintf(stderr, "import: missing -d dir\n");
+    return 2;
+  }
+
+  import.dir = dir;
+  import.time = -1;
+  memset(&import.stats, 0, sizeof(import.stats));
+
+  if (optind == argc)
+  {
+    std::vector<char> log;
+    char buffer[65536];
+    ssize_t size;
+    while ((size = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+    {
+      log.insert(log.end(), buffer, buffer + size);
+    }
+    store_import(&import, log.data(), log.size());
+  }
+  for (; optind < argc; optind++)
+  {
+    struct stat st;
+    const int fd = open(argv[optind], O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) != 0))
+    {
+      fprintf(stderr, "%s: cannot open\n", argv[optind]);
+      retval = 1;
+    }
+    else if (st.st_size > 0)
+    {
+      const char * data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+      {
+        madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+        store_import(&import, data, st.st_size);
+        munmap((void *)data, st.st_size);
+      }
+      else
+      {
+        fprintf(stderr, "%s: cannot map\n", argv[optind]);
+        retval = 1;
+      }
+    }
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+  }
+
+  if (store_close(&import) != 0)
+  {
+    fprintf(stderr, "%s: write error\n", dir);
+    retval = 1;
+  }
+  fprintf(stderr, "%llu lines, %llu samples stored, %llu ignored, %llu undated, %llu dropped\n",
+      (unsigned long long)import.stats.lines, (unsigned long long)import.stats.samples,
+      (unsigned long long)import.stats.ignored, (unsigned long long)import.stats.undated,
+      (unsigned long long)import.stats.dropped);
+
+  return retval;
+}
+
+/**
+ * Query command.
+ */
+static int store_command_query(int argc, char ** argv)
+{
+  series_reader_t reader;
+  std::vector<series_aggregate_t> buckets;
+  series_query_stats_t stats;
+  const char * dir = NULL;
+  int32_t node = -1;
+  int32_t child = -1;
+  int64_t start = INT64_MIN;
+  int64_t end = INT64_MAX;
+  int64_t bucket_ms = 0;
+  int32_t low = INT32_MIN;
+  int32_t high = INT32_MAX;
+  const char * colon;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:n:c:s:e:b:v:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd': dir = optarg; break;
+    case 'n': node = atoi(optarg); break;
+    case 'c': child = atoi(optarg); break;
+    case 's': start = strtoll(optarg, NULL, 0) * 1000; break;
+    case 'e': end = strtoll(optarg, NULL, 0) * 1000; break;
+    case 'b': bucket_ms = strtoll(optarg, NULL, 0) * 1000; break;
+    case 'v':
+      colon = strchr(optarg, ':');
+      if ((colon == NULL) || (mysensors_line_tenths(optarg, (int32_t)(colon - optarg), &low) != 0) ||
+          (mysensors_line_tenths(colon + 1, (int32_t)strlen(colon + 1), &high) != 0))
+      {
+        fprintf(stderr, "query: -v expects low:high (e.g. 30:45.5)\n");
+        return 2;
+      }
+      break;
+    default:
+      return 2;
+    }
+  }
+  if ((dir == NULL) || (node < 0) || (child < 0) || (bucket_ms < 0))
+  {
+    fprintf(stderr, "query: missing -d dir, -n node or -c child\n");
+    return 2;
+  }
+  if (series_reader_open(&reader, dir, node, child) != 0)
+  {
+    fprintf(stderr, "%s: no series %d_%d\n", dir, (int)node, (int)child);
+    return 1;
+  }
+
+  const uint64_t begin = time_ns();
+  series_query(&reader, start, end, low, high, bucket_ms, buckets, &stats);
+  const uint64_t elapsed = time_ns() - begin;
+
+  printf("start_ms,count,min,max,mean\n");
+  for (const series_aggregate_t & bucket : buckets)
+  {
+    if (bucket.count > 0)
+    {
+      printf("%lld,%llu,%.1f,%.1f,%.2f\n", (long long)bucket.start, (unsigned long long)bucket.count,
+          bucket.min / 10.0, bucket.max / 10.0, (double)bucket.sum / bucket.count / 10.0);
+    }
+  }
+  fprintf(stderr, "%.3f ms, %u blocks from the index, %u decoded, %u skipped\n", elapsed / 1e6,
+      (unsigned)stats.indexed, (unsigned)stats.decoded, (unsigned)stats.skipped);
+  series_reader_close(&reader);
+
+  return 0;
+}
+
+/**
+ * xorshift32 pseudo-random generator.
+ */
+static uint32_t bench_random(uint32_t * state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/**
+ * Appends a timestamped reading to a log.
+ */
+static void bench_line(std::vector<char> & log, int64_t time, int32_t child, int32_t type, int32_t value)
+{
+  char line[64];
+  const int32_t magnitude = (value < 0) ? -value : value;
+  const int len = sprintf(line, "%lld.%03d %d;%d;%d;0;%d;%s%d.%d\n", (long long)(time / 1000), (int)(time % 1000),
+      BENCH_NODE, (int)child, STORE_CMD_SET, (int)type, (value < 0) ? "-" : "", (int)(magnitude / 10),
+      (int)(magnitude % 10));
+  log.insert(log.end(), line, line + len);
+}
+
+/**
+ * Generates a serial log of a temperature and a humidity reading every 60 s
+ * (up to 1 s late, a few missing) with daily and yearly cycles.
+ */
+static void bench_generate(std::vector<char> & log, int32_t years)
+{
+  const int64_t samples = (int64_t)years * 365 * 24 * 3600 * 1000 / BENCH_PERIOD_MS;
+  uint32_t random = 0x13579BDu;
+  int64_t k;
+
+  log.reserve(samples * 2 * 36);
+  for (k = 0; k < samples; k++)
+  {
+    const uint32_t r = bench_random(&random);
+    const double day = 2.0 * M_PI * (double)k * BENCH_PERIOD_MS / (24 * 3600 * 1000.0);
+    const int64_t time = BENCH_START_MS + (k * BENCH_PERIOD_MS) + (r % 1000);
+
+    if (((r >> 10) % 2000) != 0)
+    {
+      const int32_t noise = (int32_t)((r >> 22) % 5) - 2;
+      bench_line(log, time, 0, STORE_TYPE_TEMP, (int32_t)(120.0 - 100.0 * cos(day / 365.0) + 40.0 * sin(day)) + noise);
+      bench_line(log, time + 1, 1, STORE_TYPE_HUM, (int32_t)(600.0 + 150.0 * sin(day / 365.0) - 80.0 * sin(day)) + noise);
+    }
+  }
+}
+
+/**
+ * Empties buckets (keeping their start) for a baseline.
+ */
+static void bench_reset(std::vector<series_aggregate_t> & buckets, const std::vector<series_aggregate_t> & layout)
+{
+  size_t i;
+
+  buckets = layout;
+  for (i = 0; i < buckets.size(); i++)
+  {
+    buckets[i].count = 0;
+    buckets[i].sum = 0;
+    buckets[i].min = INT32_MAX;
+    buckets[i].max = INT32_MIN;
+  }
+}
+
+/**
+ * Adds a sample to the buckets of a baseline.
+ */
+static void bench_add(std::vector<series_aggregate_t> & buckets, int64_t bucket_ms, int64_t time, int32_t value)
+{
+  const int64_t index = (bucket_ms > 0) ? (series_bucket(time, bucket_ms) - series_bucket(buckets[0].start, bucket_ms)) : 0;
+  series_aggregate_t * bucket = &buckets[index];
+
+  bucket->count++;
+  bucket->sum += value;
+  bucket->min = (value < bucket->min) ? value : bucket->min;
+  bucket->max = (value > bucket->max) ? value : bucket->max;
+}
+
+/**
+ * Compares the results of a baseline with the store.
+ *
+ * @return 1 if identical, otherwise 0.
+ */
+static int32_t bench_same(const std::vector<series_aggregate_t> & a, const std::vector<series_aggregate_t> & b)
+{
+  size_t i;
+
+  if (a.size() != b.size())
+  {
+    return 0;
+  }
+  for (i = 0; i < a.size(); i++)
+  {
+    if ((a[i].count != b[i].count) || (a[i].sum != b[i].sum) ||
+        ((a[i].count > 0) && ((a[i].min != b[i].min) || (a[i].max != b[i].max))))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Returns the size of the files of a series in bytes.
+ */
+static uint64_t bench_size(const char * dir, int32_t child)
+{
+  static const char * const ext[3] = { "idx", "time", "value" };
+  char path[SERIES_PATH_MAX];
+  uint64_t size = 0;
+  int32_t i;
+
+  for (i = 0; i < 3; i++)
+  {
+    struct stat st;
+    series_path(path, dir, BENCH_NODE, child, ext[i]);
+    size += (stat(path, &st) == 0) ? st.st_size : 0;
+  }
+
+  return size;
+}
+
+/**
+ * Removes the files of the benchmark series.
+ */
+static void bench_remove(const char * dir)
+{
+  static const char * const ext[3] = { "idx", "time", "value" };
+  char path[SERIES_PATH_MAX];
+  int32_t child, i;
+
+  for (child = 0; child < 2; child++)
+  {
+    for (i = 0; i < 3; i++)
+    {
+      series_path(path, dir, BENCH_NODE, child, ext[i]);
+      unlink(path);
+    }
+  }
+}
+
+/**
+ * Benchmark command.
+ */
+static int store_command_bench(int argc, char ** argv)
+{
+  typedef struct
+  {
+    const char * name;
+    int64_t start;
+    int64_t end;
+    int64_t bucket_ms;
+    int32_t low;
+    int32_t high;
+  } bench_query_t;
+
+  char temporary[] = "/tmp/series_bench.XXXXXX";
+  const char * dir = NULL;
+  int32_t years = 1;
+  int32_t retval = 0;
+  std::vector<char> log;
+  store_import_t import;
+  series_reader_t reader;
+  int opt;
+  int i, k;
+
+  while ((opt = getopt(argc, argv, "y:d:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'y': years = atoi(optarg); break;
+    case 'd': dir = optarg; break;
+    default: return 2;
+    }
+  }
+  if (years < 1)
+  {
+    return 2;
+  }
+  if ((dir == NULL) && ((dir = mkdtemp(temporary)) == NULL))
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  bench_remove(dir);
+
+  /* import */
+  bench_generate(log, years);
+  import.dir = dir;
+  import.time = -1;
+  memset(&import.stats, 0, sizeof(import.stats));
+  uint64_t begin = time_ns();
+  store_import(&import, log.data(), log.size());
+  retval |= store_close(&import);
+  uint64_t elapsed = time_ns() - begin;
+  const uint64_t size = bench_size(dir, 0) + bench_size(dir, 1);
+  printf("import   %llu samples in %.0f ms: %.1f MB/s of log, %.1f Msamples/s\n",
+      (unsigned long long)import.stats.samples, elapsed / 1e6, log.size() * 1e3 / elapsed,
+      import.stats.samples * 1e3 / elapsed);
+  printf("size     %.2f bytes/sample (log %.1f bytes/sample)\n", (double)size / import.stats.samples,
+      (double)log.size() / import.stats.samples);
+
+  if (series_reader_open(&reader, dir, BENCH_NODE, 0) != 0)
+  {
+    fprintf(stderr, "%s: no series\n", dir);
+    return 1;
+  }
+
+  const int64_t last = reader.blocks[reader.block_count - 1].time_last + 1;
+  const bench_query_t queries[] = {
+    { "year", last - 365LL * 86400000, last, 0, INT32_MIN, INT32_MAX },
+    { "year by day", last - 365LL * 86400000, last, 86400000, INT32_MIN, INT32_MAX },
+    { "year by hour", last - 365LL * 86400000, last, 3600000, INT32_MIN, INT32_MAX },
+    { "day by 10 min", last - 86400000, last, 600000, INT32_MIN, INT32_MAX },
+    { "year above 25.0", last - 365LL * 86400000, last, 0, 250, INT32_MAX },
+  };
+
+  printf("%-16s %10s %12s %12s %16s\n", "query", "store", "decode all", "text rows", "index/decoded");
+  for (i = 0; i < (int)(sizeof(queries) / sizeof(queries[0])); i++)
+  {
+    const bench_query_t * query = &queries[i];
+    std::vector<series_aggregate_t> buckets;
+    std::vector<series_aggregate_t> decoded;
+    std::vector<series_aggregate_t> rows;
+    series_query_stats_t stats;
+    uint64_t best = UINT64_MAX;
+    int64_t times[SERIES_BLOCK_SAMPLES];
+    int32_t values[SERIES_BLOCK_SAMPLES];
+    mysensors_line_t line;
+    uint32_t b, j;
+
+    for (k = 0; k < BENCH_REPEAT; k++)
+    {
+      begin = time_ns();
+      series_query(&reader, query->start, query->end, query->low, query->high, query->bucket_ms, buckets, &stats);
+      elapsed = time_ns() - begin;
+      best = (elapsed < best) ? elapsed : best;
+    }
+
+    /* baseline: every block decoded */
+    begin = time_ns();
+    bench_reset(decoded, buckets);
+    for (b = 0; b < reader.block_count; b++)
+    {
+      const uint32_t count = series_block_decode(&reader, &reader.blocks[b], times, values);
+      for (j = 0; j < count; j++)
+      {
+        if ((times[j] >= query->start) && (times[j] < query->end) && (values[j] >= query->low) &&
+            (values[j] <= query->high))
+        {
+          bench_add(decoded, query->bucket_ms, times[j], values[j]);
+        }
+      }
+    }
+    const uint64_t elapsed_decoded = time_ns() - begin;
+
+    /* baseline: rows parsed from the text */
+    begin = time_ns();
+    bench_reset(rows, buckets);
+    for (size_t offset = 0; offset < log.size();)
+    {
+      const char * start = &log[offset];
+      const char * end = (const char *)memchr(start, '\n', log.size() - offset);
+      int64_t time = 0;
+      int32_t value;
+      offset = end - log.data() + 1;
+
+      const int32_t prefix = store_line_time(start, (int32_t)(end - start), &time);
+      if ((mysensors_line_parse(start + prefix, (int32_t)(end - start - prefix), &line) == 0) &&
+          (line.node == BENCH_NODE) && (line.child == 0) &&
+          (mysensors_line_tenths(line.payload, line.payload_len, &value) == 0) &&
+          (time >= query->start) && (time < query->end) && (value >= query->low) && (value <= query->high))
+      {
+        bench_add(rows, query->bucket_ms, time, value);
+      }
+    }
+    const uint64_t elapsed_rows = time_ns() - begin;
+
+    const int32_t same = bench_same(buckets, decoded) && bench_same(buckets, rows);
+    printf("%-16s %7.3f ms %9.3f ms %9.3f ms %9u/%u%s\n", query->name, best / 1e6, elapsed_decoded / 1e6,
+        elapsed_rows / 1e6, (unsigned)stats.indexed, (unsigned)stats.decoded, same ? "" : "  results differ");
+    retval |= same ? 0 : 1;
+  }
+
+  series_reader_close(&reader);
+  bench_remove(dir);
+  if (dir == temporary)
+  {
+    rmdir(dir);
+  }
+
+  return retval;
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  if ((argc >= 2) && (strcmp(argv[1], "import") == 0))
+  {
+    return store_command_import(argc - 1, argv + 1);
+  }
+  if ((argc >= 2) && (strcmp(argv[1], "query") == 0))
+  {
+    return store_command_query(argc - 1, argv + 1);
+  }
+  if ((argc >= 2) && (strcmp(argv[1], "bench") == 0))
+  {
+    return store_command_bench(argc - 1, argv + 1);
+  }
+
+  fprintf(stderr, "usage: %s import -d dir [log...]\n"
+      "       %s query -d dir -n node -c child [-s start] [-e end] [-b bucket] [-v low:high]\n"
+      "       %s bench [-y years] [-d dir]\n", argv[0], argv[0], argv[0]);
+
+  return 2;
+}
@@ -0,0 +1,727 @@
+/**
+ * @file series_store.h
+ *
+ * @brief Compressed columnar store of the sensor readings on the host: one
+ * append-only series per node/child, read back through memory mappings.
+ *
+ * @details A series is made of three files in the store directory:
+ *
+ * File                | Content
+ * --------------------|--------
+ * node_child.idx      | SERIES_HEADER_SIZE-byte header, then one series_block_t per block
+ * node_child.time     | timestamps of the blocks (delta-of-delta, zigzag varints)
+ * node_child.value    | x10 values of the blocks (delta, zigzag varints)
+ *
+ * Blocks hold up to SERIES_BLOCK_SAMPLES samples in increasing time. The
+ * first sample of a block is stored in its index entry, so each block is
+ * decoded alone. The index entry also holds the count, min, max and sum of
+ * the block: a query answers from the index for the blocks that fall
+ * entirely inside the requested range and bucket, skips the blocks outside
+ * the requested value range and only decodes the blocks at the edges.
+ *
+ * The column bytes of a block are written before its index entry: after a
+ * crash series_writer_open() truncates the columns to the last indexed
+ * block. The index entries are in host byte order.
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#ifndef SERIES_STORE_H
+#define SERIES_STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+/* index header */
+#define SERIES_MAGIC        "DSTS"
+#define SERIES_VERSION      1
+#define SERIES_HEADER_SIZE  16
+
+/* samples per block */
+#define SERIES_BLOCK_SAMPLES  1024
+
+/* encoded size of a block column at most (10-byte and 5-byte varints) */
+#define SERIES_TIME_BYTES_MAX   (SERIES_BLOCK_SAMPLES * 10)
+#define SERIES_VALUE_BYTES_MAX  (SERIES_BLOCK_SAMPLES * 5)
+
+/* file path length */
+#define SERIES_PATH_MAX  512
+
+
+/**
+ * Index entry of a block.
+ */
+typedef struct
+{
+  int64_t time_first; /*!< time of the first sample in millisec since epoch */
+  int64_t time_last; /*!< time of the last sample in millisec since epoch */
+  int64_t sum; /*!< sum of the values */
+  uint64_t time_offset; /*!< offset of the block in the time column */
+  uint64_t value_offset; /*!< offset of the block in the value column */
+  uint32_t time_size; /*!< encoded timestamps in bytes */
+  uint32_t value_size; /*!< encoded values in bytes */
+  uint32_t count; /*!< number of samples */
+  int32_t value_first; /*!< value of the first sample */
+  int32_t min; /*!< lowest value */
+  int32_t max; /*!< highest value */
+} series_block_t;
+
+static_assert(sizeof(series_block_t) == 64, "index entries are written as is");
+
+/**
+ * Appending state of a series.
+ */
+typedef struct
+{
+  int index; /*!< index fd */
+  int time; /*!< time column fd */
+  int value; /*!< value column fd */
+  uint64_t time_size; /*!< time column size */
+  uint64_t value_size; /*!< value column size */
+  int64_t time_last; /*!< time of the last sample, INT64_MIN if none */
+  uint32_t count; /*!< samples of the open block */
+  int64_t times[SERIES_BLOCK_SAMPLES]; /*!< open block timestamps */
+  int32_t values[SERIES_BLOCK_SAMPLES]; /*!< open block values */
+} series_writer_t;
+
+/**
+ * Memory-mapped series.
+ */
+typedef struct
+{
+  const uint8_t * index; /*!< index mapping */
+  size_t index_len; /*!< index size */
+  const uint8_t * time; /*!< time column mapping */
+  size_t time_len; /*!< time column size */
+  const uint8_t * value; /*!< value column mapping */
+  size_t value_len; /*!< value column size */
+  const series_block_t * blocks; /*!< index entries */
+  uint32_t block_count; /*!< valid index entries */
+} series_reader_t;
+
+/**
+ * Aggregate of a bucket.
+ */
+typedef struct
+{
+  int64_t start; /*!< start of the bucket in millisec since epoch */
+  uint64_t count; /*!< number of samples */
+  int64_t sum; /*!< sum of the values */
+  int32_t min; /*!< lowest value */
+  int32_t max; /*!< highest value */
+} series_aggregate_t;
+
+/**
+ * Work done by a query.
+ */
+typedef struct
+{
+  uint32_t indexed; /*!< blocks answered from the index */
+  uint32_t decoded; /*!< blocks decoded */
+  uint32_t skipped; /*!< blocks skipped on their min/max */
+} series_query_stats_t;
+
+
+/**
+ * Builds the path of a series file.
+ */
+static inline void series_path(char * path, const char * dir, int32_t node, int32_t child, const char * ext)
+{
+  snprintf(path, SERIES_PATH_MAX, "%s/%d_%d.%s", dir, (int)node, (int)child, ext);
+}
+
+/**
+ * Writes an unsigned LEB128 varint.
+ *
+ * @return position after the varint.
+ */
+static inline uint8_t * series_varint_put(uint8_t * p, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    *p++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (uint8_t)value;
+
+  return p;
+}
+
+/**
+ * Reads an unsigned LEB128 varint.
+ *
+ * @return position after the varint, NULL if truncated.
+ */
+static inline const uint8_t * series_varint_get(const uint8_t * p, const uint8_t * end, uint64_t * value)
+{
+  uint64_t result = 0;
+  int32_t shift;
+
+  /* one byte in the usual case (regular sampling, slow variations) */
+  if ((p < end) && (*p < 0x80))
+  {
+    *value = *p;
+    return p + 1;
+  }
+  for (shift = 0; (p < end) && (shift < 64); shift += 7)
+  {
+    const uint8_t byte = *p++;
+    result |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      *value = result;
+      return p;
+    }
+  }
+
+  return NULL;
+}
+
+static inline uint64_t series_zigzag(int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t series_unzigzag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * Writes a whole buffer.
+ *
+ * @return 0 if ok, -1 if error.
+ */
+static inline int32_t series_write(int fd, const void * buffer, size_t len)
+{
+  const uint8_t * p = (const uint8_t *)buffer;
+
+  while (len > 0)
+  {
+    const ssize_t size = write(fd, p, len);
+    if (size < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    p += size;
+    len -= size;
+  }
+
+  return 0;
+}
+
+/**
+ * Encodes a block.
+ *
+ * @param times timestamps in increasing order.
+ * @param values values.
+ * @param count number of samples (1 to SERIES_BLOCK_SAMPLES).
+ * @param time_bytes output timestamps (SERIES_TIME_BYTES_MAX bytes).
+ * @param value_bytes output values (SERIES_VALUE_BYTES_MAX bytes).
+ * @param block output index entry (without the column offsets).
+ *
+ * @return void.
+ */
+static inline void series_block_encode(const int64_t * times, const int32_t * values, uint32_t count,
+    uint8_t * time_bytes, uint8_t * value_bytes, series_block_t * block)
+{
+  uint8_t * t = time_bytes;
+  uint8_t * v = value_bytes;
+  int64_t delta = 0;
+  uint32_t i;
+
+  block->time_first = times[0];
+  block->time_last = times[count - 1];
+  block->value_first = values[0];
+  block->min = values[0];
+  block->max = values[0];
+  block->sum = values[0];
+  block->count = count;
+
+  for (i = 1; i < count; i++)
+  {
+    const int64_t delta_new = times[i] - times[i - 1];
+    t = series_varint_put(t, series_zigzag(delta_new - delta));
+    delta = delta_new;
+    v = series_varint_put(v, series_zigzag((int64_t)values[i] - values[i - 1]));
+    block->min = (values[i] < block->min) ? values[i] : block->min;
+    block->max = (values[i] > block->max) ? values[i] : block->max;
+    block->sum += values[i];
+  }
+
+  block->time_size = (uint32_t)(t - time_bytes);
+  block->value_size = (uint32_t)(v - value_bytes);
+}
+
+/**
+ * Decodes a block.
+ *
+ * @param reader series.
+ * @param block index entry.
+ * @param times output timestamps (SERIES_BLOCK_SAMPLES).
+ * @param values output values (SERIES_BLOCK_SAMPLES).
+ *
+ * @return number of decoded samples (less than the block count if corrupted).
+ */
+static inline uint32_t series_block_decode(const series_reader_t * reader, const series_block_t * block,
+    int64_t * times, int32_t * values)
+{
+  const uint8_t * t = &reader->time[block->time_offset];
+  const uint8_t * v = &reader->value[block->value_offset];
+  const uint8_t * const t_end = t + block->time_size;
+  const uint8_t * const v_end = v + block->value_size;
+  int64_t time = block->time_first;
+  int64_t delta = 0;
+  int32_t value = block->value_first;
+  uint32_t count = block->count;
+  uint32_t i;
+
+  /* one column at a time: simpler loops, better predicted */
+  times[0] = time;
+  for (i = 1; i < count; i++)
+  {
+    uint64_t dod;
+    t = series_varint_get(t, t_end, &dod);
+    if (t == NULL)
+    {
+      break;
+    }
+    delta += series_unzigzag(dod);
+    time += delta;
+    times[i] = time;
+  }
+  count = i;
+
+  values[0] = value;
+  for (i = 1; i < count; i++)
+  {
+    uint64_t diff;
+    v = series_varint_get(v, v_end, &diff);
+    if (v == NULL)
+    {
+      break;
+    }
+    value += (int32_t)series_unzigzag(diff);
+    values[i] = value;
+  }
+
+  return i;
+}
+
+/**
+ * Opens a series for appending (created if needed). An interrupted append
+ * (columns longer than the index) is rolled back.
+ *
+ * @return 0 if ok, -1 if error.
+ */
+static inline int32_t series_writer_open(series_writer_t * writer, const char * dir, int32_t node, int32_t child)
+{
+  char path[SERIES_PATH_MAX];
+  uint8_t header[SERIES_HEADER_SIZE];
+  struct stat st;
+  int32_t retval = 0;
+
+  writer->count = 0;
+  writer->time_size = 0;
+  writer->value_size = 0;
+  writer->time_last = INT64_MIN;
+
+  series_path(path, dir, node, child, "idx");
+  writer->index = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  series_path(path, dir, node, child, "time");
+  writer->time = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  series_path(path, dir, node, child, "value");
+  writer->value = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if ((writer->index < 0) || (writer->time < 0) || (writer->value < 0) || (fstat(writer->index, &st) != 0))
+  {
+    retval = -1;
+  }
+  else if (st.st_size < SERIES_HEADER_SIZE)
+  {
+    memset(header, 0, sizeof(header));
+    memcpy(header, SERIES_MAGIC, 4);
+    header[4] = SERIES_VERSION;
+    retval = ((ftruncate(writer->index, 0) == 0) && (series_write(writer->index, header, sizeof(header)) == 0)) ? 0 : -1;
+  }
+  else if ((pread(writer->index, header, sizeof(header), 0) != (ssize_t)sizeof(header)) ||
+      (memcmp(header, SERIES_MAGIC, 4) != 0) || (header[4] != SERIES_VERSION))
+  {
+    retval = -1;
+  }
+  else
+  {
+    /* whole entries only, the last one gives the column sizes */
+    const off_t blocks = (st.st_size - SERIES_HEADER_SIZE) / (off_t)sizeof(series_block_t);
+    const off_t size = SERIES_HEADER_SIZE + blocks * (off_t)sizeof(series_block_t);
+    series_block_t block;
+
+    if (blocks > 0)
+    {
+      if (pread(writer->index, &block, sizeof(block), size - sizeof(block)) != (ssize_t)sizeof(block))
+      {
+        retval = -1;
+      }
+      else
+      {
+        writer->time_size = block.time_offset + block.time_size;
+        writer->value_size = block.value_offset + block.value_size;
+        writer->time_last = block.time_last;
+      }
+    }
+    if ((retval == 0) && ((ftruncate(writer->index, size) != 0) ||
+        (ftruncate(writer->time, (off_t)writer->time_size) != 0) ||
+        (ftruncate(writer->value, (off_t)writer->value_size) != 0)))
+    {
+      retval = -1;
+    }
+  }
+
+  return retval;
+}
+
+/**
+ * Writes the open block of a series.
+ *
+ * @return 0 if ok, -1 if error.
+ */
+static inline int32_t series_writer_flush(series_writer_t * writer)
+{
+  static uint8_t time_bytes[SERIES_TIME_BYTES_MAX];
+  static uint8_t value_bytes[SERIES_VALUE_BYTES_MAX];
+  series_block_t block;
+  int32_t retval = 0;
+
+  if (writer->count > 0)
+  {
+    series_block_encode(writer->times, writer->values, writer->count, time_bytes, value_bytes, &block);
+    block.time_offset = writer->time_size;
+    block.value_offset = writer->value_size;
+
+    /* the index entry commits the block */
+    if ((series_write(writer->time, time_bytes, block.time_size) != 0) ||
+        (series_write(writer->value, value_bytes, block.value_size) != 0) ||
+        (series_write(writer->index, &block, sizeof(block)) != 0))
+    {
+      retval = -1;
+    }
+    writer->time_size += block.time_size;
+    writer->value_size += block.value_size;
+    writer->count = 0;
+  }
+
+  return retval;
+}
+
+/**
+ * Appends a sample to a series.
+ *
+ * @param writer series.
+ * @param time time in millisec since epoch, after the last sample.
+ * @param value x10 value.
+ *
+ * @return 0 if ok, -1 if not after the last sample, -2 if write error.
+ */
+static inline int32_t series_writer_append(series_writer_t * writer, int64_t time, int32_t value)
+{
+  if (time <= writer->time_last)
+  {
+    return -1;
+  }
+  writer->times[writer->count] = time;
+  writer->values[writer->count] = value;
+  writer->time_last = time;
+  writer->count++;
+
+  if ((writer->count == SERIES_BLOCK_SAMPLES) && (series_writer_flush(writer) != 0))
+  {
+    return -2;
+  }
+
+  return 0;
+}
+
+/**
+ * Writes the open block and closes a series.
+ *
+ * @return 0 if ok, -1 if error.
+ */
+static inline int32_t series_writer_close(series_writer_t * writer)
+{
+  const int32_t retval = series_writer_flush(writer);
+
+  if (writer->index >= 0)
+  {
+    close(writer->index);
+  }
+  if (writer->time >= 0)
+  {
+    close(writer->time);
+  }
+  if (writer->value >= 0)
+  {
+    close(writer->value);
+  }
+
+  return retval;
+}
+
+/**
+ * Maps a series file.
+ *
+ * @return mapping, NULL if empty or error.
+ */
+static inline const uint8_t * series_map(const char * path, size_t * len)
+{
+  const uint8_t * data = NULL;
+  struct stat st;
+  const int fd = open(path, O_RDONLY);
+
+  *len = 0;
+  if ((fd >= 0) && (fstat(fd, &st) == 0) && (st.st_size > 0))
+  {
+    data = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      data = NULL;
+    }
+    else
+    {
+      *len = st.st_size;
+    }
+  }
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+
+  return data;
+}
+
+/**
+ * Unmaps a series.
+ */
+static inline void series_reader_close(series_reader_t * reader)
+{
+  if (reader->index != NULL)
+  {
+    munmap((void *)reader->index, reader->index_len);
+  }
+  if (reader->time != NULL)
+  {
+    munmap((void *)reader->time, reader->time_len);
+  }
+  if (reader->value != NULL)
+  {
+    munmap((void *)reader->value, reader->value_len);
+  }
+  memset(reader, 0, sizeof(*reader));
+}
+
+/**
+ * Maps a series. Only the blocks whose columns are complete are used.
+ *
+ * @return 0 if ok, -1 if missing or not a series.
+ */
+static inline int32_t series_reader_open(series_reader_t * reader, const char * dir, int32_t node, int32_t child)
+{
+  char path[SERIES_PATH_MAX];
+  uint32_t i;
+
+  memset(reader, 0, sizeof(*reader));
+  series_path(path, dir, node, child, "idx");
+  reader->index = series_map(path, &reader->index_len);
+  series_path(path, dir, node, child, "time");
+  reader->time = series_map(path, &reader->time_len);
+  series_path(path, dir, node, child, "value");
+  reader->value = series_map(path, &reader->value_len);
+
+  if ((reader->index == NULL) || (reader->index_len < SERIES_HEADER_SIZE) ||
+      (memcmp(reader->index, SERIES_MAGIC, 4) != 0) || (reader->index[4] != SERIES_VERSION))
+  {
+    series_reader_close(reader);
+    return -1;
+  }
+
+  reader->blocks = (const series_block_t *)&reader->index[SERIES_HEADER_SIZE];
+  const uint32_t blocks = (uint32_t)((reader->index_len - SERIES_HEADER_SIZE) / sizeof(series_block_t));
+  for (i = 0; i < blocks; i++)
+  {
+    const series_block_t * block = &reader->blocks[i];
+    if ((block->count == 0) || (block->count > SERIES_BLOCK_SAMPLES) ||
+        (block->time_offset + block->time_size > reader->time_len) ||
+        (block->value_offset + block->value_size > reader->value_len))
+    {
+      break;
+    }
+  }
+  reader->block_count = i;
+
+  return 0;
+}
+
+/**
+ * Finds the first block ending at or after a time.
+ *
+ * @return block index, block_count if none.
+ */
+static inline uint32_t series_block_find(const series_reader_t * reader, int64_t time)
+{
+  uint32_t low = 0;
+  uint32_t high = reader->block_count;
+
+  while (low < high)
+  {
+    const uint32_t middle = low + (high - low) / 2;
+    if (reader->blocks[middle].time_last < time)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+/**
+ * Returns the bucket of a time (floor division, buckets aligned on the epoch).
+ */
+static inline int64_t series_bucket(int64_t time, int64_t bucket_ms)
+{
+  return (time >= 0) ? (time / bucket_ms) : -((-time + bucket_ms - 1) / bucket_ms);
+}
+
+/**
+ * Aggregates the samples of a series by time buckets.
+ *
+ * @param reader series.
+ * @param start start of the range in millisec since epoch (included).
+ * @param end end of the range in millisec since epoch (excluded).
+ * @param low lowest value of the samples to aggregate.
+ * @param high highest value of the samples to aggregate.
+ * @param bucket_ms bucket duration, 0 for a single bucket.
+ * @param buckets output buckets (empty ones included), resized by the call.
+ * @param stats output work done (can be NULL).
+ *
+ * @return void.
+ */
+static inline void series_query(const series_reader_t * reader, int64_t start, int64_t end, int32_t low, int32_t high,
+    int64_t bucket_ms, std::vector<series_aggregate_t> & buckets, series_query_stats_t * stats)
+{
+  int64_t times[SERIES_BLOCK_SAMPLES];
+  int32_t values[SERIES_BLOCK_SAMPLES];
+  series_query_stats_t work = { 0, 0, 0 };
+  uint32_t b = series_block_find(reader, start);
+  uint32_t i;
+
+  buckets.clear();
+  if (reader->block_count > 0)
+  {
+    /* no empty buckets outside of the series */
+    start = (start > reader->blocks[0].time_first) ? start : reader->blocks[0].time_first;
+    end = (end <= reader->blocks[reader->block_count - 1].time_last) ? end :
+        (reader->blocks[reader->block_count - 1].time_last + 1);
+  }
+  if (start < end)
+  {
+    const int64_t first = (bucket_ms > 0) ? series_bucket(start, bucket_ms) : 0;
+    const int64_t last = (bucket_ms > 0) ? series_bucket(end - 1, bucket_ms) : 0;
+    buckets.resize((size_t)(last - first + 1));
+    for (i = 0; i < buckets.size(); i++)
+    {
+      buckets[i].start = (bucket_ms > 0) ? ((first + i) * bucket_ms) : start;
+      buckets[i].count = 0;
+      buckets[i].sum = 0;
+      buckets[i].min = INT32_MAX;
+      buckets[i].max = INT32_MIN;
+    }
+
+    for (; (b < reader->block_count) && (reader->blocks[b].time_first < end); b++)
+    {
+      const series_block_t * block = &reader->blocks[b];
+      const int64_t bucket_first = (bucket_ms > 0) ? (series_bucket(block->time_first, bucket_ms) - first) : 0;
+      const int64_t bucket_last = (bucket_ms > 0) ? (series_bucket(block->time_last, bucket_ms) - first) : 0;
+
+      if ((block->max < low) || (block->min > high))
+      {
+        work.skipped++;
+      }
+      else if ((block->time_first >= start) && (block->time_last < end) && (bucket_first == bucket_last) &&
+          (block->min >= low) && (block->max <= high))
+      {
+        /* whole block in the bucket: answered from the index */
+        series_aggregate_t * bucket = &buckets[bucket_first];
+        bucket->count += block->count;
+        bucket->sum += block->sum;
+        bucket->min = (block->min < bucket->min) ? block->min : bucket->min;
+        bucket->max = (block->max > bucket->max) ? block->max : bucket->max;
+        work.indexed++;
+      }
+      else
+      {
+        const uint32_t count = series_block_decode(reader, block, times, values);
+        const int64_t bucket_index = (bucket_first > 0) ? bucket_first : 0;
+        series_aggregate_t * bucket = &buckets[bucket_index];
+        int64_t bucket_end = (bucket_ms > 0) ? ((first + bucket_index + 1) * bucket_ms) : INT64_MAX;
+
+        for (i = 0; (i < count) && (times[i] < start); i++)
+        {
+        }
+        for (; (i < count) && (times[i] < end); i++)
+        {
+          /* increasing times: next bucket without a division */
+          while (times[i] >= bucket_end)
+          {
+            bucket++;
+            bucket_end += bucket_ms;
+          }
+          if ((values[i] >= low) && (values[i] <= high))
+          {
+            bucket->count++;
+            bucket->sum += values[i];
+            bucket->min = (values[i] < bucket->min) ? values[i] : bucket->min;
+            bucket->max = (values[i] > bucket->max) ? values[i] : bucket->max;
+          }
+        }
+        work.decoded++;
+      }
+    }
+  }
+
+  if (stats != NULL)
+  {
+    *stats = work;
+  }
+}
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * @file trace_render.cpp
+ *
+ * @brief Host renderer of the firmware trace log (trace.h): decodes the hex
+ * records of the trace lines of a serial log and prints them with the
+ * format strings of trace_events.h (compiled in).
+ *
+ * Build on the host:
+ *   g++ -std=c++14 -O2 -IInc -ITools Tools/trace_render.cpp -o trace_render
+ *
+ * Usage:
+ *   trace_render [-l] [log...]
+ *     -l  list the event table
+ *   Reads the serial logs (stdin if none): raw MySensors lines, or lines
+ *   prefixed by the host time (ts, mysensors_aggregate -t), the prefix is
+ *   printed before the record. Times are in seconds from the first record
+ *   (the 32-bit microsec time of the firmware is unwrapped).
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "trace_events.h"
+
+/* words of a record before its arguments (see trace.h) */
+#define RENDER_HEADER_WORDS  2
+
+/* longest line */
+#define RENDER_LINE_MAX  1024
+
+
+/**
+ * Event table (from the firmware sources).
+ */
+typedef struct
+{
+  const char * name; /*!< event name */
+  uint32_t args; /*!< number of arguments */
+  const char * format; /*!< format string */
+} render_event_t;
+
+#define RENDER_EVENT(name, args, format)  { #name, (args), (format) },
+static const render_event_t render_events[TRACE_EVENT_NUMBER] = {
+  TRACE_EVENTS(RENDER_EVENT)
+};
+
+/**
+ * Renderer state.
+ */
+typedef struct
+{
+  uint64_t lines; /*!< trace lines */
+  uint64_t invalid; /*!< invalid trace lines */
+  uint64_t records; /*!< rendered records */
+  uint64_t lost; /*!< records lost by the firmware */
+  int32_t started; /*!< first record seen */
+  uint32_t time_last; /*!< last firmware time */
+  int64_t time; /*!< unwrapped time from the first record in microsec */
+} render_t;
+
+
+/**
+ * Parses a hex word.
+ *
+ * @return 0 if ok, -1 if not 8 hex digits.
+ */
+static int32_t render_word(const char * text, uint32_t * word)
+{
+  uint32_t value = 0;
+  int32_t i;
+
+  for (i = 0; i < 8; i++)
+  {
+    const char c = text[i];
+    uint32_t digit;
+
+    if ((c >= '0') && (c <= '9'))
+    {
+      digit = c - '0';
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+      digit = c - 'a' + 10;
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+      digit = c - 'A' + 10;
+    }
+    else
+    {
+      return -1;
+    }
+    value = (value << 4) | digit;
+  }
+  *word = value;
+
+  return 0;
+}
+
+/**
+ * Renders the records of a trace line.
+ *
+ * @param render renderer state.
+ * @param prefix text before the MySensors line (host time), may be empty.
+ * @param hex hex payload.
+ * @param len payload length.
+ *
+ * @return 0 if ok, -1 if invalid (the valid records before are printed).
+ */
+static int32_t render_line(render_t * render, const std::string & prefix, const char * hex, size_t len)
+{
+  uint32_t words[RENDER_HEADER_WORDS + TRACE_ARG_MAX];
+  size_t offset = 0;
+
+  if ((len % 8) != 0)
+  {
+    return -1;
+  }
+
+  while (offset < len)
+  {
+    char text[256];
+    uint32_t i;
+
+    memset(words, 0, sizeof(words));
+    if (render_word(&hex[offset], &words[0]) != 0)
+    {
+      return -1;
+    }
+    const uint32_t event = words[0] & 0xFF;
+    const uint32_t args = (words[0] >> 8) & 0x3;
+    const size_t size = (RENDER_HEADER_WORDS + args) * 8;
+    if ((offset + size > len) || (event >= TRACE_EVENT_NUMBER) || (render_events[event].args != args))
+    {
+      return -1;
+    }
+    for (i = 1; i < RENDER_HEADER_WORDS + args; i++)
+    {
+      if (render_word(&hex[offset + (i * 8)], &words[i]) != 0)
+      {
+        return -1;
+      }
+    }
+    offset += size;
+
+    /* time from the first record, the 32-bit microsec time wraps every 71 min */
+    if (render->started)
+    {
+      render->time += (int32_t)(words[1] - render->time_last);
+    }
+    render->started = 1;
+    render->time_last = words[1];
+
+    snprintf(text, sizeof(text), render_events[event].format, (unsigned)words[2], (unsigned)words[3],
+        (unsigned)words[4]);
+    printf("%s%12.6f  %-14s %s\n", prefix.c_str(), render->time / 1e6, render_events[event].name, text);
+    render->records++;
+    render->lost += (event == TRACE_EVENT_LOST) ? words[2] : 0;
+  }
+
+  return 0;
+}
+
+/**
+ * Renders the trace lines of a log.
+ *
+ * @return void.
+ */
+static void render_file(render_t * render, FILE * file)
+{
+  char header[64];
+  char line[RENDER_LINE_MAX];
+
+  const int header_len = snprintf(header, sizeof(header), "%d;%d;1;0;%d;", TRACE_MYSENSORS_NODE,
+      TRACE_MYSENSORS_CHILD, TRACE_MYSENSORS_TYPE);
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    const char * start = strstr(line, header);
+    size_t len;
+
+    /* trace lines only, at the start of the line or after the host time */
+    if ((start == NULL) || ((start != line) && (start[-1] != ' ') && (start[-1] != '\t')))
+    {
+      continue;
+    }
+    render->lines++;
+
+    const char * hex = start + header_len;
+    for (len = strlen(hex); (len > 0) && ((hex[len - 1] == '\n') || (hex[len - 1] == '\r')); len--)
+    {
+    }
+    if (render_line(render, std::string(line, start - line), hex, len) != 0)
+    {
+      render->invalid++;
+    }
+  }
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  render_t render;
+  int32_t retval = 0;
+  int i;
+
+  memset(&render, 0, sizeof(render));
+
+  if ((argc > 1) && (strcmp(argv[1], "-l") == 0))
+  {
+    for (i = 0; i < TRACE_EVENT_NUMBER; i++)
+    {
+      printf("%3d %-14s %u  \"%s\"\n", i, render_events[i].name, (unsigned)render_events[i].args,
+          render_events[i].format);
+    }
+    return 0;
+  }
+
+  if (argc < 2)
+  {
+    render_file(&render, stdin);
+  }
+  for (i = 1; i < argc; i++)
+  {
+    FILE * file = fopen(argv[i], "r");
+    if (file == NULL)
+    {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      retval = 1;
+      continue;
+    }
+    render_file(&render, file);
+    fclose(file);
+  }
+
+  fprintf(stderr, "%llu trace lines (%llu invalid), %llu records, %llu lost by the firmware\n",
+      (unsigned long long)render.lines, (unsigned long long)render.invalid, (unsigned long long)render.records,
+      (unsigned long long)render.lost);
+
+  return retval;
+}
@@ -0,0 +1,398 @@
+/**
+ * @file tx_check.cpp
+ *
+ * @brief Host check of the LaCrosse transmitter through the platform layer
+ * (platform.h): the transmitter loop is played with a recording policy, the
+ * falling edges are fed to LACROSSE_input_handler() (loopback) and the
+ * decoded frames are decrypted back, the schedule is also played edge by
+ * edge as from a timer interrupt (LACROSSE_output_edge()), the decryption
+ * is checked over all 24-bit values, and the loop is timed with the inlined
+ * host policy and with function pointer hooks.
+ *
+ * Build and run on the host:
+ *   g++ -std=c++14 -O2 -DLACROSSE_HOST -IInc -ITools Tools/tx_check.cpp -o tx_check
+ *   ./tx_check [-n bursts] [-s seed]
+ *     -n  bursts (default 2000)
+ *     -s  random seed (default 0x13579BDF)
+ *
+ * Data Server STM32 - low level application for the Smart Home data acquisition.
+ * Copyright (C) 2020-2021 tuppi-ovh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on Data Server STM32: tuppi.ovh@gmail.com
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* static transmitter loops are instantiated with the check policies */
+#include "../Src/lacrosse.cpp"
+#include "pulse_train.h"
+
+/* sync byte of the transmitted frames */
+#define CHECK_SYNC  0xAA
+
+/* silence before a burst in microsec */
+#define CHECK_GAP_US  10000
+
+
+/**
+ * Recording policy: durations between falling edges (what the receiver
+ * measures) on a virtual clock.
+ */
+struct check_record_tx
+{
+  static std::vector<uint32_t> durations; /*!< durations between falling edges */
+  static int32_t level; /*!< current level */
+  static uint32_t since_fall; /*!< time since the last falling edge in microsec */
+
+  static inline void pin_write(int32_t value)
+  {
+    if ((level == 1) && (value == 0))
+    {
+      durations.push_back(since_fall);
+      since_fall = 0;
+    }
+    level = value;
+  }
+
+  static inline void delay_us(int32_t delay)
+  {
+    since_fall += (uint32_t)delay;
+  }
+};
+
+std::vector<uint32_t> check_record_tx::durations;
+int32_t check_record_tx::level = 0;
+uint32_t check_record_tx::since_fall = 0;
+
+/* hooks of the previous design (runtime function pointers, not inlined) */
+static void (* volatile check_hook_pin)(int32_t) = NULL;
+static void (* volatile check_hook_sleep)(int32_t) = NULL;
+
+/**
+ * Pin hook: same as the host policy.
+ */
+static void __attribute__((noinline)) check_pin_switch(int32_t level)
+{
+  platform_radio_tx::pin_write(level);
+}
+
+/**
+ * Sleep hook: same as the host policy.
+ */
+static void __attribute__((noinline)) check_sleep_us(int32_t delay)
+{
+  platform_radio_tx::delay_us(delay);
+}
+
+/**
+ * Policy calling through the hooks.
+ */
+struct check_hook_tx
+{
+  static inline void pin_write(int32_t level)
+  {
+    check_hook_pin(level);
+  }
+
+  static inline void delay_us(int32_t delay)
+  {
+    check_hook_sleep(delay);
+  }
+};
+
+
+/**
+ * Returns a monotonic time in nanosec.
+ */
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Plays bursts through the loopback and decodes them.
+ *
+ * @param bursts number of bursts.
+ * @param random random generator of the data.
+ * @param frames output number of decoded frames.
+ *
+ * @return number of errors (durations different from the schedule, wrong frames, bursts not decoded).
+ */
+static uint32_t loopback(uint32_t bursts, pulse_random_t * random, uint64_t * frames)
+{
+  LACROSSE_schedule_t schedule;
+  std::vector<uint32_t> reference;
+  uint32_t errors = 0;
+  uint32_t i;
+  size_t k;
+
+  LACROSSE_calib_reset();
+  LACROSSE_flush();
+  *frames = 0;
+
+  for (i = 0; i < bursts; i++)
+  {
+    const uint32_t data = pulse_random(random) & 0xFFFFFF;
+    const uint32_t expected = (CHECK_SYNC << 24) | LACROSSE_encrypt_24bits(data);
+    uint32_t decoded = 0;
+
+    /* durations of the schedule as seen by the receiver */
+    reference.clear();
+    pulse_train_lacrosse(reference, CHECK_SYNC, data, CHECK_GAP_US);
+
+    /* same burst played by the transmitter loop */
+    check_record_tx::durations.clear();
+    check_record_tx::level = 0;
+    check_record_tx::since_fall = CHECK_GAP_US;
+    LACROSSE_schedule_build(&schedule, CHECK_SYNC, data);
+    output_send<check_record_tx>(&schedule);
+
+    errors += (check_record_tx::durations != reference) ? 1 : 0;
+    errors += (check_record_tx::level != 0) ? 1 : 0;
+
+    /* receiver */
+    for (k = 0; k <= check_record_tx::durations.size(); k++)
+    {
+      const uint32_t value = (k < check_record_tx::durations.size()) ?
+          LACROSSE_input_handler(check_record_tx::durations[k]) : LACROSSE_flush();
+      if (value != 0xFFFFFFFFu)
+      {
+        errors += (value != expected) ? 1 : 0;
+        errors += (LACROSSE_decrypt_24bits(value & 0xFFFFFF) != data) ? 1 : 0;
+        decoded++;
+      }
+    }
+    errors += (decoded == 0) ? 1 : 0;
+    *frames += decoded;
+  }
+
+  return errors;
+}
+
+/**
+ * Plays bursts edge by edge as a timer interrupt would do
+ * (LACROSSE_output_start(), LACROSSE_output_edge() on the host platform) 
+ * and decodes them.
+ *
+ * @param bursts number of bursts.
+ * @param random random generator of the data.
+ * @param frames output number of decoded frames.
+ *
+ * @return number of errors (durations different from the schedule, wrong frames, bursts not decoded).
+ */
+static uint32_t edge_loopback(uint32_t bursts, pulse_random_t * random, uint64_t * frames)
+{
+  std::vector<uint32_t> reference;
+  std::vector<uint32_t> durations;
+  uint32_t errors = 0;
+  uint32_t i;
+  size_t k;
+
+  LACROSSE_init();
+  LACROSSE_calib_reset();
+  LACROSSE_flush();
+  *frames = 0;
+
+  for (i = 0; i < bursts; i++)
+  {
+    const uint32_t data = pulse_random(random) & 0xFFFFFF;
+    uint32_t decoded = 0;
+
+    reference.clear();
+    pulse_train_lacrosse(reference, CHECK_SYNC, data, CHECK_GAP_US);
+
+    /* falling edges seen on the pin between the timer interrupts */
+    durations.clear();
+    uint32_t since_fall = CHECK_GAP_US;
+    uint32_t level = 0;
+    uint32_t duration = LACROSSE_output_start(CHECK_SYNC, data);
+    while (duration != 0)
+    {
+      const uint32_t level_new = platform_radio_tx::port()->level & PLATFORM_RADIO_TX_PIN;
+      if ((level != 0) && (level_new == 0))
+      {
+        durations.push_back(since_fall);
+        since_fall = 0;
+      }
+      level = level_new;
+      since_fall += duration;
+      duration = LACROSSE_output_edge();
+    }
+
+    errors += (durations != reference) ? 1 : 0;
+    errors += ((platform_radio_tx::port()->level & PLATFORM_RADIO_TX_PIN) != 0) ? 1 : 0;
+
+    for (k = 0; k <= durations.size(); k++)
+    {
+      const uint32_t value = (k < durations.size()) ? LACROSSE_input_handler(durations[k]) : LACROSSE_flush();
+      if (value != 0xFFFFFFFFu)
+      {
+        errors += ((value >> 24) != CHECK_SYNC) ? 1 : 0;
+        errors += (LACROSSE_decrypt_24bits(value & 0xFFFFFF) != data) ? 1 : 0;
+        decoded++;
+      }
+    }
+    errors += (decoded == 0) ? 1 : 0;
+    *frames += decoded;
+  }
+
+  return errors;
+}
+
+/**
+ * Checks that LACROSSE_decrypt_24bits() inverts LACROSSE_encrypt_24bits() 
+ * for all 24-bit values.
+ *
+ * @return number of errors.
+ */
+static uint32_t cipher_check(void)
+{
+  uint32_t errors = 0;
+  uint32_t data;
+
+  for (data = 0; data <= 0xFFFFFF; data++)
+  {
+    errors += (LACROSSE_decrypt_24bits(LACROSSE_encrypt_24bits(data)) != data) ? 1 : 0;
+  }
+
+  return errors;
+}
+
+/**
+ * Checks the transmitter of the host platform (LACROSSE_init(), LACROSSE_output_send()).
+ *
+ * @param duration_us output duration of a burst on the virtual clock.
+ *
+ * @return number of errors.
+ */
+static uint32_t platform_check(uint64_t * duration_us)
+{
+  LACROSSE_schedule_t schedule;
+  int32_t level;
+  uint32_t duration;
+  uint64_t expected = 0;
+  uint32_t errors = 0;
+
+  LACROSSE_init();
+  errors += ((platform_radio_tx::port()->output & PLATFORM_RADIO_TX_PIN) == 0) ? 1 : 0;
+
+  LACROSSE_schedule_build(&schedule, CHECK_SYNC, 0x123456);
+  while (LACROSSE_schedule_next(&schedule, &level, &duration) == 0)
+  {
+    expected += duration;
+  }
+
+  const uint64_t start = platform_radio_tx::timer()->now_us;
+  LACROSSE_output_send(CHECK_SYNC, 0x123456);
+  *duration_us = platform_radio_tx::timer()->now_us - start;
+
+  errors += (*duration_us != expected) ? 1 : 0;
+  errors += ((platform_radio_tx::port()->level & PLATFORM_RADIO_TX_PIN) != 0) ? 1 : 0;
+
+  return errors;
+}
+
+/**
+ * Times the transmitter loop with a policy.
+ *
+ * @tparam policy transmitter policy.
+ * @param name policy name.
+ * @param bursts number of bursts.
+ *
+ * @return void.
+ */
+template <typename policy>
+static void bench(const char * name, uint32_t bursts)
+{
+  LACROSSE_schedule_t schedule;
+  uint32_t i;
+
+  LACROSSE_schedule_build(&schedule, CHECK_SYNC, 0x123456);
+  const uint32_t writes = platform_radio_tx::port()->writes;
+
+  const uint64_t start = time_ns();
+  for (i = 0; i < bursts; i++)
+  {
+    schedule.index = 0;
+    schedule.repeat = 0;
+    output_send<policy>(&schedule);
+  }
+  const uint64_t stop = time_ns();
+
+  const uint32_t edges = platform_radio_tx::port()->writes - writes;
+  printf("%-14s %8.3f ns/edge (%u edges)\n", name, (double)(stop - start) / ((edges != 0) ? edges : 1),
+      (unsigned)edges);
+}
+
+/**
+ * Entry point.
+ */
+int main(int argc, char ** argv)
+{
+  uint32_t bursts = 2000;
+  pulse_random_t random = { 0x13579BDFu };
+  uint64_t frames = 0;
+  uint64_t frames_edge = 0;
+  uint64_t duration_us = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      bursts = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      random.state = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n bursts] [-s seed]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (random.state == 0)
+  {
+    return 1;
+  }
+
+  const uint32_t errors_loopback = loopback(bursts, &random, &frames);
+  const uint32_t errors_edge = edge_loopback(bursts, &random, &frames_edge);
+  const uint32_t errors_cipher = cipher_check();
+  const uint32_t errors_platform = platform_check(&duration_us);
+  const uint32_t errors = errors_loopback + errors_edge + errors_cipher + errors_platform;
+
+  printf("loopback       %u bursts, %llu frames, %u errors\n", (unsigned)bursts, (unsigned long long)frames,
+      (unsigned)errors_loopback);
+  printf("edge loopback  %u bursts, %llu frames, %u errors\n", (unsigned)bursts, (unsigned long long)frames_edge,
+      (unsigned)errors_edge);
+  printf("decryption     %u values, %u errors\n", 0x1000000u, (unsigned)errors_cipher);
+  printf("host platform  %llu us per burst (virtual clock), %u errors\n", (unsigned long long)duration_us,
+      (unsigned)errors_platform);
+
+  check_hook_pin = check_pin_switch;
+  check_hook_sleep = check_sleep_us;
+  bench<platform_radio_tx>("inlined", bursts);
+  bench<check_hook_tx>("hooks", bursts);
+
+  printf("result         %s\n", (errors == 0) ? "ok" : "FAILED");
+
+  return (errors == 0) ? 0 : 1;
+}